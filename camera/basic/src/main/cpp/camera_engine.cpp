@@ -20,10 +20,41 @@
 
 #include "camera_engine.h"
 
+#include <android/hardware_buffer.h>
+
+#include <algorithm>
+#include <cinttypes>
 #include <cstdio>
+#include <cstring>
+#include <thread>
 
 #include "utils/native_debug.h"
 
+/*
+ * Present preview frames straight from the camera buffers when the OS
+ * supports it (API 29+), instead of converting them on the CPU.
+ */
+static const bool kPreferZeroCopyPreview = true;
+
+/*
+ * Without zero copy, convert preview frames on worker threads, overlapping
+ * with acquiring the next frame and presenting the previous one, instead of
+ * serially in DrawFrame().
+ */
+static const bool kPipelinedCpuPreview = true;
+
+/*
+ * Depth of each pipeline queue: frames waiting to be converted and frames
+ * waiting to be presented. Kept small, every queued frame adds latency and
+ * holds one of the reader's images.
+ */
+static const int32_t kPipelineQueueDepth = 1;
+
+/*
+ * Period of the preview frame statistics reports
+ */
+static const int64_t kPreviewStatsPeriodNs = 1000000000LL;
+
 /**
  * constructor and destructor for main application class
  * @param app native_app_glue environment
@@ -36,7 +67,9 @@ CameraEngine::CameraEngine(android_app* app)
       cameraReady_(false),
       camera_(nullptr),
       yuvReader_(nullptr),
-      jpgReader_(nullptr) {
+      jpgReader_(nullptr),
+      preview_(nullptr),
+      pipeline_(nullptr) {
   memset(&savedNativeWinRes_, 0, sizeof(savedNativeWinRes_));
 }
 
@@ -87,8 +120,7 @@ void CameraEngine::CreateCamera(void) {
       app_->window, portraitNativeWindow ? view.height : view.width,
       portraitNativeWindow ? view.width : view.height, WINDOW_FORMAT_RGBA_8888);
 
-  yuvReader_ = new ImageReader(&view, AIMAGE_FORMAT_YUV_420_888);
-  yuvReader_->SetPresentRotation(imageRotation);
+  CreatePreview(&view, imageRotation);
   jpgReader_ = new ImageReader(&capture, AIMAGE_FORMAT_JPEG);
   jpgReader_->SetPresentRotation(imageRotation);
   jpgReader_->RegisterCallback(
@@ -101,13 +133,133 @@ void CameraEngine::CreateCamera(void) {
                          jpgReader_->GetNativeWindow(), imageRotation);
 }
 
+/**
+ * Create the preview ImageReader: zero copy through the display when
+ * possible, otherwise YUV images converted into the app window on the CPU.
+ */
+void CameraEngine::CreatePreview(ImageFormat* view, int32_t imageRotation) {
+  if (kPreferZeroCopyPreview) {
+    if (__builtin_available(android 29, *)) {
+      yuvReader_ = new ImageReader(view, AIMAGE_FORMAT_PRIVATE,
+                                   AHARDWAREBUFFER_USAGE_GPU_SAMPLED_IMAGE |
+                                       AHARDWAREBUFFER_USAGE_COMPOSER_OVERLAY);
+      preview_ = new HardwareBufferPreview(
+          app_->window, savedNativeWinRes_.width, savedNativeWinRes_.height,
+          imageRotation, yuvReader_->GetMaxImages());
+      if (preview_->IsValid()) {
+        LOGI("Preview: zero copy");
+        previewStats_.Reset(FrameClockNs());
+        preview_->SetFrameStats(&previewStats_);
+        yuvReader_->SetFrameStats(&previewStats_);
+        return;
+      }
+      delete preview_;
+      preview_ = nullptr;
+      delete yuvReader_;
+      yuvReader_ = nullptr;
+    }
+  }
+
+  LOGI("Preview: CPU conversion");
+  yuvReader_ = new ImageReader(view, AIMAGE_FORMAT_YUV_420_888);
+  yuvReader_->SetPresentRotation(imageRotation);
+  previewStats_.Reset(FrameClockNs());
+  yuvReader_->SetFrameStats(&previewStats_);
+  if (kPipelinedCpuPreview) {
+    CreatePreviewPipeline();
+  }
+}
+
+/**
+ * Run the CPU preview as acquire -> convert -> present stages on their own
+ * threads; the conversion workers each convert whole frames, split in bands
+ * with the reader's converter threads, which they share. Together they get
+ * the cores the acquire and present threads leave.
+ */
+void CameraEngine::CreatePreviewPipeline(void) {
+  int32_t cores =
+      std::max(1, static_cast<int32_t>(std::thread::hardware_concurrency()));
+  PreviewPipeline::Config config;
+  config.width = ANativeWindow_getWidth(app_->window);
+  config.height = ANativeWindow_getHeight(app_->window);
+  config.workers = cores >= 4 ? 2 : 1;
+  config.queueDepth = kPipelineQueueDepth;
+  yuvReader_->SetConverterThreads(std::max(1, cores - 2 * config.workers + 1));
+
+  ImageReader* reader = yuvReader_;
+  pipeline_ = new PreviewPipeline(
+      config, [reader]() -> void* { return reader->GetLatestImage(); },
+      [reader](void* source, uint32_t* pixels, int32_t width,
+               int32_t height) {
+        ANativeWindow_Buffer buf;
+        memset(&buf, 0, sizeof(buf));
+        buf.width = width;
+        buf.height = height;
+        buf.stride = width;
+        buf.format = WINDOW_FORMAT_RGBA_8888;
+        buf.bits = pixels;
+        reader->DisplayImage(&buf, static_cast<AImage*>(source));
+      },
+      [reader](void* source) {
+        reader->DeleteImage(static_cast<AImage*>(source));
+      },
+      [this](const uint32_t* pixels, int32_t width, int32_t height) {
+        PresentPipelineFrame(pixels, width, height);
+      });
+  pipeline_->SetFrameStats(&previewStats_);
+  PreviewPipeline* pipeline = pipeline_;
+  yuvReader_->RegisterImageAvailableCallback(
+      [pipeline]() { pipeline->NotifyFrameAvailable(); });
+  pipeline_->Start();
+  LOGI("Preview: pipelined, %d conversion workers", config.workers);
+}
+
+/**
+ * Present stage of the preview pipeline: copy a converted frame into the
+ * app window.
+ */
+void CameraEngine::PresentPipelineFrame(const uint32_t* pixels, int32_t width,
+                                        int32_t height) {
+  ANativeWindow_Buffer buf;
+  if (ANativeWindow_lock(app_->window, &buf, nullptr) < 0) {
+    return;
+  }
+  int32_t rows = std::min(height, buf.height);
+  size_t rowBytes = std::min(width, buf.width) * sizeof(uint32_t);
+  uint32_t* out = static_cast<uint32_t*>(buf.bits);
+  for (int32_t y = 0; y < rows; y++) {
+    memcpy(out + static_cast<size_t>(y) * buf.stride,
+           pixels + static_cast<size_t>(y) * width, rowBytes);
+  }
+  ANativeWindow_unlockAndPost(app_->window);
+}
+
 void CameraEngine::DeleteCamera(void) {
   cameraReady_ = false;
   if (camera_) {
     delete camera_;
     camera_ = nullptr;
   }
+  if (pipeline_) {
+    delete pipeline_;
+    pipeline_ = nullptr;
+  }
+  // the preview still holds images of yuvReader_
+  if (preview_) {
+    if (__builtin_available(android 29, *)) {
+      delete preview_;
+    }
+    preview_ = nullptr;
+  }
   if (yuvReader_) {
+    for (PreviewMetric metric :
+         {PreviewMetric::SENSOR_INTERVAL, PreviewMetric::FRAME_CPU_TIME}) {
+      FrameSummary m = previewStats_.Session(metric);
+      LOGI("Preview session %s: %u frames, mean %.3f ms, p50 %.3f, p90 %.3f, "
+           "p99 %.3f, max %.3f",
+           FrameStats::MetricName(metric), m.count, m.mean_ns / 1e6,
+           m.p50_ns / 1e6, m.p90_ns / 1e6, m.p99_ns / 1e6, m.max_ns / 1e6);
+    }
     delete yuvReader_;
     yuvReader_ = nullptr;
   }
@@ -151,23 +303,90 @@ void CameraEngine::OnCameraParameterChanged(int32_t code, int64_t val) {
 
 /**
  * The main function rendering a frame. In our case, it is yuv to RGBA8888
- * converter
+ * converter, or handing the camera buffer to the display in zero copy mode.
  */
 void CameraEngine::DrawFrame(void) {
   if (!cameraReady_ || !yuvReader_) return;
+
+  if (pipeline_) {
+    // frames are drawn by the pipeline threads
+    ReportFrameStats();
+    return;
+  }
+
+  int64_t cpuStart = FrameClockNs(CLOCK_THREAD_CPUTIME_ID);
+  bool drawn = preview_ ? DrawFrameZeroCopy() : DrawFrameCpu();
+  if (drawn) {
+    previewStats_.Record(PreviewMetric::FRAME_CPU_TIME,
+                         FrameClockNs(CLOCK_THREAD_CPUTIME_ID) - cpuStart);
+  }
+  ReportFrameStats();
+}
+
+bool CameraEngine::DrawFrameZeroCopy(void) {
+  if (__builtin_available(android 29, *)) {
+    int fenceFd = -1;
+    AImage* image = yuvReader_->GetLatestImageAsync(&fenceFd);
+    if (!image) {
+      return false;
+    }
+    return preview_->Present(image, fenceFd, FrameClockNs());
+  }
+  return false;
+}
+
+bool CameraEngine::DrawFrameCpu(void) {
   AImage* image = yuvReader_->GetNextImage();
   if (!image) {
-    return;
+    return false;
   }
+  int64_t acquireNs = FrameClockNs();
 
   ANativeWindow_acquire(app_->window);
   ANativeWindow_Buffer buf;
   if (ANativeWindow_lock(app_->window, &buf, nullptr) < 0) {
     yuvReader_->DeleteImage(image);
-    return;
+    ANativeWindow_release(app_->window);
+    previewStats_.OnImageDropped(1);
+    return false;
   }
 
   yuvReader_->DisplayImage(&buf, image);
   ANativeWindow_unlockAndPost(app_->window);
   ANativeWindow_release(app_->window);
+
+  previewStats_.OnFramePresented();
+  previewStats_.Record(PreviewMetric::PRESENT_LATENCY,
+                       FrameClockNs() - acquireNs);
+  return true;
+}
+
+const FrameStats& CameraEngine::GetPreviewStats(void) const {
+  return previewStats_;
+}
+
+/**
+ * Log a summary of the preview frame statistics once per period
+ */
+void CameraEngine::ReportFrameStats(void) {
+  FrameStatsReport report;
+  if (!previewStats_.TakeReport(FrameClockNs(), kPreviewStatsPeriodNs,
+                                &report)) {
+    return;
+  }
+
+  LOGI("Preview(%s): %.1f fps, arrived %" PRIu64 ", acquired %" PRIu64
+       ", dropped %" PRIu64,
+       preview_ ? "zero copy" : (pipeline_ ? "pipelined CPU" : "CPU"),
+       report.presented * 1e9 / report.periodNs, report.arrived,
+       report.acquired, report.dropped);
+  for (int32_t i = 0; i < static_cast<int32_t>(PreviewMetric::MAX_METRIC);
+       i++) {
+    const FrameSummary& m = report.metrics[i];
+    if (!m.count) continue;
+    LOGI("  %s: mean %.3f ms, p50 %.3f, p90 %.3f, p99 %.3f, max %.3f",
+         FrameStats::MetricName(static_cast<PreviewMetric>(i)),
+         m.mean_ns / 1e6, m.p50_ns / 1e6, m.p90_ns / 1e6, m.p99_ns / 1e6,
+         m.max_ns / 1e6);
+  }
 }
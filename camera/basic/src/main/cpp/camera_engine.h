@@ -25,6 +25,9 @@
 #include <thread>
 
 #include "camera_manager.h"
+#include "frame_stats.h"
+#include "hardware_buffer_preview.h"
+#include "preview_pipeline.h"
 
 /**
  * basic CameraAppEngine
@@ -58,9 +61,19 @@ class CameraEngine {
   void CreateCamera(void);
   void DeleteCamera(void);
 
+  // Preview frame accounting, for tuning maxImages and preview resolution
+  const FrameStats& GetPreviewStats(void) const;
+
  private:
   void OnPhotoTaken(const char* fileName);
   int GetDisplayRotation(void);
+  void CreatePreview(ImageFormat* view, int32_t imageRotation);
+  void CreatePreviewPipeline(void);
+  void PresentPipelineFrame(const uint32_t* pixels, int32_t width,
+                            int32_t height);
+  bool DrawFrameCpu(void);
+  bool DrawFrameZeroCopy(void);
+  void ReportFrameStats(void);
 
   struct android_app* app_;
   ImageFormat savedNativeWinRes_;
@@ -70,6 +83,10 @@ class CameraEngine {
   NDKCamera* camera_;
   ImageReader* yuvReader_;
   ImageReader* jpgReader_;
+  HardwareBufferPreview* preview_;  // nullptr: CPU conversion preview
+  PreviewPipeline* pipeline_;       // pipelined CPU conversion preview
+
+  FrameStats previewStats_;
 };
 
 /**
@@ -0,0 +1,155 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef CAMERA_FRAME_QUEUE_H
+#define CAMERA_FRAME_QUEUE_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+/*
+ * FrameQueue:
+ *   Bounded lock-free multi-producer/multi-consumer queue of small trivially
+ *   copyable items (frame pointers), after Dmitry Vyukov's bounded MPMC
+ *   queue: every cell carries a sequence number telling producers and
+ *   consumers whose turn it is, so no operation ever takes a lock.
+ *   Capacity is rounded up to a power of two, and to at least 2: with a
+ *   single cell, "full" and "empty for the next push" carry the same
+ *   sequence number.
+ */
+template <typename T>
+class FrameQueue {
+ public:
+  explicit FrameQueue(uint32_t capacity)
+      : cells_(RoundUp(capacity)), mask_(cells_.size() - 1) {
+    for (size_t i = 0; i < cells_.size(); i++) {
+      cells_[i].sequence.store(i, std::memory_order_relaxed);
+    }
+    head_.store(0, std::memory_order_relaxed);
+    tail_.store(0, std::memory_order_relaxed);
+  }
+
+  bool TryPush(T item) {
+    size_t pos = tail_.load(std::memory_order_relaxed);
+    while (true) {
+      Cell& cell = cells_[pos & mask_];
+      size_t seq = cell.sequence.load(std::memory_order_acquire);
+      intptr_t diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos);
+      if (diff == 0) {
+        if (tail_.compare_exchange_weak(pos, pos + 1,
+                                        std::memory_order_relaxed)) {
+          cell.item = item;
+          cell.sequence.store(pos + 1, std::memory_order_release);
+          return true;
+        }
+      } else if (diff < 0) {
+        return false;  // full
+      } else {
+        pos = tail_.load(std::memory_order_relaxed);
+      }
+    }
+  }
+
+  bool TryPop(T* item) {
+    size_t pos = head_.load(std::memory_order_relaxed);
+    while (true) {
+      Cell& cell = cells_[pos & mask_];
+      size_t seq = cell.sequence.load(std::memory_order_acquire);
+      intptr_t diff =
+          static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos + 1);
+      if (diff == 0) {
+        if (head_.compare_exchange_weak(pos, pos + 1,
+                                        std::memory_order_relaxed)) {
+          *item = cell.item;
+          cell.sequence.store(pos + mask_ + 1, std::memory_order_release);
+          return true;
+        }
+      } else if (diff < 0) {
+        return false;  // empty
+      } else {
+        pos = head_.load(std::memory_order_relaxed);
+      }
+    }
+  }
+
+  /**
+   * Push item, making room by popping the oldest items when the queue is
+   * full: back-pressure drops stale frames, never the newest one.
+   * @param evict called with every item removed to make room
+   */
+  template <typename Evict>
+  void PushEvictOldest(T item, Evict evict) {
+    while (!TryPush(item)) {
+      T oldest;
+      if (TryPop(&oldest)) evict(oldest);
+    }
+  }
+
+  size_t Capacity(void) const { return cells_.size(); }
+
+ private:
+  struct Cell {
+    std::atomic<size_t> sequence;
+    T item;
+  };
+
+  static size_t RoundUp(uint32_t n) {
+    size_t size = 2;
+    while (size < n) size <<= 1;
+    return size;
+  }
+
+  std::vector<Cell> cells_;
+  const size_t mask_;
+  alignas(64) std::atomic<size_t> head_;
+  alignas(64) std::atomic<size_t> tail_;
+};
+
+/*
+ * Doorbell:
+ *   Lets a pipeline stage sleep while its input queue is empty. Producers
+ *   Ring() after pushing; the queues themselves stay lock free.
+ */
+class Doorbell {
+ public:
+  Doorbell() : rings_(0) {}
+
+  void Ring(void) {
+    {
+      std::lock_guard<std::mutex> lock(lock_);
+      rings_++;
+    }
+    cond_.notify_all();
+  }
+
+  // Wait for a Ring() after the previous Wait(), or the timeout
+  void Wait(std::chrono::milliseconds timeout) {
+    std::unique_lock<std::mutex> lock(lock_);
+    cond_.wait_for(lock, timeout, [this] { return rings_ != 0; });
+    rings_ = 0;
+  }
+
+ private:
+  std::mutex lock_;
+  std::condition_variable cond_;
+  uint64_t rings_;
+};
+
+#endif  // CAMERA_FRAME_QUEUE_H
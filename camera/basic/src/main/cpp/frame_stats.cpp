@@ -0,0 +1,119 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "frame_stats.h"
+
+FrameStats::FrameStats() : maxPending_(0) { Reset(0); }
+
+void FrameStats::Reset(int64_t nowNs) {
+  {
+    std::lock_guard<std::mutex> lock(lock_);
+    for (auto& h : period_) frame_histogram_reset(&h);
+    for (auto& h : session_) frame_histogram_reset(&h);
+  }
+  lastArrivalNs_ = 0;
+  arrived_ = 0;
+  acquired_ = 0;
+  dropped_ = 0;
+  presented_ = 0;
+  lastSensorTimestampNs_ = 0;
+  periodStartNs_ = nowNs;
+  pending_ = 0;
+}
+
+void FrameStats::SetMaxPending(uint32_t images) { maxPending_ = images; }
+
+void FrameStats::OnImageArrived(int64_t nowNs) {
+  lastArrivalNs_.store(nowNs, std::memory_order_relaxed);
+  arrived_.fetch_add(1, std::memory_order_relaxed);
+}
+
+void FrameStats::OnImageAcquired(int64_t nowNs, int64_t sensorTimestampNs) {
+  acquired_.fetch_add(1, std::memory_order_relaxed);
+  int64_t arrival = lastArrivalNs_.load(std::memory_order_relaxed);
+  if (arrival && nowNs >= arrival) {
+    Record(PreviewMetric::ACQUIRE_LATENCY, nowNs - arrival);
+  }
+  if (lastSensorTimestampNs_ && sensorTimestampNs > lastSensorTimestampNs_) {
+    Record(PreviewMetric::SENSOR_INTERVAL,
+           sensorTimestampNs - lastSensorTimestampNs_);
+  }
+  lastSensorTimestampNs_ = sensorTimestampNs;
+}
+
+void FrameStats::OnImageDropped(uint32_t count) {
+  dropped_.fetch_add(count, std::memory_order_relaxed);
+}
+
+void FrameStats::OnFramePresented(void) {
+  presented_.fetch_add(1, std::memory_order_relaxed);
+}
+
+void FrameStats::Record(PreviewMetric metric, int64_t ns) {
+  std::lock_guard<std::mutex> lock(lock_);
+  frame_histogram_record(&period_[static_cast<int32_t>(metric)], ns);
+  frame_histogram_record(&session_[static_cast<int32_t>(metric)], ns);
+}
+
+bool FrameStats::TakeReport(int64_t nowNs, int64_t periodNs,
+                            FrameStatsReport* report) {
+  if (nowNs - periodStartNs_ < periodNs) return false;
+
+  report->periodNs = nowNs - periodStartNs_;
+  report->arrived = arrived_.exchange(0);
+  report->acquired = acquired_.exchange(0);
+  report->presented = presented_.exchange(0);
+  // images the reader replaced before the app got to them are not reported
+  // individually. Of the images that arrived but were not acquired, up to
+  // maxPending_ may still be in the reader: carry those over, as they are
+  // usually acquired early in the next period, and count the rest
+  report->dropped = dropped_.exchange(0);
+  uint64_t unmatched = pending_ + report->arrived;
+  unmatched = unmatched > report->acquired ? unmatched - report->acquired : 0;
+  pending_ = unmatched < maxPending_ ? unmatched : maxPending_;
+  report->dropped += unmatched - pending_;
+  std::lock_guard<std::mutex> lock(lock_);
+  for (int32_t i = 0; i < static_cast<int32_t>(PreviewMetric::MAX_METRIC);
+       i++) {
+    frame_histogram_summarize(&period_[i], &report->metrics[i]);
+    frame_histogram_reset(&period_[i]);
+  }
+  periodStartNs_ = nowNs;
+  return true;
+}
+
+FrameSummary FrameStats::Session(PreviewMetric metric) const {
+  FrameSummary summary;
+  std::lock_guard<std::mutex> lock(lock_);
+  frame_histogram_summarize(&session_[static_cast<int32_t>(metric)], &summary);
+  return summary;
+}
+
+const char* FrameStats::MetricName(PreviewMetric metric) {
+  switch (metric) {
+    case PreviewMetric::SENSOR_INTERVAL:
+      return "sensor interval";
+    case PreviewMetric::ACQUIRE_LATENCY:
+      return "acquire latency";
+    case PreviewMetric::CONVERSION_TIME:
+      return "conversion";
+    case PreviewMetric::FRAME_CPU_TIME:
+      return "frame cpu";
+    case PreviewMetric::PRESENT_LATENCY:
+      return "present latency";
+    default:
+      return "unknown";
+  }
+}
@@ -0,0 +1,109 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef CAMERA_FRAME_STATS_H
+#define CAMERA_FRAME_STATS_H
+
+#include <atomic>
+#include <cstdint>
+#include <ctime>
+#include <mutex>
+
+#include "frame_timing.h"
+
+/**
+ * Current time of the given clock, in nanoseconds
+ */
+inline int64_t FrameClockNs(clockid_t clock = CLOCK_MONOTONIC) {
+  struct timespec ts;
+  clock_gettime(clock, &ts);
+  return static_cast<int64_t>(ts.tv_sec) * 1000000000LL + ts.tv_nsec;
+}
+
+enum class PreviewMetric : int32_t {
+  SENSOR_INTERVAL = 0,  // delta between sensor timestamps of used frames
+  ACQUIRE_LATENCY,      // image available -> acquired by the app
+  CONVERSION_TIME,      // YUV -> RGBA conversion (CPU preview only)
+  FRAME_CPU_TIME,       // app thread CPU time spent per preview frame
+  PRESENT_LATENCY,      // acquired -> posted (CPU) / latched (zero copy)
+  MAX_METRIC
+};
+
+/*
+ * FrameStatsReport:
+ *   Summary of one reporting period
+ */
+struct FrameStatsReport {
+  int64_t periodNs;
+  uint64_t arrived;    // images the camera delivered to the reader
+  uint64_t acquired;   // images the app took from the reader
+  uint64_t dropped;    // images skipped by the reader or the app
+  uint64_t presented;  // frames that reached the display
+  FrameSummary metrics[static_cast<int32_t>(PreviewMetric::MAX_METRIC)];
+};
+
+/*
+ * FrameStats:
+ *   Preview frame accounting, fed by ImageReader and CameraEngine. Every
+ *   metric keeps a histogram of the current period (reset by
+ *   TakeReport()) and one over the whole session, for tuning maxImages and
+ *   the preview resolution. The histograms are the FrameHistogram of
+ *   common/frame_timing, behind a lock: they are recorded from the reader
+ *   callback, the app and the presenting threads. No NDK dependency.
+ */
+class FrameStats {
+ public:
+  FrameStats();
+
+  void Reset(int64_t nowNs);
+  // images the reader can hold before the app acquires them
+  void SetMaxPending(uint32_t images);
+
+  // camera side: called from the AImageReader callback thread
+  void OnImageArrived(int64_t nowNs);
+  // app side
+  void OnImageAcquired(int64_t nowNs, int64_t sensorTimestampNs);
+  void OnImageDropped(uint32_t count);
+  void OnFramePresented(void);
+  void Record(PreviewMetric metric, int64_t ns);
+
+  /**
+   * If at least periodNs passed since the last report, fill *report with
+   * the period that just ended, start a new one and return true.
+   */
+  bool TakeReport(int64_t nowNs, int64_t periodNs, FrameStatsReport* report);
+
+  // summary of a metric over the whole session
+  FrameSummary Session(PreviewMetric metric) const;
+  static const char* MetricName(PreviewMetric metric);
+
+ private:
+  mutable std::mutex lock_;
+  FrameHistogram period_[static_cast<int32_t>(PreviewMetric::MAX_METRIC)];
+  FrameHistogram session_[static_cast<int32_t>(PreviewMetric::MAX_METRIC)];
+
+  std::atomic<int64_t> lastArrivalNs_;
+  std::atomic<uint64_t> arrived_;
+  std::atomic<uint64_t> acquired_;
+  std::atomic<uint64_t> dropped_;
+  std::atomic<uint64_t> presented_;
+  int64_t lastSensorTimestampNs_;
+  int64_t periodStartNs_;
+  uint32_t maxPending_;
+  uint64_t pending_;  // arrived, not acquired yet at the last report
+};
+
+#endif  // CAMERA_FRAME_STATS_H
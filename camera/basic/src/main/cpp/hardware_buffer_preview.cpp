@@ -0,0 +1,166 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "hardware_buffer_preview.h"
+
+#include <android/hardware_buffer.h>
+#include <unistd.h>
+
+#include "utils/native_debug.h"
+
+/*
+ * Camera images are rotated anti-clockwise, buffer transforms are clockwise.
+ */
+static int32_t RotationToTransform(int32_t rotation) {
+  switch (rotation) {
+    case 90:
+      return ANATIVEWINDOW_TRANSFORM_ROTATE_270;
+    case 180:
+      return ANATIVEWINDOW_TRANSFORM_ROTATE_180;
+    case 270:
+      return ANATIVEWINDOW_TRANSFORM_ROTATE_90;
+    default:
+      return ANATIVEWINDOW_TRANSFORM_IDENTITY;
+  }
+}
+
+HardwareBufferPreview::HardwareBufferPreview(ANativeWindow* window,
+                                             int32_t windowWidth,
+                                             int32_t windowHeight,
+                                             int32_t rotation,
+                                             int32_t maxImages)
+    : surface_(nullptr),
+      tracker_(maxImages,
+               [](void* image, int fenceFd) {
+                 if (__builtin_available(android 29, *)) {
+                   AImage_deleteAsync(static_cast<AImage*>(image), fenceFd);
+                 }
+               }),
+      pending_(maxImages, PendingFrame{this, nullptr, 0}),
+      nextPending_(0),
+      windowWidth_(windowWidth),
+      windowHeight_(windowHeight),
+      transform_(RotationToTransform(rotation)),
+      stats_(nullptr),
+      detached_(false) {
+  surface_ = ASurfaceControl_createFromWindow(window, "CameraPreview");
+  if (!surface_) {
+    LOGW("Failed to create preview ASurfaceControl");
+    return;
+  }
+  ASurfaceTransaction* transaction = ASurfaceTransaction_create();
+  ASurfaceTransaction_setVisibility(transaction, surface_,
+                                    ASURFACE_TRANSACTION_VISIBILITY_SHOW);
+  ASurfaceTransaction_setZOrder(transaction, surface_, 1);
+  ASurfaceTransaction_apply(transaction);
+  ASurfaceTransaction_delete(transaction);
+}
+
+HardwareBufferPreview::~HardwareBufferPreview() {
+  if (surface_) {
+    // Transactions complete in order: once the layer removal is acknowledged,
+    // no callback referencing this object is outstanding and the display
+    // has let go of every buffer. Until then the callbacks may still run, so
+    // there is no giving up on the acknowledgement.
+    ASurfaceTransaction* transaction = ASurfaceTransaction_create();
+    ASurfaceTransaction_reparent(transaction, surface_, nullptr);
+    ASurfaceTransaction_setOnComplete(transaction, this, OnDetached);
+    ASurfaceTransaction_apply(transaction);
+    ASurfaceTransaction_delete(transaction);
+
+    std::unique_lock<std::mutex> lock(detachLock_);
+    detachCond_.wait(lock, [this] { return detached_; });
+    lock.unlock();
+    ASurfaceControl_release(surface_);
+  }
+  tracker_.ReleaseAll();
+}
+
+bool HardwareBufferPreview::IsValid(void) const { return surface_ != nullptr; }
+
+bool HardwareBufferPreview::Present(AImage* image, int acquireFenceFd,
+                                    int64_t acquireNs) {
+  AHardwareBuffer* buffer = nullptr;
+  if (!surface_ || !tracker_.Acquire(image)) {
+    if (acquireFenceFd >= 0) close(acquireFenceFd);
+    AImage_delete(image);
+    if (stats_) stats_->OnImageDropped(1);
+    return false;
+  }
+  if (AImage_getHardwareBuffer(image, &buffer) != AMEDIA_OK || !buffer) {
+    if (acquireFenceFd >= 0) close(acquireFenceFd);
+    tracker_.Drop(image);
+    if (stats_) stats_->OnImageDropped(1);
+    return false;
+  }
+
+  // The camera may pad the buffer beyond the image, only show its crop.
+  ARect source;
+  AImageCropRect crop;
+  if (AImage_getCropRect(image, &crop) == AMEDIA_OK) {
+    source = {crop.left, crop.top, crop.right, crop.bottom};
+  } else {
+    AHardwareBuffer_Desc desc;
+    AHardwareBuffer_describe(buffer, &desc);
+    source = {0, 0, static_cast<int32_t>(desc.width),
+              static_cast<int32_t>(desc.height)};
+  }
+  ARect destination{0, 0, windowWidth_, windowHeight_};
+
+  PendingFrame* frame = &pending_[nextPending_];
+  nextPending_ = (nextPending_ + 1) % pending_.size();
+  frame->image = image;
+  frame->acquireNs = acquireNs;
+
+  tracker_.Queue(image);
+  ASurfaceTransaction* transaction = ASurfaceTransaction_create();
+  ASurfaceTransaction_setBuffer(transaction, surface_, buffer, acquireFenceFd);
+  ASurfaceTransaction_setGeometry(transaction, surface_, source, destination,
+                                  transform_);
+  ASurfaceTransaction_setOnComplete(transaction, frame, OnTransactionComplete);
+  ASurfaceTransaction_apply(transaction);
+  ASurfaceTransaction_delete(transaction);
+  return true;
+}
+
+void HardwareBufferPreview::OnTransactionComplete(
+    void* ctx, ASurfaceTransactionStats* stats) {
+  PendingFrame* frame = static_cast<PendingFrame*>(ctx);
+  HardwareBufferPreview* self = frame->preview;
+
+  int releaseFenceFd = ASurfaceTransactionStats_getPreviousReleaseFenceFd(
+      stats, self->surface_);
+  if (!self->tracker_.OnPresented(frame->image, releaseFenceFd)) return;
+
+  if (self->stats_) {
+    self->stats_->OnFramePresented();
+    int64_t latchNs = ASurfaceTransactionStats_getLatchTime(stats);
+    if (latchNs > frame->acquireNs) {
+      self->stats_->Record(PreviewMetric::PRESENT_LATENCY,
+                           latchNs - frame->acquireNs);
+    }
+  }
+}
+
+void HardwareBufferPreview::OnDetached(void* ctx, ASurfaceTransactionStats*) {
+  HardwareBufferPreview* self = static_cast<HardwareBufferPreview*>(ctx);
+  std::lock_guard<std::mutex> lock(self->detachLock_);
+  self->detached_ = true;
+  self->detachCond_.notify_one();
+}
+
+void HardwareBufferPreview::SetFrameStats(FrameStats* stats) {
+  stats_ = stats;
+}
@@ -0,0 +1,97 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef CAMERA_HARDWARE_BUFFER_PREVIEW_H
+#define CAMERA_HARDWARE_BUFFER_PREVIEW_H
+
+#include <android/surface_control.h>
+#include <media/NdkImage.h>
+
+#include <condition_variable>
+#include <mutex>
+#include <vector>
+
+#include "frame_stats.h"
+#include "preview_buffer_tracker.h"
+
+/*
+ * HardwareBufferPreview:
+ *   Zero copy preview path: the AHardwareBuffer behind each camera AImage is
+ *   handed to SurfaceFlinger through an ASurfaceControl child of the app
+ *   window, and rotation/scaling is done by the compositor. The AImage stays
+ *   alive until the display reports the release fence of its buffer, at
+ *   which point it is freed with AImage_deleteAsync().
+ *   Requires API 29; use ImageReader::DisplayImage() as the fallback.
+ */
+class HardwareBufferPreview {
+ public:
+  /**
+   * @param window app window the preview layer is attached to
+   * @param windowWidth/windowHeight size of the window, in pixels
+   * @param rotation anti-clockwise rotation to apply to camera images
+   * @param maxImages maxImages of the AImageReader feeding this preview
+   */
+  HardwareBufferPreview(ANativeWindow* window, int32_t windowWidth,
+                        int32_t windowHeight, int32_t rotation,
+                        int32_t maxImages) __INTRODUCED_IN(29);
+  ~HardwareBufferPreview() __INTRODUCED_IN(29);
+
+  bool IsValid(void) const;
+
+  /**
+   * Submit an image to the display. Ownership of image and acquireFenceFd
+   * is always taken over, even when returning false (the frame is dropped).
+   * @param acquireNs FrameClockNs() when the image was acquired, to report
+   *        the latency until the display latched it.
+   */
+  bool Present(AImage* image, int acquireFenceFd, int64_t acquireNs)
+      __INTRODUCED_IN(29);
+
+  /**
+   * Report presented/dropped frames and present latency into stats
+   */
+  void SetFrameStats(FrameStats* stats);
+
+  const PreviewBufferTracker& Tracker(void) const { return tracker_; }
+
+ private:
+  struct PendingFrame {
+    HardwareBufferPreview* preview;
+    AImage* image;
+    int64_t acquireNs;
+  };
+
+  static void OnTransactionComplete(void* ctx, ASurfaceTransactionStats* stats)
+      __INTRODUCED_IN(29);
+  static void OnDetached(void* ctx, ASurfaceTransactionStats* stats)
+      __INTRODUCED_IN(29);
+
+  ASurfaceControl* surface_;
+  PreviewBufferTracker tracker_;
+  std::vector<PendingFrame> pending_;
+  uint32_t nextPending_;
+  int32_t windowWidth_;
+  int32_t windowHeight_;
+  int32_t transform_;
+
+  FrameStats* stats_;
+
+  std::mutex detachLock_;
+  std::condition_variable detachCond_;
+  bool detached_;
+};
+
+#endif  // CAMERA_HARDWARE_BUFFER_PREVIEW_H
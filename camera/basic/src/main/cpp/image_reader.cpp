@@ -15,15 +15,13 @@
  */
 #include "image_reader.h"
 
-#include <dirent.h>
-
-#include <cstdlib>
-#include <ctime>
+#include <algorithm>
 #include <functional>
-#include <string>
 #include <thread>
 
+#include "jpeg_writer.h"
 #include "utils/native_debug.h"
+#include "yuv_converter.h"
 
 /*
  * For JPEG capture, captured files are saved under
@@ -40,6 +38,12 @@ static const char *kFileName = "capture";
  */
 #define MAX_BUF_COUNT 4
 
+/**
+ * MAX_CONVERTER_THREADS:
+ *   Upper limit of threads used by default to convert one preview frame.
+ */
+#define MAX_CONVERTER_THREADS 4
+
 /**
  * ImageReader listener: called by AImageReader for every frame captured
  * We pass the event to ImageReader class, so it could do some housekeeping
@@ -58,14 +62,45 @@ void OnImageCallback(void *ctx, AImageReader *reader) {
  * Constructor
  */
 ImageReader::ImageReader(ImageFormat *res, enum AIMAGE_FORMATS format)
-    : presentRotation_(0), reader_(nullptr) {
-  callback_ = nullptr;
-  callbackCtx_ = nullptr;
-
+    : presentRotation_(0), presentMirror_(false), reader_(nullptr) {
   media_status_t status = AImageReader_new(res->width, res->height, format,
                                            MAX_BUF_COUNT, &reader_);
   ASSERT(reader_ && status == AMEDIA_OK, "Failed to create AImageReader");
 
+  Init(format);
+}
+
+ImageReader::ImageReader(ImageFormat *res, enum AIMAGE_FORMATS format,
+                         uint64_t usage)
+    : presentRotation_(0), presentMirror_(false), reader_(nullptr) {
+  media_status_t status = AImageReader_newWithUsage(
+      res->width, res->height, format, usage, MAX_BUF_COUNT, &reader_);
+  ASSERT(reader_ && status == AMEDIA_OK,
+         "Failed to create AImageReader with usage 0x%llx",
+         static_cast<unsigned long long>(usage));
+
+  Init(format);
+}
+
+void ImageReader::Init(enum AIMAGE_FORMATS format) {
+  stats_ = nullptr;
+  writer_ = nullptr;
+  if (format == AIMAGE_FORMAT_JPEG) {
+    writer_ = new JpegWriter(kDirName, kFileName, MAX_BUF_COUNT,
+                             [this](const char *fileName) {
+                               if (callback_) callback_(callbackCtx_, fileName);
+                             });
+  }
+  converter_ = nullptr;
+  if (format == AIMAGE_FORMAT_YUV_420_888) {
+    converter_ = new YuvConverterPool(std::max(
+        1, std::min(MAX_CONVERTER_THREADS,
+                    static_cast<int>(std::thread::hardware_concurrency()))));
+  }
+  callback_ = nullptr;
+  callbackCtx_ = nullptr;
+  imageAvailableCallback_ = nullptr;
+
   AImageReader_ImageListener listener{
       .context = this,
       .onImageAvailable = OnImageCallback,
@@ -76,6 +111,9 @@ ImageReader::ImageReader(ImageFormat *res, enum AIMAGE_FORMATS format)
 ImageReader::~ImageReader() {
   ASSERT(reader_, "NULL Pointer to %s", __FUNCTION__);
   AImageReader_delete(reader_);
+  // finishes writing the captures already queued
+  delete writer_;
+  delete converter_;
 }
 
 void ImageReader::RegisterCallback(
@@ -84,18 +122,37 @@ void ImageReader::RegisterCallback(
   callback_ = func;
 }
 
+void ImageReader::RegisterImageAvailableCallback(
+    std::function<void(void)> callback) {
+  imageAvailableCallback_ = callback;
+}
+
 void ImageReader::ImageCallback(AImageReader *reader) {
   int32_t format;
   media_status_t status = AImageReader_getFormat(reader, &format);
   ASSERT(status == AMEDIA_OK, "Failed to get the media format");
+  if (stats_) stats_->OnImageArrived(FrameClockNs());
+  if (format != AIMAGE_FORMAT_JPEG && imageAvailableCallback_) {
+    imageAvailableCallback_();
+  }
   if (format == AIMAGE_FORMAT_JPEG) {
     AImage *image = nullptr;
     media_status_t status = AImageReader_acquireNextImage(reader, &image);
     ASSERT(status == AMEDIA_OK && image, "Image is not available");
 
-    // Create a thread and write out the jpeg files
-    std::thread writeFileHandler(&ImageReader::WriteFile, this, image);
-    writeFileHandler.detach();
+    // Copy the jpeg out and give the buffer back to the reader right away,
+    // the file is written by the writer thread
+    int planeCount;
+    status = AImage_getNumberOfPlanes(image, &planeCount);
+    ASSERT(status == AMEDIA_OK && planeCount == 1,
+           "Error: getNumberOfPlanes() planeCount = %d", planeCount);
+    uint8_t *data = nullptr;
+    int len = 0;
+    AImage_getPlaneData(image, 0, &data, &len);
+    if (!writer_->Enqueue(data, len)) {
+      LOGW("Failed to queue capture for writing to %s", kDirName);
+    }
+    AImage_delete(image);
   }
 }
 
@@ -119,7 +176,7 @@ AImage *ImageReader::GetNextImage(void) {
   if (status != AMEDIA_OK) {
     return nullptr;
   }
-  return image;
+  return OnAcquired(image);
 }
 
 /**
@@ -133,9 +190,38 @@ AImage *ImageReader::GetLatestImage(void) {
   if (status != AMEDIA_OK) {
     return nullptr;
   }
+  return OnAcquired(image);
+}
+
+/**
+ * GetLatestImageAsync()
+ *   Retrieve the last image in ImageReader's bufferQueue without waiting for
+ * the camera to finish writing it; *fenceFd signals when it is complete.
+ */
+AImage *ImageReader::GetLatestImageAsync(int *fenceFd) {
+  AImage *image;
+  media_status_t status =
+      AImageReader_acquireLatestImageAsync(reader_, &image, fenceFd);
+  if (status != AMEDIA_OK) {
+    return nullptr;
+  }
+  return OnAcquired(image);
+}
+
+/**
+ * Account a newly acquired image
+ */
+AImage *ImageReader::OnAcquired(AImage *image) {
+  if (stats_) {
+    int64_t timestampNs = 0;
+    AImage_getTimestamp(image, &timestampNs);
+    stats_->OnImageAcquired(FrameClockNs(), timestampNs);
+  }
   return image;
 }
 
+int32_t ImageReader::GetMaxImages(void) const { return MAX_BUF_COUNT; }
+
 /**
  * Delete Image
  * @param image {@link AImage} instance to be deleted
@@ -144,59 +230,6 @@ void ImageReader::DeleteImage(AImage *image) {
   if (image) AImage_delete(image);
 }
 
-/**
- * Helper function for YUV_420 to RGB conversion. Courtesy of Tensorflow
- * ImageClassifier Sample:
- * https://github.com/tensorflow/tensorflow/blob/master/tensorflow/examples/android/jni/yuv2rgb.cc
- * The difference is that here we have to swap UV plane when calling it.
- */
-#ifndef MAX
-#define MAX(a, b)           \
-  ({                        \
-    __typeof__(a) _a = (a); \
-    __typeof__(b) _b = (b); \
-    _a > _b ? _a : _b;      \
-  })
-#define MIN(a, b)           \
-  ({                        \
-    __typeof__(a) _a = (a); \
-    __typeof__(b) _b = (b); \
-    _a < _b ? _a : _b;      \
-  })
-#endif
-
-// This value is 2 ^ 18 - 1, and is used to clamp the RGB values before their
-// ranges
-// are normalized to eight bits.
-static const int kMaxChannelValue = 262143;
-
-static inline uint32_t YUV2RGB(int nY, int nU, int nV) {
-  nY -= 16;
-  nU -= 128;
-  nV -= 128;
-  if (nY < 0) nY = 0;
-
-  // This is the floating point equivalent. We do the conversion in integer
-  // because some Android devices do not have floating point in hardware.
-  // nR = (int)(1.164 * nY + 1.596 * nV);
-  // nG = (int)(1.164 * nY - 0.813 * nV - 0.391 * nU);
-  // nB = (int)(1.164 * nY + 2.018 * nU);
-
-  int nR = (int)(1192 * nY + 1634 * nV);
-  int nG = (int)(1192 * nY - 833 * nV - 400 * nU);
-  int nB = (int)(1192 * nY + 2066 * nU);
-
-  nR = MIN(kMaxChannelValue, MAX(0, nR));
-  nG = MIN(kMaxChannelValue, MAX(0, nG));
-  nB = MIN(kMaxChannelValue, MAX(0, nB));
-
-  nR = (nR >> 10) & 0xff;
-  nG = (nG >> 10) & 0xff;
-  nB = (nB >> 10) & 0xff;
-
-  return 0xff000000 | (nB << 16) | (nG << 8) | nR;
-}
-
 /**
  * Convert yuv image inside AImage into ANativeWindow_Buffer
  * ANativeWindow_Buffer format is guaranteed to be
@@ -219,241 +252,55 @@ bool ImageReader::DisplayImage(ANativeWindow_Buffer *buf, AImage *image) {
   AImage_getNumberOfPlanes(image, &srcPlanes);
   ASSERT(srcPlanes == 3, "Is not 3 planes");
 
-  switch (presentRotation_) {
-    case 0:
-      PresentImage(buf, image);
-      break;
-    case 90:
-      PresentImage90(buf, image);
-      break;
-    case 180:
-      PresentImage180(buf, image);
-      break;
-    case 270:
-      PresentImage270(buf, image);
-      break;
-    default:
-      ASSERT(0, "NOT recognized display rotation: %d", presentRotation_);
-  }
-
-  AImage_delete(image);
-
-  return true;
-}
-
-/*
- * PresentImage()
- *   Converting yuv to RGB
- *   No rotation: (x,y) --> (x, y)
- *   Refer to:
- * https://mathbits.com/MathBits/TISection/Geometry/Transformations2.htm
- */
-void ImageReader::PresentImage(ANativeWindow_Buffer *buf, AImage *image) {
-  AImageCropRect srcRect;
-  AImage_getCropRect(image, &srcRect);
-
-  int32_t yStride, uvStride;
-  uint8_t *yPixel, *uPixel, *vPixel;
-  int32_t yLen, uLen, vLen;
-  AImage_getPlaneRowStride(image, 0, &yStride);
-  AImage_getPlaneRowStride(image, 1, &uvStride);
-  AImage_getPlaneData(image, 0, &yPixel, &yLen);
-  AImage_getPlaneData(image, 1, &uPixel, &uLen);
-  AImage_getPlaneData(image, 2, &vPixel, &vLen);
-  int32_t uvPixelStride;
-  AImage_getPlanePixelStride(image, 1, &uvPixelStride);
-
-  int32_t height = MIN(buf->height, (srcRect.bottom - srcRect.top));
-  int32_t width = MIN(buf->width, (srcRect.right - srcRect.left));
-
-  uint32_t *out = static_cast<uint32_t *>(buf->bits);
-  for (int32_t y = 0; y < height; y++) {
-    const uint8_t *pY = yPixel + yStride * (y + srcRect.top) + srcRect.left;
-
-    int32_t uv_row_start = uvStride * ((y + srcRect.top) >> 1);
-    const uint8_t *pU = uPixel + uv_row_start + (srcRect.left >> 1);
-    const uint8_t *pV = vPixel + uv_row_start + (srcRect.left >> 1);
-
-    for (int32_t x = 0; x < width; x++) {
-      const int32_t uv_offset = (x >> 1) * uvPixelStride;
-      out[x] = YUV2RGB(pY[x], pU[uv_offset], pV[uv_offset]);
-    }
-    out += buf->stride;
-  }
-}
+  ASSERT(presentRotation_ % 90 == 0 && presentRotation_ >= 0 &&
+             presentRotation_ < 360,
+         "NOT recognized display rotation: %d", presentRotation_);
 
-/*
- * PresentImage90()
- *   Converting YUV to RGB
- *   Rotation image anti-clockwise 90 degree -- (x, y) --> (-y, x)
- */
-void ImageReader::PresentImage90(ANativeWindow_Buffer *buf, AImage *image) {
   AImageCropRect srcRect;
   AImage_getCropRect(image, &srcRect);
 
-  int32_t yStride, uvStride;
+  YuvImage src;
   uint8_t *yPixel, *uPixel, *vPixel;
   int32_t yLen, uLen, vLen;
-  AImage_getPlaneRowStride(image, 0, &yStride);
-  AImage_getPlaneRowStride(image, 1, &uvStride);
+  AImage_getPlaneRowStride(image, 0, &src.yStride);
+  AImage_getPlaneRowStride(image, 1, &src.uvStride);
+  AImage_getPlanePixelStride(image, 1, &src.uvPixelStride);
   AImage_getPlaneData(image, 0, &yPixel, &yLen);
   AImage_getPlaneData(image, 1, &uPixel, &uLen);
   AImage_getPlaneData(image, 2, &vPixel, &vLen);
-  int32_t uvPixelStride;
-  AImage_getPlanePixelStride(image, 1, &uvPixelStride);
-
-  int32_t height = MIN(buf->width, (srcRect.bottom - srcRect.top));
-  int32_t width = MIN(buf->height, (srcRect.right - srcRect.left));
-
-  uint32_t *out = static_cast<uint32_t *>(buf->bits);
-  out += height - 1;
-  for (int32_t y = 0; y < height; y++) {
-    const uint8_t *pY = yPixel + yStride * (y + srcRect.top) + srcRect.left;
-
-    int32_t uv_row_start = uvStride * ((y + srcRect.top) >> 1);
-    const uint8_t *pU = uPixel + uv_row_start + (srcRect.left >> 1);
-    const uint8_t *pV = vPixel + uv_row_start + (srcRect.left >> 1);
-
-    for (int32_t x = 0; x < width; x++) {
-      const int32_t uv_offset = (x >> 1) * uvPixelStride;
-      // [x, y]--> [-y, x]
-      out[x * buf->stride] = YUV2RGB(pY[x], pU[uv_offset], pV[uv_offset]);
-    }
-    out -= 1;  // move to the next column
+  src.y = yPixel;
+  src.u = uPixel;
+  src.v = vPixel;
+  src.left = srcRect.left;
+  src.top = srcRect.top;
+  src.width = srcRect.right - srcRect.left;
+  src.height = srcRect.bottom - srcRect.top;
+
+  RgbaImage dst{static_cast<uint32_t *>(buf->bits), buf->width, buf->height,
+                buf->stride};
+  int64_t start = FrameClockNs();
+  ConvertYuvToRgba(src, dst, presentRotation_, presentMirror_, converter_);
+  if (stats_) {
+    stats_->Record(PreviewMetric::CONVERSION_TIME, FrameClockNs() - start);
   }
-}
 
-/*
- * PresentImage180()
- *   Converting yuv to RGB
- *   Rotate image 180 degree: (x, y) --> (-x, -y)
- */
-void ImageReader::PresentImage180(ANativeWindow_Buffer *buf, AImage *image) {
-  AImageCropRect srcRect;
-  AImage_getCropRect(image, &srcRect);
+  AImage_delete(image);
 
-  int32_t yStride, uvStride;
-  uint8_t *yPixel, *uPixel, *vPixel;
-  int32_t yLen, uLen, vLen;
-  AImage_getPlaneRowStride(image, 0, &yStride);
-  AImage_getPlaneRowStride(image, 1, &uvStride);
-  AImage_getPlaneData(image, 0, &yPixel, &yLen);
-  AImage_getPlaneData(image, 1, &uPixel, &uLen);
-  AImage_getPlaneData(image, 2, &vPixel, &vLen);
-  int32_t uvPixelStride;
-  AImage_getPlanePixelStride(image, 1, &uvPixelStride);
-
-  int32_t height = MIN(buf->height, (srcRect.bottom - srcRect.top));
-  int32_t width = MIN(buf->width, (srcRect.right - srcRect.left));
-
-  uint32_t *out = static_cast<uint32_t *>(buf->bits);
-  out += (height - 1) * buf->stride;
-  for (int32_t y = 0; y < height; y++) {
-    const uint8_t *pY = yPixel + yStride * (y + srcRect.top) + srcRect.left;
-
-    int32_t uv_row_start = uvStride * ((y + srcRect.top) >> 1);
-    const uint8_t *pU = uPixel + uv_row_start + (srcRect.left >> 1);
-    const uint8_t *pV = vPixel + uv_row_start + (srcRect.left >> 1);
-
-    for (int32_t x = 0; x < width; x++) {
-      const int32_t uv_offset = (x >> 1) * uvPixelStride;
-      // mirror image since we are using front camera
-      out[width - 1 - x] = YUV2RGB(pY[x], pU[uv_offset], pV[uv_offset]);
-      // out[x] = YUV2RGB(pY[x], pU[uv_offset], pV[uv_offset]);
-    }
-    out -= buf->stride;
-  }
+  return true;
 }
 
-/*
- * PresentImage270()
- *   Converting image from YUV to RGB
- *   Rotate Image counter-clockwise 270 degree: (x, y) --> (y, x)
- */
-void ImageReader::PresentImage270(ANativeWindow_Buffer *buf, AImage *image) {
-  AImageCropRect srcRect;
-  AImage_getCropRect(image, &srcRect);
-
-  int32_t yStride, uvStride;
-  uint8_t *yPixel, *uPixel, *vPixel;
-  int32_t yLen, uLen, vLen;
-  AImage_getPlaneRowStride(image, 0, &yStride);
-  AImage_getPlaneRowStride(image, 1, &uvStride);
-  AImage_getPlaneData(image, 0, &yPixel, &yLen);
-  AImage_getPlaneData(image, 1, &uPixel, &uLen);
-  AImage_getPlaneData(image, 2, &vPixel, &vLen);
-  int32_t uvPixelStride;
-  AImage_getPlanePixelStride(image, 1, &uvPixelStride);
-
-  int32_t height = MIN(buf->width, (srcRect.bottom - srcRect.top));
-  int32_t width = MIN(buf->height, (srcRect.right - srcRect.left));
-
-  uint32_t *out = static_cast<uint32_t *>(buf->bits);
-  for (int32_t y = 0; y < height; y++) {
-    const uint8_t *pY = yPixel + yStride * (y + srcRect.top) + srcRect.left;
-
-    int32_t uv_row_start = uvStride * ((y + srcRect.top) >> 1);
-    const uint8_t *pU = uPixel + uv_row_start + (srcRect.left >> 1);
-    const uint8_t *pV = vPixel + uv_row_start + (srcRect.left >> 1);
-
-    for (int32_t x = 0; x < width; x++) {
-      const int32_t uv_offset = (x >> 1) * uvPixelStride;
-      out[(width - 1 - x) * buf->stride] =
-          YUV2RGB(pY[x], pU[uv_offset], pV[uv_offset]);
-    }
-    out += 1;  // move to the next column
-  }
-}
 void ImageReader::SetPresentRotation(int32_t angle) {
   presentRotation_ = angle;
 }
 
-/**
- * Write out jpeg files to kDirName directory
- * @param image point capture jpg image
- */
-void ImageReader::WriteFile(AImage *image) {
-  int planeCount;
-  media_status_t status = AImage_getNumberOfPlanes(image, &planeCount);
-  ASSERT(status == AMEDIA_OK && planeCount == 1,
-         "Error: getNumberOfPlanes() planeCount = %d", planeCount);
-  uint8_t *data = nullptr;
-  int len = 0;
-  AImage_getPlaneData(image, 0, &data, &len);
-
-  DIR *dir = opendir(kDirName);
-  if (dir) {
-    closedir(dir);
-  } else {
-    std::string cmd = "mkdir -p ";
-    cmd += kDirName;
-    system(cmd.c_str());
-  }
+void ImageReader::SetPresentMirror(bool mirror) { presentMirror_ = mirror; }
 
-  struct timespec ts {
-    0, 0
-  };
-  clock_gettime(CLOCK_REALTIME, &ts);
-  struct tm localTime;
-  localtime_r(&ts.tv_sec, &localTime);
-
-  std::string fileName = kDirName;
-  std::string dash("-");
-  fileName += kFileName + std::to_string(localTime.tm_mon) +
-              std::to_string(localTime.tm_mday) + dash +
-              std::to_string(localTime.tm_hour) +
-              std::to_string(localTime.tm_min) +
-              std::to_string(localTime.tm_sec) + ".jpg";
-  FILE *file = fopen(fileName.c_str(), "wb");
-  if (file && data && len) {
-    fwrite(data, 1, len, file);
-    fclose(file);
-
-    if (callback_) {
-      callback_(callbackCtx_, fileName.c_str());
-    }
-  } else {
-    if (file) fclose(file);
-  }
-  AImage_delete(image);
+void ImageReader::SetConverterThreads(int32_t count) {
+  delete converter_;
+  converter_ = new YuvConverterPool(count);
+}
+
+void ImageReader::SetFrameStats(FrameStats *stats) {
+  stats_ = stats;
+  if (stats_) stats_->SetMaxPending(MAX_BUF_COUNT);
 }
@@ -19,6 +19,10 @@
 #include <media/NdkImageReader.h>
 
 #include <functional>
+
+#include "frame_stats.h"
+#include "jpeg_writer.h"
+#include "yuv_converter.h"
 /*
  * ImageFormat:
  *     A Data Structure to communicate resolution between camera and ImageReader
@@ -38,6 +42,13 @@ class ImageReader {
    */
   explicit ImageReader(ImageFormat* res, enum AIMAGE_FORMATS format);
 
+  /**
+   * Create a reader whose buffers are allocated with the given
+   * AHardwareBuffer usage flags, e.g. to hand them to the display directly.
+   */
+  ImageReader(ImageFormat* res, enum AIMAGE_FORMATS format, uint64_t usage)
+      __INTRODUCED_IN(26);
+
   ~ImageReader();
 
   /**
@@ -56,6 +67,17 @@ class ImageReader {
    */
   AImage* GetLatestImage(void);
 
+  /**
+   * Same as GetLatestImage(), but does not wait for the producer: the image
+   * may only be read once *fenceFd (owned by the caller, -1 if none) signals.
+   */
+  AImage* GetLatestImageAsync(int* fenceFd) __INTRODUCED_IN(26);
+
+  /**
+   * Max number of images the reader hands out at the same time
+   */
+  int32_t GetMaxImages(void) const;
+
   /**
    * Delete Image
    * @param image {@link AImage} instance to be deleted
@@ -90,6 +112,25 @@ class ImageReader {
    */
   void SetPresentRotation(int32_t angle);
 
+  /**
+   * Mirror the presented image horizontally, on top of the present rotation.
+   * Useful for a selfie style preview of front facing cameras.
+   */
+  void SetPresentMirror(bool mirror);
+
+  /**
+   * Number of threads DisplayImage() splits the YUV to RGB conversion
+   * across. Defaults to the number of CPUs, capped to MAX_CONVERTER_THREADS.
+   * The threads are kept between frames; call it before presenting starts.
+   */
+  void SetConverterThreads(int32_t count);
+
+  /**
+   * Account arrived/acquired images, sensor timestamp deltas, acquire
+   * latency and conversion time into stats (nullptr to stop).
+   */
+  void SetFrameStats(FrameStats* stats);
+
   /**
    * regsiter a callback function for client to be notified that jpeg already
    * written out.
@@ -99,19 +140,28 @@ class ImageReader {
   void RegisterCallback(void* ctx,
                         std::function<void(void* ctx, const char* fileName)>);
 
+  /**
+   * register a callback invoked on the AImageReader thread whenever a new
+   * (non JPEG) image is available for GetNextImage()/GetLatestImage().
+   */
+  void RegisterImageAvailableCallback(std::function<void(void)> callback);
+
  private:
   int32_t presentRotation_;
+  bool presentMirror_;
+  YuvConverterPool* converter_;  // YUV readers only
   AImageReader* reader_;
 
   std::function<void(void* ctx, const char* fileName)> callback_;
   void* callbackCtx_;
+  std::function<void(void)> imageAvailableCallback_;
+
+  JpegWriter* writer_;  // JPEG readers only
+  FrameStats* stats_;
 
-  void PresentImage(ANativeWindow_Buffer* buf, AImage* image);
-  void PresentImage90(ANativeWindow_Buffer* buf, AImage* image);
-  void PresentImage180(ANativeWindow_Buffer* buf, AImage* image);
-  void PresentImage270(ANativeWindow_Buffer* buf, AImage* image);
+  AImage* OnAcquired(AImage* image);
 
-  void WriteFile(AImage* image);
+  void Init(enum AIMAGE_FORMATS format);
 };
 
 #endif  // CAMERA_IMAGE_READER_H
@@ -0,0 +1,183 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "jpeg_writer.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <climits>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+
+/*
+ * Equivalent of "mkdir -p path", without spawning a shell
+ */
+static bool MakeDirectories(const std::string& path) {
+  std::string partial;
+  size_t pos = 0;
+  while (pos != std::string::npos) {
+    pos = path.find('/', pos + 1);
+    partial = path.substr(0, pos);
+    if (partial.empty()) continue;
+    if (mkdir(partial.c_str(), 0775) != 0 && errno != EEXIST) return false;
+  }
+  struct stat st;
+  return stat(path.c_str(), &st) == 0 && S_ISDIR(st.st_mode);
+}
+
+JpegWriter::JpegWriter(const char* dirName, const char* filePrefix,
+                       int32_t maxPending, Callback callback)
+    : dirName_(dirName),
+      filePrefix_(filePrefix),
+      callback_(callback),
+      dirValid_(false),
+      sequence_(0),
+      jobs_(maxPending),
+      pendingJobs_(maxPending),
+      pendingHead_(0),
+      pendingCount_(0),
+      busy_(false),
+      quit_(false) {
+  dirValid_ = MakeDirectories(dirName_);
+  for (int32_t i = maxPending - 1; i >= 0; i--) freeJobs_.push_back(i);
+  thread_ = std::thread(&JpegWriter::WriterThread, this);
+}
+
+JpegWriter::~JpegWriter() {
+  {
+    std::lock_guard<std::mutex> lock(lock_);
+    quit_ = true;
+  }
+  cond_.notify_all();
+  thread_.join();
+}
+
+bool JpegWriter::Enqueue(const uint8_t* data, size_t len) {
+  if (!dirValid_ || !data || !len) return false;
+
+  std::unique_lock<std::mutex> lock(lock_);
+  cond_.wait(lock, [this] { return !freeJobs_.empty() || quit_; });
+  if (quit_) return false;
+  int32_t idx = freeJobs_.back();
+  freeJobs_.pop_back();
+  lock.unlock();
+
+  // copy outside of the lock so the writer keeps going meanwhile
+  Job& job = jobs_[idx];
+  if (job.data.size() < len) job.data.resize(len);
+  memcpy(job.data.data(), data, len);
+  job.len = len;
+
+  lock.lock();
+  pendingJobs_[(pendingHead_ + pendingCount_) % pendingJobs_.size()] = idx;
+  pendingCount_++;
+  lock.unlock();
+  cond_.notify_all();
+  return true;
+}
+
+void JpegWriter::Flush(void) {
+  std::unique_lock<std::mutex> lock(lock_);
+  cond_.wait(lock, [this] { return (pendingCount_ == 0 && !busy_) || quit_; });
+}
+
+void JpegWriter::MakeFileName(char* name, size_t size) {
+  struct timespec ts {
+    0, 0
+  };
+  clock_gettime(CLOCK_REALTIME, &ts);
+  struct tm localTime;
+  localtime_r(&ts.tv_sec, &localTime);
+
+  // several captures may land in the same second during a burst
+  snprintf(name, size, "%s%s%d%d-%d%d%d-%u.jpg", dirName_.c_str(),
+           filePrefix_.c_str(), localTime.tm_mon, localTime.tm_mday,
+           localTime.tm_hour, localTime.tm_min, localTime.tm_sec,
+           sequence_++);
+}
+
+bool JpegWriter::WriteJob(const Job& job, WrittenFile* file) {
+  char name[PATH_MAX];
+  MakeFileName(name, sizeof(name));
+
+  int fd = open(name, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0664);
+  if (fd < 0) return false;
+
+  size_t offset = 0;
+  while (offset < job.len) {
+    ssize_t written =
+        pwrite(fd, job.data.data() + offset, job.len - offset, offset);
+    if (written < 0 && errno == EINTR) continue;
+    if (written <= 0) {
+      close(fd);
+      unlink(name);
+      return false;
+    }
+    offset += written;
+  }
+  file->fd = fd;
+  file->name = name;
+  return true;
+}
+
+void JpegWriter::SyncBatch(std::vector<WrittenFile>* batch) {
+  for (auto& file : *batch) {
+    fdatasync(file.fd);
+    close(file.fd);
+    if (callback_) callback_(file.name.c_str());
+  }
+  batch->clear();
+}
+
+void JpegWriter::WriterThread(void) {
+  std::vector<WrittenFile> batch;
+  std::unique_lock<std::mutex> lock(lock_);
+  while (true) {
+    // Make the burst durable at once when the queue runs dry, or once the
+    // batch holds as many files as the queue so that a steady stream of
+    // captures does not keep piling up open files.
+    if (!batch.empty() &&
+        (pendingCount_ == 0 || batch.size() >= jobs_.size())) {
+      lock.unlock();
+      SyncBatch(&batch);
+      lock.lock();
+      continue;
+    }
+    if (pendingCount_ == 0) {
+      busy_ = false;
+      cond_.notify_all();
+      if (quit_) break;
+      cond_.wait(lock, [this] { return pendingCount_ != 0 || quit_; });
+      continue;
+    }
+
+    int32_t idx = pendingJobs_[pendingHead_];
+    pendingHead_ = (pendingHead_ + 1) % pendingJobs_.size();
+    pendingCount_--;
+    busy_ = true;
+    lock.unlock();
+
+    WrittenFile file;
+    if (WriteJob(jobs_[idx], &file)) batch.push_back(file);
+
+    lock.lock();
+    freeJobs_.push_back(idx);
+    cond_.notify_all();
+  }
+}
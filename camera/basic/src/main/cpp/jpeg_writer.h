@@ -0,0 +1,101 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef CAMERA_JPEG_WRITER_H
+#define CAMERA_JPEG_WRITER_H
+
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/*
+ * JpegWriter:
+ *   Writes captured JPEG blobs to disk on a background thread so the
+ *   AImageReader callback only has to copy the plane and can return the
+ *   image to the reader right away.
+ *     - at most maxPending captures are buffered; their buffers are reused,
+ *       so a burst only allocates while the buffers grow to the JPEG size
+ *     - the target directory is created once, up front
+ *     - files written back to back are fsync'ed as one batch when the queue
+ *       runs dry or maxPending files are waiting, then reported through the
+ *       callback
+ *   No NDK dependency: it can be driven with synthetic blobs on a host.
+ */
+class JpegWriter {
+ public:
+  using Callback = std::function<void(const char* fileName)>;
+
+  /**
+   * @param dirName directory to write into, created if missing; must end
+   *        with '/'
+   * @param filePrefix file name prefix, followed by a time stamp and a
+   *        sequence number
+   * @param maxPending number of captures buffered before Enqueue() blocks
+   * @param callback invoked on the writer thread for each file written
+   */
+  JpegWriter(const char* dirName, const char* filePrefix, int32_t maxPending,
+             Callback callback);
+  ~JpegWriter();
+
+  /**
+   * Copy a JPEG blob into the write queue; blocks while the queue is full.
+   * @return false if the writer is not usable (e.g. no directory)
+   */
+  bool Enqueue(const uint8_t* data, size_t len);
+
+  /**
+   * Block until every capture enqueued so far is written and synced
+   */
+  void Flush(void);
+
+ private:
+  struct Job {
+    std::vector<uint8_t> data;
+    size_t len;
+  };
+  struct WrittenFile {
+    int fd;
+    std::string name;
+  };
+
+  void WriterThread(void);
+  bool WriteJob(const Job& job, WrittenFile* file);
+  void SyncBatch(std::vector<WrittenFile>* batch);
+  void MakeFileName(char* name, size_t size);
+
+  std::string dirName_;
+  std::string filePrefix_;
+  Callback callback_;
+  bool dirValid_;
+  uint32_t sequence_;
+
+  std::mutex lock_;
+  std::condition_variable cond_;
+  std::vector<Job> jobs_;
+  std::vector<int32_t> freeJobs_;
+  std::vector<int32_t> pendingJobs_;  // ring of job indices, FIFO
+  size_t pendingHead_;
+  size_t pendingCount_;
+  bool busy_;
+  bool quit_;
+  std::thread thread_;
+};
+
+#endif  // CAMERA_JPEG_WRITER_H
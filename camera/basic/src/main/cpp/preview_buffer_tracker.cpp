@@ -0,0 +1,125 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "preview_buffer_tracker.h"
+
+#include <unistd.h>
+
+PreviewBufferTracker::PreviewBufferTracker(int32_t maxBuffers,
+                                           ReleaseFunc release)
+    : slots_(maxBuffers, Slot{nullptr, State::FREE}),
+      release_(release),
+      presented_(0),
+      dropped_(0) {}
+
+PreviewBufferTracker::~PreviewBufferTracker() { ReleaseAll(); }
+
+PreviewBufferTracker::Slot* PreviewBufferTracker::Find(void* image) {
+  for (auto& slot : slots_) {
+    if (slot.state != State::FREE && slot.image == image) return &slot;
+  }
+  return nullptr;
+}
+
+void PreviewBufferTracker::Release(Slot* slot, int fenceFd) {
+  void* image = slot->image;
+  slot->image = nullptr;
+  slot->state = State::FREE;
+  if (release_) {
+    release_(image, fenceFd);
+  } else if (fenceFd >= 0) {
+    close(fenceFd);
+  }
+}
+
+bool PreviewBufferTracker::Acquire(void* image) {
+  std::lock_guard<std::mutex> lock(lock_);
+  if (!image || Find(image)) return false;
+  for (auto& slot : slots_) {
+    if (slot.state == State::FREE) {
+      slot.image = image;
+      slot.state = State::ACQUIRED;
+      return true;
+    }
+  }
+  return false;
+}
+
+bool PreviewBufferTracker::Queue(void* image) {
+  std::lock_guard<std::mutex> lock(lock_);
+  Slot* slot = Find(image);
+  if (!slot || slot->state != State::ACQUIRED) return false;
+  slot->state = State::QUEUED;
+  return true;
+}
+
+bool PreviewBufferTracker::OnPresented(void* image,
+                                       int previousReleaseFenceFd) {
+  std::lock_guard<std::mutex> lock(lock_);
+  Slot* slot = Find(image);
+  if (!slot || slot->state != State::QUEUED) {
+    if (previousReleaseFenceFd >= 0) close(previousReleaseFenceFd);
+    return false;
+  }
+
+  bool released = false;
+  for (auto& other : slots_) {
+    if (other.state == State::ON_SCREEN) {
+      Release(&other, previousReleaseFenceFd);
+      released = true;
+      break;
+    }
+  }
+  if (!released && previousReleaseFenceFd >= 0) close(previousReleaseFenceFd);
+
+  slot->state = State::ON_SCREEN;
+  presented_++;
+  return true;
+}
+
+bool PreviewBufferTracker::Drop(void* image) {
+  std::lock_guard<std::mutex> lock(lock_);
+  Slot* slot = Find(image);
+  if (!slot || slot->state == State::ON_SCREEN) return false;
+  Release(slot, -1);
+  dropped_++;
+  return true;
+}
+
+void PreviewBufferTracker::ReleaseAll(void) {
+  std::lock_guard<std::mutex> lock(lock_);
+  for (auto& slot : slots_) {
+    if (slot.state != State::FREE) Release(&slot, -1);
+  }
+}
+
+int32_t PreviewBufferTracker::Count(State state) const {
+  std::lock_guard<std::mutex> lock(lock_);
+  int32_t count = 0;
+  for (auto& slot : slots_) {
+    if (slot.state == state) count++;
+  }
+  return count;
+}
+
+uint64_t PreviewBufferTracker::PresentedCount(void) const {
+  std::lock_guard<std::mutex> lock(lock_);
+  return presented_;
+}
+
+uint64_t PreviewBufferTracker::DroppedCount(void) const {
+  std::lock_guard<std::mutex> lock(lock_);
+  return dropped_;
+}
@@ -0,0 +1,108 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef CAMERA_PREVIEW_BUFFER_TRACKER_H
+#define CAMERA_PREVIEW_BUFFER_TRACKER_H
+
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <vector>
+
+/*
+ * PreviewBufferTracker:
+ *   Ownership bookkeeping for camera images whose hardware buffers are handed
+ *   to the display without a copy. An image may only be deleted once the
+ *   display stopped reading from it, which is signalled by the release fence
+ *   it reports when the *next* buffer is latched:
+ *
+ *     FREE -> ACQUIRED -> QUEUED -> ON_SCREEN -> (release(image, fence)) FREE
+ *                |           |
+ *                +-----------+--> (Drop: release(image, -1)) FREE
+ *
+ *   Images are opaque handles here, so the tracker builds without the NDK and
+ *   the release action is supplied by the owner (AImage_deleteAsync() in the
+ *   app). All functions are thread safe: display callbacks arrive on a binder
+ *   thread while frames are queued from the app thread.
+ */
+class PreviewBufferTracker {
+ public:
+  enum class State : int32_t {
+    FREE = 0,
+    ACQUIRED,   // acquired from the reader, not yet given to the display
+    QUEUED,     // submitted to the display, not latched yet
+    ON_SCREEN,  // latched, the display may still read it
+    MAX_STATE
+  };
+
+  // Called once per image when the tracker gives up its ownership.
+  // fenceFd is -1 or a fence the release must wait on; it is owned by the
+  // callee.
+  using ReleaseFunc = std::function<void(void* image, int fenceFd)>;
+
+  PreviewBufferTracker(int32_t maxBuffers, ReleaseFunc release);
+  ~PreviewBufferTracker();
+
+  /**
+   * Start tracking an image just acquired from the reader.
+   * @return false if all slots are taken; the caller still owns the image.
+   */
+  bool Acquire(void* image);
+
+  /**
+   * The image has been submitted to the display.
+   */
+  bool Queue(void* image);
+
+  /**
+   * The display latched image. Whatever was on screen before is released
+   * with previousReleaseFenceFd, which is closed if nothing was on screen.
+   */
+  bool OnPresented(void* image, int previousReleaseFenceFd);
+
+  /**
+   * The image will never reach the display (submission failed, or it got
+   * superseded before being queued); release it right away.
+   */
+  bool Drop(void* image);
+
+  /**
+   * Release every tracked image regardless of state. Only call this once the
+   * display no longer references any of them (e.g. the layer was removed).
+   */
+  void ReleaseAll(void);
+
+  int32_t Count(State state) const;
+  uint64_t PresentedCount(void) const;
+  uint64_t DroppedCount(void) const;
+
+ private:
+  struct Slot {
+    void* image;
+    State state;
+  };
+
+  Slot* Find(void* image);
+  void Release(Slot* slot, int fenceFd);
+
+  mutable std::mutex lock_;
+  std::vector<Slot> slots_;
+  ReleaseFunc release_;
+  uint64_t presented_;
+  uint64_t dropped_;
+};
+
+#endif  // CAMERA_PREVIEW_BUFFER_TRACKER_H
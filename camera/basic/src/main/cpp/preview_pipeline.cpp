@@ -0,0 +1,177 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "preview_pipeline.h"
+
+#include <algorithm>
+
+/*
+ * How long an idle stage sleeps before polling its input again; a safety
+ * net only, stages are woken up by their producers.
+ */
+static const std::chrono::milliseconds kIdleWait(10);
+
+/*
+ * Frames in flight: one per queue slot, one per worker and one on display.
+ */
+static uint32_t FrameCount(int32_t workers, int32_t queueDepth) {
+  return 2 * queueDepth + workers + 1;
+}
+
+PreviewPipeline::PreviewPipeline(const Config& config, AcquireFunc acquire,
+                                 ConvertFunc convert, ReleaseFunc release,
+                                 PresentFunc present)
+    : config_(config),
+      acquire_(acquire),
+      convert_(convert),
+      release_(release),
+      present_(present),
+      stats_(nullptr),
+      frames_(FrameCount(std::max(1, config.workers),
+                         std::max(1, config.queueDepth))),
+      freeFrames_(frames_.size()),
+      convertQueue_(std::max(1, config.queueDepth)),
+      presentQueue_(std::max(1, config.queueDepth)),
+      running_(false),
+      nextSequence_(0),
+      lastPresented_(0),
+      presented_(0),
+      dropped_(0) {
+  config_.workers = std::max(1, config_.workers);
+  for (auto& frame : frames_) {
+    frame.source = nullptr;
+    frame.pixels.resize(static_cast<size_t>(config_.width) * config_.height);
+    freeFrames_.TryPush(&frame);
+  }
+}
+
+PreviewPipeline::~PreviewPipeline() { Stop(); }
+
+void PreviewPipeline::SetFrameStats(FrameStats* stats) { stats_ = stats; }
+
+void PreviewPipeline::Start(void) {
+  if (running_) return;
+  running_ = true;
+  threads_.emplace_back(&PreviewPipeline::AcquireLoop, this);
+  for (int32_t i = 0; i < config_.workers; i++) {
+    threads_.emplace_back(&PreviewPipeline::ConvertLoop, this);
+  }
+  threads_.emplace_back(&PreviewPipeline::PresentLoop, this);
+}
+
+void PreviewPipeline::Stop(void) {
+  if (!running_) return;
+  running_ = false;
+  acquireBell_.Ring();
+  convertBell_.Ring();
+  presentBell_.Ring();
+  for (auto& thread : threads_) thread.join();
+  threads_.clear();
+
+  Frame* frame;
+  while (convertQueue_.TryPop(&frame)) DropFrame(frame);
+  while (presentQueue_.TryPop(&frame)) freeFrames_.TryPush(frame);
+}
+
+void PreviewPipeline::NotifyFrameAvailable(void) { acquireBell_.Ring(); }
+
+uint64_t PreviewPipeline::PresentedCount(void) const { return presented_; }
+
+uint64_t PreviewPipeline::DroppedCount(void) const { return dropped_; }
+
+/*
+ * Discard a frame: give its source back if it was never converted.
+ */
+void PreviewPipeline::DropFrame(Frame* frame) {
+  if (frame->source) {
+    release_(frame->source);
+    frame->source = nullptr;
+  }
+  freeFrames_.TryPush(frame);
+  dropped_++;
+  if (stats_) stats_->OnImageDropped(1);
+}
+
+void PreviewPipeline::AcquireLoop(void) {
+  while (running_) {
+    Frame* frame;
+    if (!freeFrames_.TryPop(&frame)) {
+      // Everything is busy: wait for a frame to come back rather than
+      // holding more images from the camera.
+      acquireBell_.Wait(kIdleWait);
+      continue;
+    }
+
+    void* source = acquire_();
+    if (!source) {
+      freeFrames_.TryPush(frame);
+      acquireBell_.Wait(kIdleWait);
+      continue;
+    }
+    frame->source = source;
+    frame->sequence = ++nextSequence_;
+    frame->acquireNs = FrameClockNs();
+
+    convertQueue_.PushEvictOldest(frame,
+                                  [this](Frame* old) { DropFrame(old); });
+    convertBell_.Ring();
+  }
+}
+
+void PreviewPipeline::ConvertLoop(void) {
+  while (running_) {
+    Frame* frame;
+    if (!convertQueue_.TryPop(&frame)) {
+      convertBell_.Wait(kIdleWait);
+      continue;
+    }
+
+    convert_(frame->source, frame->pixels.data(), config_.width,
+             config_.height);
+    frame->source = nullptr;
+
+    presentQueue_.PushEvictOldest(frame,
+                                  [this](Frame* old) { DropFrame(old); });
+    presentBell_.Ring();
+  }
+}
+
+void PreviewPipeline::PresentLoop(void) {
+  while (running_) {
+    Frame* frame;
+    if (!presentQueue_.TryPop(&frame)) {
+      presentBell_.Wait(kIdleWait);
+      continue;
+    }
+
+    // a slower worker may finish an older frame after a newer one is shown
+    if (frame->sequence <= lastPresented_) {
+      DropFrame(frame);
+      acquireBell_.Ring();
+      continue;
+    }
+
+    present_(frame->pixels.data(), config_.width, config_.height);
+    lastPresented_ = frame->sequence;
+    presented_++;
+    if (stats_) {
+      stats_->OnFramePresented();
+      stats_->Record(PreviewMetric::PRESENT_LATENCY,
+                     FrameClockNs() - frame->acquireNs);
+    }
+    freeFrames_.TryPush(frame);
+    acquireBell_.Ring();
+  }
+}
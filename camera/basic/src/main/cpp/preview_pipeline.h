@@ -0,0 +1,125 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef CAMERA_PREVIEW_PIPELINE_H
+#define CAMERA_PREVIEW_PIPELINE_H
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <thread>
+#include <vector>
+
+#include "frame_queue.h"
+#include "frame_stats.h"
+
+/*
+ * PreviewPipeline:
+ *   Three stage CPU preview, so that converting frame N overlaps with
+ *   acquiring N+1 and presenting N-1:
+ *
+ *     acquire thread --> [convert queue] --> worker threads (convert)
+ *                    --> [present queue] --> present thread
+ *
+ *   Frames travel as pointers through bounded lock-free FrameQueues. When a
+ *   queue is full the oldest entry is dropped, and the present stage skips
+ *   frames finished out of order by parallel workers, so the display always
+ *   shows the most recent image.
+ *   Sources are opaque (AImage* in the app, synthetic frames on a host); the
+ *   stages are plain callbacks:
+ *     acquire(): next source, or nullptr if none is ready
+ *     convert(source, pixels, width, height): fill RGBA pixels (stride ==
+ *       width) and consume source
+ *     release(source): give back a source dropped before conversion
+ *     present(pixels, width, height): show a converted frame
+ */
+class PreviewPipeline {
+ public:
+  struct Config {
+    int32_t width;       // converted frame size, in pixels
+    int32_t height;
+    int32_t workers;     // conversion threads
+    int32_t queueDepth;  // capacity of each queue
+  };
+
+  using AcquireFunc = std::function<void*(void)>;
+  using ConvertFunc =
+      std::function<void(void* source, uint32_t* pixels, int32_t width,
+                         int32_t height)>;
+  using ReleaseFunc = std::function<void(void* source)>;
+  using PresentFunc =
+      std::function<void(const uint32_t* pixels, int32_t width,
+                         int32_t height)>;
+
+  PreviewPipeline(const Config& config, AcquireFunc acquire,
+                  ConvertFunc convert, ReleaseFunc release,
+                  PresentFunc present);
+  ~PreviewPipeline();
+
+  void Start(void);
+  // Stop all stages and release every source still in flight
+  void Stop(void);
+
+  /**
+   * Wake up the acquire stage: a new source is ready (AImageReader callback)
+   */
+  void NotifyFrameAvailable(void);
+
+  /**
+   * Report drops, presented frames and acquire-to-present latency
+   */
+  void SetFrameStats(FrameStats* stats);
+
+  uint64_t PresentedCount(void) const;
+  uint64_t DroppedCount(void) const;
+
+ private:
+  struct Frame {
+    void* source;
+    uint64_t sequence;
+    int64_t acquireNs;
+    std::vector<uint32_t> pixels;
+  };
+
+  void AcquireLoop(void);
+  void ConvertLoop(void);
+  void PresentLoop(void);
+  void DropFrame(Frame* frame);
+
+  Config config_;
+  AcquireFunc acquire_;
+  ConvertFunc convert_;
+  ReleaseFunc release_;
+  PresentFunc present_;
+  FrameStats* stats_;
+
+  std::vector<Frame> frames_;
+  FrameQueue<Frame*> freeFrames_;
+  FrameQueue<Frame*> convertQueue_;
+  FrameQueue<Frame*> presentQueue_;
+  Doorbell acquireBell_;
+  Doorbell convertBell_;
+  Doorbell presentBell_;
+
+  std::atomic<bool> running_;
+  uint64_t nextSequence_;
+  uint64_t lastPresented_;
+  std::atomic<uint64_t> presented_;
+  std::atomic<uint64_t> dropped_;
+  std::vector<std::thread> threads_;
+};
+
+#endif  // CAMERA_PREVIEW_PIPELINE_H
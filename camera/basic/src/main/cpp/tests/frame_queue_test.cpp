@@ -0,0 +1,108 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "frame_queue.h"
+
+#include <gtest/gtest.h>
+
+#include <thread>
+#include <vector>
+
+namespace {
+
+TEST(FrameQueueTest, RoundsCapacityUpToPowerOfTwoOfAtLeastTwo) {
+  EXPECT_EQ(FrameQueue<int>(1).Capacity(), 2u);
+  EXPECT_EQ(FrameQueue<int>(3).Capacity(), 4u);
+  EXPECT_EQ(FrameQueue<int>(8).Capacity(), 8u);
+}
+
+TEST(FrameQueueTest, IsFifoAndBounded) {
+  FrameQueue<int> queue(4);
+  for (int i = 0; i < 4; i++) EXPECT_TRUE(queue.TryPush(i));
+  EXPECT_FALSE(queue.TryPush(4));
+  for (int i = 0; i < 4; i++) {
+    int item = -1;
+    ASSERT_TRUE(queue.TryPop(&item));
+    EXPECT_EQ(item, i);
+  }
+  int item;
+  EXPECT_FALSE(queue.TryPop(&item));
+}
+
+TEST(FrameQueueTest, SingleItemQueueDoesNotOverwrite) {
+  FrameQueue<int> queue(1);
+  for (int i = 0; i < 2; i++) EXPECT_TRUE(queue.TryPush(i));
+  EXPECT_FALSE(queue.TryPush(2));
+  int item;
+  ASSERT_TRUE(queue.TryPop(&item));
+  EXPECT_EQ(item, 0);
+}
+
+TEST(FrameQueueTest, PushEvictOldestKeepsNewest) {
+  FrameQueue<int> queue(2);
+  std::vector<int> evicted;
+  for (int i = 0; i < 5; i++) {
+    queue.PushEvictOldest(i, [&evicted](int old) { evicted.push_back(old); });
+  }
+  EXPECT_EQ(evicted, (std::vector<int>{0, 1, 2}));
+  int item;
+  ASSERT_TRUE(queue.TryPop(&item));
+  EXPECT_EQ(item, 3);
+  ASSERT_TRUE(queue.TryPop(&item));
+  EXPECT_EQ(item, 4);
+}
+
+// Several producers and consumers, as the acquire thread and the workers
+// share the queues of the preview pipeline: nothing is lost or duplicated.
+TEST(FrameQueueTest, ConcurrentProducersAndConsumers) {
+  constexpr int kThreads = 2;
+  constexpr int kItemsPerProducer = 20000;
+  FrameQueue<int> queue(8);
+  std::vector<std::vector<int>> seen(kThreads);
+
+  std::vector<std::thread> threads;
+  for (int t = 0; t < kThreads; t++) {
+    threads.emplace_back([&queue, t] {
+      for (int i = 0; i < kItemsPerProducer; i++) {
+        while (!queue.TryPush(t * kItemsPerProducer + i)) {
+          std::this_thread::yield();
+        }
+      }
+    });
+    threads.emplace_back([&queue, &seen, t] {
+      for (int i = 0; i < kItemsPerProducer; i++) {
+        int item;
+        while (!queue.TryPop(&item)) std::this_thread::yield();
+        seen[t].push_back(item);
+      }
+    });
+  }
+  for (auto& thread : threads) thread.join();
+
+  std::vector<int> count(kThreads * kItemsPerProducer, 0);
+  for (const auto& items : seen) {
+    int last[kThreads] = {-1, -1};
+    for (int item : items) {
+      count[item]++;
+      // each consumer sees a producer's items in the order they were pushed
+      int producer = item / kItemsPerProducer;
+      EXPECT_GT(item, last[producer]);
+      last[producer] = item;
+    }
+  }
+  for (int n : count) ASSERT_EQ(n, 1);
+}
+
+}  // namespace
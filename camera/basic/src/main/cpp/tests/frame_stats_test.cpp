@@ -0,0 +1,161 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "frame_stats.h"
+
+#include <gtest/gtest.h>
+
+#include <thread>
+#include <vector>
+
+namespace {
+
+const FrameSummary& Metric(const FrameStatsReport& report,
+                           PreviewMetric metric) {
+  return report.metrics[static_cast<int32_t>(metric)];
+}
+
+TEST(FrameStatsTest, ReportsOncePerPeriod) {
+  FrameStats stats;
+  stats.Reset(1000);
+  FrameStatsReport report;
+  EXPECT_FALSE(stats.TakeReport(1999, 1000, &report));
+  ASSERT_TRUE(stats.TakeReport(2000, 1000, &report));
+  EXPECT_EQ(report.periodNs, 1000);
+  EXPECT_FALSE(stats.TakeReport(2999, 1000, &report));
+}
+
+TEST(FrameStatsTest, CountsImagesAndDrops) {
+  FrameStats stats;
+  stats.Reset(0);
+  for (int i = 0; i < 10; i++) stats.OnImageArrived(1000 + i);
+  for (int i = 0; i < 6; i++) {
+    stats.OnImageAcquired(2000 + i, 33333333LL * (i + 1));
+    stats.OnFramePresented();
+  }
+  stats.OnImageDropped(1);
+
+  FrameStatsReport report;
+  ASSERT_TRUE(stats.TakeReport(1000000000, 0, &report));
+  EXPECT_EQ(report.arrived, 10u);
+  EXPECT_EQ(report.acquired, 6u);
+  EXPECT_EQ(report.presented, 6u);
+  // the one the app dropped, and the four it never got
+  EXPECT_EQ(report.dropped, 5u);
+
+  const FrameSummary& interval =
+      Metric(report, PreviewMetric::SENSOR_INTERVAL);
+  EXPECT_EQ(interval.count, 5u);
+  EXPECT_EQ(interval.min_ns, 33333333);
+  EXPECT_EQ(interval.max_ns, 33333333);
+  EXPECT_EQ(Metric(report, PreviewMetric::ACQUIRE_LATENCY).count, 6u);
+
+  // a new period starts empty, the session keeps everything
+  ASSERT_TRUE(stats.TakeReport(2000000000, 0, &report));
+  EXPECT_EQ(report.arrived, 0u);
+  EXPECT_EQ(Metric(report, PreviewMetric::SENSOR_INTERVAL).count, 0u);
+  EXPECT_EQ(stats.Session(PreviewMetric::SENSOR_INTERVAL).count, 5u);
+}
+
+// An image that arrives at the end of a period and is acquired in the next
+// one is not a drop; the ones the reader can't be holding any more are.
+TEST(FrameStatsTest, CarriesImagesStillInTheReaderOver) {
+  FrameStats stats;
+  stats.SetMaxPending(2);
+  stats.Reset(0);
+  FrameStatsReport report;
+  for (int i = 0; i < 5; i++) stats.OnImageArrived(1000 + i);
+  for (int i = 0; i < 4; i++) stats.OnImageAcquired(2000 + i, 0);
+  stats.OnImageArrived(3000);
+  ASSERT_TRUE(stats.TakeReport(1000, 0, &report));
+  EXPECT_EQ(report.arrived, 6u);
+  EXPECT_EQ(report.acquired, 4u);
+  EXPECT_EQ(report.dropped, 0u);
+
+  stats.OnImageAcquired(4000, 0);
+  stats.OnImageAcquired(4001, 0);
+  for (int i = 0; i < 3; i++) stats.OnImageArrived(5000 + i);
+  stats.OnImageAcquired(6000, 0);
+  ASSERT_TRUE(stats.TakeReport(2000, 0, &report));
+  EXPECT_EQ(report.dropped, 0u);
+
+  // With the two carried over, seven not acquired: at most two can still be
+  // pending.
+  for (int i = 0; i < 6; i++) stats.OnImageArrived(7000 + i);
+  stats.OnImageAcquired(8000, 0);
+  stats.OnImageDropped(1);
+  ASSERT_TRUE(stats.TakeReport(3000, 0, &report));
+  EXPECT_EQ(report.dropped, 1u + 5u);
+
+  // Reset starts over with nothing pending.
+  stats.Reset(4000);
+  stats.OnImageArrived(5000);
+  stats.OnImageAcquired(5001, 0);
+  ASSERT_TRUE(stats.TakeReport(5000, 0, &report));
+  EXPECT_EQ(report.dropped, 0u);
+}
+
+TEST(FrameStatsTest, SummarizesDurations) {
+  FrameStats stats;
+  stats.Reset(0);
+  for (int64_t ms = 1; ms <= 100; ms++) {
+    stats.Record(PreviewMetric::CONVERSION_TIME, ms * 1000000);
+  }
+  FrameSummary summary = stats.Session(PreviewMetric::CONVERSION_TIME);
+  EXPECT_EQ(summary.count, 100u);
+  EXPECT_EQ(summary.min_ns, 1000000);
+  EXPECT_EQ(summary.max_ns, 100000000);
+  EXPECT_EQ(summary.mean_ns, 50500000);
+  // percentiles are the upper bound of their bucket, within 12.5%
+  EXPECT_GE(summary.p50_ns, 50000000);
+  EXPECT_LE(summary.p50_ns, 50000000 * 9 / 8);
+  EXPECT_GE(summary.p99_ns, 99000000);
+  EXPECT_LE(summary.p99_ns, 100000000);
+}
+
+// The reader callback, the app and the presenting threads record at once,
+// while the app takes reports.
+TEST(FrameStatsTest, RecordsFromSeveralThreads) {
+  const int kThreads = 4, kRecords = 20000;
+  FrameStats stats;
+  stats.Reset(0);
+  std::vector<std::thread> threads;
+  for (int t = 0; t < kThreads; t++) {
+    threads.emplace_back([&stats, t]() {
+      for (int i = 0; i < kRecords; i++) {
+        stats.Record(PreviewMetric::PRESENT_LATENCY, (t + 1) * 1000);
+      }
+    });
+  }
+  uint64_t reported = 0;
+  FrameStatsReport report;
+  for (int i = 0; i < 100; i++) {
+    if (stats.TakeReport(i + 1, 0, &report)) {
+      reported += Metric(report, PreviewMetric::PRESENT_LATENCY).count;
+    }
+  }
+  for (auto& thread : threads) thread.join();
+  ASSERT_TRUE(stats.TakeReport(1000, 0, &report));
+  reported += Metric(report, PreviewMetric::PRESENT_LATENCY).count;
+
+  EXPECT_EQ(reported, uint64_t(kThreads) * kRecords);
+  FrameSummary session = stats.Session(PreviewMetric::PRESENT_LATENCY);
+  EXPECT_EQ(session.count, uint32_t(kThreads * kRecords));
+  EXPECT_EQ(session.min_ns, 1000);
+  EXPECT_EQ(session.max_ns, kThreads * 1000);
+}
+
+}  // namespace
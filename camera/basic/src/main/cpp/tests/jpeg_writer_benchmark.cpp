@@ -0,0 +1,108 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+/*
+ * Images/s and MB/s of a burst of 30 synthetic 3 MB JPEG blobs written by
+ * JpegWriter with 1, 4 and 8 pending captures, against writing and syncing
+ * each file on the capture thread. Also how long the capture thread is held
+ * up per image. Files go to a temporary directory under argv[1], or /tmp.
+ */
+#include <dirent.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "jpeg_writer.h"
+
+namespace {
+
+constexpr int kImages = 30;
+constexpr size_t kBlobSize = 3 << 20;
+
+using Clock = std::chrono::steady_clock;
+
+void RemoveFiles(const std::string& dir) {
+  DIR* d = opendir(dir.c_str());
+  if (!d) return;
+  while (struct dirent* entry = readdir(d)) {
+    if (entry->d_name[0] != '.') unlink((dir + entry->d_name).c_str());
+  }
+  closedir(d);
+}
+
+void Report(const char* name, double blockedSeconds, double seconds) {
+  printf("%-24s %6.1f images/s %7.1f MB/s, capture thread %6.2f ms/image\n",
+         name, kImages / seconds, kImages * (kBlobSize / 1e6) / seconds,
+         blockedSeconds * 1e3 / kImages);
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  std::string pattern =
+      std::string(argc > 1 ? argv[1] : "/tmp") + "/jpeg_writer_XXXXXX";
+  if (!mkdtemp(&pattern[0])) {
+    perror("mkdtemp");
+    return 1;
+  }
+  std::string dir = pattern + "/";
+
+  // Incompressible, between the JPEG start and end markers.
+  std::vector<uint8_t> blob(kBlobSize);
+  std::mt19937 random(1);
+  for (uint8_t& byte : blob) byte = static_cast<uint8_t>(random());
+  blob[0] = 0xFF, blob[1] = 0xD8;
+  blob[kBlobSize - 2] = 0xFF, blob[kBlobSize - 1] = 0xD9;
+
+  for (int32_t maxPending : {1, 4, 8}) {
+    std::chrono::duration<double> blocked(0);
+    auto start = Clock::now();
+    {
+      JpegWriter writer(dir.c_str(), "burst", maxPending, nullptr);
+      for (int i = 0; i < kImages; i++) {
+        auto enqueue = Clock::now();
+        writer.Enqueue(blob.data(), blob.size());
+        blocked += Clock::now() - enqueue;
+      }
+      writer.Flush();
+    }
+    std::chrono::duration<double> elapsed = Clock::now() - start;
+    char name[32];
+    snprintf(name, sizeof(name), "JpegWriter, %d pending", maxPending);
+    Report(name, blocked.count(), elapsed.count());
+    RemoveFiles(dir);
+  }
+
+  auto start = Clock::now();
+  for (int i = 0; i < kImages; i++) {
+    std::string name = dir + "inline" + std::to_string(i) + ".jpg";
+    int fd = open(name.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0 || write(fd, blob.data(), blob.size()) < 0) perror(name.c_str());
+    fsync(fd);
+    close(fd);
+  }
+  std::chrono::duration<double> elapsed = Clock::now() - start;
+  Report("write and fsync inline", elapsed.count(), elapsed.count());
+  RemoveFiles(dir);
+  rmdir(dir.c_str());
+  return 0;
+}
@@ -0,0 +1,98 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "jpeg_writer.h"
+
+#include <dirent.h>
+#include <gtest/gtest.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+
+#include <atomic>
+#include <string>
+#include <vector>
+
+namespace {
+
+// Number of open file descriptors of the process, -1 if it can't tell.
+int CountOpenFiles(void) {
+  DIR* dir = opendir("/proc/self/fd");
+  if (!dir) return -1;
+  int count = 0;
+  while (readdir(dir)) count++;
+  closedir(dir);
+  return count;
+}
+
+class JpegWriterTest : public testing::Test {
+ protected:
+  void SetUp() override {
+    std::string pattern = testing::TempDir() + "jpeg_writer_XXXXXX";
+    ASSERT_NE(mkdtemp(&pattern[0]), nullptr);
+    dir_ = pattern + "/captures/";
+  }
+
+  std::string dir_;
+  std::vector<uint8_t> blob_ = std::vector<uint8_t>(64 * 1024, 0xab);
+};
+
+TEST_F(JpegWriterTest, WritesEveryCapture) {
+  std::vector<std::string> names;
+  JpegWriter writer(dir_.c_str(), "capture", 4,
+                    [&names](const char* name) { names.push_back(name); });
+  for (int i = 0; i < 30; i++) {
+    ASSERT_TRUE(writer.Enqueue(blob_.data(), blob_.size()));
+  }
+  writer.Flush();
+
+  ASSERT_EQ(names.size(), 30u);
+  for (const std::string& name : names) {
+    struct stat st;
+    ASSERT_EQ(stat(name.c_str(), &st), 0) << name;
+    EXPECT_EQ(static_cast<size_t>(st.st_size), blob_.size());
+  }
+}
+
+TEST_F(JpegWriterTest, RejectsUnusableDirectory) {
+  JpegWriter writer("/proc/self/no/such/dir/", "capture", 2, nullptr);
+  EXPECT_FALSE(writer.Enqueue(blob_.data(), blob_.size()));
+}
+
+// A steady stream of captures never lets the queue run dry; the files still
+// have to be synced and closed every maxPending captures.
+TEST_F(JpegWriterTest, BoundsOpenFilesUnderSteadyLoad) {
+  constexpr int32_t kMaxPending = 4;
+  int baseline = CountOpenFiles();
+  if (baseline < 0) GTEST_SKIP() << "no /proc/self/fd";
+
+  std::atomic<int> mostOpen(0);
+  std::atomic<int> written(0);
+  {
+    JpegWriter writer(dir_.c_str(), "capture", kMaxPending,
+                      [&mostOpen, &written](const char*) {
+                        mostOpen = std::max(mostOpen.load(), CountOpenFiles());
+                        written++;
+                      });
+    for (int i = 0; i < 200; i++) {
+      ASSERT_TRUE(writer.Enqueue(blob_.data(), blob_.size()));
+    }
+    writer.Flush();
+  }
+  EXPECT_EQ(written, 200);
+  // the callback's own directory handle is open while it counts
+  EXPECT_LE(mostOpen, baseline + kMaxPending + 1);
+}
+
+}  // namespace
@@ -0,0 +1,187 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "preview_buffer_tracker.h"
+
+#include <fcntl.h>
+#include <gtest/gtest.h>
+#include <unistd.h>
+
+#include <vector>
+
+namespace {
+
+using State = PreviewBufferTracker::State;
+
+// A file descriptor standing in for a display fence.
+int MakeFence(void) {
+  int fds[2];
+  if (pipe(fds) != 0) return -1;
+  close(fds[1]);
+  return fds[0];
+}
+
+bool IsOpen(int fd) { return fcntl(fd, F_GETFD) != -1; }
+
+class PreviewBufferTrackerTest : public testing::Test {
+ protected:
+  struct Released {
+    void* image;
+    int fenceFd;
+  };
+
+  // The release closes the fence, as AImage_deleteAsync() does.
+  PreviewBufferTracker::ReleaseFunc Recorder(void) {
+    return [this](void* image, int fenceFd) {
+      released_.push_back({image, fenceFd});
+      if (fenceFd >= 0) {
+        fence_was_open_.push_back(IsOpen(fenceFd));
+        close(fenceFd);
+      }
+    };
+  }
+
+  void* Image(int i) { return &images_[i]; }
+
+  int images_[8] = {};
+  std::vector<Released> released_;
+  std::vector<bool> fence_was_open_;
+};
+
+TEST_F(PreviewBufferTrackerTest, ReleasesTheImageBeforeWithItsFence) {
+  PreviewBufferTracker tracker(3, Recorder());
+  ASSERT_TRUE(tracker.Acquire(Image(0)));
+  EXPECT_EQ(tracker.Count(State::ACQUIRED), 1);
+  ASSERT_TRUE(tracker.Queue(Image(0)));
+  EXPECT_EQ(tracker.Count(State::QUEUED), 1);
+
+  // Nothing was on screen: the tracker closes the fence itself.
+  int fence = MakeFence();
+  ASSERT_TRUE(tracker.OnPresented(Image(0), fence));
+  EXPECT_FALSE(IsOpen(fence));
+  EXPECT_TRUE(released_.empty());
+  EXPECT_EQ(tracker.Count(State::ON_SCREEN), 1);
+
+  // The next frame releases the first with the fence the display gave.
+  ASSERT_TRUE(tracker.Acquire(Image(1)));
+  ASSERT_TRUE(tracker.Queue(Image(1)));
+  fence = MakeFence();
+  ASSERT_TRUE(tracker.OnPresented(Image(1), fence));
+  ASSERT_EQ(released_.size(), 1u);
+  EXPECT_EQ(released_[0].image, Image(0));
+  EXPECT_EQ(released_[0].fenceFd, fence);
+  ASSERT_EQ(fence_was_open_.size(), 1u);
+  EXPECT_TRUE(fence_was_open_[0]);
+  EXPECT_EQ(tracker.Count(State::ON_SCREEN), 1);
+  EXPECT_EQ(tracker.Count(State::FREE), 2);
+  EXPECT_EQ(tracker.PresentedCount(), 2u);
+}
+
+TEST_F(PreviewBufferTrackerTest, DropsWithoutAFence) {
+  PreviewBufferTracker tracker(3, Recorder());
+  ASSERT_TRUE(tracker.Acquire(Image(0)));
+  ASSERT_TRUE(tracker.Acquire(Image(1)));
+  ASSERT_TRUE(tracker.Queue(Image(1)));
+
+  EXPECT_TRUE(tracker.Drop(Image(0)));
+  EXPECT_TRUE(tracker.Drop(Image(1)));
+  ASSERT_EQ(released_.size(), 2u);
+  EXPECT_EQ(released_[0].image, Image(0));
+  EXPECT_EQ(released_[0].fenceFd, -1);
+  EXPECT_EQ(released_[1].image, Image(1));
+  EXPECT_EQ(released_[1].fenceFd, -1);
+  EXPECT_EQ(tracker.DroppedCount(), 2u);
+  EXPECT_EQ(tracker.Count(State::FREE), 3);
+
+  // Gone from the tracker: it is the caller's again.
+  EXPECT_FALSE(tracker.Drop(Image(0)));
+  EXPECT_FALSE(tracker.Queue(Image(1)));
+}
+
+// The display may still read what is on screen.
+TEST_F(PreviewBufferTrackerTest, DoesNotDropTheImageOnScreen) {
+  PreviewBufferTracker tracker(2, Recorder());
+  ASSERT_TRUE(tracker.Acquire(Image(0)));
+  ASSERT_TRUE(tracker.Queue(Image(0)));
+  ASSERT_TRUE(tracker.OnPresented(Image(0), -1));
+  EXPECT_FALSE(tracker.Drop(Image(0)));
+  EXPECT_TRUE(released_.empty());
+}
+
+TEST_F(PreviewBufferTrackerTest, RunsOutOfBuffers) {
+  PreviewBufferTracker tracker(2, Recorder());
+  ASSERT_TRUE(tracker.Acquire(Image(0)));
+  ASSERT_TRUE(tracker.Acquire(Image(1)));
+  EXPECT_FALSE(tracker.Acquire(Image(2)));
+  EXPECT_FALSE(tracker.Acquire(Image(0)));
+  EXPECT_FALSE(tracker.Acquire(nullptr));
+  EXPECT_TRUE(released_.empty());
+
+  ASSERT_TRUE(tracker.Drop(Image(0)));
+  EXPECT_TRUE(tracker.Acquire(Image(2)));
+}
+
+TEST_F(PreviewBufferTrackerTest, RefusesStepsOutOfOrder) {
+  PreviewBufferTracker tracker(2, Recorder());
+  EXPECT_FALSE(tracker.Queue(Image(0)));
+  ASSERT_TRUE(tracker.Acquire(Image(0)));
+  EXPECT_FALSE(tracker.OnPresented(Image(0), -1));
+
+  // A fence handed over with a refused call is closed, not leaked.
+  int fence = MakeFence();
+  EXPECT_FALSE(tracker.OnPresented(Image(1), fence));
+  EXPECT_FALSE(IsOpen(fence));
+
+  ASSERT_TRUE(tracker.Queue(Image(0)));
+  EXPECT_FALSE(tracker.Queue(Image(0)));
+  EXPECT_EQ(tracker.PresentedCount(), 0u);
+  EXPECT_TRUE(released_.empty());
+}
+
+TEST_F(PreviewBufferTrackerTest, ReleasesEverythingLeft) {
+  {
+    PreviewBufferTracker tracker(4, Recorder());
+    ASSERT_TRUE(tracker.Acquire(Image(0)));
+    ASSERT_TRUE(tracker.Acquire(Image(1)));
+    ASSERT_TRUE(tracker.Queue(Image(1)));
+    ASSERT_TRUE(tracker.OnPresented(Image(1), -1));
+    tracker.ReleaseAll();
+    EXPECT_EQ(released_.size(), 2u);
+    EXPECT_EQ(tracker.Count(State::FREE), 4);
+
+    ASSERT_TRUE(tracker.Acquire(Image(2)));
+  }
+  // The destructor releases what is still tracked.
+  ASSERT_EQ(released_.size(), 3u);
+  EXPECT_EQ(released_[2].image, Image(2));
+  for (const Released& released : released_) {
+    EXPECT_EQ(released.fenceFd, -1);
+  }
+}
+
+// Without a release function the tracker still closes the fences.
+TEST_F(PreviewBufferTrackerTest, ClosesFencesWithoutAReleaseFunction) {
+  PreviewBufferTracker tracker(2, nullptr);
+  ASSERT_TRUE(tracker.Acquire(Image(0)));
+  ASSERT_TRUE(tracker.Queue(Image(0)));
+  ASSERT_TRUE(tracker.OnPresented(Image(0), -1));
+  ASSERT_TRUE(tracker.Acquire(Image(1)));
+  ASSERT_TRUE(tracker.Queue(Image(1)));
+  int fence = MakeFence();
+  ASSERT_TRUE(tracker.OnPresented(Image(1), fence));
+  EXPECT_FALSE(IsOpen(fence));
+}
+
+}  // namespace
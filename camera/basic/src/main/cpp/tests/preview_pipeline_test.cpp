@@ -0,0 +1,114 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "preview_pipeline.h"
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+namespace {
+
+/*
+ * SyntheticCamera:
+ *   Sources are heap allocated frame numbers. The converter writes the
+ *   number into the first pixel so the display side can tell frames apart.
+ */
+struct SyntheticCamera {
+  std::atomic<uint32_t> acquired{0};
+  std::atomic<uint32_t> converted{0};
+  std::atomic<uint32_t> released{0};
+  uint32_t lastPresented = 0;
+  bool presentedInOrder = true;
+
+  PreviewPipeline Make(PreviewPipeline::Config config) {
+    return PreviewPipeline(
+        config, [this]() -> void* { return new uint32_t(++acquired); },
+        [this](void* source, uint32_t* pixels, int32_t width, int32_t height) {
+          uint32_t number = *static_cast<uint32_t*>(source);
+          delete static_cast<uint32_t*>(source);
+          for (int32_t i = 0; i < width * height; i++) pixels[i] = number;
+          converted++;
+        },
+        [this](void* source) {
+          delete static_cast<uint32_t*>(source);
+          released++;
+        },
+        [this](const uint32_t* pixels, int32_t, int32_t) {
+          if (pixels[0] <= lastPresented) presentedInOrder = false;
+          lastPresented = pixels[0];
+        });
+  }
+};
+
+void RunFor(PreviewPipeline* pipeline, int32_t frames) {
+  pipeline->Start();
+  for (int32_t i = 0; i < frames; i++) {
+    pipeline->NotifyFrameAvailable();
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  pipeline->Stop();
+}
+
+TEST(PreviewPipelineTest, EverySourceIsConvertedOrReleased) {
+  SyntheticCamera camera;
+  PreviewPipeline pipeline = camera.Make({64, 48, 2, 2});
+  RunFor(&pipeline, 100);
+
+  EXPECT_GT(camera.acquired, 0u);
+  EXPECT_EQ(camera.acquired, camera.converted + camera.released);
+  EXPECT_GT(pipeline.PresentedCount(), 0u);
+  EXPECT_LE(pipeline.PresentedCount(), camera.converted);
+}
+
+TEST(PreviewPipelineTest, PresentsNewestFramesInOrder) {
+  SyntheticCamera camera;
+  PreviewPipeline pipeline = camera.Make({64, 48, 3, 1});
+  RunFor(&pipeline, 100);
+
+  EXPECT_TRUE(camera.presentedInOrder);
+}
+
+TEST(PreviewPipelineTest, ReportsToFrameStats) {
+  SyntheticCamera camera;
+  PreviewPipeline pipeline = camera.Make({64, 48, 2, 2});
+  FrameStats stats;
+  stats.Reset(0);
+  pipeline.SetFrameStats(&stats);
+  RunFor(&pipeline, 50);
+
+  FrameStatsReport report;
+  ASSERT_TRUE(stats.TakeReport(FrameClockNs(), 0, &report));
+  EXPECT_EQ(report.presented, pipeline.PresentedCount());
+  EXPECT_EQ(report.dropped, pipeline.DroppedCount());
+  EXPECT_EQ(
+      report.metrics[static_cast<int32_t>(PreviewMetric::PRESENT_LATENCY)].count,
+      pipeline.PresentedCount());
+}
+
+TEST(PreviewPipelineTest, StopsWithoutFrames) {
+  PreviewPipeline pipeline(
+      {64, 48, 2, 2}, []() -> void* { return nullptr; },
+      [](void*, uint32_t*, int32_t, int32_t) {}, [](void*) {},
+      [](const uint32_t*, int32_t, int32_t) {});
+  pipeline.Start();
+  pipeline.Stop();
+  EXPECT_EQ(pipeline.PresentedCount(), 0u);
+  EXPECT_EQ(pipeline.DroppedCount(), 0u);
+}
+
+}  // namespace
@@ -0,0 +1,58 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Time per frame of ConvertYuvToRgba() for NV12 frames at 1080p and 4K, with
+ * and without rotation, on 1 and 4 threads.
+ */
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+
+#include "yuv_converter.h"
+
+int main(void) {
+  constexpr int kFrames = 30;
+  struct Size {
+    const char* name;
+    int32_t width;
+    int32_t height;
+  };
+  for (const Size& size : {Size{"1080p", 1920, 1080}, Size{"4K", 3840, 2160}}) {
+    int32_t w = size.width, h = size.height;
+    std::vector<uint8_t> y(w * h, 100), uv(w * h / 2, 128);
+    std::vector<uint32_t> out(w * h);
+    YuvImage src{y.data(), uv.data(), uv.data() + 1, w, w, 2, 0, 0, w, h};
+    for (int32_t threads : {1, 4}) {
+      YuvConverterPool pool(threads);
+      for (int32_t rotation : {0, 90}) {
+        RgbaImage dst{out.data(), rotation ? h : w, rotation ? w : h,
+                      rotation ? h : w};
+        ConvertYuvToRgba(src, dst, rotation, false, &pool);  // warm up
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < kFrames; i++) {
+          ConvertYuvToRgba(src, dst, rotation, false, &pool);
+        }
+        std::chrono::duration<double, std::milli> elapsed =
+            std::chrono::steady_clock::now() - start;
+        printf("%-5s rotation %3d, %d thread(s): %6.2f ms/frame\n", size.name,
+               rotation, threads, elapsed.count() / kFrames);
+      }
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,160 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "yuv_converter.h"
+
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <random>
+#include <thread>
+#include <tuple>
+#include <vector>
+
+namespace {
+
+/*
+ * TestFrame:
+ *     Random planes with padded strides and a crop window that starts on odd
+ *     coordinates, so every converter path sees unaligned rows.
+ */
+struct TestFrame {
+  TestFrame(int32_t width, int32_t height, int32_t uvPixelStride,
+            uint32_t seed) {
+    int32_t yStride = width + 5;
+    int32_t uvStride = (width / 2 + 3) * uvPixelStride + 3;
+    y.resize(yStride * height);
+    u.resize(uvStride * (height / 2 + 1) + 64);
+    v.resize(uvStride * (height / 2 + 1) + 64);
+    std::mt19937 random(seed);
+    for (auto* plane : {&y, &u, &v}) {
+      for (auto& c : *plane) c = static_cast<uint8_t>(random());
+    }
+    image = {y.data(),     u.data(), v.data(), yStride, uvStride,
+             uvPixelStride, 2,        1,        width - 4, height - 3};
+  }
+
+  std::vector<uint8_t> y, u, v;
+  YuvImage image;
+};
+
+bool IsTransposed(int32_t rotation) {
+  return rotation == 90 || rotation == 270;
+}
+
+// Destination for src rotated by rotation, with a padded stride.
+std::vector<uint32_t> MakeDestination(const YuvImage& src, int32_t rotation,
+                                      RgbaImage* dst) {
+  int32_t width = IsTransposed(rotation) ? src.height : src.width;
+  int32_t height = IsTransposed(rotation) ? src.width : src.height;
+  std::vector<uint32_t> bits((width + 9) * height, 0);
+  *dst = {bits.data(), width, height, width + 9};
+  return bits;
+}
+
+// Pixel by pixel conversion with YuvToRgbaPixel(), the expected output.
+std::vector<uint32_t> Reference(const YuvImage& src, int32_t rotation,
+                                bool mirror) {
+  RgbaImage dst;
+  std::vector<uint32_t> bits = MakeDestination(src, rotation, &dst);
+  int32_t w = src.width, h = src.height;
+  for (int32_t y = 0; y < h; y++) {
+    for (int32_t x = 0; x < w; x++) {
+      int32_t uvOffset = src.uvStride * ((y + src.top) >> 1) +
+                         ((src.left >> 1) + (x >> 1)) * src.uvPixelStride;
+      uint32_t pixel = YuvToRgbaPixel(
+          src.y[src.yStride * (y + src.top) + src.left + x],
+          src.u[uvOffset], src.v[uvOffset]);
+      int32_t outX, outY;
+      switch (rotation) {
+        case 0: outX = x; outY = y; break;
+        case 90: outX = h - 1 - y; outY = x; break;
+        case 180: outX = w - 1 - x; outY = h - 1 - y; break;
+        default: outX = y; outY = w - 1 - x; break;
+      }
+      if (mirror) outX = dst.width - 1 - outX;
+      bits[outY * dst.stride + outX] = pixel;
+    }
+  }
+  return bits;
+}
+
+// pixel stride, rotation, mirror, thread count
+using ConversionParam = std::tuple<int32_t, int32_t, bool, int32_t>;
+
+class YuvConverterTest : public testing::TestWithParam<ConversionParam> {};
+
+TEST_P(YuvConverterTest, MatchesScalarReference) {
+  auto [uvPixelStride, rotation, mirror, threads] = GetParam();
+  TestFrame frame(101 + uvPixelStride * 7, 67 + rotation / 90 * 3,
+                  uvPixelStride, rotation + uvPixelStride);
+  RgbaImage dst;
+  std::vector<uint32_t> out = MakeDestination(frame.image, rotation, &dst);
+
+  YuvConverterPool pool(threads);
+  ConvertYuvToRgba(frame.image, dst, rotation, mirror, &pool);
+
+  EXPECT_EQ(Reference(frame.image, rotation, mirror), out);
+}
+
+INSTANTIATE_TEST_SUITE_P(AllLayouts, YuvConverterTest,
+                         testing::Combine(testing::Values(1, 2, 3),
+                                          testing::Values(0, 90, 180, 270),
+                                          testing::Bool(),
+                                          testing::Values(1, 4)));
+
+TEST(YuvConverterPoolTest, ConvertsWithoutPool) {
+  TestFrame frame(96, 64, 2, 7);
+  RgbaImage dst;
+  std::vector<uint32_t> out = MakeDestination(frame.image, 90, &dst);
+  ConvertYuvToRgba(frame.image, dst, 90, false);
+  EXPECT_EQ(Reference(frame.image, 90, false), out);
+}
+
+TEST(YuvConverterPoolTest, ReusedAcrossFrames) {
+  YuvConverterPool pool(3);
+  for (uint32_t i = 0; i < 20; i++) {
+    TestFrame frame(160, 120, 2, i);
+    RgbaImage dst;
+    std::vector<uint32_t> out = MakeDestination(frame.image, 270, &dst);
+    ConvertYuvToRgba(frame.image, dst, 270, true, &pool);
+    ASSERT_EQ(Reference(frame.image, 270, true), out) << "frame " << i;
+  }
+}
+
+// Two readers convert through the same pool, as the preview and the capture
+// readers of the camera engine do.
+TEST(YuvConverterPoolTest, SharedBetweenThreads) {
+  YuvConverterPool pool(4);
+  auto convert = [&pool](int32_t rotation, uint32_t seed, bool* matched) {
+    *matched = true;
+    for (uint32_t i = 0; i < 20 && *matched; i++) {
+      TestFrame frame(200, 150, 2, seed + i);
+      RgbaImage dst;
+      std::vector<uint32_t> out = MakeDestination(frame.image, rotation, &dst);
+      ConvertYuvToRgba(frame.image, dst, rotation, false, &pool);
+      *matched = Reference(frame.image, rotation, false) == out;
+    }
+  };
+  bool previewMatched = false, captureMatched = false;
+  std::thread preview(convert, 0, 100, &previewMatched);
+  std::thread capture(convert, 90, 200, &captureMatched);
+  preview.join();
+  capture.join();
+  EXPECT_TRUE(previewMatched);
+  EXPECT_TRUE(captureMatched);
+}
+
+}  // namespace
@@ -0,0 +1,422 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "yuv_converter.h"
+
+#include <algorithm>
+#include <vector>
+
+#if defined(__ARM_NEON)
+#include <arm_neon.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+/*
+ * Number of source rows converted into a tile before it is transposed into
+ * the destination for 90/270 degree rotations: 16 RGBA pixels fill one
+ * 64 byte cache line of the destination row.
+ */
+static const int32_t kTileRows = 16;
+
+// This value is 2 ^ 18 - 1, and is used to clamp the RGB values before their
+// ranges are normalized to eight bits.
+static const int kMaxChannelValue = 262143;
+
+/**
+ * Helper function for YUV_420 to RGB conversion. Courtesy of Tensorflow
+ * ImageClassifier Sample:
+ * https://github.com/tensorflow/tensorflow/blob/master/tensorflow/examples/android/jni/yuv2rgb.cc
+ * The difference is that here we have to swap UV plane when calling it.
+ */
+uint32_t YuvToRgbaPixel(int nY, int nU, int nV) {
+  nY -= 16;
+  nU -= 128;
+  nV -= 128;
+  if (nY < 0) nY = 0;
+
+  // This is the floating point equivalent. We do the conversion in integer
+  // because some Android devices do not have floating point in hardware.
+  // nR = (int)(1.164 * nY + 1.596 * nV);
+  // nG = (int)(1.164 * nY - 0.813 * nV - 0.391 * nU);
+  // nB = (int)(1.164 * nY + 2.018 * nU);
+
+  int nR = (int)(1192 * nY + 1634 * nV);
+  int nG = (int)(1192 * nY - 833 * nV - 400 * nU);
+  int nB = (int)(1192 * nY + 2066 * nU);
+
+  nR = std::min(kMaxChannelValue, std::max(0, nR));
+  nG = std::min(kMaxChannelValue, std::max(0, nG));
+  nB = std::min(kMaxChannelValue, std::max(0, nB));
+
+  nR = (nR >> 10) & 0xff;
+  nG = (nG >> 10) & 0xff;
+  nB = (nB >> 10) & 0xff;
+
+  return 0xff000000 | (nB << 16) | (nG << 8) | nR;
+}
+
+/*
+ * The vectorized paths below compute exactly the integer math above:
+ * clamp(x, 0, 2^18 - 1) >> 10 is the same as saturating (x >> 10) to
+ * [0, 255], which both NEON and SSE2 do for free while narrowing.
+ * They handle 16 pixels (8 chroma samples) per iteration.
+ */
+#if defined(__ARM_NEON)
+static inline uint8x8_t NarrowChannel(int32x4_t lo, int32x4_t hi) {
+  return vqmovn_u16(
+      vcombine_u16(vqshrun_n_s32(lo, 10), vqshrun_n_s32(hi, 10)));
+}
+
+static inline void ConvertHalf(uint8x8_t y8, uint8x8_t u8, uint8x8_t v8,
+                               uint8_t* out) {
+  int16x8_t y = vreinterpretq_s16_u16(vmovl_u8(y8));
+  int16x8_t u = vsubq_s16(vreinterpretq_s16_u16(vmovl_u8(u8)), vdupq_n_s16(128));
+  int16x8_t v = vsubq_s16(vreinterpretq_s16_u16(vmovl_u8(v8)), vdupq_n_s16(128));
+
+  int32x4_t yLo = vmull_n_s16(vget_low_s16(y), 1192);
+  int32x4_t yHi = vmull_n_s16(vget_high_s16(y), 1192);
+
+  int32x4_t rLo = vmlal_n_s16(yLo, vget_low_s16(v), 1634);
+  int32x4_t rHi = vmlal_n_s16(yHi, vget_high_s16(v), 1634);
+  int32x4_t gLo = vmlal_n_s16(vmlal_n_s16(yLo, vget_low_s16(v), -833),
+                              vget_low_s16(u), -400);
+  int32x4_t gHi = vmlal_n_s16(vmlal_n_s16(yHi, vget_high_s16(v), -833),
+                              vget_high_s16(u), -400);
+  int32x4_t bLo = vmlal_n_s16(yLo, vget_low_s16(u), 2066);
+  int32x4_t bHi = vmlal_n_s16(yHi, vget_high_s16(u), 2066);
+
+  uint8x8x4_t rgba;
+  rgba.val[0] = NarrowChannel(rLo, rHi);
+  rgba.val[1] = NarrowChannel(gLo, gHi);
+  rgba.val[2] = NarrowChannel(bLo, bHi);
+  rgba.val[3] = vdup_n_u8(0xff);
+  vst4_u8(out, rgba);
+}
+
+static inline void Convert16(const uint8_t* pY, uint8x8_t u8, uint8x8_t v8,
+                             uint32_t* out) {
+  uint8x16_t y = vqsubq_u8(vld1q_u8(pY), vdupq_n_u8(16));
+  uint8x8x2_t u = vzip_u8(u8, u8);
+  uint8x8x2_t v = vzip_u8(v8, v8);
+  uint8_t* dst = reinterpret_cast<uint8_t*>(out);
+  ConvertHalf(vget_low_u8(y), u.val[0], v.val[0], dst);
+  ConvertHalf(vget_high_u8(y), u.val[1], v.val[1], dst + 32);
+}
+
+static inline void LoadChroma(const uint8_t* p, int32_t pixelStride,
+                              uint8x8_t* c) {
+  *c = (pixelStride == 1) ? vld1_u8(p) : vld2_u8(p).val[0];
+}
+#elif defined(__SSE2__)
+// pairs of 16 bit coefficients for _mm_madd_epi16
+static inline __m128i Coeffs(int16_t a, int16_t b) {
+  return _mm_setr_epi16(a, b, a, b, a, b, a, b);
+}
+
+static inline __m128i Channel(__m128i a, __m128i b, __m128i coeffA,
+                              __m128i coeffB) {
+  return _mm_srai_epi32(_mm_add_epi32(_mm_madd_epi16(a, coeffA),
+                                      _mm_madd_epi16(b, coeffB)),
+                        10);
+}
+
+// Convert 8 pixels (16 bit lanes) into 8 bytes per channel
+static inline void ConvertHalf(__m128i y, __m128i u, __m128i v, __m128i* r,
+                               __m128i* g, __m128i* b) {
+  const __m128i kR = Coeffs(1192, 1634);
+  const __m128i kG = Coeffs(1192, -833);
+  const __m128i kGu = Coeffs(-400, 0);
+  const __m128i kB = Coeffs(1192, 2066);
+  const __m128i zero = _mm_setzero_si128();
+
+  __m128i yvLo = _mm_unpacklo_epi16(y, v), yvHi = _mm_unpackhi_epi16(y, v);
+  __m128i yuLo = _mm_unpacklo_epi16(y, u), yuHi = _mm_unpackhi_epi16(y, u);
+  __m128i uLo = _mm_unpacklo_epi16(u, zero), uHi = _mm_unpackhi_epi16(u, zero);
+
+  *r = _mm_packs_epi32(_mm_srai_epi32(_mm_madd_epi16(yvLo, kR), 10),
+                       _mm_srai_epi32(_mm_madd_epi16(yvHi, kR), 10));
+  *g = _mm_packs_epi32(Channel(yvLo, uLo, kG, kGu),
+                       Channel(yvHi, uHi, kG, kGu));
+  *b = _mm_packs_epi32(_mm_srai_epi32(_mm_madd_epi16(yuLo, kB), 10),
+                       _mm_srai_epi32(_mm_madd_epi16(yuHi, kB), 10));
+}
+
+static inline void Convert16(const uint8_t* pY, __m128i u8, __m128i v8,
+                             uint32_t* out) {
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i k128 = _mm_set1_epi16(128);
+  __m128i y = _mm_subs_epu8(
+      _mm_loadu_si128(reinterpret_cast<const __m128i*>(pY)),
+      _mm_set1_epi8(16));
+  __m128i u = _mm_unpacklo_epi8(u8, u8);
+  __m128i v = _mm_unpacklo_epi8(v8, v8);
+
+  __m128i rLo, gLo, bLo, rHi, gHi, bHi;
+  ConvertHalf(_mm_unpacklo_epi8(y, zero),
+              _mm_sub_epi16(_mm_unpacklo_epi8(u, zero), k128),
+              _mm_sub_epi16(_mm_unpacklo_epi8(v, zero), k128), &rLo, &gLo,
+              &bLo);
+  ConvertHalf(_mm_unpackhi_epi8(y, zero),
+              _mm_sub_epi16(_mm_unpackhi_epi8(u, zero), k128),
+              _mm_sub_epi16(_mm_unpackhi_epi8(v, zero), k128), &rHi, &gHi,
+              &bHi);
+  __m128i r = _mm_packus_epi16(rLo, rHi);
+  __m128i g = _mm_packus_epi16(gLo, gHi);
+  __m128i b = _mm_packus_epi16(bLo, bHi);
+  __m128i a = _mm_set1_epi8(static_cast<char>(0xff));
+
+  __m128i rgLo = _mm_unpacklo_epi8(r, g), rgHi = _mm_unpackhi_epi8(r, g);
+  __m128i baLo = _mm_unpacklo_epi8(b, a), baHi = _mm_unpackhi_epi8(b, a);
+  __m128i* dst = reinterpret_cast<__m128i*>(out);
+  _mm_storeu_si128(dst + 0, _mm_unpacklo_epi16(rgLo, baLo));
+  _mm_storeu_si128(dst + 1, _mm_unpackhi_epi16(rgLo, baLo));
+  _mm_storeu_si128(dst + 2, _mm_unpacklo_epi16(rgHi, baHi));
+  _mm_storeu_si128(dst + 3, _mm_unpackhi_epi16(rgHi, baHi));
+}
+
+static inline void LoadChroma(const uint8_t* p, int32_t pixelStride,
+                              __m128i* c) {
+  if (pixelStride == 1) {
+    *c = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(p));
+  } else {
+    __m128i even =
+        _mm_and_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p)),
+                      _mm_set1_epi16(0x00ff));
+    *c = _mm_packus_epi16(even, even);
+  }
+}
+#endif
+
+/*
+ * Convert one row of width pixels into out[0..width).
+ * pU/pV point at the chroma samples of the first pixel.
+ */
+static void ConvertRow(const uint8_t* pY, const uint8_t* pU,
+                       const uint8_t* pV, int32_t uvPixelStride,
+                       int32_t width, uint32_t* out) {
+  int32_t x = 0;
+#if defined(__ARM_NEON) || defined(__SSE2__)
+  if (uvPixelStride == 1 || uvPixelStride == 2) {
+    // A semi-planar load reads one byte past the last chroma sample it uses,
+    // so always leave the last two pixels of a row to the scalar loop.
+    for (; x + 16 + 2 <= width; x += 16) {
+      const int32_t uvOffset = (x >> 1) * uvPixelStride;
+#if defined(__ARM_NEON)
+      uint8x8_t u, v;
+#else
+      __m128i u, v;
+#endif
+      LoadChroma(pU + uvOffset, uvPixelStride, &u);
+      LoadChroma(pV + uvOffset, uvPixelStride, &v);
+      Convert16(pY + x, u, v, out + x);
+    }
+  }
+#endif
+  for (; x < width; x++) {
+    const int32_t uvOffset = (x >> 1) * uvPixelStride;
+    out[x] = YuvToRgbaPixel(pY[x], pU[uvOffset], pV[uvOffset]);
+  }
+}
+
+/*
+ * Mapping:
+ *   Destination of source pixel (x, y) is bits[base + x * dx + y * dy];
+ *   one of dx/dy is +-1 and the other is +-stride.
+ */
+struct Mapping {
+  int64_t base;
+  int64_t dx;
+  int64_t dy;
+  int32_t width;
+  int32_t height;
+};
+
+static void ConvertBand(const YuvImage& src, uint32_t* bits,
+                        const Mapping& m, int32_t yBegin, int32_t yEnd) {
+  auto rowY = [&src](int32_t y) {
+    return src.y + src.yStride * (y + src.top) + src.left;
+  };
+  auto rowUVOffset = [&src](int32_t y) {
+    return src.uvStride * ((y + src.top) >> 1) +
+           (src.left >> 1) * src.uvPixelStride;
+  };
+
+  if (m.dx == 1) {
+    for (int32_t y = yBegin; y < yEnd; y++) {
+      int32_t uv = rowUVOffset(y);
+      ConvertRow(rowY(y), src.u + uv, src.v + uv, src.uvPixelStride, m.width,
+                 bits + m.base + y * m.dy);
+    }
+    return;
+  }
+
+  if (m.dx == -1) {
+    std::vector<uint32_t> line(m.width);
+    for (int32_t y = yBegin; y < yEnd; y++) {
+      int32_t uv = rowUVOffset(y);
+      ConvertRow(rowY(y), src.u + uv, src.v + uv, src.uvPixelStride, m.width,
+                 line.data());
+      std::reverse_copy(line.begin(), line.end(),
+                        bits + m.base + y * m.dy - (m.width - 1));
+    }
+    return;
+  }
+
+  // Rotated by 90/270: consecutive source rows land in consecutive
+  // destination columns, so convert a tile of rows and write it out as
+  // short contiguous runs, one per destination row.
+  std::vector<uint32_t> tile(static_cast<size_t>(kTileRows) * m.width);
+  for (int32_t y0 = yBegin; y0 < yEnd; y0 += kTileRows) {
+    int32_t rows = std::min(kTileRows, yEnd - y0);
+    for (int32_t r = 0; r < rows; r++) {
+      int32_t uv = rowUVOffset(y0 + r);
+      ConvertRow(rowY(y0 + r), src.u + uv, src.v + uv, src.uvPixelStride,
+                 m.width, &tile[static_cast<size_t>(r) * m.width]);
+    }
+    uint32_t* column = bits + m.base + y0 * m.dy;
+    for (int32_t x = 0; x < m.width; x++) {
+      uint32_t* out = column + x * m.dx;
+      const uint32_t* in = &tile[x];
+      if (m.dy == 1) {
+        for (int32_t r = 0; r < rows; r++) out[r] = in[r * m.width];
+      } else {
+        for (int32_t r = 0; r < rows; r++) out[-r] = in[r * m.width];
+      }
+    }
+  }
+}
+
+struct YuvConverterPool::Job {
+  const YuvImage* src;
+  uint32_t* bits;
+  const Mapping* mapping;
+  int32_t bandRows;
+  int32_t next;     // first row of the next band to claim
+  int32_t pending;  // bands not converted yet
+};
+
+void ConvertYuvToRgba(const YuvImage& src, const RgbaImage& dst,
+                      int32_t rotation, bool mirror, YuvConverterPool* pool) {
+  const bool transposed = (rotation == 90 || rotation == 270);
+  Mapping m;
+  m.width = std::min(src.width, transposed ? dst.height : dst.width);
+  m.height = std::min(src.height, transposed ? dst.width : dst.height);
+  if (m.width <= 0 || m.height <= 0) return;
+
+  const int64_t stride = dst.stride;
+  switch (rotation) {
+    case 90:  // (x, y) --> (-y, x)
+      m.base = m.height - 1;
+      m.dx = stride;
+      m.dy = -1;
+      break;
+    case 180:  // (x, y) --> (-x, -y)
+      m.base = (m.height - 1) * stride + (m.width - 1);
+      m.dx = -1;
+      m.dy = -stride;
+      break;
+    case 270:  // (x, y) --> (y, -x)
+      m.base = (m.width - 1) * stride;
+      m.dx = -stride;
+      m.dy = 1;
+      break;
+    default:  // (x, y) --> (x, y)
+      m.base = 0;
+      m.dx = 1;
+      m.dy = stride;
+      break;
+  }
+  if (mirror) {
+    // flip the destination columns: negate whichever step walks along a
+    // destination row and move the base to the other end of that row
+    int64_t* step = transposed ? &m.dy : &m.dx;
+    int32_t outWidth = transposed ? m.height : m.width;
+    m.base += (*step > 0) ? (outWidth - 1) : -(outWidth - 1);
+    *step = -*step;
+  }
+
+  int32_t threadCount = pool ? pool->ThreadCount() : 1;
+  threadCount = std::max(1, std::min(threadCount, m.height / kTileRows));
+  if (threadCount == 1) {
+    ConvertBand(src, dst.bits, m, 0, m.height);
+    return;
+  }
+
+  // Keep band boundaries on tile boundaries so rotated bands write whole
+  // tiles.
+  YuvConverterPool::Job job;
+  job.src = &src;
+  job.bits = dst.bits;
+  job.mapping = &m;
+  job.bandRows =
+      (m.height / threadCount + kTileRows - 1) / kTileRows * kTileRows;
+  job.next = 0;
+  job.pending = (m.height + job.bandRows - 1) / job.bandRows;
+  pool->Run(&job);
+}
+
+/*
+ * YuvConverterPool
+ */
+YuvConverterPool::YuvConverterPool(int32_t threadCount)
+    : threadCount_(std::max(1, threadCount)), stop_(false) {
+  for (int32_t i = 1; i < threadCount_; i++) {
+    workers_.emplace_back(&YuvConverterPool::WorkerLoop, this);
+  }
+}
+
+YuvConverterPool::~YuvConverterPool() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stop_ = true;
+  }
+  work_.notify_all();
+  for (auto& worker : workers_) worker.join();
+}
+
+void YuvConverterPool::ConvertNextBand(std::unique_lock<std::mutex>& lock) {
+  Job* job = jobs_.front();
+  int32_t begin = job->next;
+  int32_t end = std::min(job->mapping->height, begin + job->bandRows);
+  job->next = end;
+  if (end == job->mapping->height) jobs_.erase(jobs_.begin());
+
+  lock.unlock();
+  ConvertBand(*job->src, job->bits, *job->mapping, begin, end);
+  lock.lock();
+  // The job belongs to the thread in Run(), which may return as soon as
+  // this is 0: don't touch it afterwards.
+  if (--job->pending == 0) done_.notify_all();
+}
+
+void YuvConverterPool::Run(Job* job) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  jobs_.push_back(job);
+  work_.notify_all();
+  // Help with the frames queued before this one too: they have to be done
+  // for the helpers to get to this one anyway.
+  while (job->next < job->mapping->height) ConvertNextBand(lock);
+  done_.wait(lock, [job] { return job->pending == 0; });
+}
+
+void YuvConverterPool::WorkerLoop(void) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  for (;;) {
+    work_.wait(lock, [this] { return stop_ || !jobs_.empty(); });
+    if (stop_) return;
+    ConvertNextBand(lock);
+  }
+}
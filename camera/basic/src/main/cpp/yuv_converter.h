@@ -0,0 +1,122 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef CAMERA_YUV_CONVERTER_H
+#define CAMERA_YUV_CONVERTER_H
+
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/*
+ * YuvImage:
+ *     Plane layout of a YUV_420_888 image, as reported by AImage. The
+ *     converter only depends on this description, not on the NDK media
+ *     headers, so it builds for the host as well.
+ *     uvPixelStride is 1 for planar (I420) and 2 for semi-planar (NV12/NV21)
+ *     chroma; any other value is handled by the scalar path.
+ */
+struct YuvImage {
+  const uint8_t* y;
+  const uint8_t* u;
+  const uint8_t* v;
+  int32_t yStride;
+  int32_t uvStride;
+  int32_t uvPixelStride;
+
+  // crop window inside the planes
+  int32_t left;
+  int32_t top;
+  int32_t width;
+  int32_t height;
+};
+
+/*
+ * RgbaImage:
+ *     Destination buffer in RGBA_8888/RGBX_8888 layout, stride in pixels
+ *     (same meaning as ANativeWindow_Buffer::stride).
+ */
+struct RgbaImage {
+  uint32_t* bits;
+  int32_t width;
+  int32_t height;
+  int32_t stride;
+};
+
+/*
+ * YuvConverterPool:
+ *     Threads helping ConvertYuvToRgba() with the row bands of a frame. They
+ *     live as long as the pool and sleep between frames. Several threads may
+ *     convert frames through the same pool at once: the helpers take bands
+ *     from the frames in the order they came in.
+ */
+class YuvConverterPool {
+ public:
+  /**
+   * @param threadCount number of threads converting a frame, including the
+   *        one calling ConvertYuvToRgba(): threadCount - 1 helpers start.
+   */
+  explicit YuvConverterPool(int32_t threadCount);
+  ~YuvConverterPool();
+
+  int32_t ThreadCount(void) const { return threadCount_; }
+
+  struct Job;
+  // Convert the bands of job with the helpers, return when all are done.
+  void Run(Job* job);
+
+ private:
+  void WorkerLoop(void);
+  // Claim the next band of jobs_.front() and convert it, with mutex_ held
+  // on entry and exit.
+  void ConvertNextBand(std::unique_lock<std::mutex>& lock);
+
+  int32_t threadCount_;
+  std::mutex mutex_;
+  std::condition_variable work_;
+  std::condition_variable done_;
+  std::vector<Job*> jobs_;  // with bands left to claim, oldest first
+  bool stop_;
+  std::vector<std::thread> workers_;
+};
+
+/**
+ * Convert a YUV_420_888 image into RGBA, rotating it anti-clockwise by
+ * rotation degrees (0, 90, 180 or 270) and optionally mirroring it
+ * horizontally in the same pass.
+ *   The source is cropped to whatever fits into the (rotated) destination.
+ *   90/270 degree rotations are written through small tiles of converted rows
+ *   so that the destination is filled in contiguous runs, not column by column.
+ * @param src source image description
+ * @param dst destination buffer
+ * @param rotation anti-clockwise rotation, multiple of 90
+ * @param mirror true to flip the output horizontally
+ * @param pool threads to split the source rows across, nullptr to convert on
+ *        the calling thread only.
+ */
+void ConvertYuvToRgba(const YuvImage& src, const RgbaImage& dst,
+                      int32_t rotation, bool mirror,
+                      YuvConverterPool* pool = nullptr);
+
+/**
+ * Scalar conversion of a single pixel, kept as the reference the vectorized
+ * paths must match bit for bit.
+ */
+uint32_t YuvToRgbaPixel(int nY, int nU, int nV);
+
+#endif  // CAMERA_YUV_CONVERTER_H
@@ -0,0 +1,52 @@
+# Test and benchmark targets for the native code the samples keep free of
+# NDK-only APIs.
+#
+# add_native_tests(<name> SOURCES ... [LIBRARIES ...]) builds the googletest
+# tests of a sample. In the NDK build it is the shared library that the
+# androidTest GtestRunner loads (see unit-test/), so <name> has to match the
+# @TargetLibrary and the testOnly entry of the sample's build.gradle. For a
+# host it is an executable registered with CTest:
+#
+#   cmake -S <sample>/src/main/cpp/tests -B build && cmake --build build
+#   ctest --test-dir build
+#
+# add_native_benchmark(<name> SOURCES ... [LIBRARIES ...]) builds a host
+# executable with its own main(). Benchmarks are not run by CTest.
+include_guard(GLOBAL)
+
+function(add_native_tests name)
+  cmake_parse_arguments(ARG "" "" "SOURCES;LIBRARIES" ${ARGN})
+  if(ANDROID)
+    find_package(googletest REQUIRED CONFIG)
+    find_package(junit-gtest REQUIRED CONFIG)
+    add_library(${name} SHARED ${ARG_SOURCES})
+    target_link_libraries(${name}
+      PRIVATE
+        ${ARG_LIBRARIES}
+        googletest::gtest
+        junit-gtest::junit-gtest
+    )
+  else()
+    find_package(GTest REQUIRED)
+    find_package(Threads REQUIRED)
+    include(GoogleTest)
+    add_executable(${name} ${ARG_SOURCES})
+    target_link_libraries(${name}
+      PRIVATE
+        ${ARG_LIBRARIES}
+        GTest::gtest_main
+        Threads::Threads
+    )
+    gtest_discover_tests(${name})
+  endif()
+endfunction()
+
+function(add_native_benchmark name)
+  if(ANDROID)
+    return()
+  endif()
+  cmake_parse_arguments(ARG "" "" "SOURCES;LIBRARIES" ${ARGN})
+  find_package(Threads REQUIRED)
+  add_executable(${name} ${ARG_SOURCES})
+  target_link_libraries(${name} PRIVATE ${ARG_LIBRARIES} Threads::Threads)
+endfunction()
@@ -0,0 +1,217 @@
+/*
+ * Copyright (C) 2010 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "frame_timing.h"
+
+#include <math.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+
+#ifdef __ANDROID__
+#include <android/log.h>
+#define LOG_REPORT(tag, ...) \
+  __android_log_print(ANDROID_LOG_INFO, tag, __VA_ARGS__)
+#else
+#include <stdio.h>
+#define LOG_REPORT(tag, ...) \
+  (fprintf(stderr, "%s: ", tag), fprintf(stderr, __VA_ARGS__), \
+   fputc('\n', stderr))
+#endif
+
+#define SUB_BUCKETS (1 << FRAME_HISTOGRAM_SUB_BITS)
+
+int64_t frame_timing_now_ns(void) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (int64_t)now.tv_sec * 1000000000LL + now.tv_nsec;
+}
+
+static int32_t bucket_of(int64_t us) {
+  if (us < SUB_BUCKETS) {
+    return us < 0 ? 0 : (int32_t)us;
+  }
+  int32_t exponent = 63 - __builtin_clzll((uint64_t)us);
+  int32_t sub = (int32_t)(us >> (exponent - FRAME_HISTOGRAM_SUB_BITS)) &
+                (SUB_BUCKETS - 1);
+  int32_t bucket =
+      SUB_BUCKETS + (exponent - FRAME_HISTOGRAM_SUB_BITS) * SUB_BUCKETS + sub;
+  return bucket < FRAME_HISTOGRAM_BUCKETS ? bucket
+                                          : FRAME_HISTOGRAM_BUCKETS - 1;
+}
+
+static int64_t bucket_lower_us(int32_t bucket) {
+  if (bucket < SUB_BUCKETS) {
+    return bucket;
+  }
+  int32_t exponent =
+      (bucket - SUB_BUCKETS) / SUB_BUCKETS + FRAME_HISTOGRAM_SUB_BITS;
+  int32_t sub = (bucket - SUB_BUCKETS) % SUB_BUCKETS;
+  return (int64_t)(SUB_BUCKETS + sub) << (exponent - FRAME_HISTOGRAM_SUB_BITS);
+}
+
+void frame_histogram_reset(FrameHistogram* histogram) {
+  memset(histogram, 0, sizeof(*histogram));
+  histogram->min_ns = INT64_MAX;
+}
+
+void frame_histogram_record(FrameHistogram* histogram, int64_t ns) {
+  if (ns < 0) ns = 0;
+  histogram->buckets[bucket_of(ns / 1000)]++;
+  histogram->count++;
+  histogram->sum_ns += ns;
+  if (ns < histogram->min_ns) histogram->min_ns = ns;
+  if (ns > histogram->max_ns) histogram->max_ns = ns;
+}
+
+int64_t frame_histogram_percentile_ns(const FrameHistogram* histogram,
+                                      double percentile) {
+  if (histogram->count == 0) {
+    return 0;
+  }
+  uint32_t target = (uint32_t)ceil(percentile / 100.0 * histogram->count);
+  if (target < 1) target = 1;
+  if (target > histogram->count) target = histogram->count;
+
+  uint32_t seen = 0;
+  int32_t bucket;
+  for (bucket = 0; bucket < FRAME_HISTOGRAM_BUCKETS; bucket++) {
+    seen += histogram->buckets[bucket];
+    if (seen >= target) {
+      int64_t upper_ns = bucket_lower_us(bucket + 1) * 1000;
+      return upper_ns < histogram->max_ns ? upper_ns : histogram->max_ns;
+    }
+  }
+  return histogram->max_ns;
+}
+
+void frame_histogram_summarize(const FrameHistogram* histogram,
+                               FrameSummary* summary) {
+  summary->count = histogram->count;
+  if (histogram->count == 0) {
+    memset(summary, 0, sizeof(*summary));
+    return;
+  }
+  summary->mean_ns = histogram->sum_ns / histogram->count;
+  summary->min_ns = histogram->min_ns;
+  summary->p50_ns = frame_histogram_percentile_ns(histogram, 50);
+  summary->p90_ns = frame_histogram_percentile_ns(histogram, 90);
+  summary->p99_ns = frame_histogram_percentile_ns(histogram, 99);
+  summary->max_ns = histogram->max_ns;
+}
+
+static void start_period(FrameTiming* timing, int64_t now_ns) {
+  int32_t metric;
+  for (metric = 0; metric < FRAME_METRIC_COUNT; metric++) {
+    frame_histogram_reset(&timing->metrics[metric]);
+  }
+  timing->period_start_ns = now_ns;
+  timing->frames = 0;
+}
+
+void frame_timing_init(FrameTiming* timing, int64_t now_ns) {
+  start_period(timing, now_ns);
+  timing->last_frame_start_ns = 0;
+  timing->frame_start_ns = 0;
+  timing->phase_start_ns = 0;
+}
+
+void frame_timing_begin_frame(FrameTiming* timing, int64_t now_ns) {
+  if (timing->last_frame_start_ns) {
+    frame_histogram_record(&timing->metrics[FRAME_METRIC_INTERVAL],
+                           now_ns - timing->last_frame_start_ns);
+  }
+  timing->last_frame_start_ns = now_ns;
+  timing->frame_start_ns = now_ns;
+  timing->phase_start_ns = now_ns;
+}
+
+void frame_timing_end_phase(FrameTiming* timing, FrameMetric phase,
+                            int64_t now_ns) {
+  if (!timing->frame_start_ns) {
+    return;
+  }
+  frame_histogram_record(&timing->metrics[phase],
+                         now_ns - timing->phase_start_ns);
+  timing->phase_start_ns = now_ns;
+}
+
+void frame_timing_end_frame(FrameTiming* timing, int64_t now_ns) {
+  if (!timing->frame_start_ns) {
+    return;
+  }
+  frame_histogram_record(&timing->metrics[FRAME_METRIC_FRAME],
+                         now_ns - timing->frame_start_ns);
+  timing->frame_start_ns = 0;
+  timing->frames++;
+}
+
+int frame_timing_take_report(FrameTiming* timing, int64_t now_ns,
+                             int64_t period_ns, FrameTimingReport* report) {
+  if (now_ns - timing->period_start_ns < period_ns) {
+    return 0;
+  }
+  report->period_ns = now_ns - timing->period_start_ns;
+  report->frames = timing->frames;
+  int32_t metric;
+  for (metric = 0; metric < FRAME_METRIC_COUNT; metric++) {
+    frame_histogram_summarize(&timing->metrics[metric],
+                              &report->metrics[metric]);
+  }
+  start_period(timing, now_ns);
+  return 1;
+}
+
+const char* frame_metric_name(FrameMetric metric) {
+  switch (metric) {
+    case FRAME_METRIC_INTERVAL:
+      return "interval";
+    case FRAME_METRIC_FRAME:
+      return "frame";
+    case FRAME_METRIC_LOCK:
+      return "lock";
+    case FRAME_METRIC_RENDER:
+      return "render";
+    case FRAME_METRIC_POST:
+      return "post";
+    default:
+      return "?";
+  }
+}
+
+#define MS(ns) ((ns) / 1000000.)
+
+void frame_timing_log_report(const FrameTimingReport* report,
+                             const char* tag) {
+  if (report->period_ns <= 0) {
+    return;
+  }
+  LOG_REPORT(tag, "%u frames in %.2f s, %.1f frame/s", report->frames,
+             report->period_ns / 1e9, report->frames * 1e9 / report->period_ns);
+  int32_t metric;
+  for (metric = 0; metric < FRAME_METRIC_COUNT; metric++) {
+    const FrameSummary* summary = &report->metrics[metric];
+    if (summary->count == 0) {
+      continue;
+    }
+    LOG_REPORT(tag,
+               "  %-8s ms (mean,min,p50,p90,p99,max) = "
+               "(%.2f,%.2f,%.2f,%.2f,%.2f,%.2f)",
+               frame_metric_name((FrameMetric)metric), MS(summary->mean_ns),
+               MS(summary->min_ns), MS(summary->p50_ns), MS(summary->p90_ns),
+               MS(summary->p99_ns), MS(summary->max_ns));
+  }
+}
@@ -0,0 +1,122 @@
+/*
+ * Copyright (C) 2010 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef FRAME_TIMING_H
+#define FRAME_TIMING_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* What a FrameTiming measures. The three phases split a frame the way
+ * ANativeWindow rendering does; GL renderers have no lock phase, and post
+ * is their eglSwapBuffers(). */
+typedef enum {
+  FRAME_METRIC_INTERVAL, /* start of a frame to the start of the next */
+  FRAME_METRIC_FRAME,    /* start to end of a frame */
+  FRAME_METRIC_LOCK,     /* getting a buffer: ANativeWindow_lock() */
+  FRAME_METRIC_RENDER,   /* drawing into it */
+  FRAME_METRIC_POST,     /* handing it over: ANativeWindow_unlockAndPost() */
+  FRAME_METRIC_COUNT
+} FrameMetric;
+
+/* Log-linear histogram of durations in microseconds: values below 8us get
+ * a bucket each, and every power of two above is split into 8 linear
+ * buckets, so any value is known to within 12.5%, up to about 2 minutes. */
+#define FRAME_HISTOGRAM_SUB_BITS 3
+#define FRAME_HISTOGRAM_BUCKETS \
+  ((1 << FRAME_HISTOGRAM_SUB_BITS) * (28 - FRAME_HISTOGRAM_SUB_BITS))
+
+typedef struct {
+  uint32_t buckets[FRAME_HISTOGRAM_BUCKETS];
+  uint32_t count;
+  int64_t sum_ns;
+  int64_t min_ns;
+  int64_t max_ns;
+} FrameHistogram;
+
+typedef struct {
+  uint32_t count;
+  int64_t mean_ns;
+  int64_t min_ns;
+  /* Percentiles are the upper bound of their bucket, capped at max_ns. */
+  int64_t p50_ns;
+  int64_t p90_ns;
+  int64_t p99_ns;
+  int64_t max_ns;
+} FrameSummary;
+
+typedef struct {
+  int64_t period_ns;
+  uint32_t frames;
+  FrameSummary metrics[FRAME_METRIC_COUNT];
+} FrameTimingReport;
+
+/*
+ * FrameTiming
+ * Frame timing of a render loop over a reporting period. It is a plain
+ * struct with no allocation, meant to be owned by the engine and used from
+ * its render thread only.
+ *
+ * A frame is begin_frame, then end_phase for each phase in order, each one
+ * measured from the end of the previous, then end_frame.
+ */
+typedef struct {
+  FrameHistogram metrics[FRAME_METRIC_COUNT];
+  int64_t period_start_ns;
+  int64_t last_frame_start_ns;
+  int64_t frame_start_ns;
+  int64_t phase_start_ns;
+  uint32_t frames;
+} FrameTiming;
+
+/* CLOCK_MONOTONIC, in nanoseconds. */
+int64_t frame_timing_now_ns(void);
+
+void frame_histogram_reset(FrameHistogram* histogram);
+void frame_histogram_record(FrameHistogram* histogram, int64_t ns);
+/* The percentile is in 0..100. */
+int64_t frame_histogram_percentile_ns(const FrameHistogram* histogram,
+                                      double percentile);
+void frame_histogram_summarize(const FrameHistogram* histogram,
+                               FrameSummary* summary);
+
+void frame_timing_init(FrameTiming* timing, int64_t now_ns);
+void frame_timing_begin_frame(FrameTiming* timing, int64_t now_ns);
+void frame_timing_end_phase(FrameTiming* timing, FrameMetric phase,
+                            int64_t now_ns);
+void frame_timing_end_frame(FrameTiming* timing, int64_t now_ns);
+
+/*
+ * If at least period_ns passed since the period started, summarize it into
+ * report, start a new one and return 1. Return 0 otherwise.
+ */
+int frame_timing_take_report(FrameTiming* timing, int64_t now_ns,
+                             int64_t period_ns, FrameTimingReport* report);
+
+/* Log the frame rate and the metrics that have samples, in milliseconds. */
+void frame_timing_log_report(const FrameTimingReport* report,
+                             const char* tag);
+
+const char* frame_metric_name(FrameMetric metric);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* FRAME_TIMING_H */
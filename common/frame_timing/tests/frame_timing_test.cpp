@@ -0,0 +1,186 @@
+/*
+ * Copyright (C) 2010 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "frame_timing.h"
+
+#include <gtest/gtest.h>
+
+namespace {
+
+const int64_t kUs = 1000;
+const int64_t kMs = 1000 * kUs;
+const int64_t kSecond = 1000 * kMs;
+
+// The upper bound of the bucket ns falls in: the median of ns and of a
+// value larger than any bucket, so that max_ns doesn't cap it.
+int64_t BucketUpperNs(int64_t ns) {
+  FrameHistogram histogram;
+  frame_histogram_reset(&histogram);
+  frame_histogram_record(&histogram, ns);
+  frame_histogram_record(&histogram, 3600 * kSecond);
+  return frame_histogram_percentile_ns(&histogram, 50);
+}
+
+TEST(FrameHistogramTest, BucketBoundaries) {
+  // one bucket per microsecond below 8us
+  EXPECT_EQ(BucketUpperNs(0), 1 * kUs);
+  EXPECT_EQ(BucketUpperNs(999), 1 * kUs);
+  EXPECT_EQ(BucketUpperNs(1 * kUs), 2 * kUs);
+  EXPECT_EQ(BucketUpperNs(7 * kUs), 8 * kUs);
+  // then 8 buckets per power of two
+  EXPECT_EQ(BucketUpperNs(8 * kUs), 9 * kUs);
+  EXPECT_EQ(BucketUpperNs(15 * kUs), 16 * kUs);
+  EXPECT_EQ(BucketUpperNs(16 * kUs), 18 * kUs);
+  EXPECT_EQ(BucketUpperNs(17 * kUs), 18 * kUs);
+  EXPECT_EQ(BucketUpperNs(18 * kUs), 20 * kUs);
+  EXPECT_EQ(BucketUpperNs(1000 * kUs), 1024 * kUs);
+  EXPECT_EQ(BucketUpperNs(1024 * kUs), 1152 * kUs);
+  EXPECT_EQ(BucketUpperNs(16666 * kUs), 18432 * kUs);
+  // negative durations count as 0
+  EXPECT_EQ(BucketUpperNs(-5 * kMs), 1 * kUs);
+}
+
+TEST(FrameHistogramTest, BucketsAreWithinAnEighth) {
+  for (int64_t us = 8; us < 120 * 1000 * 1000; us += us / 97 + 1) {
+    int64_t upper = BucketUpperNs(us * kUs);
+    ASSERT_GT(upper, us * kUs) << us << "us";
+    ASSERT_LE(upper, us * kUs + us * kUs / 8) << us << "us";
+  }
+}
+
+TEST(FrameHistogramTest, ClampsToTheLastBucket) {
+  // The last bucket starts at 15 << 23 us and ends at 1 << 27 us, about
+  // 134 s; anything longer lands there too.
+  EXPECT_EQ(BucketUpperNs(130 * kSecond), (int64_t{1} << 27) * kUs);
+  EXPECT_EQ(BucketUpperNs(1000 * kSecond), (int64_t{1} << 27) * kUs);
+  EXPECT_EQ(BucketUpperNs(INT64_MAX / 2), (int64_t{1} << 27) * kUs);
+
+  FrameHistogram histogram;
+  frame_histogram_reset(&histogram);
+  frame_histogram_record(&histogram, 1000 * kSecond);
+  EXPECT_EQ(histogram.buckets[FRAME_HISTOGRAM_BUCKETS - 1], 1u);
+  // capped at the largest value seen
+  EXPECT_EQ(frame_histogram_percentile_ns(&histogram, 50),
+            (int64_t{1} << 27) * kUs);
+  EXPECT_EQ(histogram.max_ns, 1000 * kSecond);
+}
+
+TEST(FrameHistogramTest, Percentiles) {
+  FrameHistogram histogram;
+  frame_histogram_reset(&histogram);
+  EXPECT_EQ(frame_histogram_percentile_ns(&histogram, 50), 0);
+
+  for (int64_t ms = 100; ms >= 1; ms--) {
+    frame_histogram_record(&histogram, ms * kMs);
+  }
+  // 1ms is in [960us, 1024us)
+  EXPECT_EQ(frame_histogram_percentile_ns(&histogram, 0), 1024 * kUs);
+  // 50ms is in [49152us, 53248us), which holds 50ms to 53ms
+  EXPECT_EQ(frame_histogram_percentile_ns(&histogram, 50), 53248 * kUs);
+  // 90ms is in [81920us, 90112us)
+  EXPECT_EQ(frame_histogram_percentile_ns(&histogram, 90), 90112 * kUs);
+  // 99ms is in [98304us, 106496us), capped at the 100ms max
+  EXPECT_EQ(frame_histogram_percentile_ns(&histogram, 99), 100 * kMs);
+  EXPECT_EQ(frame_histogram_percentile_ns(&histogram, 100), 100 * kMs);
+
+  FrameSummary summary;
+  frame_histogram_summarize(&histogram, &summary);
+  EXPECT_EQ(summary.count, 100u);
+  EXPECT_EQ(summary.mean_ns, 50500 * kUs);
+  EXPECT_EQ(summary.min_ns, 1 * kMs);
+  EXPECT_EQ(summary.p50_ns, 53248 * kUs);
+  EXPECT_EQ(summary.p90_ns, 90112 * kUs);
+  EXPECT_EQ(summary.p99_ns, 100 * kMs);
+  EXPECT_EQ(summary.max_ns, 100 * kMs);
+}
+
+// A frame every 16ms from start: 1ms to lock, 4ms to render, 1ms to post.
+void RenderFrame(FrameTiming* timing, int64_t start) {
+  frame_timing_begin_frame(timing, start);
+  frame_timing_end_phase(timing, FRAME_METRIC_LOCK, start + 1 * kMs);
+  frame_timing_end_phase(timing, FRAME_METRIC_RENDER, start + 5 * kMs);
+  frame_timing_end_phase(timing, FRAME_METRIC_POST, start + 6 * kMs);
+  frame_timing_end_frame(timing, start + 6 * kMs);
+}
+
+TEST(FrameTimingTest, ReportsAPeriodAndStartsTheNext) {
+  FrameTiming timing;
+  FrameTimingReport report;
+  // 0 means no frame, a monotonic clock is never there
+  const int64_t t0 = 1 * kSecond;
+  frame_timing_init(&timing, t0);
+  for (int i = 0; i < 10; i++) RenderFrame(&timing, t0 + i * 16 * kMs);
+
+  EXPECT_EQ(frame_timing_take_report(&timing, t0 + 159 * kMs, 160 * kMs,
+                                     &report),
+            0);
+  ASSERT_EQ(frame_timing_take_report(&timing, t0 + 160 * kMs, 160 * kMs,
+                                     &report),
+            1);
+  EXPECT_EQ(report.period_ns, 160 * kMs);
+  EXPECT_EQ(report.frames, 10u);
+  EXPECT_EQ(report.metrics[FRAME_METRIC_INTERVAL].count, 9u);
+  EXPECT_EQ(report.metrics[FRAME_METRIC_INTERVAL].mean_ns, 16 * kMs);
+  EXPECT_EQ(report.metrics[FRAME_METRIC_FRAME].count, 10u);
+  EXPECT_EQ(report.metrics[FRAME_METRIC_FRAME].max_ns, 6 * kMs);
+  EXPECT_EQ(report.metrics[FRAME_METRIC_LOCK].mean_ns, 1 * kMs);
+  EXPECT_EQ(report.metrics[FRAME_METRIC_RENDER].mean_ns, 4 * kMs);
+  EXPECT_EQ(report.metrics[FRAME_METRIC_POST].mean_ns, 1 * kMs);
+
+  // the next period starts empty
+  ASSERT_EQ(frame_timing_take_report(&timing, t0 + 200 * kMs, 10 * kMs,
+                                     &report),
+            1);
+  EXPECT_EQ(report.period_ns, 40 * kMs);
+  EXPECT_EQ(report.frames, 0u);
+  for (int metric = 0; metric < FRAME_METRIC_COUNT; metric++) {
+    EXPECT_EQ(report.metrics[metric].count, 0u) << metric;
+    EXPECT_EQ(report.metrics[metric].min_ns, 0) << metric;
+  }
+
+  // The interval from the last frame carries over to the period the next
+  // frame begins in, the frame to the period it ends in.
+  frame_timing_begin_frame(&timing, t0 + 204 * kMs);
+  ASSERT_EQ(frame_timing_take_report(&timing, t0 + 205 * kMs, 1 * kMs,
+                                     &report),
+            1);
+  EXPECT_EQ(report.frames, 0u);
+  EXPECT_EQ(report.metrics[FRAME_METRIC_INTERVAL].count, 1u);
+  EXPECT_EQ(report.metrics[FRAME_METRIC_INTERVAL].max_ns, 60 * kMs);
+  frame_timing_end_frame(&timing, t0 + 210 * kMs);
+  ASSERT_EQ(frame_timing_take_report(&timing, t0 + 220 * kMs, 1 * kMs,
+                                     &report),
+            1);
+  EXPECT_EQ(report.frames, 1u);
+  EXPECT_EQ(report.metrics[FRAME_METRIC_INTERVAL].count, 0u);
+  EXPECT_EQ(report.metrics[FRAME_METRIC_FRAME].max_ns, 6 * kMs);
+}
+
+TEST(FrameTimingTest, IgnoresPhasesOutsideAFrame) {
+  FrameTiming timing;
+  FrameTimingReport report;
+  frame_timing_init(&timing, 1 * kSecond);
+  frame_timing_end_phase(&timing, FRAME_METRIC_RENDER, 1 * kSecond + 5 * kMs);
+  frame_timing_end_frame(&timing, 1 * kSecond + 6 * kMs);
+  ASSERT_EQ(
+      frame_timing_take_report(&timing, 1 * kSecond + 10 * kMs, 0, &report),
+      1);
+  EXPECT_EQ(report.frames, 0u);
+  EXPECT_EQ(report.metrics[FRAME_METRIC_RENDER].count, 0u);
+  EXPECT_EQ(report.metrics[FRAME_METRIC_FRAME].count, 0u);
+}
+
+}  // namespace
@@ -0,0 +1,608 @@
+/*
+ * Copyright (C) 2010 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "plasma_renderer.h"
+
+#include <math.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#if defined(__ARM_NEON)
+#include <arm_neon.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#ifdef __ANDROID__
+#include <android/log.h>
+#define LOG_TAG "plasma_core"
+#define LOGI(...) __android_log_print(ANDROID_LOG_INFO, LOG_TAG, __VA_ARGS__)
+#define LOGE(...) __android_log_print(ANDROID_LOG_ERROR, LOG_TAG, __VA_ARGS__)
+#else
+#include <stdio.h>
+#define LOGI(...) (fprintf(stderr, __VA_ARGS__), fputc('\n', stderr))
+#define LOGE(...) (fprintf(stderr, __VA_ARGS__), fputc('\n', stderr))
+#endif
+
+/* We're going to perform computations for every pixel of the target
+ * bitmap. floating-point operations are very slow on ARMv5, and not
+ * too bad on ARMv7 with the exception of trigonometric functions.
+ *
+ * For better performance on all platforms, we're going to use fixed-point
+ * arithmetic and all kinds of tricks
+ */
+
+typedef int32_t Fixed;
+
+#define FIXED_BITS 16
+#define FIXED_ONE (1 << FIXED_BITS)
+
+#define FIXED_FROM_FLOAT(x) ((Fixed)((x)*FIXED_ONE))
+
+#define FIXED_FRAC(x) ((x) & ((1 << FIXED_BITS) - 1))
+
+typedef int32_t Angle;
+
+#define ANGLE_BITS 9
+
+#if ANGLE_BITS < 8
+#error ANGLE_BITS must be at least 8
+#endif
+
+#define ANGLE_2PI (1 << ANGLE_BITS)
+#define ANGLE_PI (1 << (ANGLE_BITS - 1))
+
+#if ANGLE_BITS <= FIXED_BITS
+#define ANGLE_FROM_FIXED(x) (Angle)((x) >> (FIXED_BITS - ANGLE_BITS))
+#else
+#define ANGLE_FROM_FIXED(x) (Angle)((x) << (ANGLE_BITS - FIXED_BITS))
+#endif
+
+static Fixed angle_sin_tab[ANGLE_2PI + 1];
+
+static void init_angles(void) {
+  int nn;
+  for (nn = 0; nn < ANGLE_2PI + 1; nn++) {
+    double radians = nn * M_PI / ANGLE_PI;
+    angle_sin_tab[nn] = FIXED_FROM_FLOAT(sin(radians));
+  }
+}
+
+static __inline__ Fixed angle_sin(Angle a) {
+  return angle_sin_tab[(uint32_t)a & (ANGLE_2PI - 1)];
+}
+
+static __inline__ Fixed fixed_sin(Fixed f) {
+  return angle_sin(ANGLE_FROM_FIXED(f));
+}
+
+/* Color palette used for rendering the plasma */
+#define PALETTE_BITS 8
+#define PALETTE_SIZE (1 << PALETTE_BITS)
+
+#if PALETTE_BITS > FIXED_BITS
+#error PALETTE_BITS must be smaller than FIXED_BITS
+#endif
+
+/* The vector code computes the palette instead of looking it up, and
+ * relies on these sizes. */
+#if PALETTE_BITS != 8
+#error The vector palette math assumes PALETTE_BITS is 8
+#endif
+
+static uint16_t palette_565[PALETTE_SIZE];
+static uint32_t palette_8888[PALETTE_SIZE];
+
+static uint16_t make565(int red, int green, int blue) {
+  return (uint16_t)(((red << 8) & 0xf800) | ((green << 3) & 0x07e0) |
+                    ((blue >> 3) & 0x001f));
+}
+
+static uint32_t make8888(int red, int green, int blue) {
+  return (uint32_t)red | ((uint32_t)green << 8) | ((uint32_t)blue << 16) |
+         0xff000000u;
+}
+
+static void init_palette(void) {
+  int nn;
+  /* fun with colors: four linear ramps of PALETTE_SIZE / 4 entries */
+  for (nn = 0; nn < PALETTE_SIZE; nn++) {
+    int jj = (nn % (PALETTE_SIZE / 4)) * 4 * 255 / PALETTE_SIZE;
+    int red, green, blue;
+    switch (nn / (PALETTE_SIZE / 4)) {
+      case 0:
+        red = 255, green = jj, blue = 255 - jj;
+        break;
+      case 1:
+        red = 255 - jj, green = 255, blue = jj;
+        break;
+      case 2:
+        red = 0, green = 255 - jj, blue = 255;
+        break;
+      default:
+        red = jj, green = 0, blue = 255;
+        break;
+    }
+    palette_565[nn] = make565(red, green, blue);
+    palette_8888[nn] = make8888(red, green, blue);
+  }
+}
+
+/* Palette entry of a plasma value, the sum of the row and column terms. */
+static __inline__ int palette_index(Fixed ii) {
+  Fixed x = ii >> 2;
+  if (x < 0) x = -x;
+  if (x >= FIXED_ONE) x = FIXED_ONE - 1;
+  int idx = FIXED_FRAC(x) >> (FIXED_BITS - PALETTE_BITS);
+  return idx & (PALETTE_SIZE - 1);
+}
+
+static pthread_once_t tables_once = PTHREAD_ONCE_INIT;
+
+static void init_tables(void) {
+  init_palette();
+  init_angles();
+}
+
+/* Phase increments between two rows, and two columns, of the plasma. The
+ * phases wrap around, so they are added as unsigned values. */
+#define YT1_INCR FIXED_FROM_FLOAT(1 / 100.)
+#define YT2_INCR FIXED_FROM_FLOAT(1 / 163.)
+#define XT1_INCR FIXED_FROM_FLOAT(1 / 173.)
+#define XT2_INCR FIXED_FROM_FLOAT(1 / 242.)
+
+static __inline__ Fixed phase_at(Fixed start, Fixed incr, int32_t n) {
+  return (Fixed)((uint32_t)start + (uint32_t)n * (uint32_t)incr);
+}
+
+/* A pixel is the palette entry of rows[y] + columns[x], see update_terms().
+ * The vector code computes the palette from the index, since neither NEON
+ * nor SSE2 has a gather: each quarter of the palette is a linear ramp
+ * jj = (idx % 64) * 1020 / 256 of one channel, with the other channels at
+ * 0, 255 or 255 - jj. It matches the tables exactly.
+ */
+#if defined(__ARM_NEON)
+
+#define PLASMA_VECTOR_PIXELS 8
+
+typedef struct {
+  uint16x8_t red;
+  uint16x8_t green;
+  uint16x8_t blue;
+} PixelChannels;
+
+static __inline__ PixelChannels plasma_pixels(int32x4_t base,
+                                              const Fixed* columns) {
+  int32x4_t lo = vaddq_s32(base, vld1q_s32(columns));
+  int32x4_t hi = vaddq_s32(base, vld1q_s32(columns + 4));
+  /* |ii >> 2| is at most FIXED_ONE, so the shifted index is at most
+   * PALETTE_SIZE, and the saturation is the clamp of palette_index(). */
+  lo = vshrq_n_s32(vabsq_s32(vshrq_n_s32(lo, 2)), FIXED_BITS - PALETTE_BITS);
+  hi = vshrq_n_s32(vabsq_s32(vshrq_n_s32(hi, 2)), FIXED_BITS - PALETTE_BITS);
+  uint16x8_t idx = vminq_u16(vcombine_u16(vqmovun_s32(lo), vqmovun_s32(hi)),
+                             vdupq_n_u16(PALETTE_SIZE - 1));
+
+  const uint16x8_t full = vdupq_n_u16(255);
+  uint16x8_t jj = vshrq_n_u16(
+      vmulq_n_u16(vandq_u16(idx, vdupq_n_u16(PALETTE_SIZE / 4 - 1)), 1020),
+      PALETTE_BITS);
+  uint16x8_t inv = vsubq_u16(full, jj);
+  uint16x8_t ramp = vshrq_n_u16(idx, PALETTE_BITS - 2);
+  uint16x8_t q0 = vceqq_u16(ramp, vdupq_n_u16(0));
+  uint16x8_t q1 = vceqq_u16(ramp, vdupq_n_u16(1));
+  uint16x8_t q2 = vceqq_u16(ramp, vdupq_n_u16(2));
+  uint16x8_t q3 = vceqq_u16(ramp, vdupq_n_u16(3));
+
+  PixelChannels pixels;
+  pixels.red = vorrq_u16(vorrq_u16(vandq_u16(q0, full), vandq_u16(q1, inv)),
+                         vandq_u16(q3, jj));
+  pixels.green = vorrq_u16(vorrq_u16(vandq_u16(q0, jj), vandq_u16(q1, full)),
+                           vandq_u16(q2, inv));
+  pixels.blue = vorrq_u16(vorrq_u16(vandq_u16(q0, inv), vandq_u16(q1, jj)),
+                          vandq_u16(vorrq_u16(q2, q3), full));
+  return pixels;
+}
+
+static __inline__ void store_565(uint16_t* line, PixelChannels pixels) {
+  uint16x8_t red = vshlq_n_u16(vshrq_n_u16(pixels.red, 3), 11);
+  uint16x8_t green = vshlq_n_u16(vshrq_n_u16(pixels.green, 2), 5);
+  uint16x8_t blue = vshrq_n_u16(pixels.blue, 3);
+  vst1q_u16(line, vorrq_u16(vorrq_u16(red, green), blue));
+}
+
+static __inline__ void store_8888(uint32_t* line, PixelChannels pixels) {
+  uint8x8x4_t rgba;
+  rgba.val[0] = vmovn_u16(pixels.red);
+  rgba.val[1] = vmovn_u16(pixels.green);
+  rgba.val[2] = vmovn_u16(pixels.blue);
+  rgba.val[3] = vdup_n_u8(255);
+  vst4_u8((uint8_t*)line, rgba);
+}
+
+#define VECTOR_BASE(base) vdupq_n_s32(base)
+
+#elif defined(__SSE2__)
+
+#define PLASMA_VECTOR_PIXELS 8
+
+typedef struct {
+  __m128i red;
+  __m128i green;
+  __m128i blue;
+} PixelChannels;
+
+static __inline__ __m128i abs_epi32(__m128i x) {
+  __m128i sign = _mm_srai_epi32(x, 31);
+  return _mm_sub_epi32(_mm_xor_si128(x, sign), sign);
+}
+
+static __inline__ PixelChannels plasma_pixels(__m128i base,
+                                              const Fixed* columns) {
+  __m128i lo =
+      _mm_add_epi32(base, _mm_loadu_si128((const __m128i*)columns));
+  __m128i hi =
+      _mm_add_epi32(base, _mm_loadu_si128((const __m128i*)(columns + 4)));
+  /* |ii >> 2| is at most FIXED_ONE, so the shifted index is at most
+   * PALETTE_SIZE, and the minimum is the clamp of palette_index(). */
+  lo = _mm_srli_epi32(abs_epi32(_mm_srai_epi32(lo, 2)),
+                      FIXED_BITS - PALETTE_BITS);
+  hi = _mm_srli_epi32(abs_epi32(_mm_srai_epi32(hi, 2)),
+                      FIXED_BITS - PALETTE_BITS);
+  __m128i idx = _mm_min_epi16(_mm_packs_epi32(lo, hi),
+                              _mm_set1_epi16(PALETTE_SIZE - 1));
+
+  const __m128i full = _mm_set1_epi16(255);
+  __m128i jj = _mm_srli_epi16(
+      _mm_mullo_epi16(_mm_and_si128(idx, _mm_set1_epi16(PALETTE_SIZE / 4 - 1)),
+                      _mm_set1_epi16(1020)),
+      PALETTE_BITS);
+  __m128i inv = _mm_sub_epi16(full, jj);
+  __m128i ramp = _mm_srli_epi16(idx, PALETTE_BITS - 2);
+  __m128i q0 = _mm_cmpeq_epi16(ramp, _mm_setzero_si128());
+  __m128i q1 = _mm_cmpeq_epi16(ramp, _mm_set1_epi16(1));
+  __m128i q2 = _mm_cmpeq_epi16(ramp, _mm_set1_epi16(2));
+  __m128i q3 = _mm_cmpeq_epi16(ramp, _mm_set1_epi16(3));
+
+  PixelChannels pixels;
+  pixels.red = _mm_or_si128(
+      _mm_or_si128(_mm_and_si128(q0, full), _mm_and_si128(q1, inv)),
+      _mm_and_si128(q3, jj));
+  pixels.green = _mm_or_si128(
+      _mm_or_si128(_mm_and_si128(q0, jj), _mm_and_si128(q1, full)),
+      _mm_and_si128(q2, inv));
+  pixels.blue = _mm_or_si128(
+      _mm_or_si128(_mm_and_si128(q0, inv), _mm_and_si128(q1, jj)),
+      _mm_and_si128(_mm_or_si128(q2, q3), full));
+  return pixels;
+}
+
+static __inline__ void store_565(uint16_t* line, PixelChannels pixels) {
+  __m128i red = _mm_slli_epi16(_mm_srli_epi16(pixels.red, 3), 11);
+  __m128i green = _mm_slli_epi16(_mm_srli_epi16(pixels.green, 2), 5);
+  __m128i blue = _mm_srli_epi16(pixels.blue, 3);
+  _mm_storeu_si128((__m128i*)line,
+                   _mm_or_si128(_mm_or_si128(red, green), blue));
+}
+
+static __inline__ void store_8888(uint32_t* line, PixelChannels pixels) {
+  __m128i red_green =
+      _mm_or_si128(pixels.red, _mm_slli_epi16(pixels.green, 8));
+  __m128i blue_alpha = _mm_or_si128(pixels.blue, _mm_set1_epi16(0xff00));
+  _mm_storeu_si128((__m128i*)line, _mm_unpacklo_epi16(red_green, blue_alpha));
+  _mm_storeu_si128((__m128i*)(line + 4),
+                   _mm_unpackhi_epi16(red_green, blue_alpha));
+}
+
+#define VECTOR_BASE(base) _mm_set1_epi32(base)
+
+#else
+
+#define PLASMA_VECTOR_PIXELS 0
+
+#endif
+
+static void fill_row_565(uint16_t* line, const Fixed* columns, Fixed base,
+                         int32_t width) {
+  int32_t xx = 0;
+#if PLASMA_VECTOR_PIXELS
+  for (; xx + PLASMA_VECTOR_PIXELS <= width; xx += PLASMA_VECTOR_PIXELS) {
+    store_565(line + xx, plasma_pixels(VECTOR_BASE(base), columns + xx));
+  }
+#endif
+  for (; xx < width; xx++) {
+    line[xx] = palette_565[palette_index(base + columns[xx])];
+  }
+}
+
+static void fill_row_8888(uint32_t* line, const Fixed* columns, Fixed base,
+                          int32_t width) {
+  int32_t xx = 0;
+#if PLASMA_VECTOR_PIXELS
+  for (; xx + PLASMA_VECTOR_PIXELS <= width; xx += PLASMA_VECTOR_PIXELS) {
+    store_8888(line + xx, plasma_pixels(VECTOR_BASE(base), columns + xx));
+  }
+#endif
+  for (; xx < width; xx++) {
+    line[xx] = palette_8888[palette_index(base + columns[xx])];
+  }
+}
+
+struct PlasmaRenderer {
+  pthread_t workers[PLASMA_MAX_THREADS - 1];
+  int32_t worker_count;
+
+  pthread_mutex_t lock;
+  pthread_cond_t start_cond;
+  pthread_cond_t done_cond;
+  /* Bumped for each frame handed to the workers, under lock. */
+  uint32_t generation;
+  /* Workers still drawing the current frame, under lock. */
+  int32_t busy_workers;
+  int quit;
+
+  /* Row and column terms of the plasma at time terms_t, for the first
+   * row_count rows and column_count columns. */
+  double terms_t;
+  Fixed* rows;
+  Fixed* columns;
+  int32_t row_count;
+  int32_t column_count;
+
+  /* The rectangle being drawn. It is only written while the workers
+   * sleep. */
+  PlasmaTarget target;
+  PlasmaRect rect;
+  int32_t band_count;
+  atomic_int next_band;
+};
+
+static void fill_band(const PlasmaRenderer* renderer, int32_t band) {
+  const PlasmaTarget* target = &renderer->target;
+  const PlasmaRect* rect = &renderer->rect;
+  int32_t first = rect->top + band * PLASMA_BAND_ROWS;
+  int32_t last = first + PLASMA_BAND_ROWS;
+  if (last > rect->bottom) last = rect->bottom;
+
+  const Fixed* columns = renderer->columns + rect->left;
+  int32_t width = rect->right - rect->left;
+  char* pixels = (char*)target->pixels + (intptr_t)first * target->stride;
+  int32_t yy;
+  for (yy = first; yy < last; yy++) {
+    if (target->format == PLASMA_FORMAT_RGB_565) {
+      fill_row_565((uint16_t*)pixels + rect->left, columns,
+                   renderer->rows[yy], width);
+    } else {
+      fill_row_8888((uint32_t*)pixels + rect->left, columns,
+                    renderer->rows[yy], width);
+    }
+    pixels += target->stride;
+  }
+}
+
+/* Take bands of the current frame until there are none left. */
+static void fill_bands(PlasmaRenderer* renderer) {
+  for (;;) {
+    int32_t band = atomic_fetch_add_explicit(&renderer->next_band, 1,
+                                             memory_order_relaxed);
+    if (band >= renderer->band_count) {
+      return;
+    }
+    fill_band(renderer, band);
+  }
+}
+
+static void* worker_main(void* arg) {
+  PlasmaRenderer* renderer = (PlasmaRenderer*)arg;
+  uint32_t seen = 0;
+
+  pthread_mutex_lock(&renderer->lock);
+  for (;;) {
+    while (!renderer->quit && renderer->generation == seen) {
+      pthread_cond_wait(&renderer->start_cond, &renderer->lock);
+    }
+    if (renderer->quit) {
+      break;
+    }
+    seen = renderer->generation;
+    pthread_mutex_unlock(&renderer->lock);
+
+    fill_bands(renderer);
+
+    pthread_mutex_lock(&renderer->lock);
+    if (--renderer->busy_workers == 0) {
+      pthread_cond_signal(&renderer->done_cond);
+    }
+  }
+  pthread_mutex_unlock(&renderer->lock);
+  return NULL;
+}
+
+PlasmaRenderer* plasma_renderer_create(int32_t thread_count) {
+  pthread_once(&tables_once, init_tables);
+
+  if (thread_count <= 0) {
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    thread_count = cpus > 0 ? (int32_t)cpus : 1;
+  }
+  if (thread_count > PLASMA_MAX_THREADS) {
+    thread_count = PLASMA_MAX_THREADS;
+  }
+
+  PlasmaRenderer* renderer = (PlasmaRenderer*)calloc(1, sizeof(*renderer));
+  if (renderer == NULL) {
+    LOGE("Unable to allocate the plasma renderer");
+    return NULL;
+  }
+  pthread_mutex_init(&renderer->lock, NULL);
+  pthread_cond_init(&renderer->start_cond, NULL);
+  pthread_cond_init(&renderer->done_cond, NULL);
+  atomic_init(&renderer->next_band, 0);
+
+  while (renderer->worker_count < thread_count - 1) {
+    if (pthread_create(&renderer->workers[renderer->worker_count], NULL,
+                       worker_main, renderer) != 0) {
+      LOGE("Unable to start a plasma worker, using %d threads",
+           renderer->worker_count + 1);
+      break;
+    }
+    renderer->worker_count++;
+  }
+  LOGI("Rendering the plasma with %d threads", renderer->worker_count + 1);
+  return renderer;
+}
+
+void plasma_renderer_destroy(PlasmaRenderer* renderer) {
+  if (renderer == NULL) {
+    return;
+  }
+  pthread_mutex_lock(&renderer->lock);
+  renderer->quit = 1;
+  pthread_cond_broadcast(&renderer->start_cond);
+  pthread_mutex_unlock(&renderer->lock);
+
+  int32_t ii;
+  for (ii = 0; ii < renderer->worker_count; ii++) {
+    pthread_join(renderer->workers[ii], NULL);
+  }
+  pthread_cond_destroy(&renderer->done_cond);
+  pthread_cond_destroy(&renderer->start_cond);
+  pthread_mutex_destroy(&renderer->lock);
+  free(renderer->rows);
+  free(renderer->columns);
+  free(renderer);
+}
+
+int32_t plasma_renderer_thread_count(const PlasmaRenderer* renderer) {
+  return renderer->worker_count + 1;
+}
+
+/* Grow terms to hold count values. */
+static int reserve_terms(Fixed** terms, int32_t count) {
+  Fixed* grown = (Fixed*)realloc(*terms, count * sizeof(Fixed));
+  if (grown == NULL) {
+    LOGE("Unable to allocate the plasma terms");
+    return -1;
+  }
+  *terms = grown;
+  return 0;
+}
+
+/*
+ * Make the row and column terms cover a width x height target at time t.
+ * A pixel is rows[y] + columns[x]: the terms cost two table lookups each,
+ * once per frame, and the rest of the frame only adds them.
+ */
+static int update_terms(PlasmaRenderer* renderer, int32_t width,
+                        int32_t height, double t) {
+  if (renderer->terms_t != t) {
+    renderer->terms_t = t;
+    renderer->row_count = 0;
+    renderer->column_count = 0;
+  }
+
+  if (width > renderer->column_count) {
+    if (reserve_terms(&renderer->columns, width) < 0) {
+      renderer->column_count = 0;
+      return -1;
+    }
+    Fixed xt10 = FIXED_FROM_FLOAT(t / 3000.);
+    Fixed xt20 = xt10;
+    int32_t xx;
+    for (xx = renderer->column_count; xx < width; xx++) {
+      renderer->columns[xx] = fixed_sin(phase_at(xt10, XT1_INCR, xx)) +
+                              fixed_sin(phase_at(xt20, XT2_INCR, xx));
+    }
+    renderer->column_count = width;
+  }
+
+  if (height > renderer->row_count) {
+    if (reserve_terms(&renderer->rows, height) < 0) {
+      renderer->row_count = 0;
+      return -1;
+    }
+    Fixed yt1 = FIXED_FROM_FLOAT(t / 1230.);
+    Fixed yt2 = yt1;
+    int32_t yy;
+    for (yy = renderer->row_count; yy < height; yy++) {
+      renderer->rows[yy] = fixed_sin(phase_at(yt1, YT1_INCR, yy)) +
+                           fixed_sin(phase_at(yt2, YT2_INCR, yy));
+    }
+    renderer->row_count = height;
+  }
+  return 0;
+}
+
+int plasma_renderer_fill(PlasmaRenderer* renderer, const PlasmaTarget* target,
+                         double t) {
+  PlasmaRect rect = {0, 0, target->width, target->height};
+  return plasma_renderer_fill_rect(renderer, target, t, &rect);
+}
+
+int plasma_renderer_fill_rect(PlasmaRenderer* renderer,
+                              const PlasmaTarget* target, double t,
+                              const PlasmaRect* rect) {
+  int32_t bytes_per_pixel =
+      target->format == PLASMA_FORMAT_RGB_565 ? 2 : 4;
+  if (target->pixels == NULL || target->width <= 0 || target->height <= 0 ||
+      (target->format != PLASMA_FORMAT_RGB_565 &&
+       target->format != PLASMA_FORMAT_RGBA_8888) ||
+      target->stride < target->width * bytes_per_pixel) {
+    LOGE("Invalid plasma target %dx%d, stride %d, format %d", target->width,
+         target->height, target->stride, target->format);
+    return -1;
+  }
+
+  PlasmaRect clipped = *rect;
+  if (clipped.left < 0) clipped.left = 0;
+  if (clipped.top < 0) clipped.top = 0;
+  if (clipped.right > target->width) clipped.right = target->width;
+  if (clipped.bottom > target->height) clipped.bottom = target->height;
+  if (clipped.left >= clipped.right || clipped.top >= clipped.bottom) {
+    return 0;
+  }
+
+  if (update_terms(renderer, clipped.right, clipped.bottom, t) < 0) {
+    return -1;
+  }
+
+  renderer->target = *target;
+  renderer->rect = clipped;
+  renderer->band_count =
+      (clipped.bottom - clipped.top + PLASMA_BAND_ROWS - 1) / PLASMA_BAND_ROWS;
+  atomic_store_explicit(&renderer->next_band, 0, memory_order_relaxed);
+
+  if (renderer->worker_count == 0 || renderer->band_count == 1) {
+    fill_bands(renderer);
+    return 0;
+  }
+
+  pthread_mutex_lock(&renderer->lock);
+  renderer->generation++;
+  renderer->busy_workers = renderer->worker_count;
+  pthread_cond_broadcast(&renderer->start_cond);
+  pthread_mutex_unlock(&renderer->lock);
+
+  fill_bands(renderer);
+
+  pthread_mutex_lock(&renderer->lock);
+  while (renderer->busy_workers > 0) {
+    pthread_cond_wait(&renderer->done_cond, &renderer->lock);
+  }
+  pthread_mutex_unlock(&renderer->lock);
+  return 0;
+}
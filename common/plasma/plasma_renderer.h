@@ -0,0 +1,104 @@
+/*
+ * Copyright (C) 2010 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef PLASMA_RENDERER_H
+#define PLASMA_RENDERER_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Pixel formats the plasma can be rendered into. RGBA_8888 is stored as
+ * R, G, B, A bytes, like ANDROID_BITMAP_FORMAT_RGBA_8888 and
+ * WINDOW_FORMAT_RGBA_8888. */
+typedef enum {
+  PLASMA_FORMAT_RGB_565,
+  PLASMA_FORMAT_RGBA_8888,
+} PlasmaFormat;
+
+typedef struct {
+  void* pixels;
+  int32_t width;
+  int32_t height;
+  /* Distance between the starts of two rows, in bytes. */
+  int32_t stride;
+  PlasmaFormat format;
+} PlasmaTarget;
+
+/* Pixels from (left, top) included to (right, bottom) excluded, like ARect. */
+typedef struct {
+  int32_t left;
+  int32_t top;
+  int32_t right;
+  int32_t bottom;
+} PlasmaRect;
+
+/* Most threads a renderer splits a frame across, the caller included. */
+#define PLASMA_MAX_THREADS 8
+
+/* Rows in each band of a frame handed to a thread. */
+#define PLASMA_BAND_ROWS 16
+
+typedef struct PlasmaRenderer PlasmaRenderer;
+
+/*
+ * Create a renderer and its thread pool. The workers live as long as the
+ * renderer and sleep between frames.
+ *
+ * thread_count is the number of threads drawing a frame, including the one
+ * calling plasma_renderer_fill(); 0 uses one per online CPU. It is capped at
+ * PLASMA_MAX_THREADS.
+ *
+ * Returns NULL if the renderer can't be allocated. Workers failing to start
+ * only make it use fewer threads.
+ */
+PlasmaRenderer* plasma_renderer_create(int32_t thread_count);
+
+void plasma_renderer_destroy(PlasmaRenderer* renderer);
+
+/* Threads drawing a frame, including the caller. */
+int32_t plasma_renderer_thread_count(const PlasmaRenderer* renderer);
+
+/*
+ * Draw the plasma at time t, in milliseconds, into target. The rows are
+ * split in bands of PLASMA_BAND_ROWS that the threads take in turn, and the
+ * call returns when the whole frame is drawn. A renderer draws one frame at
+ * a time: don't call it from several threads at once.
+ *
+ * Returns 0, or -1 if the target is invalid.
+ */
+int plasma_renderer_fill(PlasmaRenderer* renderer, const PlasmaTarget* target,
+                         double t);
+
+/*
+ * Draw the plasma at time t only in rect, clipped to the target, leaving the
+ * other pixels alone: a frame can be updated one dirty region at a time.
+ * The row and column terms are kept between calls for the same t, so the
+ * regions of a frame only cost their own pixels.
+ *
+ * Returns 0, or -1 if the target is invalid.
+ */
+int plasma_renderer_fill_rect(PlasmaRenderer* renderer,
+                              const PlasmaTarget* target, double t,
+                              const PlasmaRect* rect);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* PLASMA_RENDERER_H */
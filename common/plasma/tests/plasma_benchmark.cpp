@@ -0,0 +1,103 @@
+/*
+ * Copyright (C) 2010 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Megapixels per second of the plasma at phone screen sizes: the per-pixel
+ * loop the samples drew with, and the renderer with one thread and with all
+ * of them. Then the cost of redrawing a frame one dirty rect at a time.
+ */
+#include <stdio.h>
+
+#include <chrono>
+#include <functional>
+#include <vector>
+
+#include "plasma_reference.h"
+#include "plasma_renderer.h"
+
+namespace {
+
+// Milliseconds per frame of fill(t) over consecutive 60 Hz frames.
+double MsPerFrame(const std::function<void(double)>& fill) {
+  const int kFrames = 30;
+  fill(0);
+  auto begin = std::chrono::steady_clock::now();
+  for (int i = 0; i < kFrames; i++) fill(i * 16.0);
+  return std::chrono::duration<double, std::milli>(
+             std::chrono::steady_clock::now() - begin)
+             .count() /
+         kFrames;
+}
+
+}  // namespace
+
+int main() {
+  const PlasmaReference reference;
+  PlasmaRenderer* single = plasma_renderer_create(1);
+  PlasmaRenderer* all = plasma_renderer_create(0);
+  if (!single || !all) {
+    fprintf(stderr, "cannot create the renderers\n");
+    return 1;
+  }
+  const int kSizes[][2] = {{1280, 720}, {1920, 1080}, {2560, 1440}};
+  for (const auto& size : kSizes) {
+    int width = size[0], height = size[1];
+    std::vector<uint32_t> pixels(width * height);
+    for (bool rgba8888 : {false, true}) {
+      PlasmaTarget target = {
+          pixels.data(), width, height, width * (rgba8888 ? 4 : 2),
+          rgba8888 ? PLASMA_FORMAT_RGBA_8888 : PLASMA_FORMAT_RGB_565};
+      double original = MsPerFrame([&](double t) {
+        reference.Fill(target.pixels, width, height, target.stride, t,
+                       rgba8888);
+      });
+      double one = MsPerFrame(
+          [&](double t) { plasma_renderer_fill(single, &target, t); });
+      double threads = MsPerFrame(
+          [&](double t) { plasma_renderer_fill(all, &target, t); });
+      double mpix = width * height / 1e3;
+      printf(
+          "%dx%d %s: per pixel %.2f ms (%.0f Mpix/s), renderer %.2f ms "
+          "(%.0f Mpix/s), %d threads %.2f ms (%.0f Mpix/s)\n",
+          width, height, rgba8888 ? "RGBA_8888" : "RGB_565", original,
+          mpix / original, one, mpix / one,
+          plasma_renderer_thread_count(all), threads, mpix / threads);
+    }
+  }
+
+  // A 1080p frame redrawn as a grid of 4x4 dirty rects, against one fill.
+  const int kWidth = 1920, kHeight = 1080, kGrid = 4;
+  std::vector<uint16_t> pixels(kWidth * kHeight);
+  PlasmaTarget target = {pixels.data(), kWidth, kHeight, kWidth * 2,
+                         PLASMA_FORMAT_RGB_565};
+  double whole =
+      MsPerFrame([&](double t) { plasma_renderer_fill(single, &target, t); });
+  double rects = MsPerFrame([&](double t) {
+    for (int y = 0; y < kGrid; y++) {
+      for (int x = 0; x < kGrid; x++) {
+        PlasmaRect rect = {kWidth * x / kGrid, kHeight * y / kGrid,
+                           kWidth * (x + 1) / kGrid, kHeight * (y + 1) / kGrid};
+        plasma_renderer_fill_rect(single, &target, t, &rect);
+      }
+    }
+  });
+  printf("%dx%d RGB_565: fill %.2f ms, %d dirty rects %.2f ms\n", kWidth,
+         kHeight, whole, kGrid * kGrid, rects);
+
+  plasma_renderer_destroy(single);
+  plasma_renderer_destroy(all);
+  return 0;
+}
@@ -0,0 +1,121 @@
+/*
+ * Copyright (C) 2010 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef PLASMA_REFERENCE_H
+#define PLASMA_REFERENCE_H
+
+#include <math.h>
+#include <stdint.h>
+
+/*
+ * The plasma as bitmap-plasma drew it before the shared renderer: one pixel
+ * at a time, in 16.16 fixed point, with a 512 entry sine table and a 256
+ * color palette. The renderer has to give the same pixels.
+ */
+class PlasmaReference {
+ public:
+  PlasmaReference() {
+    for (int i = 0; i <= kAngle2Pi; i++) {
+      sin_[i] = FromFloat(sin(i * M_PI / (kAngle2Pi / 2)));
+    }
+    const int kQuarter = kPaletteSize / 4;
+    for (int n = 0; n < kPaletteSize; n++) {
+      int j = (n % kQuarter) * 4 * 255 / kPaletteSize;
+      switch (n / kQuarter) {
+        case 0:
+          SetColor(n, 255, j, 255 - j);
+          break;
+        case 1:
+          SetColor(n, 255 - j, 255, j);
+          break;
+        case 2:
+          SetColor(n, 0, 255 - j, 255);
+          break;
+        default:
+          SetColor(n, j, 0, 255);
+          break;
+      }
+    }
+  }
+
+  // Draw the frame at t milliseconds, RGB_565 or RGBA_8888.
+  void Fill(void* pixels, int width, int height, int stride, double t,
+            bool rgba8888) const {
+    int32_t yt1 = FromFloat(t / 1230.0), yt2 = yt1;
+    int32_t xt10 = FromFloat(t / 3000.0), xt20 = xt10;
+    for (int y = 0; y < height; y++) {
+      int32_t base = Sin(yt1) + Sin(yt2);
+      int32_t xt1 = xt10, xt2 = xt20;
+      yt1 += kYt1Incr;
+      yt2 += kYt2Incr;
+      uint8_t* row = static_cast<uint8_t*>(pixels) + y * stride;
+      for (int x = 0; x < width; x++) {
+        int index = PaletteIndex((base + Sin(xt1) + Sin(xt2)) >> 2);
+        xt1 += kXt1Incr;
+        xt2 += kXt2Incr;
+        if (rgba8888) {
+          reinterpret_cast<uint32_t*>(row)[x] = palette8888_[index];
+        } else {
+          reinterpret_cast<uint16_t*>(row)[x] = palette565_[index];
+        }
+      }
+    }
+  }
+
+ private:
+  static constexpr int kFixedBits = 16;
+  static constexpr int kAngleBits = 9;
+  static constexpr int kAngle2Pi = 1 << kAngleBits;
+  static constexpr int kPaletteBits = 8;
+  static constexpr int kPaletteSize = 1 << kPaletteBits;
+
+  static int32_t FromFloat(double x) {
+    return static_cast<int32_t>(x * (1 << kFixedBits));
+  }
+  static const int32_t kYt1Incr;
+  static const int32_t kYt2Incr;
+  static const int32_t kXt1Incr;
+  static const int32_t kXt2Incr;
+
+  int32_t Sin(int32_t fixed) const {
+    return sin_[static_cast<uint32_t>(fixed >> (kFixedBits - kAngleBits)) &
+                (kAngle2Pi - 1)];
+  }
+
+  static int PaletteIndex(int32_t x) {
+    if (x < 0) x = -x;
+    if (x >= 1 << kFixedBits) x = (1 << kFixedBits) - 1;
+    return (x & ((1 << kFixedBits) - 1)) >> (kFixedBits - kPaletteBits);
+  }
+
+  void SetColor(int n, int red, int green, int blue) {
+    palette565_[n] = static_cast<uint16_t>(((red << 8) & 0xf800) |
+                                           ((green << 3) & 0x07e0) |
+                                           ((blue >> 3) & 0x001f));
+    palette8888_[n] = red | green << 8 | blue << 16 | 0xffu << 24;
+  }
+
+  int32_t sin_[kAngle2Pi + 1];
+  uint16_t palette565_[kPaletteSize];
+  uint32_t palette8888_[kPaletteSize];
+};
+
+inline const int32_t PlasmaReference::kYt1Incr = FromFloat(1 / 100.0);
+inline const int32_t PlasmaReference::kYt2Incr = FromFloat(1 / 163.0);
+inline const int32_t PlasmaReference::kXt1Incr = FromFloat(1 / 173.0);
+inline const int32_t PlasmaReference::kXt2Incr = FromFloat(1 / 242.0);
+
+#endif  // PLASMA_REFERENCE_H
@@ -0,0 +1,229 @@
+/*
+ * Copyright (C) 2010 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "plasma_renderer.h"
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <random>
+#include <vector>
+
+#include "plasma_reference.h"
+
+namespace {
+
+const PlasmaReference& Reference() {
+  static const PlasmaReference reference;
+  return reference;
+}
+
+struct Frame {
+  Frame(int width, int height, int stride, PlasmaFormat format, int offset = 0)
+      : memory(offset + stride * height + 16, 0xab) {
+    target.pixels = memory.data() + offset;
+    target.width = width;
+    target.height = height;
+    target.stride = stride;
+    target.format = format;
+  }
+
+  std::vector<uint8_t> memory;
+  PlasmaTarget target;
+};
+
+int BytesPerPixel(PlasmaFormat format) {
+  return format == PLASMA_FORMAT_RGBA_8888 ? 4 : 2;
+}
+
+// Fills the frame with the reference, leaving the padding as it is.
+void FillReference(Frame* frame, double t) {
+  const PlasmaTarget& target = frame->target;
+  Reference().Fill(target.pixels, target.width, target.height, target.stride,
+                   t, target.format == PLASMA_FORMAT_RGBA_8888);
+}
+
+class PlasmaRendererTest : public testing::TestWithParam<int> {
+ protected:
+  void SetUp() override {
+    renderer_ = plasma_renderer_create(GetParam());
+    ASSERT_NE(renderer_, nullptr);
+  }
+  void TearDown() override { plasma_renderer_destroy(renderer_); }
+
+  PlasmaRenderer* renderer_ = nullptr;
+};
+
+// Every row and column term, at sizes around the vector widths and the band
+// height, at times where the phases have wrapped many times.
+TEST_P(PlasmaRendererTest, MatchesThePerPixelPlasma) {
+  const int kSizes[][2] = {{1, 1},  {7, 3},    {8, 17},   {9, 33},
+                           {31, 5}, {720, 97}, {1081, 37}};
+  const double kTimes[] = {0, 1, 1234.5, 99999, 1e6, 3.3e6};
+  for (PlasmaFormat format : {PLASMA_FORMAT_RGB_565, PLASMA_FORMAT_RGBA_8888}) {
+    for (const auto& size : kSizes) {
+      for (int padding : {0, 6}) {
+        int bpp = BytesPerPixel(format);
+        int stride = size[0] * bpp + padding * bpp / 2;
+        // A padded RGB_565 frame also starts off the 4-byte alignment.
+        int offset = padding && bpp == 2 ? 2 : 0;
+        for (double t : kTimes) {
+          Frame frame(size[0], size[1], stride, format, offset);
+          Frame expected(size[0], size[1], stride, format, offset);
+          ASSERT_EQ(plasma_renderer_fill(renderer_, &frame.target, t), 0);
+          FillReference(&expected, t);
+          EXPECT_EQ(frame.memory, expected.memory)
+              << size[0] << "x" << size[1] << " stride " << stride
+              << " format " << format << " t " << t;
+        }
+      }
+    }
+  }
+}
+
+TEST_P(PlasmaRendererTest, FillsAFrameTallerThanAllTheBands) {
+  Frame frame(64, PLASMA_MAX_THREADS * PLASMA_BAND_ROWS * 4 + 3, 64 * 4,
+              PLASMA_FORMAT_RGBA_8888);
+  Frame expected(64, frame.target.height, 64 * 4, PLASMA_FORMAT_RGBA_8888);
+  ASSERT_EQ(plasma_renderer_fill(renderer_, &frame.target, 4321.0), 0);
+  FillReference(&expected, 4321.0);
+  EXPECT_EQ(frame.memory, expected.memory);
+}
+
+TEST_P(PlasmaRendererTest, RefusesInvalidTargets) {
+  uint8_t pixels[400];
+  PlasmaTarget target = {nullptr, 10, 10, 20, PLASMA_FORMAT_RGB_565};
+  EXPECT_EQ(plasma_renderer_fill(renderer_, &target, 0), -1);
+  target.pixels = pixels;
+  target.stride = 19;
+  EXPECT_EQ(plasma_renderer_fill(renderer_, &target, 0), -1);
+  target.stride = 20;
+  EXPECT_EQ(plasma_renderer_fill(renderer_, &target, 0), 0);
+}
+
+bool Contains(const PlasmaRect& rect, int x, int y) {
+  return x >= rect.left && x < rect.right && y >= rect.top && y < rect.bottom;
+}
+
+// Random rects, some partly outside the frame, then the rest of the frame as
+// four more rects for the same t.
+TEST_P(PlasmaRendererTest, FillsOnlyTheRectAndCompletesTheFrame) {
+  std::mt19937 random(GetParam());
+  auto uniform = [&](int lo, int hi) {
+    return std::uniform_int_distribution<int>(lo, hi)(random);
+  };
+  for (int i = 0; i < 100; i++) {
+    int width = uniform(1, 300), height = uniform(1, 200);
+    PlasmaFormat format =
+        uniform(0, 1) ? PLASMA_FORMAT_RGBA_8888 : PLASMA_FORMAT_RGB_565;
+    int bpp = BytesPerPixel(format);
+    int stride = width * bpp + 4 * uniform(0, 2);
+    double t = uniform(0, 100000);
+    Frame frame(width, height, stride, format);
+    Frame expected(width, height, stride, format);
+    FillReference(&expected, t);
+
+    PlasmaRect rect;
+    rect.left = uniform(-5, width - 1);
+    rect.top = uniform(-5, height - 1);
+    rect.right = rect.left + uniform(1, width);
+    rect.bottom = rect.top + uniform(1, height);
+    ASSERT_EQ(plasma_renderer_fill_rect(renderer_, &frame.target, t, &rect),
+              0);
+    for (int y = 0; y < height; y++) {
+      for (int x = 0; x < width; x++) {
+        const uint8_t* pixel = &frame.memory[y * stride + x * bpp];
+        std::vector<uint8_t> actual(pixel, pixel + bpp);
+        std::vector<uint8_t> want(bpp, 0xab);
+        if (Contains(rect, x, y)) {
+          const uint8_t* reference = &expected.memory[y * stride + x * bpp];
+          want.assign(reference, reference + bpp);
+        }
+        ASSERT_EQ(actual, want) << "pixel " << x << "," << y << " of "
+                                << width << "x" << height << " in rect "
+                                << rect.left << "," << rect.top << " "
+                                << rect.right << "," << rect.bottom;
+      }
+    }
+
+    int top = std::max(rect.top, 0), bottom = std::min(rect.bottom, height);
+    const PlasmaRect kRest[] = {{0, 0, width, top},
+                                {0, bottom, width, height},
+                                {0, top, rect.left, bottom},
+                                {rect.right, top, width, bottom}};
+    for (const PlasmaRect& rest : kRest) {
+      ASSERT_EQ(plasma_renderer_fill_rect(renderer_, &frame.target, t, &rest),
+                0);
+    }
+    EXPECT_EQ(frame.memory, expected.memory);
+  }
+}
+
+// The terms kept for one t must not leak into the regions of the next one.
+TEST_P(PlasmaRendererTest, FillsRectsOfSuccessiveFrames) {
+  Frame frame(97, 61, 97 * 2, PLASMA_FORMAT_RGB_565);
+  PlasmaRect rect = {10, 5, 90, 60};
+  for (double t : {0.0, 16.0, 33.0, 16.0}) {
+    Frame expected(97, 61, 97 * 2, PLASMA_FORMAT_RGB_565);
+    FillReference(&expected, t);
+    ASSERT_EQ(plasma_renderer_fill_rect(renderer_, &frame.target, t, &rect),
+              0);
+    for (int y = rect.top; y < rect.bottom; y++) {
+      const uint8_t* row = &frame.memory[y * 97 * 2];
+      const uint8_t* want = &expected.memory[y * 97 * 2];
+      EXPECT_TRUE(std::equal(row + rect.left * 2, row + rect.right * 2,
+                             want + rect.left * 2))
+          << "row " << y << " at t " << t;
+    }
+  }
+}
+
+TEST_P(PlasmaRendererTest, LeavesTheFrameAloneForEmptyRects) {
+  Frame frame(32, 32, 32 * 4, PLASMA_FORMAT_RGBA_8888);
+  const std::vector<uint8_t> untouched = frame.memory;
+  const PlasmaRect kEmpty[] = {
+      {5, 5, 5, 20}, {5, 5, 20, 5}, {20, 20, 5, 5}, {32, 0, 40, 32},
+      {0, -10, 32, 0}, {-10, -10, -1, -1}};
+  for (const PlasmaRect& rect : kEmpty) {
+    EXPECT_EQ(plasma_renderer_fill_rect(renderer_, &frame.target, 1.0, &rect),
+              0);
+  }
+  EXPECT_EQ(frame.memory, untouched);
+
+  PlasmaRect rect = {0, 0, 10, 10};
+  frame.target.stride = 32 * 4 - 1;
+  EXPECT_EQ(plasma_renderer_fill_rect(renderer_, &frame.target, 1.0, &rect),
+            -1);
+  EXPECT_EQ(frame.memory, untouched);
+}
+
+INSTANTIATE_TEST_SUITE_P(Threads, PlasmaRendererTest,
+                         testing::Values(1, 2, 4, PLASMA_MAX_THREADS));
+
+TEST(PlasmaRendererThreadsTest, CapsTheThreadCount) {
+  PlasmaRenderer* renderer = plasma_renderer_create(PLASMA_MAX_THREADS * 4);
+  ASSERT_NE(renderer, nullptr);
+  EXPECT_EQ(plasma_renderer_thread_count(renderer), PLASMA_MAX_THREADS);
+  plasma_renderer_destroy(renderer);
+
+  renderer = plasma_renderer_create(0);
+  ASSERT_NE(renderer, nullptr);
+  EXPECT_GE(plasma_renderer_thread_count(renderer), 1);
+  EXPECT_LE(plasma_renderer_thread_count(renderer), PLASMA_MAX_THREADS);
+  plasma_renderer_destroy(renderer);
+}
+
+}  // namespace
@@ -33,6 +33,9 @@
 // max # of GL errors to print before giving up
 #define MAX_GL_ERRORS 200
 
+// how often to log the frame timing
+#define FRAME_TIMING_PERIOD_NS 5000000000LL
+
 static NativeEngine *_singleton = NULL;
 
 // workaround for internal bug b/149866792
@@ -52,6 +55,7 @@ NativeEngine::NativeEngine(struct android_app *app) {
   mJniEnv = NULL;
   memset(&mState, 0, sizeof(mState));
   mIsFirstFrame = true;
+  frame_timing_init(&mFrameTiming, frame_timing_now_ns());
 
   if (app->savedState != NULL) {
     // we are starting with previously saved state -- restore it
@@ -516,6 +520,8 @@ void NativeEngine::DoFrame() {
     return;
   }
 
+  frame_timing_begin_frame(&mFrameTiming, frame_timing_now_ns());
+
   SceneManager *mgr = SceneManager::GetInstance();
 
   // how big is the surface? We query every frame because it's cheap, and some
@@ -543,6 +549,8 @@ void NativeEngine::DoFrame() {
 
   // render!
   mgr->DoFrame();
+  frame_timing_end_phase(&mFrameTiming, FRAME_METRIC_RENDER,
+                         frame_timing_now_ns());
 
   // swap buffers
   if (EGL_FALSE == eglSwapBuffers(mEglDisplay, mEglSurface)) {
@@ -551,6 +559,15 @@ void NativeEngine::DoFrame() {
     HandleEglError(eglGetError());
   }
 
+  int64_t frameEndNs = frame_timing_now_ns();
+  frame_timing_end_phase(&mFrameTiming, FRAME_METRIC_POST, frameEndNs);
+  frame_timing_end_frame(&mFrameTiming, frameEndNs);
+  FrameTimingReport report;
+  if (frame_timing_take_report(&mFrameTiming, frameEndNs,
+                               FRAME_TIMING_PERIOD_NS, &report)) {
+    frame_timing_log_report(&report, DEBUG_TAG);
+  }
+
   // print out GL errors, if any
   GLenum e;
   static int errorsPrinted = 0;
@@ -17,6 +17,7 @@
 #define endlesstunnel_native_engine_hpp
 
 #include "common.hpp"
+#include "frame_timing.h"
 
 struct NativeEngineSavedState {
   bool mHasFocus;
@@ -71,6 +72,9 @@ class NativeEngine {
   // is this the first frame we're drawing?
   bool mIsFirstFrame;
 
+  // render and swap times of the frames, logged periodically
+  FrameTiming mFrameTiming;
+
   // initialize the display
   bool InitDisplay();
 
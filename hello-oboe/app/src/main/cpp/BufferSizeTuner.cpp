@@ -0,0 +1,87 @@
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "BufferSizeTuner.h"
+
+void BufferSizeTuner::reset(int32_t framesPerBurst, int32_t capacityInFrames,
+                            int32_t sampleRate) {
+  mFramesPerBurst = framesPerBurst;
+  mCapacityInFrames = capacityInFrames;
+  mSampleRate = sampleRate;
+  mStarted = false;
+}
+
+int32_t BufferSizeTuner::clampToBursts(int64_t frames) const {
+  int64_t bursts = (frames + mFramesPerBurst - 1) / mFramesPerBurst;
+  int64_t clamped = bursts * mFramesPerBurst;
+  if (clamped > mCapacityInFrames) {
+    clamped = mCapacityInFrames / mFramesPerBurst * mFramesPerBurst;
+  }
+  return static_cast<int32_t>(clamped < mFramesPerBurst ? mFramesPerBurst
+                                                        : clamped);
+}
+
+int32_t BufferSizeTuner::update(int64_t callbackStartNs, int32_t numFrames,
+                                int32_t xRunCount, int32_t bufferSize) {
+  if (mFramesPerBurst <= 0 || mSampleRate <= 0) return 0;
+
+  if (!mStarted) {
+    mStarted = true;
+    mFirstStartNs = callbackStartNs;
+    mFramesRequested = 0;
+    mXRunCount = xRunCount;
+    mHoldUntilNs = callbackStartNs + kHoldNs;
+    mWindowStartNs = callbackStartNs;
+    mMinOffsetNs = mMaxOffsetNs = 0;
+  }
+
+  // How late this callback is against one started with the first and
+  // keeping up with the sample rate since.
+  int64_t idealNs = mFramesRequested * 1000000000LL / mSampleRate;
+  int64_t offsetNs = callbackStartNs - mFirstStartNs - idealNs;
+  mFramesRequested += numFrames;
+  if (offsetNs < mMinOffsetNs) mMinOffsetNs = offsetNs;
+  if (offsetNs > mMaxOffsetNs) mMaxOffsetNs = offsetNs;
+
+  int32_t size = 0;
+  if (xRunCount > mXRunCount) {
+    size = clampToBursts(static_cast<int64_t>(bufferSize) + mFramesPerBurst);
+    mHoldUntilNs = callbackStartNs + kHoldNs;
+  } else if (callbackStartNs - mWindowStartNs >= kWindowNs) {
+    int64_t jitterFrames =
+        ((mMaxOffsetNs - mMinOffsetNs) * mSampleRate + 999999999LL) /
+        1000000000LL;
+    int32_t needed = clampToBursts(mFramesPerBurst + jitterFrames);
+    if (needed >= bufferSize) {
+      // Still needed: wait another kHoldNs before trying a smaller one.
+      size = needed;
+      mHoldUntilNs = callbackStartNs + kHoldNs;
+    } else if (needed < bufferSize && callbackStartNs >= mHoldUntilNs) {
+      size = clampToBursts(static_cast<int64_t>(bufferSize) -
+                           mFramesPerBurst);
+    }
+    // The next window is measured against this callback, so the drift
+    // between the audio clock and CLOCK_MONOTONIC doesn't add up.
+    mFirstStartNs = callbackStartNs;
+    mFramesRequested = numFrames;
+    mWindowStartNs = callbackStartNs;
+    mMinOffsetNs = mMaxOffsetNs = 0;
+  }
+  mXRunCount = xRunCount;
+
+  return size != bufferSize ? size : 0;
+}
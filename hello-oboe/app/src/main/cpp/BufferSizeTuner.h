@@ -0,0 +1,74 @@
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef HELLO_OBOE_BUFFERSIZETUNER_H
+#define HELLO_OBOE_BUFFERSIZETUNER_H
+
+#include <stdint.h>
+
+/*
+ * BufferSizeTuner
+ * Picks a stream buffer size from how the callbacks are scheduled, like
+ * oboe::LatencyTuner does from xruns alone.
+ *
+ * Callbacks should start every numFrames / sampleRate. Over each window,
+ * the spread between the earliest and the latest start against that ideal
+ * schedule is the jitter the buffer has to absorb on top of a burst, and
+ * the buffer grows to it right away. An xrun also grows it by a burst.
+ * Once no window has needed the current size for kHoldNs, it shrinks back
+ * a burst per window, down to what the jitter needs.
+ *
+ * It holds no stream: update() takes what the callback knows and returns
+ * the size to set, so it runs the same against a simulated stream.
+ */
+class BufferSizeTuner {
+ public:
+  static constexpr int64_t kWindowNs = 1000000000;  // 1 s
+  static constexpr int64_t kHoldNs = 5000000000;    // 5 s
+
+  // Before the audio stream starts, or to start over.
+  void reset(int32_t framesPerBurst, int32_t capacityInFrames,
+             int32_t sampleRate);
+
+  /*
+   * From the audio callback, with the time it started, the frames it is
+   * asked for, the stream's xrun count and current buffer size. Returns the
+   * buffer size to set, or 0 to leave it as it is.
+   */
+  int32_t update(int64_t callbackStartNs, int32_t numFrames,
+                 int32_t xRunCount, int32_t bufferSize);
+
+ private:
+  int32_t clampToBursts(int64_t frames) const;
+
+  int32_t mFramesPerBurst = 0;
+  int32_t mCapacityInFrames = 0;
+  int32_t mSampleRate = 0;
+
+  bool mStarted = false;
+  int64_t mFirstStartNs = 0;
+  int64_t mFramesRequested = 0;  // before the current callback
+  int32_t mXRunCount = 0;
+  int64_t mHoldUntilNs = 0;
+
+  // Current window, offsets of the starts against the ideal schedule
+  int64_t mWindowStartNs = 0;
+  int64_t mMinOffsetNs = 0;
+  int64_t mMaxOffsetNs = 0;
+};
+
+#endif  // HELLO_OBOE_BUFFERSIZETUNER_H
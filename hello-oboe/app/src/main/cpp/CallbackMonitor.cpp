@@ -0,0 +1,92 @@
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "CallbackMonitor.h"
+
+#include <string.h>
+#include <time.h>
+
+int64_t callbackNowNs() {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return static_cast<int64_t>(now.tv_sec) * 1000000000LL + now.tv_nsec;
+}
+
+// The audio thread is the only writer: a load and a store are enough, and
+// cheaper than a read-modify-write.
+static inline void increment(std::atomic<uint32_t> &counter) {
+  counter.store(counter.load(std::memory_order_relaxed) + 1,
+                std::memory_order_relaxed);
+}
+
+void CallbackMonitor::recordCallback(int64_t startNs, int64_t endNs,
+                                     int32_t numFrames) {
+  if (numFrames <= 0) return;
+  // Percent of the numFrames / sampleRate the callback has.
+  int64_t percent = (endNs - startNs) * mSampleRate /
+                    (static_cast<int64_t>(numFrames) * 10000000LL);
+  int64_t bucket = percent / kBucketPercent;
+  if (bucket < 0) bucket = 0;
+  if (bucket >= kBuckets) bucket = kBuckets - 1;
+  increment(mBuckets[bucket]);
+  increment(mCallbacks);
+}
+
+void CallbackMonitor::recordStream(int32_t xRunCount, int32_t bufferSize) {
+  mXRunCount.store(xRunCount, std::memory_order_relaxed);
+  mBufferSize.store(bufferSize, std::memory_order_relaxed);
+}
+
+void CallbackMonitor::snapshot(Snapshot *snapshot) const {
+  for (int32_t bucket = 0; bucket < kBuckets; bucket++) {
+    snapshot->buckets[bucket] =
+        mBuckets[bucket].load(std::memory_order_relaxed);
+  }
+  snapshot->callbacks = mCallbacks.load(std::memory_order_relaxed);
+  snapshot->xRunCount = mXRunCount.load(std::memory_order_relaxed);
+  snapshot->bufferSize = mBufferSize.load(std::memory_order_relaxed);
+}
+
+void CallbackMonitor::summarize(const Snapshot &current,
+                                const Snapshot &previous, Load *load) {
+  memset(load, 0, sizeof(*load));
+  load->xRuns = current.xRunCount - previous.xRunCount;
+  load->bufferSize = current.bufferSize;
+
+  // The buckets are read one at a time while callbacks go on, so they are
+  // counted again rather than trusting callbacks to match them.
+  uint32_t counts[kBuckets];
+  uint32_t total = 0;
+  for (int32_t bucket = 0; bucket < kBuckets; bucket++) {
+    counts[bucket] = current.buckets[bucket] - previous.buckets[bucket];
+    total += counts[bucket];
+  }
+  load->callbacks = total;
+  if (total == 0) return;
+
+  uint32_t p50Target = (total + 1) / 2;
+  uint32_t p99Target = total - total / 100;
+  uint32_t seen = 0;
+  for (int32_t bucket = 0; bucket < kBuckets; bucket++) {
+    if (counts[bucket] == 0) continue;
+    seen += counts[bucket];
+    float upper = static_cast<float>((bucket + 1) * kBucketPercent);
+    if (load->p50 == 0 && seen >= p50Target) load->p50 = upper;
+    if (load->p99 == 0 && seen >= p99Target) load->p99 = upper;
+    load->max = upper;
+  }
+}
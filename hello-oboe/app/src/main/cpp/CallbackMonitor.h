@@ -0,0 +1,82 @@
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef HELLO_OBOE_CALLBACKMONITOR_H
+#define HELLO_OBOE_CALLBACKMONITOR_H
+
+#include <stdint.h>
+
+#include <atomic>
+
+// CLOCK_MONOTONIC, in nanoseconds.
+int64_t callbackNowNs();
+
+/*
+ * CallbackMonitor
+ * How close the audio callback gets to its deadline.
+ *
+ * Each callback records its duty cycle, the time it took over the time its
+ * frames last at the sample rate, in a histogram, along with the stream's
+ * xrun count and buffer size. The audio thread is the only writer and only
+ * stores relaxed atomics, so recording costs two clock reads and no lock;
+ * the UI thread reads a snapshot whenever it likes.
+ */
+class CallbackMonitor {
+ public:
+  // Duty cycle buckets of 2%, the last one for 200% and above.
+  static constexpr int32_t kBucketPercent = 2;
+  static constexpr int32_t kBuckets = 101;
+
+  struct Snapshot {
+    uint32_t buckets[kBuckets];
+    uint32_t callbacks;
+    int32_t xRunCount;
+    int32_t bufferSize;
+  };
+
+  // Between two snapshots, with the duty cycles in percent.
+  struct Load {
+    uint32_t callbacks;
+    // Percentiles are the upper bound of their bucket.
+    float p50;
+    float p99;
+    float max;
+    int32_t xRuns;
+    int32_t bufferSize;
+  };
+
+  // Before the audio stream starts.
+  void setSampleRate(int32_t sampleRate) { mSampleRate = sampleRate; }
+
+  // From the audio thread.
+  void recordCallback(int64_t startNs, int64_t endNs, int32_t numFrames);
+  void recordStream(int32_t xRunCount, int32_t bufferSize);
+
+  // From any thread.
+  void snapshot(Snapshot *snapshot) const;
+  static void summarize(const Snapshot &current, const Snapshot &previous,
+                        Load *load);
+
+ private:
+  int32_t mSampleRate = 48000;
+  std::atomic<uint32_t> mBuckets[kBuckets] = {};
+  std::atomic<uint32_t> mCallbacks{0};
+  std::atomic<int32_t> mXRunCount{0};
+  std::atomic<int32_t> mBufferSize{0};
+};
+
+#endif  // HELLO_OBOE_CALLBACKMONITOR_H
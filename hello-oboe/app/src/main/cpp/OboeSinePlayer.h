@@ -18,22 +18,25 @@
 #ifndef HELLO_OBOE_OBOESINEPLAYER_H
 #define HELLO_OBOE_OBOESINEPLAYER_H
 
-#include <math.h>
 #include <oboe/Oboe.h>
 
-#include <algorithm>
+#include "BufferSizeTuner.h"
+#include "CallbackMonitor.h"
+#include "OscillatorBank.h"
 
 /*
  * This class is responsible for creating an audio stream and starting it.
  * It specifies a callback function onAudioReady which is called each time
  * the audio stream needs more data.
- * Inside this callback either silence is rendered or if the isOn variable
- * is true a sine wave will be rendered.
- * The sine wave's frequency is hardcoded to 440Hz inside kFrequency.
+ * Inside this callback an OscillatorBank renders the voices that are on,
+ * which is silence if none is.
+ * Each callback is timed by a CallbackMonitor, and a BufferSizeTuner can
+ * size the stream buffer to the callback jitter it sees.
  */
 class OboeSinePlayer : public oboe::AudioStreamCallback {
  public:
-  OboeSinePlayer() {
+  explicit OboeSinePlayer(bool adaptBufferSize)
+      : mAdaptBufferSize(adaptBufferSize) {
     oboe::AudioStreamBuilder builder;
     // The builder set methods can be chained for convenience.
     builder.setSharingMode(oboe::SharingMode::Exclusive);
@@ -44,7 +47,11 @@ class OboeSinePlayer : public oboe::AudioStreamCallback {
     // Typically, start the stream after querying some stream information, as
     // well as some input from the user
     channelCount = outStream->getChannelCount();
-    mPhaseIncrement = kFrequency * kTwoPi / outStream->getSampleRate();
+    mBank.setSampleRate(outStream->getSampleRate());
+    mMonitor.setSampleRate(outStream->getSampleRate());
+    mTuner.reset(outStream->getFramesPerBurst(),
+                 outStream->getBufferCapacityInFrames(),
+                 outStream->getSampleRate());
     outStream->requestStart();
   }
 
@@ -53,43 +60,50 @@ class OboeSinePlayer : public oboe::AudioStreamCallback {
   oboe::DataCallbackResult onAudioReady(oboe::AudioStream *oboeStream,
                                         void *audioData,
                                         int32_t numFrames) override {
-    float *floatData = static_cast<float *>(audioData);
-    if (isOn) {
-      // Generate sine wave values
-      for (int i = 0; i < numFrames; ++i) {
-        float sampleValue = kAmplitude * sinf(mPhase);
-        for (int j = 0; j < channelCount; j++) {
-          floatData[i * channelCount + j] = sampleValue;
-        }
-        mPhase += mPhaseIncrement;
-        if (mPhase >= kTwoPi) mPhase -= kTwoPi;
+    int64_t startNs = callbackNowNs();
+    mBank.render(static_cast<float *>(audioData), numFrames, channelCount);
+
+    // Not supported on OpenSL ES: no xruns are counted then.
+    auto xRunCount = oboeStream->getXRunCount();
+    int32_t xRuns = xRunCount ? xRunCount.value() : 0;
+    int32_t bufferSize = oboeStream->getBufferSizeInFrames();
+    if (mAdaptBufferSize) {
+      int32_t newSize = mTuner.update(startNs, numFrames, xRuns, bufferSize);
+      if (newSize > 0) {
+        auto result = oboeStream->setBufferSizeInFrames(newSize);
+        if (result) bufferSize = result.value();
       }
-    } else {
-      // This will output silence
-      std::fill_n(floatData, numFrames * channelCount, 0);
     }
+    mMonitor.recordStream(xRuns, bufferSize);
+    mMonitor.recordCallback(startNs, callbackNowNs(), numFrames);
     return oboe::DataCallbackResult::Continue;
   }
 
-  void enable(bool toEnable) { isOn.store(toEnable); }
+  // Can be called from any thread, the callback doesn't wait on it.
+  void setVoice(int32_t voice, Waveform waveform, float frequency,
+                float amplitude) {
+    mBank.setVoice(voice, waveform, frequency, amplitude);
+  }
+
+  // Callback load since the last call. Call it from one thread at a time.
+  void takeLoad(CallbackMonitor::Load *load) {
+    CallbackMonitor::Snapshot current;
+    mMonitor.snapshot(&current);
+    CallbackMonitor::summarize(current, mLastSnapshot, load);
+    mLastSnapshot = current;
+  }
 
  private:
   // ManagedStream will release audio resources when destroyed.
   oboe::ManagedStream outStream;
 
-  std::atomic_bool isOn{false};
   int channelCount;
-  double mPhaseIncrement;
-
-  // Wave params, these could be instance variables in order to modify at
-  // runtime
-  static float constexpr kAmplitude = 0.5f;
-  static float constexpr kFrequency = 440;
-
-  // Keeps track of where the wave is
-  float mPhase = 0.0;
+  OscillatorBank mBank;
 
-  static double constexpr kTwoPi = M_PI * 2;
+  bool mAdaptBufferSize;
+  BufferSizeTuner mTuner;
+  CallbackMonitor mMonitor;
+  CallbackMonitor::Snapshot mLastSnapshot = {};
 };
 
 #endif  // HELLO_OBOE_OBOESINEPLAYER_H
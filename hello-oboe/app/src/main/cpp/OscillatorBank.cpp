@@ -0,0 +1,230 @@
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "OscillatorBank.h"
+
+#include <math.h>
+#include <string.h>
+
+#if defined(__SSE__) && !defined(__aarch64__) && !defined(__arm__)
+#include <xmmintrin.h>
+#endif
+
+// GCC and Clang vector extensions: NEON on ARM, SSE on x86.
+typedef float Float4 __attribute__((vector_size(16)));
+typedef int32_t Int4 __attribute__((vector_size(16)));
+
+static inline Float4 splat(float value) {
+  return Float4{value, value, value, value};
+}
+
+static inline Float4 load(const float *source) {
+  Float4 value;
+  memcpy(&value, source, sizeof(value));
+  return value;
+}
+
+static inline void store(float *destination, Float4 value) {
+  memcpy(destination, &value, sizeof(value));
+}
+
+static inline Float4 select(Int4 mask, Float4 ifTrue, Float4 ifFalse) {
+  return (Float4)((mask & (Int4)ifTrue) | (~mask & (Int4)ifFalse));
+}
+
+// Fractional part of positive phases.
+static inline Float4 wrap(Float4 phase) {
+  return phase -
+         __builtin_convertvector(__builtin_convertvector(phase, Int4), Float4);
+}
+
+/*
+ * Correction for the step a naive saw or square makes at phase 0, a
+ * polynomial over one sample on each side of it: the step is band-limited,
+ * so its aliasing stays low.
+ */
+static inline Float4 polyBlep(Float4 phase, float increment, float inverse) {
+  Float4 before = (phase - splat(1.0f)) * splat(inverse);
+  Float4 after = phase * splat(inverse);
+  Float4 afterStep = after + after - after * after - splat(1.0f);
+  Float4 beforeStep = before * before + before + before + splat(1.0f);
+  return select(phase < splat(increment), afterStep,
+                select(phase > splat(1.0f - increment), beforeStep,
+                       splat(0.0f)));
+}
+
+static const Float4 kLanes = {0.0f, 1.0f, 2.0f, 3.0f};
+
+OscillatorBank::OscillatorBank() {
+  for (int32_t i = 0; i <= kSineTableSize; i++) {
+    mSineTable[i] = static_cast<float>(sin(2.0 * M_PI * i / kSineTableSize));
+  }
+}
+
+void OscillatorBank::setVoice(int32_t voice, Waveform waveform,
+                              float frequency, float amplitude) {
+  if (voice < 0 || voice >= kMaxVoices) return;
+  VoiceParameters &parameters = mParameters[voice];
+  parameters.waveform.store(static_cast<int32_t>(waveform),
+                            std::memory_order_relaxed);
+  parameters.frequency.store(frequency, std::memory_order_relaxed);
+  parameters.amplitude.store(amplitude, std::memory_order_relaxed);
+}
+
+void OscillatorBank::setAmplitude(int32_t voice, float amplitude) {
+  if (voice < 0 || voice >= kMaxVoices) return;
+  mParameters[voice].amplitude.store(amplitude, std::memory_order_relaxed);
+}
+
+void OscillatorBank::addSine(float phase, float increment, float gain,
+                             float gainStep, int32_t numFrames) {
+  Float4 phases = wrap(splat(phase) + splat(increment) * kLanes);
+  Float4 phaseStep = splat(4 * increment);
+  Float4 gains = splat(gain) + splat(gainStep) * kLanes;
+  Float4 gainSteps = splat(4 * gainStep);
+  for (int32_t frame = 0; frame < numFrames; frame += 4) {
+    Float4 index = phases * splat(kSineTableSize);
+    Int4 integer = __builtin_convertvector(index, Int4);
+    Float4 fraction = index - __builtin_convertvector(integer, Float4);
+    // A phase just below 1 can round up to the end of the table.
+    integer &= Int4{kSineTableSize - 1, kSineTableSize - 1, kSineTableSize - 1,
+                   kSineTableSize - 1};
+    Float4 left = {mSineTable[integer[0]], mSineTable[integer[1]],
+                   mSineTable[integer[2]], mSineTable[integer[3]]};
+    Float4 right = {mSineTable[integer[0] + 1], mSineTable[integer[1] + 1],
+                    mSineTable[integer[2] + 1], mSineTable[integer[3] + 1]};
+    Float4 value = left + fraction * (right - left);
+    store(mMix + frame, load(mMix + frame) + gains * value);
+    phases = wrap(phases + phaseStep);
+    gains += gainSteps;
+  }
+}
+
+void OscillatorBank::addPolyBlep(Waveform waveform, float phase,
+                                 float increment, float gain, float gainStep,
+                                 int32_t numFrames) {
+  float inverse = 1.0f / increment;
+  Float4 phases = wrap(splat(phase) + splat(increment) * kLanes);
+  Float4 phaseStep = splat(4 * increment);
+  Float4 gains = splat(gain) + splat(gainStep) * kLanes;
+  Float4 gainSteps = splat(4 * gainStep);
+  for (int32_t frame = 0; frame < numFrames; frame += 4) {
+    Float4 value;
+    if (waveform == Waveform::kSaw) {
+      value = phases + phases - splat(1.0f) -
+              polyBlep(phases, increment, inverse);
+    } else {
+      // Steps up at phase 0 and down at phase 0.5
+      Float4 halfway = wrap(phases + splat(0.5f));
+      value = select(phases < splat(0.5f), splat(1.0f), splat(-1.0f)) +
+              polyBlep(phases, increment, inverse) -
+              polyBlep(halfway, increment, inverse);
+    }
+    store(mMix + frame, load(mMix + frame) + gains * value);
+    phases = wrap(phases + phaseStep);
+    gains += gainSteps;
+  }
+}
+
+void OscillatorBank::renderBlock(int32_t numFrames) {
+  // Whole vectors: the frames past numFrames are computed and not used.
+  int32_t vectorFrames = (numFrames + 3) & ~3;
+  memset(mMix, 0, vectorFrames * sizeof(float));
+
+  float nyquist = 0.5f * mSampleRate;
+  for (int32_t voice = 0; voice < kMaxVoices; voice++) {
+    const VoiceParameters &parameters = mParameters[voice];
+    VoiceState &state = mVoices[voice];
+    float amplitude = parameters.amplitude.load(std::memory_order_relaxed);
+    if (amplitude == 0.0f && state.gain == 0.0f) {
+      continue;
+    }
+    float frequency = parameters.frequency.load(std::memory_order_relaxed);
+    if (!(frequency > 0.0f && frequency < nyquist)) {
+      state.gain = 0.0f;
+      continue;
+    }
+    Waveform waveform = static_cast<Waveform>(
+        parameters.waveform.load(std::memory_order_relaxed));
+
+    float increment = frequency / mSampleRate;
+    float gainStep = (amplitude - state.gain) / numFrames;
+    float phase = static_cast<float>(state.phase);
+    if (waveform == Waveform::kSine) {
+      addSine(phase, increment, state.gain, gainStep, vectorFrames);
+    } else {
+      addPolyBlep(waveform, phase, increment, state.gain, gainStep,
+                  vectorFrames);
+    }
+
+    // Kept in double, so the frequency doesn't drift over time.
+    state.phase += static_cast<double>(increment) * numFrames;
+    state.phase -= floor(state.phase);
+    state.gain = amplitude;
+  }
+}
+
+void OscillatorBank::render(float *output, int32_t numFrames,
+                            int32_t channelCount) {
+  ScopedFlushDenormals flushDenormals;
+  while (numFrames > 0) {
+    int32_t blockFrames = numFrames < kBlockFrames ? numFrames : kBlockFrames;
+    renderBlock(blockFrames);
+    if (channelCount == 1) {
+      memcpy(output, mMix, blockFrames * sizeof(float));
+    } else {
+      for (int32_t frame = 0; frame < blockFrames; frame++) {
+        for (int32_t channel = 0; channel < channelCount; channel++) {
+          output[frame * channelCount + channel] = mMix[frame];
+        }
+      }
+    }
+    output += blockFrames * channelCount;
+    numFrames -= blockFrames;
+  }
+}
+
+ScopedFlushDenormals::ScopedFlushDenormals() {
+#if defined(__aarch64__)
+  uint64_t fpcr;
+  __asm__ __volatile__("mrs %0, fpcr" : "=r"(fpcr));
+  mSaved = fpcr;
+  __asm__ __volatile__("msr fpcr, %0" : : "r"(fpcr | (1 << 24)));  // FZ
+#elif defined(__arm__)
+  uint32_t fpscr;
+  __asm__ __volatile__("vmrs %0, fpscr" : "=r"(fpscr));
+  mSaved = fpscr;
+  __asm__ __volatile__("vmsr fpscr, %0" : : "r"(fpscr | (1 << 24)));  // FZ
+#elif defined(__SSE__)
+  mSaved = _mm_getcsr();
+  _mm_setcsr(mSaved | 0x8040);  // FTZ and DAZ
+#else
+  mSaved = 0;
+#endif
+}
+
+ScopedFlushDenormals::~ScopedFlushDenormals() {
+#if defined(__aarch64__)
+  __asm__ __volatile__("msr fpcr, %0" : : "r"(static_cast<uint64_t>(mSaved)));
+#elif defined(__arm__)
+  __asm__ __volatile__("vmsr fpscr, %0"
+                       :
+                       : "r"(static_cast<uint32_t>(mSaved)));
+#elif defined(__SSE__)
+  _mm_setcsr(static_cast<unsigned int>(mSaved));
+#endif
+}
@@ -0,0 +1,106 @@
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef HELLO_OBOE_OSCILLATORBANK_H
+#define HELLO_OBOE_OSCILLATORBANK_H
+
+#include <stdint.h>
+
+#include <atomic>
+
+enum class Waveform : int32_t {
+  kSine,    // from a wavetable, with linear interpolation
+  kSaw,     // band-limited with polyBLEP
+  kSquare,  // band-limited with polyBLEP
+};
+
+/*
+ * OscillatorBank
+ * Voices summed into an audio stream, rendered a block at a time.
+ *
+ * Each voice is rendered 4 frames at a time with SIMD vectors, then mixed
+ * in. The UI thread sets the voices through atomics the audio thread reads
+ * once per block, so neither ever waits for the other. Amplitude changes
+ * ramp over a block to avoid clicks.
+ */
+class OscillatorBank {
+ public:
+  static constexpr int32_t kMaxVoices = 64;
+  static constexpr int32_t kBlockFrames = 128;
+  static constexpr int32_t kSineTableSize = 2048;
+
+  OscillatorBank();
+
+  // Before the audio stream starts.
+  void setSampleRate(int32_t sampleRate) { mSampleRate = sampleRate; }
+
+  /*
+   * From any thread. A voice is silent at amplitude 0; its frequency must
+   * be below half the sample rate.
+   */
+  void setVoice(int32_t voice, Waveform waveform, float frequency,
+                float amplitude);
+  void setAmplitude(int32_t voice, float amplitude);
+
+  /*
+   * From the audio thread: write numFrames frames of the voices, the same
+   * on every channel, to the interleaved output.
+   */
+  void render(float *output, int32_t numFrames, int32_t channelCount);
+
+ private:
+  struct VoiceParameters {
+    std::atomic<int32_t> waveform{static_cast<int32_t>(Waveform::kSine)};
+    std::atomic<float> frequency{440.0f};
+    std::atomic<float> amplitude{0.0f};
+  };
+
+  // Audio thread only
+  struct VoiceState {
+    double phase = 0.0;  // in cycles, 0 to 1
+    float gain = 0.0f;   // amplitude reached at the end of the last block
+  };
+
+  void renderBlock(int32_t numFrames);
+  void addSine(float phase, float increment, float gain, float gainStep,
+               int32_t numFrames);
+  void addPolyBlep(Waveform waveform, float phase, float increment,
+                   float gain, float gainStep, int32_t numFrames);
+
+  int32_t mSampleRate = 48000;
+  VoiceParameters mParameters[kMaxVoices];
+  VoiceState mVoices[kMaxVoices];
+
+  // One extra point, so interpolation never wraps around.
+  float mSineTable[kSineTableSize + 1];
+  alignas(16) float mMix[kBlockFrames];
+};
+
+/*
+ * Flushes denormal floats to zero on the calling thread, for the lifetime
+ * of the object: the audio thread gets no slow path from decaying values.
+ */
+class ScopedFlushDenormals {
+ public:
+  ScopedFlushDenormals();
+  ~ScopedFlushDenormals();
+
+ private:
+  uintptr_t mSaved;
+};
+
+#endif  // HELLO_OBOE_OSCILLATORBANK_H
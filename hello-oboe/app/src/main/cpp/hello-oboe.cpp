@@ -29,7 +29,7 @@ extern "C" {
 JNIEXPORT jint JNICALL
 Java_com_google_example_hellooboe_MainActivity_createStream(
     JNIEnv * /* env */, jobject /* this */) {
-  oboePlayer = new OboeSinePlayer();
+  oboePlayer = new OboeSinePlayer(true /* adaptBufferSize */);
 
   return oboePlayer ? 0 : -1;
 }
@@ -42,18 +42,43 @@ Java_com_google_example_hellooboe_MainActivity_destroyStream(
   }
 }
 /*
- * Play sound with pre-created Oboe stream
+ * Set a voice of the oscillator bank, silent at amplitude 0.
+ * waveform: 0 - sine, 1 - saw, 2 - square
  * returns:  0  - success
  *          -1  - failed (stream has not created yet )
  */
-JNIEXPORT jint JNICALL Java_com_google_example_hellooboe_MainActivity_playSound(
-    JNIEnv * /* env */, jobject /* this */, jboolean enable) {
+JNIEXPORT jint JNICALL Java_com_google_example_hellooboe_MainActivity_setVoice(
+    JNIEnv * /* env */, jobject /* this */, jint voice, jint waveform,
+    jfloat frequency, jfloat amplitude) {
   jint result = 0;
   if (oboePlayer) {
-    oboePlayer->enable(enable);
+    oboePlayer->setVoice(voice, static_cast<Waveform>(waveform), frequency,
+                         amplitude);
   } else {
     result = -1;
   }
   return result;
 }
+/*
+ * Callback load since the last call, for the UI:
+ *    callbacks, duty cycle p50, p99 and max in percent, xruns, buffer size
+ * returns null if the stream has not been created yet
+ */
+JNIEXPORT jfloatArray JNICALL
+Java_com_google_example_hellooboe_MainActivity_takeCallbackLoad(
+    JNIEnv *env, jobject /* this */) {
+  if (!oboePlayer) {
+    return nullptr;
+  }
+  CallbackMonitor::Load load;
+  oboePlayer->takeLoad(&load);
+  jfloat values[] = {static_cast<jfloat>(load.callbacks), load.p50, load.p99,
+                     load.max, static_cast<jfloat>(load.xRuns),
+                     static_cast<jfloat>(load.bufferSize)};
+  jfloatArray array = env->NewFloatArray(6);
+  if (array) {
+    env->SetFloatArrayRegion(array, 0, 6, values);
+  }
+  return array;
+}
 }
@@ -0,0 +1,95 @@
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+/*
+ * Xruns and buffer size of a simulated stream over 20 s quiet, 20 s busy
+ * and 20 s quiet again, with BufferSizeTuner, with a fixed buffer of two
+ * bursts, and growing a burst per xrun only like oboe::LatencyTuner. Then
+ * the cost of CallbackMonitor::recordCallback().
+ */
+#include <stdio.h>
+
+#include <chrono>
+#include <random>
+
+#include "BufferSizeTuner.h"
+#include "CallbackMonitor.h"
+#include "SimulatedStream.h"
+
+namespace {
+
+enum class Policy { kTuner, kFixed, kXRunsOnly };
+const char* const kPolicyNames[] = {"BufferSizeTuner", "fixed 2 bursts",
+                                    "xruns only"};
+
+void simulate(Policy policy) {
+  const int64_t kCallbacksPerPhase = 10000;
+  const int32_t kBurst = SimulatedStream::kFramesPerBurst;
+  std::mt19937 random(3);
+  SimulatedStream stream;
+  stream.bufferSize = 2 * kBurst;
+  BufferSizeTuner tuner;
+  tuner.reset(kBurst, SimulatedStream::kCapacityInFrames,
+              SimulatedStream::kSampleRate);
+
+  printf("%-16s", kPolicyNames[static_cast<int>(policy)]);
+  for (int phase = 0; phase < 3; phase++) {
+    int32_t xRunsBefore = stream.xRunCount;
+    int64_t sizeSum = 0;
+    for (int64_t i = 0; i < kCallbacksPerPhase; i++) {
+      int64_t delayNs =
+          phase == 1 ? busyDelayNs(&random) : quietDelayNs(&random);
+      int32_t xRunsBeforeCallback = stream.xRunCount;
+      int64_t startNs = stream.nextCallback(delayNs);
+      if (policy == Policy::kTuner) {
+        int32_t size = tuner.update(startNs, kBurst, stream.xRunCount,
+                                    stream.bufferSize);
+        if (size != 0) stream.bufferSize = size;
+      } else if (policy == Policy::kXRunsOnly &&
+                 stream.xRunCount > xRunsBeforeCallback &&
+                 stream.bufferSize < SimulatedStream::kCapacityInFrames) {
+        stream.bufferSize += kBurst;
+      }
+      sizeSum += stream.bufferSize;
+    }
+    printf("  %s: %4d xruns, %5.1f frames", phase == 1 ? "busy " : "quiet",
+           stream.xRunCount - xRunsBefore,
+           static_cast<double>(sizeSum) / kCallbacksPerPhase);
+  }
+  printf("\n");
+}
+
+}  // namespace
+
+int main() {
+  simulate(Policy::kTuner);
+  simulate(Policy::kFixed);
+  simulate(Policy::kXRunsOnly);
+
+  const int kCallbacks = 10000000;
+  CallbackMonitor monitor;
+  auto begin = std::chrono::steady_clock::now();
+  for (int i = 0; i < kCallbacks; i++) {
+    int64_t startNs = callbackNowNs();
+    monitor.recordCallback(startNs, callbackNowNs(), 96);
+  }
+  double seconds =
+      std::chrono::duration<double>(std::chrono::steady_clock::now() - begin)
+          .count();
+  printf("recordCallback() with its two clock reads: %.1f ns\n",
+         seconds * 1e9 / kCallbacks);
+  return 0;
+}
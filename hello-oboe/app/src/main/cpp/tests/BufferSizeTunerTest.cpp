@@ -0,0 +1,118 @@
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#include "BufferSizeTuner.h"
+
+#include <gtest/gtest.h>
+
+#include <random>
+
+#include "SimulatedStream.h"
+
+namespace {
+
+const int32_t kBurst = SimulatedStream::kFramesPerBurst;
+
+class BufferSizeTunerTest : public testing::Test {
+ protected:
+  BufferSizeTunerTest() {
+    mTuner.reset(kBurst, SimulatedStream::kCapacityInFrames,
+                 SimulatedStream::kSampleRate);
+  }
+
+  // Runs the stream for seconds, setting the sizes the tuner returns.
+  // Returns the number of xruns.
+  int32_t run(double seconds, int64_t (*delayNs)(std::mt19937*)) {
+    int32_t xRunsBefore = mStream.xRunCount;
+    int64_t numCallbacks =
+        static_cast<int64_t>(seconds * 1e9 / SimulatedStream::kPeriodNs);
+    for (int64_t i = 0; i < numCallbacks; i++) {
+      int64_t startNs = mStream.nextCallback(delayNs(&mRandom));
+      int32_t size = mTuner.update(startNs, kBurst, mStream.xRunCount,
+                                   mStream.bufferSize);
+      if (size != 0) mStream.bufferSize = size;
+    }
+    return mStream.xRunCount - xRunsBefore;
+  }
+
+  std::mt19937 mRandom{3};
+  SimulatedStream mStream;
+  BufferSizeTuner mTuner;
+};
+
+// The jitter of a quiet device fits in a second burst.
+TEST_F(BufferSizeTunerTest, SettlesAtTwoBurstsWhenQuiet) {
+  run(20.0, quietDelayNs);
+  EXPECT_EQ(mStream.bufferSize, 2 * kBurst);
+}
+
+// A busy device gets a bigger buffer within the first window, and keeps it
+// while busy; it shrinks back once quiet again.
+TEST_F(BufferSizeTunerTest, FollowsTheJitter) {
+  run(20.0, quietDelayNs);
+  int32_t xRuns = run(20.0, busyDelayNs);
+  EXPECT_GE(mStream.bufferSize, 5 * kBurst);
+  EXPECT_LT(xRuns, 5);
+  run(20.0, quietDelayNs);
+  EXPECT_EQ(mStream.bufferSize, 2 * kBurst);
+}
+
+TEST_F(BufferSizeTunerTest, GrowsABurstOnAnXRun) {
+  EXPECT_EQ(mTuner.update(0, kBurst, 0, 2 * kBurst), 0);
+  EXPECT_EQ(mTuner.update(2000000, kBurst, 1, 2 * kBurst), 3 * kBurst);
+  EXPECT_EQ(mTuner.update(4000000, kBurst, 1, 3 * kBurst), 0);
+}
+
+TEST_F(BufferSizeTunerTest, StaysWithinCapacity) {
+  int32_t capacity = SimulatedStream::kCapacityInFrames;
+  EXPECT_EQ(mTuner.update(0, kBurst, 0, capacity), 0);
+  EXPECT_EQ(mTuner.update(2000000, kBurst, 1, capacity), 0);
+
+  // A callback 100 ms late needs more than the capacity.
+  mTuner.update(4000000, kBurst, 1, 2 * kBurst);
+  EXPECT_EQ(mTuner.update(BufferSizeTuner::kWindowNs + 100000000, kBurst, 1,
+                          2 * kBurst),
+            capacity);
+}
+
+// A bigger size is kept for kHoldNs after it was last needed, then goes
+// down a burst per window.
+TEST_F(BufferSizeTunerTest, ShrinksOnlyAfterTheHold) {
+  int32_t size = 6 * kBurst;
+  int64_t startNs = 0;
+  int64_t shrunkAtNs = 0;
+  for (int64_t i = 0; i < 10000 && size > 2 * kBurst; i++) {
+    startNs = i * SimulatedStream::kPeriodNs;
+    int32_t newSize = mTuner.update(startNs, kBurst, 0, size);
+    if (newSize != 0) {
+      EXPECT_EQ(newSize, size - kBurst);
+      if (shrunkAtNs == 0) shrunkAtNs = startNs;
+      size = newSize;
+    }
+  }
+  EXPECT_EQ(size, 2 * kBurst);
+  EXPECT_GE(shrunkAtNs, BufferSizeTuner::kHoldNs);
+  EXPECT_LT(shrunkAtNs, BufferSizeTuner::kHoldNs + BufferSizeTuner::kWindowNs);
+  EXPECT_GE(startNs - shrunkAtNs, 3 * BufferSizeTuner::kWindowNs);
+}
+
+TEST(BufferSizeTunerResetTest, DoesNothingBeforeReset) {
+  BufferSizeTuner tuner;
+  EXPECT_EQ(tuner.update(0, 96, 0, 96), 0);
+  EXPECT_EQ(tuner.update(2000000, 96, 5, 96), 0);
+}
+
+}  // namespace
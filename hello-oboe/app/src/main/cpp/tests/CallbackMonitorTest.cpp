@@ -0,0 +1,111 @@
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#include "CallbackMonitor.h"
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <thread>
+
+namespace {
+
+// 96 frames at 48 kHz last 2 ms.
+const int32_t kFrames = 96;
+const int64_t kPeriodNs = 2000000;
+
+CallbackMonitor::Load loadSince(const CallbackMonitor& monitor,
+                                const CallbackMonitor::Snapshot& previous) {
+  CallbackMonitor::Snapshot current;
+  monitor.snapshot(&current);
+  CallbackMonitor::Load load;
+  CallbackMonitor::summarize(current, previous, &load);
+  return load;
+}
+
+TEST(CallbackMonitorTest, ReportsDutyCyclePercentiles) {
+  CallbackMonitor monitor;
+  for (int i = 0; i < 99; i++) monitor.recordCallback(0, kPeriodNs / 2, kFrames);
+  monitor.recordCallback(0, kPeriodNs * 3 / 2, kFrames);
+  monitor.recordStream(2, 192);
+
+  CallbackMonitor::Load load = loadSince(monitor, {});
+  EXPECT_EQ(load.callbacks, 100u);
+  EXPECT_EQ(load.p50, 52.0f);
+  EXPECT_EQ(load.p99, 52.0f);
+  EXPECT_EQ(load.max, 152.0f);
+  EXPECT_EQ(load.xRuns, 2);
+  EXPECT_EQ(load.bufferSize, 192);
+}
+
+TEST(CallbackMonitorTest, ClampsToTheEndBuckets) {
+  CallbackMonitor monitor;
+  monitor.recordCallback(10, 0, kFrames);
+  monitor.recordCallback(0, 10 * kPeriodNs, kFrames);
+  monitor.recordCallback(0, kPeriodNs, 0);
+
+  CallbackMonitor::Load load = loadSince(monitor, {});
+  EXPECT_EQ(load.callbacks, 2u);
+  EXPECT_EQ(load.p50, 2.0f);
+  EXPECT_EQ(load.max, 202.0f);
+}
+
+TEST(CallbackMonitorTest, SummarizesSinceTheLastSnapshot) {
+  CallbackMonitor monitor;
+  monitor.recordCallback(0, kPeriodNs * 3 / 2, kFrames);
+  monitor.recordStream(1, 96);
+  CallbackMonitor::Snapshot previous;
+  monitor.snapshot(&previous);
+
+  EXPECT_EQ(loadSince(monitor, previous).callbacks, 0u);
+  EXPECT_EQ(loadSince(monitor, previous).max, 0.0f);
+
+  monitor.recordCallback(0, kPeriodNs / 4, kFrames);
+  monitor.recordStream(4, 288);
+  CallbackMonitor::Load load = loadSince(monitor, previous);
+  EXPECT_EQ(load.callbacks, 1u);
+  EXPECT_EQ(load.max, 26.0f);
+  EXPECT_EQ(load.xRuns, 3);
+  EXPECT_EQ(load.bufferSize, 288);
+}
+
+// The audio thread records while the UI thread reads: snapshots only see
+// counts grow.
+TEST(CallbackMonitorTest, ReadsWhileRecording) {
+  CallbackMonitor monitor;
+  std::atomic<bool> done{false};
+  std::thread audio([&] {
+    for (int i = 0; i < 200000; i++) {
+      monitor.recordCallback(0, (i % 100) * kPeriodNs / 50, kFrames);
+      monitor.recordStream(i / 1000, 96);
+    }
+    done = true;
+  });
+  CallbackMonitor::Snapshot previous = {};
+  while (!done) {
+    CallbackMonitor::Snapshot current;
+    monitor.snapshot(&current);
+    CallbackMonitor::Load load;
+    CallbackMonitor::summarize(current, previous, &load);
+    ASSERT_GE(load.xRuns, 0);
+    ASSERT_LE(load.callbacks, 200000u);
+    previous = current;
+  }
+  audio.join();
+  EXPECT_EQ(loadSince(monitor, {}).callbacks, 200000u);
+}
+
+}  // namespace
@@ -0,0 +1,89 @@
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+/*
+ * Time to render a 128 frame stereo callback with OscillatorBank, for 16
+ * and 64 voices of each waveform, against a loop calling sinf() per voice
+ * and per frame, and how many voices that makes one core play in real time.
+ */
+#include <math.h>
+#include <stdio.h>
+
+#include <chrono>
+#include <vector>
+
+#include "OscillatorBank.h"
+
+namespace {
+
+const int32_t kSampleRate = 48000;
+const int32_t kFrames = 128;
+const int32_t kCallbacks = 20000;
+const char* const kWaveformNames[] = {"sine", "saw", "square"};
+
+template <typename Render>
+double secondsPerCallback(Render render) {
+  for (int32_t i = 0; i < 100; i++) render();
+  auto begin = std::chrono::steady_clock::now();
+  for (int32_t i = 0; i < kCallbacks; i++) render();
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() -
+                                       begin)
+             .count() /
+         kCallbacks;
+}
+
+void report(const char* name, int32_t voices, double seconds) {
+  printf("%-18s %2d voices: %6.2f us per callback, %5.0f voices per core\n",
+         name, voices, seconds * 1e6,
+         voices * (static_cast<double>(kFrames) / kSampleRate) / seconds);
+}
+
+}  // namespace
+
+int main() {
+  std::vector<float> output(kFrames * 2);
+  for (int32_t voices : {16, 64}) {
+    for (int32_t waveform = 0; waveform < 3; waveform++) {
+      OscillatorBank bank;
+      bank.setSampleRate(kSampleRate);
+      for (int32_t voice = 0; voice < voices; voice++) {
+        bank.setVoice(voice, static_cast<Waveform>(waveform),
+                      100.0f + voice * 37.0f, 0.01f);
+      }
+      report(kWaveformNames[waveform], voices, secondsPerCallback([&] {
+               bank.render(output.data(), kFrames, 2);
+             }));
+    }
+  }
+
+  const int32_t kVoices = 64;
+  float phases[kVoices] = {};
+  double seconds = secondsPerCallback([&] {
+    for (int32_t frame = 0; frame < kFrames; frame++) {
+      float sum = 0.0f;
+      for (int32_t voice = 0; voice < kVoices; voice++) {
+        sum += 0.01f * sinf(phases[voice]);
+        phases[voice] += 0.05f + voice * 0.001f;
+        if (phases[voice] > 2.0f * static_cast<float>(M_PI)) {
+          phases[voice] -= 2.0f * static_cast<float>(M_PI);
+        }
+      }
+      output[2 * frame] = output[2 * frame + 1] = sum;
+    }
+  });
+  report("sinf() per frame", kVoices, seconds);
+  return output[0] == 12345.0f;
+}
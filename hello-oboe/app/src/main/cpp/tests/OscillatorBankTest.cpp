@@ -0,0 +1,180 @@
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#include "OscillatorBank.h"
+
+#include <gtest/gtest.h>
+#include <math.h>
+
+#include <vector>
+
+#include "ToneAnalysis.h"
+
+namespace {
+
+const int32_t kSampleRate = 48000;
+
+class OscillatorBankTest : public testing::Test {
+ protected:
+  OscillatorBankTest() { mBank.setSampleRate(kSampleRate); }
+
+  // Renders past the first block, where the amplitude ramps up.
+  std::vector<float> renderSettled(int32_t numFrames) {
+    std::vector<float> output(numFrames);
+    mBank.render(output.data(), OscillatorBank::kBlockFrames, 1);
+    mBank.render(output.data(), numFrames, 1);
+    return output;
+  }
+
+  OscillatorBank mBank;
+};
+
+// Same as the bank's saw and square, without the polyBLEP correction.
+std::vector<float> naiveWave(Waveform waveform, double frequency,
+                             int32_t numFrames) {
+  std::vector<float> output(numFrames);
+  double phase = frequency * OscillatorBank::kBlockFrames / kSampleRate;
+  for (float& sample : output) {
+    phase -= floor(phase);
+    if (waveform == Waveform::kSaw) {
+      sample = static_cast<float>(2.0 * phase - 1.0);
+    } else {
+      sample = phase < 0.5 ? 1.0f : -1.0f;
+    }
+    phase += frequency / kSampleRate;
+  }
+  return output;
+}
+
+TEST_F(OscillatorBankTest, IsSilentWithoutVoices) {
+  std::vector<float> output(1000, 1.0f);
+  mBank.render(output.data(), 500, 2);
+  for (float sample : output) EXPECT_EQ(sample, 0.0f);
+}
+
+TEST_F(OscillatorBankTest, RendersASineOnEveryChannel) {
+  mBank.setVoice(0, Waveform::kSine, 440.0f, 0.5f);
+  std::vector<float> output(kSampleRate * 2);
+  mBank.render(output.data(), 100, 2);
+  mBank.render(output.data(), kSampleRate, 2);
+
+  double maxError = 0.0;
+  double startPhase = 440.0 * 100 / kSampleRate;
+  for (int32_t i = 0; i < kSampleRate; i++) {
+    double expected =
+        0.5 * sin(2.0 * M_PI * (startPhase + 440.0 * i / kSampleRate));
+    maxError = fmax(maxError, fabs(output[2 * i] - expected));
+    ASSERT_EQ(output[2 * i], output[2 * i + 1]);
+  }
+  EXPECT_LT(maxError, 1e-3);
+}
+
+TEST_F(OscillatorBankTest, SumsVoices) {
+  mBank.setVoice(0, Waveform::kSine, 1000.0f, 0.25f);
+  mBank.setVoice(5, Waveform::kSine, 3000.0f, 0.125f);
+  std::vector<float> output = renderSettled(8192);
+  EXPECT_NEAR(toneAmplitude(output, 1000.0, kSampleRate), 0.25, 0.01);
+  EXPECT_NEAR(toneAmplitude(output, 3000.0, kSampleRate), 0.125, 0.01);
+  EXPECT_LT(toneAmplitude(output, 2000.0, kSampleRate), 1e-3);
+}
+
+// The amplitude ramps over a block, both ways: no click.
+TEST_F(OscillatorBankTest, RampsAmplitudeChanges) {
+  mBank.setVoice(0, Waveform::kSquare, 375.0f, 1.0f);
+  std::vector<float> output(OscillatorBank::kBlockFrames);
+  mBank.render(output.data(), OscillatorBank::kBlockFrames, 1);
+  for (int32_t i = 0; i < OscillatorBank::kBlockFrames; i++) {
+    EXPECT_LE(fabs(output[i]), (i + 1.0) / OscillatorBank::kBlockFrames + 1e-5);
+  }
+
+  mBank.setAmplitude(0, 0.0f);
+  mBank.render(output.data(), OscillatorBank::kBlockFrames, 1);
+  for (int32_t i = 0; i < OscillatorBank::kBlockFrames; i++) {
+    EXPECT_LE(fabs(output[i]),
+              1.0 - static_cast<double>(i) / OscillatorBank::kBlockFrames +
+                  1e-5);
+  }
+  mBank.render(output.data(), OscillatorBank::kBlockFrames, 1);
+  for (float sample : output) EXPECT_EQ(sample, 0.0f);
+}
+
+// How render() is cut into calls doesn't change the output, but for the
+// rounding of the float phases the blocks start from.
+TEST_F(OscillatorBankTest, RendersTheSameInAnyPieces) {
+  OscillatorBank pieces;
+  pieces.setSampleRate(kSampleRate);
+  for (OscillatorBank* bank : {&mBank, &pieces}) {
+    bank->setVoice(0, Waveform::kSine, 440.0f, 0.3f);
+    bank->setVoice(1, Waveform::kSaw, 1234.5f, 0.3f);
+    bank->setVoice(2, Waveform::kSquare, 98.7f, 0.3f);
+  }
+  std::vector<float> whole = renderSettled(5000);
+  std::vector<float> split(5000);
+  pieces.render(split.data(), OscillatorBank::kBlockFrames, 1);
+  for (int32_t frame = 0, size = 1; frame < 5000; frame += size, size += 7) {
+    size = std::min(size, 5000 - frame);
+    pieces.render(split.data() + frame, size, 1);
+  }
+  for (int32_t i = 0; i < 5000; i++) {
+    ASSERT_NEAR(whole[i], split[i], 1e-3) << "frame " << i;
+  }
+}
+
+TEST_F(OscillatorBankTest, SkipsVoicesItCannotPlay) {
+  mBank.setVoice(-1, Waveform::kSine, 440.0f, 1.0f);
+  mBank.setVoice(OscillatorBank::kMaxVoices, Waveform::kSine, 440.0f, 1.0f);
+  mBank.setVoice(0, Waveform::kSaw, kSampleRate / 2, 1.0f);
+  mBank.setVoice(1, Waveform::kSquare, 0.0f, 1.0f);
+  std::vector<float> output = renderSettled(1000);
+  for (float sample : output) EXPECT_EQ(sample, 0.0f);
+}
+
+class OscillatorBankAliasingTest : public testing::TestWithParam<Waveform> {};
+
+// polyBLEP keeps the fundamental and takes the folded harmonics of a high
+// note well below those of the naive wave.
+TEST_P(OscillatorBankAliasingTest, AliasesLessThanTheNaiveWave) {
+  const double kFundamental = 3150.0;
+  const int32_t kFrames = 1 << 14;
+  OscillatorBank bank;
+  bank.setSampleRate(kSampleRate);
+  bank.setVoice(0, GetParam(), kFundamental, 1.0f);
+  std::vector<float> output(kFrames);
+  bank.render(output.data(), OscillatorBank::kBlockFrames, 1);
+  bank.render(output.data(), kFrames, 1);
+  std::vector<float> naive = naiveWave(GetParam(), kFundamental, kFrames);
+
+  EXPECT_NEAR(toneAmplitude(output, kFundamental, kSampleRate),
+              toneAmplitude(naive, kFundamental, kSampleRate), 0.05);
+  double aliasDb = worstAliasDb(output, kFundamental, kSampleRate);
+  double naiveAliasDb = worstAliasDb(naive, kFundamental, kSampleRate);
+  printf("worst alias %.1f dB, naive %.1f dB\n", aliasDb, naiveAliasDb);
+  EXPECT_LT(aliasDb, naiveAliasDb - 6.0);
+}
+
+INSTANTIATE_TEST_SUITE_P(Waveforms, OscillatorBankAliasingTest,
+                         testing::Values(Waveform::kSaw, Waveform::kSquare));
+
+TEST(ScopedFlushDenormalsTest, FlushesOnlyInScope) {
+  volatile float tiny = 1e-30f;
+  {
+    ScopedFlushDenormals flushDenormals;
+    EXPECT_EQ(tiny * 1e-10f, 0.0f);
+  }
+  EXPECT_NE(tiny * 1e-10f, 0.0f);
+}
+
+}  // namespace
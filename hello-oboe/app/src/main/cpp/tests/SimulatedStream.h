@@ -0,0 +1,62 @@
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#ifndef HELLO_OBOE_SIMULATEDSTREAM_H
+#define HELLO_OBOE_SIMULATEDSTREAM_H
+
+#include <stdint.h>
+
+#include <random>
+
+/*
+ * A stream with bursts of 96 frames at 48 kHz, whose callbacks start on
+ * their ideal schedule plus a random delay. A callback later than the
+ * buffer beyond a burst can cover is an xrun.
+ */
+struct SimulatedStream {
+  static constexpr int32_t kFramesPerBurst = 96;
+  static constexpr int32_t kCapacityInFrames = 16 * kFramesPerBurst;
+  static constexpr int32_t kSampleRate = 48000;
+  static constexpr int64_t kPeriodNs = 2000000;
+  static constexpr int64_t kFirstStartNs = 1000000000;
+
+  int32_t bufferSize = kFramesPerBurst;
+  int32_t xRunCount = 0;
+  int64_t numCallbacks = 0;
+
+  // Start time of the next callback, delayed by delayNs.
+  int64_t nextCallback(int64_t delayNs) {
+    int64_t startNs = kFirstStartNs + numCallbacks++ * kPeriodNs + delayNs;
+    int64_t coveredNs = static_cast<int64_t>(bufferSize - kFramesPerBurst) *
+                        1000000000LL / kSampleRate;
+    if (delayNs > coveredNs) xRunCount++;
+    return startNs;
+  }
+};
+
+/*
+ * Delays of a quiet device, up to 0.5 ms, and of a busy one, up to 3 ms
+ * with a 5 ms stall once every 200 callbacks.
+ */
+inline int64_t quietDelayNs(std::mt19937* random) {
+  return (*random)() % 500000;
+}
+
+inline int64_t busyDelayNs(std::mt19937* random) {
+  return (*random)() % 3000000 + ((*random)() % 200 == 0 ? 5000000 : 0);
+}
+
+#endif  // HELLO_OBOE_SIMULATEDSTREAM_H
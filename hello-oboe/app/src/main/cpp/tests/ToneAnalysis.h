@@ -0,0 +1,59 @@
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#ifndef HELLO_OBOE_TONEANALYSIS_H
+#define HELLO_OBOE_TONEANALYSIS_H
+
+#include <math.h>
+
+#include <complex>
+#include <vector>
+
+/*
+ * Amplitude of the component at frequency in samples, from a single bin of
+ * a Hann windowed DFT: a sine of amplitude 1 reads as 1.
+ */
+inline double toneAmplitude(const std::vector<float>& samples,
+                            double frequency, int32_t sampleRate) {
+  std::complex<double> sum = 0.0;
+  size_t size = samples.size();
+  for (size_t i = 0; i < size; i++) {
+    double window = 0.5 - 0.5 * cos(2.0 * M_PI * i / size);
+    sum += window * samples[i] *
+           std::polar(1.0, -2.0 * M_PI * frequency * i / sampleRate);
+  }
+  return std::abs(sum) / (size / 4.0);
+}
+
+/*
+ * The loudest of the harmonics 8 to 39 of fundamental that fold back below
+ * the Nyquist frequency away from any harmonic, where only aliasing puts
+ * energy, in dB relative to amplitude 1.
+ */
+inline double worstAliasDb(const std::vector<float>& samples,
+                           double fundamental, int32_t sampleRate) {
+  double worst = 0.0;
+  for (int harmonic = 8; harmonic < 40; harmonic++) {
+    double frequency = fmod(harmonic * fundamental, sampleRate);
+    if (frequency > sampleRate / 2) frequency = sampleRate - frequency;
+    double offset = fmod(frequency, fundamental);
+    if (offset < 50.0 || fundamental - offset < 50.0) continue;
+    worst = fmax(worst, toneAmplitude(samples, frequency, sampleRate));
+  }
+  return 20.0 * log10(worst);
+}
+
+#endif  // HELLO_OBOE_TONEANALYSIS_H
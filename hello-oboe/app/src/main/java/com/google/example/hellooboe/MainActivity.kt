@@ -19,14 +19,30 @@ package com.google.example.hellooboe
 
 import androidx.appcompat.app.AppCompatActivity
 import android.os.Bundle
+import android.os.Handler
+import android.os.Looper
 import android.view.MotionEvent
 import android.view.View
 import android.widget.Toast
 import com.google.example.hellooboe.databinding.ActivityMainBinding
+import kotlin.math.pow
 
 class MainActivity : AppCompatActivity() {
 
     private lateinit var binding: ActivityMainBinding
+    private val handler = Handler(Looper.getMainLooper())
+
+    // Shows how busy the audio callback was since the last update.
+    private val showLoad = object : Runnable {
+        override fun run() {
+            val load = takeCallbackLoad() ?: return
+            if (load[0] > 0) {
+                binding.loadText.text = getString(R.string.load_msg,
+                        load[1], load[2], load[3], load[4].toInt(), load[5].toInt())
+            }
+            handler.postDelayed(this, LOAD_UPDATE_MS)
+        }
+    }
 
     override fun onCreate(savedInstanceState: Bundle?) {
         super.onCreate(savedInstanceState)
@@ -37,28 +53,52 @@ class MainActivity : AppCompatActivity() {
 
     /*
     * Hook to user control to start / stop audio playback:
-    *    touch-down: start, and keeps on playing
-    *    touch-up: stop.
+    *    each finger down plays a voice, until it is lifted;
+    *    left to right sets its pitch, top to bottom its waveform.
     * simply pass the events to native side.
     */
     override fun onTouchEvent(event: MotionEvent): Boolean {
         when (event.actionMasked) {
-            MotionEvent.ACTION_DOWN -> playSound(true)
-            MotionEvent.ACTION_UP -> playSound(false)
+            MotionEvent.ACTION_DOWN,
+            MotionEvent.ACTION_POINTER_DOWN,
+            MotionEvent.ACTION_MOVE -> {
+                for (index in 0 until event.pointerCount) {
+                    playVoice(event, index, VOICE_AMPLITUDE)
+                }
+            }
+            MotionEvent.ACTION_POINTER_UP -> playVoice(event, event.actionIndex, 0f)
+            MotionEvent.ACTION_UP,
+            MotionEvent.ACTION_CANCEL -> {
+                for (index in 0 until event.pointerCount) {
+                    playVoice(event, index, 0f)
+                }
+            }
         }
         return super.onTouchEvent(event)
     }
 
+    private fun playVoice(event: MotionEvent, index: Int, amplitude: Float) {
+        val view = binding.root
+        val x = (event.getX(index) / view.width).coerceIn(0f, 1f)
+        val y = (event.getY(index) / view.height).coerceIn(0f, 0.999f)
+        val frequency = LOWEST_FREQUENCY * 2.0.pow(OCTAVES * x.toDouble())
+        setVoice(event.getPointerId(index), (y * WAVEFORMS).toInt(),
+                 frequency.toFloat(), amplitude)
+    }
+
     override fun onResume() {
         super.onResume()
         if (createStream() != 0) {
             val errorString : String = getString(R.string.error_msg)
             Toast.makeText(applicationContext, errorString,Toast.LENGTH_LONG).show()
             binding.sampleText.text = errorString
+        } else {
+            handler.postDelayed(showLoad, LOAD_UPDATE_MS)
         }
     }
 
     override fun onPause() {
+        handler.removeCallbacks(showLoad)
         destroyStream()
         super.onPause()
     }
@@ -69,10 +109,23 @@ class MainActivity : AppCompatActivity() {
     // Closes and destroys Oboe stream when app goes out of focus
     private external fun destroyStream()
 
-    // Plays sound on user tap
-    private external fun playSound(enable: Boolean) : Int
+    // Plays a voice on user tap, silent at amplitude 0
+    private external fun setVoice(voice: Int, waveform: Int, frequency: Float,
+                                  amplitude: Float) : Int
+
+    // Callback load since the last call: callbacks, duty cycle p50, p99 and
+    // max in percent, xruns and buffer size in frames
+    private external fun takeCallbackLoad() : FloatArray?
 
     companion object {
+        // Voices span 4 octaves up from A2, and the screen is split in a
+        // band per waveform: sine, saw and square.
+        private const val LOWEST_FREQUENCY = 110.0
+        private const val OCTAVES = 4.0
+        private const val WAVEFORMS = 3
+        private const val VOICE_AMPLITUDE = 0.2f
+        private const val LOAD_UPDATE_MS = 1000L
+
         // Used to load native code calling oboe on app startup.
         init {
             System.loadLibrary("hello-oboe")
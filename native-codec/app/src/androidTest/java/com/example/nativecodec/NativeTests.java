@@ -0,0 +1,25 @@
+/*
+ * Copyright (C) 2014 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+package com.example.nativecodec;
+
+import androidx.test.ext.junitgtest.GtestRunner;
+import androidx.test.ext.junitgtest.TargetLibrary;
+import org.junit.runner.RunWith;
+
+/** Runs the googletest cases of libapp_tests.so on the device. */
+@RunWith(GtestRunner.class)
+@TargetLibrary(libraryName = "app_tests")
+public class NativeTests {}
@@ -0,0 +1,354 @@
+/*
+ * Copyright (C) 2014 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "async_decoder.h"
+
+#include <string.h>
+
+AsyncDecoder::AsyncDecoder(SampleSource* source, CodecPort* codec,
+                           PresentTimer* timer, int lookahead)
+    : source(source),
+      codec(codec),
+      timer(timer),
+      scheduler(NULL),
+      streamId(-1),
+      running(false),
+      samples(lookahead),
+      readySamples(lookahead),
+      readyHead(0),
+      readyCount(0),
+      inputHead(0),
+      inputCount(0),
+      inputEOS(false),
+      lastReadUs(0),
+      frameHead(0),
+      frameCount(0),
+      outputEOS(false),
+      generation(0),
+      seekPending(false),
+      seekTargetUs(0),
+      skipUntilUs(INT64_MIN),
+      skipBudget(-1),
+      seekIndex(NULL),
+      flushing(false),
+      playing(false),
+      renderOnce(true),
+      renderStartNs(-1),
+      wakeNs(-1),
+      stats() {
+  freeSamples.reserve(lookahead);
+  for (int i = 0; i < lookahead; i++) freeSamples.push_back(i);
+}
+
+AsyncDecoder::~AsyncDecoder() { stop(); }
+
+bool AsyncDecoder::setScheduler(DecodeScheduler* s) {
+  std::lock_guard<std::mutex> l(lock);
+  if (running) return false;
+  streamId = s->add(this);
+  if (streamId < 0) return false;
+  scheduler = s;
+  return true;
+}
+
+void AsyncDecoder::start() {
+  std::lock_guard<std::mutex> l(lock);
+  if (running) return;
+  running = true;
+  if (scheduler) {
+    wakeReaderLocked();
+  } else {
+    extractor = std::thread(&AsyncDecoder::extractorLoop, this);
+  }
+}
+
+void AsyncDecoder::stop() {
+  DecodeScheduler* s;
+  {
+    std::lock_guard<std::mutex> l(lock);
+    if (!running && !scheduler) return;
+    running = false;
+    s = scheduler;
+    scheduler = NULL;
+  }
+  if (s) {
+    // also when never started, the stream was registered by setScheduler()
+    s->remove(streamId);
+    return;
+  }
+  cond.notify_all();
+  extractor.join();
+}
+
+bool AsyncDecoder::readableLocked() {
+  return seekPending || (!inputEOS && !freeSamples.empty());
+}
+
+int64_t AsyncDecoder::readDeadlineLocked() {
+  if (!readableLocked()) return DecodeScheduler::kIdle;
+  // nothing on screen to pace against yet: as soon as possible
+  if (seekPending || renderStartNs < 0) return 0;
+  return renderStartNs + lastReadUs * 1000;
+}
+
+void AsyncDecoder::wakeReaderLocked() {
+  if (!running) return;
+  if (scheduler) {
+    scheduler->wake(streamId, readDeadlineLocked());
+  } else {
+    cond.notify_all();
+  }
+}
+
+void AsyncDecoder::extractorLoop() {
+  while (true) {
+    {
+      std::unique_lock<std::mutex> l(lock);
+      cond.wait(l, [this] { return !running || readableLocked(); });
+      if (!running) return;
+    }
+    run();
+  }
+}
+
+int64_t AsyncDecoder::run() {
+  std::unique_lock<std::mutex> l(lock);
+  if (seekPending) {
+    seekPending = false;
+    int64_t target = seekTargetUs;
+    const SeekIndex::Entry* sync = seekIndex ? seekIndex->find(target) : NULL;
+    if (sync) {
+      target = sync->ptsUs;
+      skipBudget = sync->samples - 1;
+    }
+    l.unlock();
+    source->seekTo(target);
+    l.lock();
+    return readDeadlineLocked();
+  }
+  if (!readableLocked()) return DecodeScheduler::kIdle;
+
+  int slot = freeSamples.back();
+  freeSamples.pop_back();
+  uint64_t gen = generation;
+  Sample& s = samples[slot];
+  l.unlock();
+
+  // only one reader at a time touches a sample between free and ready
+  ssize_t size = source->sampleSize();
+  if (size > 0 && static_cast<size_t>(size) > s.data.size()) {
+    s.data.resize(size);
+  }
+  int64_t ptsUs = 0;
+  ssize_t read = -1;
+  if (size >= 0) {
+    read = source->readSample(s.data.data(), s.data.size(), &ptsUs);
+  }
+  s.eos = read < 0;
+  s.size = s.eos ? 0 : read;
+  s.ptsUs = s.eos ? 0 : ptsUs;
+
+  l.lock();
+  if (gen != generation) {
+    // a seek happened while reading, the sample belongs to the old position
+    freeSamples.push_back(slot);
+    return readDeadlineLocked();
+  }
+  stats.samplesRead++;
+  if (s.eos) {
+    inputEOS = true;
+  } else {
+    lastReadUs = s.ptsUs;
+  }
+  readySamples[(readyHead + readyCount) % readySamples.size()] = slot;
+  readyCount++;
+  feedLocked();
+  return readDeadlineLocked();
+}
+
+/*
+ * Hand ready samples to free codec input buffers. Runs with the lock held on
+ * whichever thread supplied the missing half of a pair.
+ */
+void AsyncDecoder::feedLocked() {
+  bool returned = false;
+  while (readyCount > 0 && inputCount > 0 && !flushing) {
+    int slot = readySamples[readyHead];
+    readyHead = (readyHead + 1) % readySamples.size();
+    readyCount--;
+    size_t index = inputs[inputHead];
+    inputHead = (inputHead + 1) % kMaxPendingInputs;
+    inputCount--;
+
+    Sample& s = samples[slot];
+    size_t capacity = 0;
+    uint8_t* buf = codec->getInputBuffer(index, &capacity);
+    size_t size = s.size < capacity ? s.size : capacity;
+    if (buf && size) memcpy(buf, s.data.data(), size);
+    codec->queueInputBuffer(index, size, s.ptsUs, s.eos);
+
+    freeSamples.push_back(slot);
+    returned = true;
+  }
+  if (returned) wakeReaderLocked();
+}
+
+void AsyncDecoder::onInputAvailable(size_t index) {
+  std::lock_guard<std::mutex> l(lock);
+  if (flushing || inputCount == kMaxPendingInputs) return;
+  inputs[(inputHead + inputCount) % kMaxPendingInputs] = index;
+  inputCount++;
+  if (readyCount == 0 && !inputEOS) stats.inputUnderruns++;
+  feedLocked();
+}
+
+void AsyncDecoder::onOutputAvailable(size_t index, int64_t ptsUs, size_t size,
+                                     bool eos) {
+  std::lock_guard<std::mutex> l(lock);
+  if (flushing) return;
+  if (frameCount == kMaxPendingOutputs) {
+    // more outputs than the codec should ever hand out, don't hold this one
+    codec->releaseOutputBuffer(index, false, 0);
+    stats.framesDropped++;
+    return;
+  }
+  frames[(frameHead + frameCount) % kMaxPendingOutputs] = {index, ptsUs, size,
+                                                           eos};
+  frameCount++;
+  if (frameCount > 1 || (!playing && !renderOnce)) return;
+  if (renderStartNs < 0) {
+    scheduleLocked(0);
+  } else {
+    scheduleLocked(renderStartNs + ptsUs * 1000 - kRenderLeadNs);
+  }
+}
+
+void AsyncDecoder::scheduleLocked(int64_t whenNs) {
+  if (wakeNs >= 0 && wakeNs <= whenNs) return;
+  wakeNs = whenNs;
+  timer->wakeAt(whenNs);
+}
+
+void AsyncDecoder::present(int64_t nowNs) {
+  std::lock_guard<std::mutex> l(lock);
+  wakeNs = -1;
+  while (frameCount > 0 && (playing || renderOnce)) {
+    Frame& f = frames[frameHead];
+    if (skipUntilUs != INT64_MIN) {
+      if (!f.eos && f.ptsUs < skipUntilUs && skipBudget != 0) {
+        codec->releaseOutputBuffer(f.index, false, 0);
+        stats.framesSkipped++;
+        if (skipBudget > 0) skipBudget--;
+        frameHead = (frameHead + 1) % kMaxPendingOutputs;
+        frameCount--;
+        continue;
+      }
+      skipUntilUs = INT64_MIN;
+    }
+    if (renderStartNs < 0) {
+      // (re)starting: show this frame now and pace the following ones from it
+      renderStartNs = nowNs - f.ptsUs * 1000;
+    }
+    int64_t renderNs = renderStartNs + f.ptsUs * 1000;
+    if (renderNs - kRenderLeadNs > nowNs) {
+      scheduleLocked(renderNs - kRenderLeadNs);
+      break;
+    }
+    bool late = f.size != 0 && !renderOnce && nowNs > renderNs + kLateNs;
+    bool render = f.size != 0 && !late;
+    codec->releaseOutputBuffer(f.index, render, renderNs);
+    if (render) {
+      stats.framesRendered++;
+    } else if (late) {
+      stats.framesDropped++;
+    }
+    if (f.eos) outputEOS = true;
+    frameHead = (frameHead + 1) % kMaxPendingOutputs;
+    frameCount--;
+    if (renderOnce && render) {
+      renderOnce = false;
+      if (!playing) renderStartNs = -1;
+    }
+  }
+}
+
+void AsyncDecoder::pause() {
+  std::lock_guard<std::mutex> l(lock);
+  playing = false;
+}
+
+void AsyncDecoder::resume() {
+  std::lock_guard<std::mutex> l(lock);
+  if (playing) return;
+  playing = true;
+  renderStartNs = -1;
+  if (frameCount > 0) scheduleLocked(0);
+  wakeReaderLocked();
+}
+
+void AsyncDecoder::seekTo(int64_t ptsUs) {
+  {
+    std::lock_guard<std::mutex> l(lock);
+    // everything queued refers to the old position or to buffers the flush
+    // below takes back
+    generation++;
+    flushing = true;
+    while (readyCount > 0) {
+      freeSamples.push_back(readySamples[readyHead]);
+      readyHead = (readyHead + 1) % readySamples.size();
+      readyCount--;
+    }
+    inputCount = 0;
+    frameCount = 0;
+    inputEOS = false;
+    outputEOS = false;
+    seekPending = true;
+    seekTargetUs = ptsUs;
+    skipUntilUs = ptsUs;
+    skipBudget = -1;
+    renderStartNs = -1;
+    if (!playing) renderOnce = true;
+    wakeReaderLocked();
+  }
+
+  // the codec may be blocked delivering a callback, so flush without the lock
+  codec->flush();
+  {
+    std::lock_guard<std::mutex> l(lock);
+    flushing = false;
+  }
+  codec->start();
+}
+
+void AsyncDecoder::setSeekIndex(const SeekIndex* index) {
+  std::lock_guard<std::mutex> l(lock);
+  seekIndex = index;
+}
+
+bool AsyncDecoder::isPlaying() {
+  std::lock_guard<std::mutex> l(lock);
+  return playing;
+}
+
+bool AsyncDecoder::sawOutputEOS() {
+  std::lock_guard<std::mutex> l(lock);
+  return outputEOS;
+}
+
+AsyncDecoderStats AsyncDecoder::getStats() {
+  std::lock_guard<std::mutex> l(lock);
+  return stats;
+}
@@ -0,0 +1,213 @@
+/*
+ * Copyright (C) 2014 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef NATIVE_CODEC_ASYNC_DECODER_H
+#define NATIVE_CODEC_ASYNC_DECODER_H
+
+#include <stdint.h>
+#include <sys/types.h>
+
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "decode_scheduler.h"
+#include "seek_index.h"
+
+/*
+ * The decoder only talks to the media framework through the three small
+ * interfaces below, so the queueing and presentation logic runs (and can be
+ * exercised with fakes) without the NDK media libraries.
+ */
+
+// Compressed samples, i.e. AMediaExtractor
+class SampleSource {
+ public:
+  virtual ~SampleSource() {}
+  // Size of the next sample, or -1 at the end of the stream
+  virtual ssize_t sampleSize() = 0;
+  // Copy the next sample into buf and advance. Returns its size, or -1 at
+  // the end of the stream.
+  virtual ssize_t readSample(uint8_t* buf, size_t capacity,
+                             int64_t* ptsUs) = 0;
+  virtual void seekTo(int64_t ptsUs) = 0;
+};
+
+// A codec running in asynchronous mode, i.e. AMediaCodec
+class CodecPort {
+ public:
+  virtual ~CodecPort() {}
+  virtual uint8_t* getInputBuffer(size_t index, size_t* capacity) = 0;
+  virtual void queueInputBuffer(size_t index, size_t size, int64_t ptsUs,
+                                bool eos) = 0;
+  // Give an output buffer back, to be displayed at CLOCK_MONOTONIC renderNs
+  virtual void releaseOutputBuffer(size_t index, bool render,
+                                   int64_t renderNs) = 0;
+  virtual void flush() = 0;
+  virtual void start() = 0;
+};
+
+// Calls AsyncDecoder::present() again at (or after) whenNs
+class PresentTimer {
+ public:
+  virtual ~PresentTimer() {}
+  virtual void wakeAt(int64_t whenNs) = 0;
+};
+
+struct AsyncDecoderStats {
+  uint64_t samplesRead;
+  uint64_t inputUnderruns;  // codec asked for input, no sample was ready
+  uint64_t framesRendered;
+  uint64_t framesDropped;  // too late to be worth displaying
+  uint64_t framesSkipped;  // only decoded to get to a seek position
+};
+
+/*
+ * AsyncDecoder feeds a codec from its own extractor thread and schedules
+ * decoded frames on the monotonic clock:
+ *   - the extractor thread reads up to `lookahead` samples ahead into reused
+ *     buffers; onInputAvailable() and the extractor thread pair codec input
+ *     buffers with ready samples, whichever comes last.
+ *   - decoded frames are held until kRenderLeadNs before their display time,
+ *     then released with that timestamp, so the display does the final
+ *     pacing and nobody sleeps.
+ * Reading happens on a thread of its own, or as a stream of a DecodeScheduler
+ * shared with other decoders; then its deadline is the display time of the
+ * newest sample read, so the stream with the least buffered reads first.
+ * onInputAvailable()/onOutputAvailable() are called from the codec callback
+ * thread, everything else from the thread the PresentTimer wakes up.
+ */
+class AsyncDecoder : public DecodeTask {
+ public:
+  // how long before its display time a frame is handed to the display
+  static const int64_t kRenderLeadNs = 20000000;
+  // frames later than this are dropped instead of displayed
+  static const int64_t kLateNs = 50000000;
+  static const int kMaxPendingInputs = 64;
+  static const int kMaxPendingOutputs = 64;
+
+  AsyncDecoder(SampleSource* source, CodecPort* codec, PresentTimer* timer,
+               int lookahead = 8);
+  ~AsyncDecoder();
+  AsyncDecoder(const AsyncDecoder&) = delete;
+  AsyncDecoder& operator=(const AsyncDecoder&) = delete;
+
+  // Read ahead on the scheduler's workers instead of a thread of our own.
+  // Must be called before start().
+  bool setScheduler(DecodeScheduler* scheduler);
+  int getStreamId() { return streamId; }
+
+  // start/stop reading ahead
+  void start();
+  void stop();
+
+  // Read one sample ahead. Returns the deadline for the next one, or
+  // DecodeScheduler::kIdle until a sample is consumed or a seek happens.
+  int64_t run() override;
+
+  // codec callbacks
+  void onInputAvailable(size_t index);
+  void onOutputAvailable(size_t index, int64_t ptsUs, size_t size, bool eos);
+
+  // Release every frame due at nowNs, and ask the timer for the next one
+  void present(int64_t nowNs);
+
+  void pause() override;
+  void resume() override;
+  // Continue with the frame at ptsUs: decoding restarts at the sync sample
+  // before it, and the frames in between are decoded and dropped. While
+  // paused the frame is displayed anyway.
+  void seekTo(int64_t ptsUs) override;
+  // Where seeks restart decoding, and how many frames they may drop before
+  // one is shown: a target past the last frame of its sync sample (e.g.
+  // beyond the end) then shows that last frame. Without an index, the source
+  // is asked for the sync sample itself and frames are dropped by pts only.
+  void setSeekIndex(const SeekIndex* index);
+  bool isPlaying();
+  bool sawOutputEOS();
+  AsyncDecoderStats getStats();
+
+ private:
+  struct Sample {
+    std::vector<uint8_t> data;
+    size_t size;
+    int64_t ptsUs;
+    bool eos;
+  };
+  struct Frame {
+    size_t index;
+    int64_t ptsUs;
+    size_t size;
+    bool eos;
+  };
+
+  void extractorLoop();
+  bool readableLocked();
+  int64_t readDeadlineLocked();
+  void wakeReaderLocked();
+  void feedLocked();
+  void scheduleLocked(int64_t whenNs);
+
+  SampleSource* source;
+  CodecPort* codec;
+  PresentTimer* timer;
+
+  std::mutex lock;
+  std::condition_variable cond;
+  std::thread extractor;
+  DecodeScheduler* scheduler;
+  int streamId;
+  bool running;
+
+  // input side: samples go round free -> ready -> codec -> free
+  std::vector<Sample> samples;
+  std::vector<int> freeSamples;
+  std::vector<int> readySamples;  // ring, oldest at readyHead
+  int readyHead;
+  int readyCount;
+  size_t inputs[kMaxPendingInputs];  // ring of codec input buffers
+  int inputHead;
+  int inputCount;
+  bool inputEOS;
+  int64_t lastReadUs;
+
+  // output side: frames in presentation order
+  Frame frames[kMaxPendingOutputs];
+  int frameHead;
+  int frameCount;
+  bool outputEOS;
+
+  // bumped by seekTo(), so the extractor drops samples it was reading
+  uint64_t generation;
+  bool seekPending;
+  int64_t seekTargetUs;
+  int64_t skipUntilUs;  // drop frames before this after a seek
+  // frames that may still be dropped for it, -1 if unknown: the samples of
+  // the indexed sync sample but the last one, which is shown at worst
+  int64_t skipBudget;
+  const SeekIndex* seekIndex;
+  bool flushing;
+
+  bool playing;
+  bool renderOnce;
+  int64_t renderStartNs;  // display time of pts 0, -1 to anchor on next frame
+  int64_t wakeNs;         // earliest present() already asked for, -1 if none
+
+  AsyncDecoderStats stats;
+};
+
+#endif  // NATIVE_CODEC_ASYNC_DECODER_H
@@ -0,0 +1,181 @@
+/*
+ * Copyright (C) 2014 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "decode_scheduler.h"
+
+#include <time.h>
+
+int64_t DecodeScheduler::now() {
+  timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+DecodeScheduler::DecodeScheduler(int count) : streams(), quit(false) {
+  if (count < 1) count = 1;
+  for (int i = 0; i < count; i++) {
+    workers.emplace_back(&DecodeScheduler::workerLoop, this);
+  }
+}
+
+DecodeScheduler::~DecodeScheduler() {
+  {
+    std::lock_guard<std::mutex> l(lock);
+    quit = true;
+  }
+  cond.notify_all();
+  for (auto& t : workers) t.join();
+}
+
+int DecodeScheduler::add(DecodeTask* task) {
+  std::lock_guard<std::mutex> l(lock);
+  for (int id = 0; id < kMaxStreams; id++) {
+    if (streams[id].task) continue;
+    streams[id] = Stream();
+    streams[id].task = task;
+    streams[id].deadline = kIdle;
+    return id;
+  }
+  return -1;
+}
+
+void DecodeScheduler::remove(int id) {
+  std::unique_lock<std::mutex> l(lock);
+  Stream& s = streams[id];
+  s.ready = false;
+  s.ops = 0;
+  cond.wait(l, [&s] { return !s.running; });
+  s.task = NULL;
+}
+
+void DecodeScheduler::wake(int id, int64_t deadlineNs) {
+  if (deadlineNs == kIdle) return;
+  std::lock_guard<std::mutex> l(lock);
+  Stream& s = streams[id];
+  if (!s.task) return;
+  if (!s.ready || deadlineNs < s.deadline) s.deadline = deadlineNs;
+  s.ready = true;
+  // a running stream is picked up again by its worker when run() returns
+  if (!s.running) cond.notify_one();
+}
+
+void DecodeScheduler::requestLocked(int id, int op) {
+  Stream& s = streams[id];
+  if (!s.task) return;
+  s.ops |= op;
+  if (!s.running) cond.notify_one();
+}
+
+void DecodeScheduler::pause(int id) {
+  std::lock_guard<std::mutex> l(lock);
+  streams[id].paused = true;
+  requestLocked(id, kOpPause);
+}
+
+void DecodeScheduler::resume(int id) {
+  std::lock_guard<std::mutex> l(lock);
+  streams[id].paused = false;
+  requestLocked(id, kOpResume);
+}
+
+void DecodeScheduler::seek(int id, int64_t ptsUs) {
+  std::lock_guard<std::mutex> l(lock);
+  streams[id].seekUs = ptsUs;
+  requestLocked(id, kOpSeek);
+}
+
+DecodeStreamStats DecodeScheduler::getStats(int id) {
+  std::lock_guard<std::mutex> l(lock);
+  return streams[id].stats;
+}
+
+/*
+ * Earliest deadline first among the streams nobody is running. Pending
+ * pause/resume/seek requests come before any deadline.
+ */
+int DecodeScheduler::pickLocked() {
+  int best = -1;
+  int64_t bestDeadline = kIdle;
+  for (int id = 0; id < kMaxStreams; id++) {
+    Stream& s = streams[id];
+    if (!s.task || s.running) continue;
+    int64_t deadline = kIdle;
+    if (s.ops) {
+      deadline = INT64_MIN;
+    } else if (s.ready && !s.paused) {
+      deadline = s.deadline;
+    }
+    if (deadline < bestDeadline) {
+      best = id;
+      bestDeadline = deadline;
+    }
+  }
+  return best;
+}
+
+void DecodeScheduler::workerLoop() {
+  std::unique_lock<std::mutex> l(lock);
+  while (!quit) {
+    int id = pickLocked();
+    if (id < 0) {
+      cond.wait(l);
+      continue;
+    }
+    Stream& s = streams[id];
+    DecodeTask* task = s.task;
+    int ops = s.ops;
+    int64_t seekUs = s.seekUs;
+    bool paused = s.paused;
+    bool run = s.ready && !paused;
+    int64_t deadline = s.deadline;
+    s.ops = 0;
+    if (run) s.ready = false;
+    s.running = true;
+    l.unlock();
+
+    // pause/resume requests collapse into the latest state
+    if (ops & (kOpPause | kOpResume)) {
+      if (paused) {
+        task->pause();
+      } else {
+        task->resume();
+      }
+    }
+    if (ops & kOpSeek) task->seekTo(seekUs);
+    int64_t next = kIdle;
+    int64_t lateness = 0;
+    if (run) {
+      lateness = now() - deadline;
+      next = task->run();
+    }
+
+    l.lock();
+    s.running = false;
+    if (run) {
+      s.stats.runs++;
+      if (lateness > 0) {
+        s.stats.lateRuns++;
+        if (lateness > s.stats.maxLatenessNs) s.stats.maxLatenessNs = lateness;
+      }
+    }
+    if (s.task && next != kIdle) {
+      if (!s.ready || next < s.deadline) s.deadline = next;
+      s.ready = true;
+    }
+    // remove() may be waiting, and this stream may be runnable again
+    cond.notify_all();
+  }
+}
@@ -0,0 +1,114 @@
+/*
+ * Copyright (C) 2014 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef NATIVE_CODEC_DECODE_SCHEDULER_H
+#define NATIVE_CODEC_DECODE_SCHEDULER_H
+
+#include <stdint.h>
+
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/*
+ * One decode session as seen by the scheduler. The scheduler never calls
+ * into a task from two threads at once, so tasks need no locking of their
+ * own against these calls.
+ */
+class DecodeTask {
+ public:
+  virtual ~DecodeTask() {}
+  // Do one short piece of work (e.g. read one sample). Returns the
+  // CLOCK_MONOTONIC deadline of the next piece, or DecodeScheduler::kIdle
+  // if there is nothing to do until the task calls DecodeScheduler::wake().
+  virtual int64_t run() = 0;
+  virtual void pause() = 0;
+  virtual void resume() = 0;
+  virtual void seekTo(int64_t ptsUs) = 0;
+};
+
+struct DecodeStreamStats {
+  uint64_t runs;
+  uint64_t lateRuns;  // started after their deadline
+  int64_t maxLatenessNs;
+};
+
+/*
+ * DecodeScheduler shares a fixed pool of worker threads between decode
+ * streams, earliest deadline first. Streams that are paused or idle cost
+ * nothing; pause/resume/seek requests are queued and applied by a worker
+ * between two run() calls of that stream, ahead of any deadline.
+ * Streams are few (thumbnail grids, picture in picture), so picking the next
+ * one is a plain scan rather than a priority queue.
+ */
+class DecodeScheduler {
+ public:
+  static const int64_t kIdle = INT64_MAX;
+  static const int kMaxStreams = 32;
+
+  explicit DecodeScheduler(int workers);
+  ~DecodeScheduler();
+  DecodeScheduler(const DecodeScheduler&) = delete;
+  DecodeScheduler& operator=(const DecodeScheduler&) = delete;
+
+  // Returns the stream id, or -1 if there are kMaxStreams streams already.
+  // The stream starts idle, call wake() to get it going.
+  int add(DecodeTask* task);
+  // Blocks until the task is not running anymore
+  void remove(int id);
+
+  // The stream has work due by deadlineNs. Callable from any thread,
+  // including from the task itself.
+  void wake(int id, int64_t deadlineNs);
+
+  void pause(int id);
+  void resume(int id);
+  void seek(int id, int64_t ptsUs);
+
+  DecodeStreamStats getStats(int id);
+
+  static int64_t now();
+
+ private:
+  enum {
+    kOpPause = 1,
+    kOpResume = 2,
+    kOpSeek = 4,
+  };
+  struct Stream {
+    DecodeTask* task;
+    bool ready;        // has work, deadline is valid
+    bool running;      // a worker is inside the task
+    bool paused;
+    int64_t deadline;  // of the pending work
+    int ops;           // kOp* to apply before the next run
+    int64_t seekUs;
+    DecodeStreamStats stats;
+  };
+
+  void workerLoop();
+  int pickLocked();
+  void requestLocked(int id, int op);
+
+  std::mutex lock;
+  std::condition_variable cond;
+  std::vector<std::thread> workers;
+  Stream streams[kMaxStreams];
+  bool quit;
+};
+
+#endif  // NATIVE_CODEC_DECODE_SCHEDULER_H
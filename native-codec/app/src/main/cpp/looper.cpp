@@ -16,42 +16,84 @@
 
 #include "looper.h"
 
-#include <assert.h>
 #include <errno.h>
-#include <fcntl.h>
-#include <jni.h>
-#include <limits.h>
+#include <poll.h>
 #include <pthread.h>
-#include <semaphore.h>
 #include <stdio.h>
 #include <string.h>
-#include <sys/stat.h>
-#include <sys/types.h>
+#include <sys/eventfd.h>
+#include <time.h>
 #include <unistd.h>
 
+#include <algorithm>
+
+#ifdef __ANDROID__
 // for __android_log_print(ANDROID_LOG_INFO, "YourApp", "formatted message");
 #include <android/log.h>
 #define TAG "NativeCodec-looper"
 #define LOGV(...) __android_log_print(ANDROID_LOG_VERBOSE, TAG, __VA_ARGS__)
+#else
+#define LOGV(...) ((void)0)
+#endif
+
+static const uint32_t kNoIndex = UINT32_MAX;
 
-struct loopermessage;
-typedef struct loopermessage loopermessage;
+enum msgkind : int32_t {
+  kMessage,
+  kFlush,
+  kQuit,
+};
 
 struct loopermessage {
+  std::atomic<loopermessage *> next;  // MPSC queue link
+  uint32_t index;                     // slot in the pool, kNoIndex if none
+  std::atomic<uint32_t> freenext;     // free list link
+  msgkind kind;
   int what;
   void *obj;
-  loopermessage *next;
-  bool quit;
+  int64_t when;
+  uint64_t seq;
 };
 
+static inline uint64_t packfree(uint32_t index, uint32_t tag) {
+  return (static_cast<uint64_t>(tag) << 32) | index;
+}
+
+// min-heap order for std::push_heap & co, which build max-heaps
+static bool later(const loopermessage *a, const loopermessage *b) {
+  if (a->when != b->when) return a->when > b->when;
+  return a->seq > b->seq;
+}
+
+int64_t looper::now() {
+  timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
 void *looper::trampoline(void *p) {
   ((looper *)p)->loop();
   return NULL;
 }
 
-looper::looper() {
-  sem_init(&headdataavailable, 0, 0);
-  sem_init(&headwriteprotect, 0, 1);
+looper::looper() : seq(0), sleeping(false) {
+  // one extra slot serves as the queue stub
+  pool = new loopermessage[kPoolSize + 1];
+  for (uint32_t i = 0; i <= kPoolSize; i++) {
+    pool[i].next.store(NULL, std::memory_order_relaxed);
+    pool[i].index = i;
+    pool[i].freenext.store((i + 1 < kPoolSize) ? i + 1 : kNoIndex,
+                           std::memory_order_relaxed);
+  }
+  freelist.store(packfree(0, 0));
+
+  stub = &pool[kPoolSize];
+  head = stub;
+  tail.store(stub);
+
+  pending.reserve(kPoolSize);
+  wakefd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+
   pthread_attr_t attr;
   pthread_attr_init(&attr);
 
@@ -66,84 +108,224 @@ looper::~looper() {
         "processed");
     quit();
   }
+  // messages posted after quit() never reached the worker
+  loopermessage *msg;
+  while ((msg = dequeue()) != NULL) recycle(msg);
+  close(wakefd);
+  delete[] pool;
+}
+
+/*
+ * Take a message from the pool (Treiber stack, tagged against ABA).
+ * If every message is pending, allocate one: waiting for the worker to
+ * return one would never end when the worker itself posts from handle().
+ */
+loopermessage *looper::obtain() {
+  uint64_t top = freelist.load(std::memory_order_acquire);
+  while (true) {
+    uint32_t index = static_cast<uint32_t>(top);
+    if (index == kNoIndex) {
+      loopermessage *msg = new loopermessage;
+      msg->index = kNoIndex;
+      return msg;
+    }
+    uint64_t newtop = packfree(
+        pool[index].freenext.load(std::memory_order_relaxed), (top >> 32) + 1);
+    if (freelist.compare_exchange_weak(top, newtop,
+                                       std::memory_order_acquire)) {
+      return &pool[index];
+    }
+  }
+}
+
+void looper::recycle(loopermessage *msg) {
+  if (msg->index == kNoIndex) {
+    delete msg;
+    return;
+  }
+  uint64_t top = freelist.load(std::memory_order_relaxed);
+  do {
+    msg->freenext.store(static_cast<uint32_t>(top),
+                        std::memory_order_relaxed);
+  } while (!freelist.compare_exchange_weak(
+      top, packfree(msg->index, (top >> 32) + 1), std::memory_order_release,
+      std::memory_order_relaxed));
+}
+
+void looper::enqueue(loopermessage *msg) {
+  msg->next.store(NULL, std::memory_order_relaxed);
+  // seq_cst pairs with wait(): either the worker sees this message when it
+  // re-checks the queue, or we see it sleeping and ring the eventfd
+  loopermessage *prev = tail.exchange(msg);
+  prev->next.store(msg, std::memory_order_release);
+
+  if (sleeping.exchange(false)) {
+    uint64_t one = 1;
+    write(wakefd, &one, sizeof(one));
+  }
+}
+
+/*
+ * Worker only: pop the oldest message pushed by producers, or NULL if
+ * there is none (or a producer is halfway through a push).
+ */
+loopermessage *looper::dequeue() {
+  loopermessage *h = head;
+  loopermessage *next = h->next.load(std::memory_order_acquire);
+  if (h == stub) {
+    if (!next) return NULL;
+    head = next;
+    h = next;
+    next = next->next.load(std::memory_order_acquire);
+  }
+  if (next) {
+    head = next;
+    return h;
+  }
+  if (h != tail.load(std::memory_order_acquire)) return NULL;
+
+  // h is the last message: put the stub behind it so it can be detached
+  stub->next.store(NULL, std::memory_order_relaxed);
+  loopermessage *prev = tail.exchange(stub, std::memory_order_acq_rel);
+  prev->next.store(stub, std::memory_order_release);
+  next = h->next.load(std::memory_order_acquire);
+  if (next) {
+    head = next;
+    return h;
+  }
+  return NULL;
 }
 
 void looper::post(int what, void *data, bool flush) {
-  loopermessage *msg = new loopermessage();
+  if (flush) this->flush(kAllMessages);
+  postAt(what, data, now());
+}
+
+void looper::postDelayed(int what, void *data, int64_t delayNs) {
+  postAt(what, data, now() + delayNs);
+}
+
+void looper::postAt(int what, void *data, int64_t whenNs) {
+  loopermessage *msg = obtain();
+  msg->kind = kMessage;
   msg->what = what;
   msg->obj = data;
-  msg->next = NULL;
-  msg->quit = false;
-  addmsg(msg, flush);
+  msg->when = whenNs;
+  enqueue(msg);
 }
 
-void looper::addmsg(loopermessage *msg, bool flush) {
-  sem_wait(&headwriteprotect);
-  loopermessage *h = head;
+void looper::flush(int what) {
+  loopermessage *msg = obtain();
+  msg->kind = kFlush;
+  msg->what = what;
+  msg->obj = NULL;
+  msg->when = 0;
+  enqueue(msg);
+}
 
-  if (flush) {
-    while (h) {
-      loopermessage *next = h->next;
-      delete h;
-      h = next;
-    }
-    h = NULL;
+void looper::dropPending(int what) {
+  auto end = pending.end();
+  if (what != kAllMessages) {
+    end = std::partition(pending.begin(), pending.end(),
+                         [what](loopermessage *m) { return m->what != what; });
+  } else {
+    end = pending.begin();
   }
-  if (h) {
-    while (h->next) {
-      h = h->next;
+  for (auto it = end; it != pending.end(); ++it) recycle(*it);
+  pending.erase(end, pending.end());
+  std::make_heap(pending.begin(), pending.end(), later);
+}
+
+/*
+ * Move everything producers pushed into the pending heap. Flush requests
+ * take effect here, so they only drop messages posted before them.
+ */
+void looper::drain() {
+  loopermessage *msg;
+  while ((msg = dequeue()) != NULL) {
+    if (msg->kind == kFlush) {
+      dropPending(msg->what);
+      recycle(msg);
+      continue;
     }
-    h->next = msg;
-  } else {
-    head = msg;
+    msg->seq = seq++;
+    pending.push_back(msg);
+    std::push_heap(pending.begin(), pending.end(), later);
+  }
+}
+
+/*
+ * Sleep until untilNs (-1: forever) unless a producer pushes something.
+ */
+void looper::wait(int64_t untilNs) {
+  sleeping.store(true);
+  // re-check after announcing the sleep, a push may have raced with it
+  if (head->next.load() != NULL || tail.load() != head) {
+    sleeping.store(false, std::memory_order_relaxed);
+    return;
+  }
+
+  pollfd pfd = {wakefd, POLLIN, 0};
+  timespec timeout;
+  timespec *ptimeout = NULL;
+  if (untilNs >= 0) {
+    int64_t delta = std::max<int64_t>(0, untilNs - now());
+    timeout.tv_sec = delta / 1000000000LL;
+    timeout.tv_nsec = delta % 1000000000LL;
+    ptimeout = &timeout;
   }
-  LOGV("post msg %d", msg->what);
-  sem_post(&headwriteprotect);
-  sem_post(&headdataavailable);
+  ppoll(&pfd, 1, ptimeout, NULL);
+
+  uint64_t count;
+  read(wakefd, &count, sizeof(count));
+  sleeping.store(false, std::memory_order_relaxed);
 }
 
 void looper::loop() {
   while (true) {
-    // wait for available message
-    sem_wait(&headdataavailable);
-
-    // get next available message
-    sem_wait(&headwriteprotect);
-    loopermessage *msg = head;
-    if (msg == NULL) {
-      LOGV("no msg");
-      sem_post(&headwriteprotect);
+    drain();
+
+    if (pending.empty()) {
+      wait(-1);
+      continue;
+    }
+    loopermessage *msg = pending.front();
+    if (msg->when > now()) {
+      wait(msg->when);
       continue;
     }
-    head = msg->next;
-    sem_post(&headwriteprotect);
+    std::pop_heap(pending.begin(), pending.end(), later);
+    pending.pop_back();
 
-    if (msg->quit) {
+    if (msg->kind == kQuit) {
       LOGV("quitting");
-      delete msg;
+      recycle(msg);
+      dropPending(kAllMessages);
       return;
     }
-    LOGV("processing msg %d", msg->what);
-    handle(msg->what, msg->obj);
-    delete msg;
+    int what = msg->what;
+    void *obj = msg->obj;
+    recycle(msg);
+    handle(what, obj);
   }
 }
 
 void looper::quit() {
   LOGV("quit");
-  loopermessage *msg = new loopermessage();
+  loopermessage *msg = obtain();
+  msg->kind = kQuit;
   msg->what = 0;
   msg->obj = NULL;
-  msg->next = NULL;
-  msg->quit = true;
-  addmsg(msg, false);
+  msg->when = now();
+  enqueue(msg);
   void *retval;
   pthread_join(worker, &retval);
-  sem_destroy(&headdataavailable);
-  sem_destroy(&headwriteprotect);
   running = false;
 }
 
 void looper::handle(int what, void *obj) {
+  // LOGV() compiles to nothing on a host
+  (void)what;
+  (void)obj;
   LOGV("dropping msg %d %p", what, obj);
 }
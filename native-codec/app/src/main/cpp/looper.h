@@ -15,29 +15,79 @@
  */
 
 #include <pthread.h>
-#include <semaphore.h>
+#include <stdint.h>
+
+#include <atomic>
+#include <vector>
 
 struct loopermessage;
 
+/*
+ * looper runs handle() for posted messages on its own thread.
+ *
+ * Posting never takes a lock and does not allocate as long as fewer than
+ * kPoolSize messages are pending: messages come from a preallocated pool
+ * and are pushed onto an intrusive multi-producer/single consumer queue.
+ * The worker thread moves them into a min-heap ordered by due time, which
+ * also serves delayed and timed messages. The worker only sleeps (on an
+ * eventfd) when nothing is due, and producers only wake it up when it
+ * actually sleeps.
+ */
 class looper {
  public:
+  // number of pending messages served from the pool, more are allocated
+  static const int kPoolSize = 128;
+  // flush() wildcard
+  static const int kAllMessages = -1;
+
   looper();
   looper& operator=(const looper&) = delete;
   looper(looper&) = delete;
   virtual ~looper();
 
+  /*
+   * Post a message to be handled as soon as possible. With flush, every
+   * message posted before this one and not handled yet is dropped first.
+   */
   void post(int what, void* data, bool flush = false);
+  // Post a message to be handled delayNs nanoseconds from now
+  void postDelayed(int what, void* data, int64_t delayNs);
+  // Post a message to be handled at CLOCK_MONOTONIC time whenNs
+  void postAt(int what, void* data, int64_t whenNs);
+  // Drop pending messages of type what (kAllMessages for all of them)
+  void flush(int what);
   void quit();
 
   virtual void handle(int what, void* data);
 
+  static int64_t now();
+
  private:
-  void addmsg(loopermessage* msg, bool flush);
+  loopermessage* obtain();
+  void recycle(loopermessage* msg);
+  void enqueue(loopermessage* msg);
+  loopermessage* dequeue();
+  void drain();
+  void dropPending(int what);
+  void wait(int64_t untilNs);
+
   static void* trampoline(void* p);
   void loop();
+
+  loopermessage* pool;
+  std::atomic<uint64_t> freelist;  // index + ABA tag
+
+  // intrusive MPSC queue (Vyukov): producers swap tail, worker owns head
+  std::atomic<loopermessage*> tail;
   loopermessage* head;
+  loopermessage* stub;
+
+  // worker side: pending messages ordered by (when, seq)
+  std::vector<loopermessage*> pending;
+  uint64_t seq;
+
+  std::atomic<bool> sleeping;
+  int wakefd;
   pthread_t worker;
-  sem_t headwriteprotect;
-  sem_t headdataavailable;
   bool running;
 };
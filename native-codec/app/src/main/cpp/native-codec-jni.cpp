@@ -35,9 +35,17 @@
 #include <sys/types.h>
 #include <unistd.h>
 
+#include <atomic>
+#include <string>
+#include <thread>
+
+#include "async_decoder.h"
+#include "decode_scheduler.h"
 #include "looper.h"
 #include "media/NdkMediaCodec.h"
 #include "media/NdkMediaExtractor.h"
+#include "ndk_media.h"
+#include "seek_index.h"
 
 // for __android_log_print(ANDROID_LOG_INFO, "YourApp", "formatted message");
 #include <android/log.h>
@@ -55,14 +63,24 @@ typedef struct {
   ANativeWindow *window;
   AMediaExtractor *ex;
   AMediaCodec *codec;
+  // asynchronous mode (API 28+), NULL when polling the codec
+  AsyncDecoder *decoder;
+  SampleSource *source;
+  CodecPort *port;
+  SeekIndex *index;
+  // set by the JNI thread, read by the looper when the seek is handled
+  std::atomic<int64_t> seekTargetUs;
+  int64_t skipUntilUs;  // frames before this are decoded, not shown
   int64_t renderstart;
   bool sawInputEOS;
   bool sawOutputEOS;
   bool isPlaying;
   bool renderonce;
+  int64_t durationUs;  // of the video track, 0 if unknown
 } workerdata;
 
-workerdata data = {-1, NULL, NULL, NULL, 0, false, false, false, false};
+workerdata data = {-1,    NULL,  NULL,  NULL,  NULL,  NULL, NULL, NULL,
+                   {0},   0,     0,     false, false, false, false, 0};
 
 enum {
   kMsgCodecBuffer,
@@ -71,6 +89,7 @@ enum {
   kMsgPauseAck,
   kMsgDecodeDone,
   kMsgSeek,
+  kMsgRender,
 };
 
 class mylooper : public looper {
@@ -79,6 +98,25 @@ class mylooper : public looper {
 
 static mylooper *mlooper = NULL;
 
+// wakes the looper up when the async decoder has frames due
+class looperTimer : public PresentTimer {
+ public:
+  void wakeAt(int64_t whenNs) override {
+    mlooper->postAt(kMsgRender, &data, whenNs);
+  }
+};
+
+static looperTimer presentTimer;
+
+// read-ahead of all the streams shares these workers
+static const int kDecodeWorkers = 2;
+static DecodeScheduler *scheduler = NULL;
+
+// assets are read only, so seek indices are kept in the app cache instead
+static char seekIndexDir[PATH_MAX];
+static std::thread indexScanner;
+static std::atomic<bool> cancelIndexScan(false);
+
 int64_t systemnanotime() {
   timespec now;
   clock_gettime(CLOCK_MONOTONIC, &now);
@@ -116,16 +154,19 @@ void doCodecWork(workerdata *d) {
         LOGV("output EOS");
         d->sawOutputEOS = true;
       }
+      // decoded only to get to the seek position
+      bool skip = !d->sawOutputEOS && info.presentationTimeUs < d->skipUntilUs;
       int64_t presentationNano = info.presentationTimeUs * 1000;
-      if (d->renderstart < 0) {
+      if (d->renderstart < 0 && !skip) {
         d->renderstart = systemnanotime() - presentationNano;
       }
       int64_t delay = (d->renderstart + presentationNano) - systemnanotime();
-      if (delay > 0) {
+      if (delay > 0 && !skip) {
         usleep(delay / 1000);
       }
-      AMediaCodec_releaseOutputBuffer(d->codec, status, info.size != 0);
-      if (d->renderonce) {
+      AMediaCodec_releaseOutputBuffer(d->codec, status,
+                                      info.size != 0 && !skip);
+      if (d->renderonce && !skip) {
         d->renderonce = false;
         return;
       }
@@ -153,9 +194,23 @@ void mylooper::handle(int what, void *obj) {
       doCodecWork((workerdata *)obj);
       break;
 
+    case kMsgRender: {
+      workerdata *d = (workerdata *)obj;
+      if (d->decoder) d->decoder->present(looper::now());
+    } break;
+
     case kMsgDecodeDone: {
       workerdata *d = (workerdata *)obj;
+      // no codec callbacks after stop, then the extractor thread can go
       AMediaCodec_stop(d->codec);
+      if (d->decoder) {
+        delete d->decoder;
+        delete d->port;
+        delete d->source;
+        d->decoder = NULL;
+        d->port = NULL;
+        d->source = NULL;
+      }
       AMediaCodec_delete(d->codec);
       AMediaExtractor_delete(d->ex);
       d->sawInputEOS = true;
@@ -164,8 +219,16 @@ void mylooper::handle(int what, void *obj) {
 
     case kMsgSeek: {
       workerdata *d = (workerdata *)obj;
-      AMediaExtractor_seekTo(d->ex, 0, AMEDIAEXTRACTOR_SEEK_NEXT_SYNC);
+      int64_t targetUs = d->seekTargetUs.load();
+      if (d->decoder) {
+        scheduler->seek(d->decoder->getStreamId(), targetUs);
+        LOGV("seeked");
+        break;
+      }
+      AMediaExtractor_seekTo(d->ex, targetUs,
+                             AMEDIAEXTRACTOR_SEEK_PREVIOUS_SYNC);
       AMediaCodec_flush(d->codec);
+      d->skipUntilUs = targetUs;
       d->renderstart = -1;
       d->sawInputEOS = false;
       d->sawOutputEOS = false;
@@ -179,9 +242,10 @@ void mylooper::handle(int what, void *obj) {
     case kMsgPause: {
       workerdata *d = (workerdata *)obj;
       if (d->isPlaying) {
-        // flush all outstanding codecbuffer messages with a no-op message
+        // drop all outstanding codecbuffer messages
         d->isPlaying = false;
-        post(kMsgPauseAck, NULL, true);
+        if (d->decoder) scheduler->pause(d->decoder->getStreamId());
+        flush(kMsgCodecBuffer);
       }
     } break;
 
@@ -190,12 +254,65 @@ void mylooper::handle(int what, void *obj) {
       if (!d->isPlaying) {
         d->renderstart = -1;
         d->isPlaying = true;
-        post(kMsgCodecBuffer, d);
+        if (d->decoder) {
+          scheduler->resume(d->decoder->getStreamId());
+        } else {
+          post(kMsgCodecBuffer, d);
+        }
       }
     } break;
   }
 }
 
+/*
+ * Give the async decoder a sync sample index for the video track: the one
+ * saved by an earlier run if the media did not change, or else one built
+ * by scanning the file with a second extractor in the background.
+ */
+static void setUpSeekIndex(workerdata *d, AAssetManager *mgr,
+                           const std::string &name, off_t length, int track) {
+  if (!d->decoder || !seekIndexDir[0]) return;
+
+  uint64_t key = SeekIndex::hash(&length, sizeof(length));
+  key = SeekIndex::hash(name.data(), name.size(), key);
+  std::string file = name;
+  for (auto &c : file) {
+    if (c == '/') c = '_';
+  }
+  std::string path = std::string(seekIndexDir) + "/" + file + ".seekidx";
+
+  SeekIndex *index = new SeekIndex();
+  d->index = index;
+  if (index->load(path.c_str(), key)) {
+    LOGV("seek index %s: %zu sync samples", path.c_str(), index->size());
+    d->decoder->setSeekIndex(index);
+    return;
+  }
+
+  AAsset *asset = AAssetManager_open(mgr, name.c_str(), 0);
+  if (!asset) return;
+  off_t start, len;
+  int fd = AAsset_openFileDescriptor(asset, &start, &len);
+  AAsset_close(asset);
+  if (fd < 0) return;
+
+  cancelIndexScan = false;
+  indexScanner = std::thread([d, index, fd, start, len, track, path, key] {
+    AMediaExtractor *ex = AMediaExtractor_new();
+    if (AMediaExtractor_setDataSourceFd(ex, fd, start, len) == AMEDIA_OK &&
+        AMediaExtractor_selectTrack(ex, track) == AMEDIA_OK &&
+        BuildSeekIndex(ex, index, cancelIndexScan)) {
+      LOGV("built seek index: %zu sync samples", index->size());
+      if (!index->save(path.c_str(), key)) {
+        LOGE("failed to save %s", path.c_str());
+      }
+      d->decoder->setSeekIndex(index);
+    }
+    AMediaExtractor_delete(ex);
+    close(fd);
+  });
+}
+
 extern "C" {
 
 jboolean Java_com_example_nativecodec_NativeCodec_createStreamingMediaPlayer(
@@ -204,16 +321,17 @@ jboolean Java_com_example_nativecodec_NativeCodec_createStreamingMediaPlayer(
 
   // convert Java string to UTF-8
   const char *utf8 = env->GetStringUTFChars(filename, NULL);
-  LOGV("opening %s", utf8);
+  std::string name(utf8);
+  env->ReleaseStringUTFChars(filename, utf8);
+  LOGV("opening %s", name.c_str());
 
+  AAssetManager *mgr = AAssetManager_fromJava(env, assetMgr);
   off_t outStart, outLen;
-  int fd = AAsset_openFileDescriptor(
-      AAssetManager_open(AAssetManager_fromJava(env, assetMgr), utf8, 0),
-      &outStart, &outLen);
+  int fd = AAsset_openFileDescriptor(AAssetManager_open(mgr, name.c_str(), 0),
+                                     &outStart, &outLen);
 
-  env->ReleaseStringUTFChars(filename, utf8);
   if (fd < 0) {
-    LOGE("failed to open file: %s %d (%s)", utf8, fd, strerror(errno));
+    LOGE("failed to open file: %s %d (%s)", name.c_str(), fd, strerror(errno));
     return JNI_FALSE;
   }
 
@@ -234,6 +352,9 @@ jboolean Java_com_example_nativecodec_NativeCodec_createStreamingMediaPlayer(
 
   AMediaCodec *codec = NULL;
 
+  // the async decoder may call back into the looper as soon as the codec runs
+  mlooper = new mylooper();
+
   LOGV("input has %d tracks", numtracks);
   for (int i = 0; i < numtracks; i++) {
     AMediaFormat *format = AMediaExtractor_getTrackFormat(ex, i);
@@ -248,6 +369,27 @@ jboolean Java_com_example_nativecodec_NativeCodec_createStreamingMediaPlayer(
       // Production code should check for errors.
       AMediaExtractor_selectTrack(ex, i);
       codec = AMediaCodec_createDecoderByType(mime);
+      d->decoder = NULL;
+      if (__builtin_available(android 28, *)) {
+        // callbacks have to be set up before configure
+        ExtractorSource *source = new ExtractorSource(ex);
+        AsyncCodec *port = new AsyncCodec(codec);
+        AsyncDecoder *decoder = new AsyncDecoder(source, port, &presentTimer);
+        if (!scheduler) scheduler = new DecodeScheduler(kDecodeWorkers);
+        if (decoder->setScheduler(scheduler) && port->setDecoder(decoder)) {
+          d->decoder = decoder;
+          d->source = source;
+          d->port = port;
+        } else {
+          delete decoder;
+          delete port;
+          delete source;
+        }
+      }
+      if (!AMediaFormat_getInt64(format, AMEDIAFORMAT_KEY_DURATION,
+                                 &d->durationUs)) {
+        d->durationUs = 0;
+      }
       AMediaCodec_configure(codec, format, d->window, NULL, 0);
       d->ex = ex;
       d->codec = codec;
@@ -256,13 +398,18 @@ jboolean Java_com_example_nativecodec_NativeCodec_createStreamingMediaPlayer(
       d->sawOutputEOS = false;
       d->isPlaying = false;
       d->renderonce = true;
+      d->skipUntilUs = 0;
       AMediaCodec_start(codec);
+      if (d->decoder) {
+        LOGV("decoding asynchronously");
+        d->decoder->start();
+        setUpSeekIndex(d, mgr, name, outLen, i);
+      }
     }
     AMediaFormat_delete(format);
   }
 
-  mlooper = new mylooper();
-  mlooper->post(kMsgCodecBuffer, d);
+  if (!d->decoder) mlooper->post(kMsgCodecBuffer, d);
 
   return JNI_TRUE;
 }
@@ -284,12 +431,22 @@ void Java_com_example_nativecodec_NativeCodec_setPlayingStreamingMediaPlayer(
 void Java_com_example_nativecodec_NativeCodec_shutdown(JNIEnv *env,
                                                        jclass clazz) {
   LOGV("@@@ shutdown");
+  if (indexScanner.joinable()) {
+    cancelIndexScan = true;
+    indexScanner.join();
+  }
   if (mlooper) {
     mlooper->post(kMsgDecodeDone, &data, true /* flush */);
     mlooper->quit();
     delete mlooper;
     mlooper = NULL;
   }
+  if (scheduler) {
+    delete scheduler;
+    scheduler = NULL;
+  }
+  delete data.index;
+  data.index = NULL;
   if (data.window) {
     ANativeWindow_release(data.window);
     data.window = NULL;
@@ -314,7 +471,32 @@ void Java_com_example_nativecodec_NativeCodec_rewindStreamingMediaPlayer(
     JNIEnv *env, jclass clazz) {
   LOGV("@@@ rewind");
   if (mlooper) {
+    data.seekTargetUs.store(0);
     mlooper->post(kMsgSeek, &data);
   }
 }
+
+// seek the streaming media player to the frame at positionUs
+void Java_com_example_nativecodec_NativeCodec_seekStreamingMediaPlayer(
+    JNIEnv *env, jclass clazz, jlong positionUs) {
+  LOGV("@@@ seek %lld", (long long)positionUs);
+  if (mlooper) {
+    data.seekTargetUs.store(positionUs);
+    mlooper->post(kMsgSeek, &data);
+  }
+}
+
+// duration of the media opened by createStreamingMediaPlayer, 0 if unknown
+jlong Java_com_example_nativecodec_NativeCodec_getStreamingMediaDurationUs(
+    JNIEnv *env, jclass clazz) {
+  return data.durationUs;
+}
+
+// directory to keep seek indices in
+void Java_com_example_nativecodec_NativeCodec_setSeekIndexDirectory(
+    JNIEnv *env, jclass clazz, jstring path) {
+  const char *utf8 = env->GetStringUTFChars(path, NULL);
+  snprintf(seekIndexDir, sizeof(seekIndexDir), "%s", utf8);
+  env->ReleaseStringUTFChars(path, utf8);
+}
 }
@@ -0,0 +1,115 @@
+/*
+ * Copyright (C) 2014 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "ndk_media.h"
+
+#include <android/log.h>
+#define TAG "NativeCodec"
+#define LOGV(...) __android_log_print(ANDROID_LOG_VERBOSE, TAG, __VA_ARGS__)
+#define LOGE(...) __android_log_print(ANDROID_LOG_ERROR, TAG, __VA_ARGS__)
+
+ssize_t ExtractorSource::sampleSize() {
+  return AMediaExtractor_getSampleSize(ex);
+}
+
+ssize_t ExtractorSource::readSample(uint8_t* buf, size_t capacity,
+                                    int64_t* ptsUs) {
+  ssize_t size = AMediaExtractor_readSampleData(ex, buf, capacity);
+  if (size < 0) return -1;
+  *ptsUs = AMediaExtractor_getSampleTime(ex);
+  AMediaExtractor_advance(ex);
+  return size;
+}
+
+void ExtractorSource::seekTo(int64_t ptsUs) {
+  AMediaExtractor_seekTo(ex, ptsUs, AMEDIAEXTRACTOR_SEEK_PREVIOUS_SYNC);
+}
+
+bool AsyncCodec::setDecoder(AsyncDecoder* d) {
+  decoder = d;
+  AMediaCodecOnAsyncNotifyCallback callback = {
+      onInputAvailable,
+      onOutputAvailable,
+      onFormatChanged,
+      onError,
+  };
+  return AMediaCodec_setAsyncNotifyCallback(codec, callback, this) ==
+         AMEDIA_OK;
+}
+
+uint8_t* AsyncCodec::getInputBuffer(size_t index, size_t* capacity) {
+  return AMediaCodec_getInputBuffer(codec, index, capacity);
+}
+
+void AsyncCodec::queueInputBuffer(size_t index, size_t size, int64_t ptsUs,
+                                  bool eos) {
+  AMediaCodec_queueInputBuffer(codec, index, 0, size, ptsUs,
+                               eos ? AMEDIACODEC_BUFFER_FLAG_END_OF_STREAM : 0);
+}
+
+void AsyncCodec::releaseOutputBuffer(size_t index, bool render,
+                                     int64_t renderNs) {
+  if (render) {
+    AMediaCodec_releaseOutputBufferAtTime(codec, index, renderNs);
+  } else {
+    AMediaCodec_releaseOutputBuffer(codec, index, false);
+  }
+}
+
+void AsyncCodec::flush() { AMediaCodec_flush(codec); }
+
+// in asynchronous mode a flushed codec only resumes callbacks after start
+void AsyncCodec::start() { AMediaCodec_start(codec); }
+
+void AsyncCodec::onInputAvailable(AMediaCodec*, void* userdata,
+                                  int32_t index) {
+  ((AsyncCodec*)userdata)->decoder->onInputAvailable(index);
+}
+
+void AsyncCodec::onOutputAvailable(AMediaCodec*, void* userdata, int32_t index,
+                                   AMediaCodecBufferInfo* info) {
+  bool eos = info->flags & AMEDIACODEC_BUFFER_FLAG_END_OF_STREAM;
+  if (eos) LOGV("output EOS");
+  ((AsyncCodec*)userdata)
+      ->decoder->onOutputAvailable(index, info->presentationTimeUs, info->size,
+                                   eos);
+}
+
+void AsyncCodec::onFormatChanged(AMediaCodec*, void*, AMediaFormat* format) {
+  LOGV("format changed to: %s", AMediaFormat_toString(format));
+  AMediaFormat_delete(format);
+}
+
+void AsyncCodec::onError(AMediaCodec*, void*, media_status_t error,
+                         int32_t actionCode, const char* detail) {
+  LOGE("codec error %d (action %d): %s", error, actionCode,
+       detail ? detail : "");
+}
+
+bool BuildSeekIndex(AMediaExtractor* ex, SeekIndex* index,
+                    const std::atomic<bool>& cancel) {
+  while (!cancel.load(std::memory_order_relaxed)) {
+    int64_t ptsUs = AMediaExtractor_getSampleTime(ex);
+    if (ptsUs < 0) {
+      index->finish();
+      return true;
+    }
+    uint32_t flags = AMediaExtractor_getSampleFlags(ex);
+    index->addSample(ptsUs, flags & AMEDIAEXTRACTOR_SAMPLE_FLAG_SYNC);
+    AMediaExtractor_advance(ex);
+  }
+  return false;
+}
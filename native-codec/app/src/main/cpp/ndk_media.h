@@ -0,0 +1,82 @@
+/*
+ * Copyright (C) 2014 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef NATIVE_CODEC_NDK_MEDIA_H
+#define NATIVE_CODEC_NDK_MEDIA_H
+
+#include <atomic>
+
+#include "async_decoder.h"
+#include "media/NdkMediaCodec.h"
+#include "media/NdkMediaExtractor.h"
+#include "seek_index.h"
+
+/*
+ * AsyncDecoder ports backed by the NDK media APIs. Both need API 28
+ * (AMediaExtractor_getSampleSize and AMediaCodec_setAsyncNotifyCallback).
+ */
+class __INTRODUCED_IN(28) ExtractorSource : public SampleSource {
+ public:
+  explicit ExtractorSource(AMediaExtractor* ex) : ex(ex) {}
+
+  ssize_t sampleSize() override;
+  ssize_t readSample(uint8_t* buf, size_t capacity, int64_t* ptsUs) override;
+  void seekTo(int64_t ptsUs) override;
+
+ private:
+  AMediaExtractor* ex;
+};
+
+class __INTRODUCED_IN(28) AsyncCodec : public CodecPort {
+ public:
+  explicit AsyncCodec(AMediaCodec* codec) : codec(codec), decoder(NULL) {}
+
+  // Send the codec callbacks to decoder. Must happen before
+  // AMediaCodec_configure().
+  bool setDecoder(AsyncDecoder* decoder);
+
+  uint8_t* getInputBuffer(size_t index, size_t* capacity) override;
+  void queueInputBuffer(size_t index, size_t size, int64_t ptsUs,
+                        bool eos) override;
+  void releaseOutputBuffer(size_t index, bool render,
+                           int64_t renderNs) override;
+  void flush() override;
+  void start() override;
+
+ private:
+  static void onInputAvailable(AMediaCodec* codec, void* userdata,
+                               int32_t index);
+  static void onOutputAvailable(AMediaCodec* codec, void* userdata,
+                                int32_t index, AMediaCodecBufferInfo* info);
+  static void onFormatChanged(AMediaCodec* codec, void* userdata,
+                              AMediaFormat* format);
+  static void onError(AMediaCodec* codec, void* userdata, media_status_t error,
+                      int32_t actionCode, const char* detail);
+
+  AMediaCodec* codec;
+  AsyncDecoder* decoder;
+};
+
+/*
+ * Walk the selected track of ex from its current position to the end and
+ * add every sample to index, without reading any sample data. Meant for an
+ * extractor of its own on a background thread; returns false if cancel was
+ * set before the end.
+ */
+bool BuildSeekIndex(AMediaExtractor* ex, SeekIndex* index,
+                    const std::atomic<bool>& cancel);
+
+#endif  // NATIVE_CODEC_NDK_MEDIA_H
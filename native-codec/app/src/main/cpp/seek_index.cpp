@@ -0,0 +1,147 @@
+/*
+ * Copyright (C) 2014 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "seek_index.h"
+
+#include <limits.h>
+#include <stdio.h>
+#include <sys/stat.h>
+
+#include <algorithm>
+
+/*
+ * File layout, native endianness:
+ *   header  magic "NCSI", version, entry count, key, duration
+ *   entries count * {int64_t ptsUs, uint32_t samples, uint32_t 0}
+ */
+namespace {
+const uint32_t kMagic = 0x4953434e;  // "NCSI"
+const uint32_t kVersion = 1;
+
+struct FileHeader {
+  uint32_t magic;
+  uint32_t version;
+  uint32_t count;
+  uint32_t reserved;
+  uint64_t key;
+  int64_t durationUs;
+};
+
+struct FileEntry {
+  int64_t ptsUs;
+  uint32_t samples;
+  uint32_t reserved;
+};
+}  // namespace
+
+SeekIndex::SeekIndex() : lastPtsUs(0), finished(false) {}
+
+void SeekIndex::addSample(int64_t ptsUs, bool sync) {
+  if (ptsUs > lastPtsUs) lastPtsUs = ptsUs;
+  if (sync || entries.empty()) {
+    entries.push_back({ptsUs, 0});
+  }
+  entries.back().samples++;
+}
+
+void SeekIndex::finish() {
+  // sync samples are normally in presentation order already
+  std::stable_sort(
+      entries.begin(), entries.end(),
+      [](const Entry& a, const Entry& b) { return a.ptsUs < b.ptsUs; });
+  finished = true;
+}
+
+const SeekIndex::Entry* SeekIndex::find(int64_t ptsUs) const {
+  if (entries.empty()) return NULL;
+  auto it = std::upper_bound(
+      entries.begin(), entries.end(), ptsUs,
+      [](int64_t pts, const Entry& e) { return pts < e.ptsUs; });
+  if (it != entries.begin()) --it;
+  return &*it;
+}
+
+bool SeekIndex::save(const char* path, uint64_t key) const {
+  if (!finished) return false;
+
+  // write next to the final file and rename, so readers never see half of it
+  char tmp[PATH_MAX];
+  if (snprintf(tmp, sizeof(tmp), "%s.tmp", path) >= (int)sizeof(tmp)) {
+    return false;
+  }
+  FILE* f = fopen(tmp, "wb");
+  if (!f) return false;
+
+  FileHeader header = {kMagic, kVersion, (uint32_t)entries.size(), 0, key,
+                       lastPtsUs};
+  bool ok = fwrite(&header, sizeof(header), 1, f) == 1;
+  for (size_t i = 0; ok && i < entries.size(); i++) {
+    FileEntry e = {entries[i].ptsUs, entries[i].samples, 0};
+    ok = fwrite(&e, sizeof(e), 1, f) == 1;
+  }
+  ok = (fclose(f) == 0) && ok;
+  if (ok) ok = rename(tmp, path) == 0;
+  if (!ok) remove(tmp);
+  return ok;
+}
+
+bool SeekIndex::load(const char* path, uint64_t key) {
+  entries.clear();
+  lastPtsUs = 0;
+  finished = false;
+
+  FILE* f = fopen(path, "rb");
+  if (!f) return false;
+  FileHeader header;
+  bool ok = fread(&header, sizeof(header), 1, f) == 1 &&
+            header.magic == kMagic && header.version == kVersion &&
+            header.key == key;
+  // the count must account for the rest of the file before it sizes
+  // anything, a corrupt one could ask for gigabytes
+  struct stat st;
+  ok = ok && fstat(fileno(f), &st) == 0 &&
+       static_cast<uint64_t>(st.st_size) ==
+           sizeof(header) + static_cast<uint64_t>(header.count) *
+                                sizeof(FileEntry);
+  if (ok) {
+    entries.reserve(header.count);
+    for (uint32_t i = 0; ok && i < header.count; i++) {
+      FileEntry e;
+      ok = fread(&e, sizeof(e), 1, f) == 1 && e.samples > 0 && !e.reserved &&
+           (entries.empty() || e.ptsUs >= entries.back().ptsUs);
+      if (ok) entries.push_back({e.ptsUs, e.samples});
+    }
+  }
+  fclose(f);
+
+  if (!ok) {
+    entries.clear();
+    return false;
+  }
+  lastPtsUs = header.durationUs;
+  finished = true;
+  return true;
+}
+
+uint64_t SeekIndex::hash(const void* data, size_t size, uint64_t seed) {
+  const uint8_t* p = (const uint8_t*)data;
+  uint64_t h = seed;
+  for (size_t i = 0; i < size; i++) {
+    h ^= p[i];
+    h *= 1099511628211ULL;
+  }
+  return h;
+}
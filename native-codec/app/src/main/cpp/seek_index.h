@@ -0,0 +1,69 @@
+/*
+ * Copyright (C) 2014 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef NATIVE_CODEC_SEEK_INDEX_H
+#define NATIVE_CODEC_SEEK_INDEX_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <vector>
+
+/*
+ * SeekIndex: presentation times of the sync samples of one track, plus the
+ * number of samples from each sync sample to the next one, so a seek knows
+ * where to start decoding and how much it will have to decode and discard.
+ *
+ * Build it by feeding every sample of the track, in decode order, to
+ * addSample() and calling finish(). A finished index can be saved and loaded
+ * again; the file is tied to a caller supplied key (e.g. a hash of the media
+ * name and size) so a changed media file does not pick up a stale index.
+ */
+class SeekIndex {
+ public:
+  struct Entry {
+    int64_t ptsUs;     // of the sync sample
+    uint32_t samples;  // decode-order samples up to the next sync sample
+  };
+
+  SeekIndex();
+
+  void addSample(int64_t ptsUs, bool sync);
+  void finish();
+  bool isFinished() const { return finished; }
+
+  // Sync sample to start decoding from to display ptsUs, i.e. the last sync
+  // sample at or before it. Returns NULL if the index is empty.
+  const Entry* find(int64_t ptsUs) const;
+  size_t size() const { return entries.size(); }
+  int64_t durationUs() const { return lastPtsUs; }
+
+  bool save(const char* path, uint64_t key) const;
+  // Returns false (and leaves the index empty) if the file is missing,
+  // corrupt or was written for another key.
+  bool load(const char* path, uint64_t key);
+
+  // FNV-1a, for building keys
+  static uint64_t hash(const void* data, size_t size,
+                       uint64_t seed = 14695981039346656037ULL);
+
+ private:
+  std::vector<Entry> entries;
+  int64_t lastPtsUs;
+  bool finished;
+};
+
+#endif  // NATIVE_CODEC_SEEK_INDEX_H
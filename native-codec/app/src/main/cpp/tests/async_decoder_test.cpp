@@ -0,0 +1,178 @@
+/*
+ * Copyright (C) 2014 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "async_decoder.h"
+
+#include <gtest/gtest.h>
+#include <unistd.h>
+
+#include <vector>
+
+#include "fake_media.h"
+
+namespace {
+
+const int64_t kFrameUs = kFakeFrameUs;
+const int64_t kMs = 1000000;
+
+class AsyncDecoderTest : public testing::Test {
+ protected:
+  AsyncDecoderTest() : source(30, 5), decoder(&source, &codec, &timer, 4) {
+    codec.attach(&decoder);
+  }
+  ~AsyncDecoderTest() { decoder.stop(); }
+
+  // Run the codec, and the display when the timer fires, in 1ms steps
+  // until the output EOS or until `until` frames were released
+  void play(size_t until = SIZE_MAX, int steps = 5000) {
+    for (int i = 0; i < steps && !decoder.sawOutputEOS(); i++) {
+      codec.decode();
+      if (timer.fire(nowNs)) decoder.present(nowNs);
+      for (const auto& r : codec.takeReleased()) released.push_back(r);
+      if (released.size() >= until) return;
+      nowNs += kMs;
+      usleep(50);  // let the extractor thread read ahead
+    }
+  }
+
+  std::vector<FakeCodec::Release> rendered() const {
+    std::vector<FakeCodec::Release> r;
+    for (const auto& f : released) {
+      if (f.render) r.push_back(f);
+    }
+    return r;
+  }
+
+  FakeSource source;
+  FakeCodec codec;
+  FakeTimer timer;
+  AsyncDecoder decoder;
+  int64_t nowNs = 1000 * kMs;
+  std::vector<FakeCodec::Release> released;
+};
+
+TEST_F(AsyncDecoderTest, ShowsTheFirstFrameWhilePaused) {
+  decoder.start();
+  play(1, 200);
+  // and nothing after it until resumed
+  play(SIZE_MAX, 100);
+  ASSERT_EQ(rendered().size(), 1u);
+  EXPECT_EQ(rendered()[0].ptsUs, 0);
+}
+
+TEST_F(AsyncDecoderTest, PlaysEveryFrameOnTime) {
+  decoder.start();
+  decoder.resume();
+  play();
+
+  ASSERT_TRUE(decoder.sawOutputEOS());
+  std::vector<FakeCodec::Release> frames = rendered();
+  ASSERT_EQ(frames.size(), 30u);
+  for (size_t i = 1; i < frames.size(); i++) {
+    EXPECT_EQ(frames[i].ptsUs, static_cast<int64_t>(i) * kFrameUs);
+    // handed over ahead of time, with the display time of its pts
+    EXPECT_EQ(frames[i].renderNs - frames[i - 1].renderNs, kFrameUs * 1000);
+  }
+  AsyncDecoderStats stats = decoder.getStats();
+  EXPECT_EQ(stats.framesRendered, 30u);
+  EXPECT_EQ(stats.framesDropped, 0u);
+  EXPECT_EQ(stats.samplesRead, 31u);  // and the EOS
+  // the display was woken up for frames, not polled
+  EXPECT_LE(timer.wakes, 2 * 30);
+}
+
+TEST_F(AsyncDecoderTest, DropsFramesTooLateToShow) {
+  decoder.start();
+  decoder.resume();
+  play(5);
+  nowNs += 500 * kMs;  // the app stalled
+  play();
+
+  AsyncDecoderStats stats = decoder.getStats();
+  EXPECT_GT(stats.framesDropped, 0u);
+  EXPECT_EQ(stats.framesRendered + stats.framesDropped, 30u);
+}
+
+TEST_F(AsyncDecoderTest, SeekDecodesFromSyncAndSkipsToTarget) {
+  decoder.start();
+  decoder.resume();
+  play(5);
+
+  decoder.seekTo(17 * kFrameUs);
+  released.clear();
+  play();
+
+  EXPECT_EQ(source.seeks, 1);
+  std::vector<FakeCodec::Release> frames = rendered();
+  ASSERT_FALSE(frames.empty());
+  EXPECT_EQ(frames.front().ptsUs, 17 * kFrameUs);
+  EXPECT_EQ(frames.back().ptsUs, 29 * kFrameUs);
+  // 15 and 16 are decoded from the sync sample at 15, not shown
+  EXPECT_EQ(decoder.getStats().framesSkipped, 2u);
+}
+
+TEST_F(AsyncDecoderTest, SeekWithIndexStartsAtIndexedSync) {
+  SeekIndex index;
+  for (int i = 0; i < 30; i++) index.addSample(i * kFrameUs, i % 5 == 0);
+  index.finish();
+  decoder.setSeekIndex(&index);
+  decoder.start();
+  decoder.resume();
+  play(5);
+
+  decoder.seekTo(12 * kFrameUs);
+  released.clear();
+  play();
+
+  std::vector<FakeCodec::Release> frames = rendered();
+  ASSERT_FALSE(frames.empty());
+  EXPECT_EQ(frames.front().ptsUs, 12 * kFrameUs);
+  EXPECT_EQ(decoder.getStats().framesSkipped, 2u);
+}
+
+// A target past the last frame of its sync sample shows that last frame,
+// instead of dropping every frame up to the end of the stream.
+TEST_F(AsyncDecoderTest, SeekWithIndexDropsNoMoreThanItsSamples) {
+  SeekIndex index;
+  for (int i = 0; i < 30; i++) index.addSample(i * kFrameUs, i % 5 == 0);
+  index.finish();
+  decoder.setSeekIndex(&index);
+  decoder.start();
+  play(1, 200);  // paused, the first frame is shown
+
+  decoder.seekTo(100 * kFrameUs);
+  released.clear();
+  play(SIZE_MAX, 200);
+
+  std::vector<FakeCodec::Release> frames = rendered();
+  ASSERT_EQ(frames.size(), 1u);
+  EXPECT_EQ(frames[0].ptsUs, 29 * kFrameUs);
+  EXPECT_EQ(decoder.getStats().framesSkipped, 4u);
+}
+
+TEST_F(AsyncDecoderTest, ReadsAheadOnASharedScheduler) {
+  DecodeScheduler scheduler(2);
+  ASSERT_TRUE(decoder.setScheduler(&scheduler));
+  decoder.start();
+  decoder.resume();
+  play();
+
+  ASSERT_TRUE(decoder.sawOutputEOS());
+  EXPECT_EQ(rendered().size(), 30u);
+  decoder.stop();
+}
+
+}  // namespace
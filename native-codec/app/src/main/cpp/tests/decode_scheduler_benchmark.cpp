@@ -0,0 +1,89 @@
+/*
+ * Copyright (C) 2014 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Simulated thumbnail grid: streams at 60 and 30 fps whose every frame costs
+ * a fixed amount of CPU, decoded by pools of 1 to 4 workers. Reports how
+ * many frames started after their deadline and by how much.
+ */
+#include <stdio.h>
+#include <unistd.h>
+
+#include <vector>
+
+#include "decode_scheduler.h"
+
+namespace {
+
+const int64_t kFrameCostNs = 1000000;
+const int kFrames = 90;
+
+class SimulatedStream : public DecodeTask {
+ public:
+  SimulatedStream(int64_t startNs, int64_t periodNs)
+      : startNs(startNs), periodNs(periodNs) {}
+
+  int64_t run() override {
+    int64_t begin = DecodeScheduler::now();
+    while (DecodeScheduler::now() - begin < kFrameCostNs) {
+    }
+    return ++frame < kFrames ? startNs + frame * periodNs
+                             : DecodeScheduler::kIdle;
+  }
+  void pause() override {}
+  void resume() override {}
+  void seekTo(int64_t) override {}
+
+ private:
+  int64_t startNs;
+  int64_t periodNs;
+  int frame = 0;
+};
+
+}  // namespace
+
+int main() {
+  const int kStreams = 8;
+  for (int workers = 1; workers <= 4; workers *= 2) {
+    DecodeScheduler scheduler(workers);
+    int64_t start = DecodeScheduler::now();
+    std::vector<SimulatedStream*> streams;
+    std::vector<int> ids;
+    for (int i = 0; i < kStreams; i++) {
+      int64_t period = i < 2 ? 16666667 : 33333333;
+      streams.push_back(new SimulatedStream(start, period));
+      ids.push_back(scheduler.add(streams.back()));
+      scheduler.wake(ids.back(), start);
+    }
+    // the 30 fps streams need the longest
+    usleep((kFrames * 33333 + 100000));
+
+    uint64_t runs = 0, late = 0;
+    int64_t maxLateNs = 0;
+    for (size_t i = 0; i < ids.size(); i++) {
+      scheduler.remove(ids[i]);
+      DecodeStreamStats stats = scheduler.getStats(ids[i]);
+      runs += stats.runs;
+      late += stats.lateRuns;
+      if (stats.maxLatenessNs > maxLateNs) maxLateNs = stats.maxLatenessNs;
+      delete streams[i];
+    }
+    printf("%d streams, %d worker(s): %llu runs, %llu late, max %.2f ms\n",
+           kStreams, workers, (unsigned long long)runs,
+           (unsigned long long)late, maxLateNs / 1e6);
+  }
+  return 0;
+}
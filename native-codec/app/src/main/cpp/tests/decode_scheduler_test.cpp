@@ -0,0 +1,246 @@
+/*
+ * Copyright (C) 2014 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "decode_scheduler.h"
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+// Records what the scheduler asks of it, in a log shared between tasks
+class Log {
+ public:
+  void add(const std::string& entry) {
+    std::lock_guard<std::mutex> l(lock);
+    entries.push_back(entry);
+    cond.notify_all();
+  }
+  // Wait up to 5s for n entries
+  std::vector<std::string> waitFor(size_t n) {
+    std::unique_lock<std::mutex> l(lock);
+    cond.wait_for(l, std::chrono::seconds(5),
+                  [this, n] { return entries.size() >= n; });
+    return entries;
+  }
+
+ private:
+  std::mutex lock;
+  std::condition_variable cond;
+  std::vector<std::string> entries;
+};
+
+// Blocks callers of wait() until open()
+class Gate {
+ public:
+  void open() {
+    std::lock_guard<std::mutex> l(lock);
+    opened = true;
+    cond.notify_all();
+  }
+  void wait() {
+    std::unique_lock<std::mutex> l(lock);
+    cond.wait(l, [this] { return opened; });
+  }
+
+ private:
+  std::mutex lock;
+  std::condition_variable cond;
+  bool opened = false;
+};
+
+class FakeTask : public DecodeTask {
+ public:
+  FakeTask(const std::string& name, Log* log, int runs = 1)
+      : name(name), log(log), runsLeft(runs) {}
+
+  int64_t run() override {
+    if (gate) {
+      started = true;
+      gate->wait();
+    }
+    if (inside.exchange(true)) reentered = true;
+    log->add(name);
+    inside = false;
+    return --runsLeft > 0 ? 0 : DecodeScheduler::kIdle;
+  }
+  void pause() override { log->add(name + " pause"); }
+  void resume() override { log->add(name + " resume"); }
+  void seekTo(int64_t ptsUs) override {
+    log->add(name + " seek " + std::to_string(ptsUs));
+  }
+
+  std::string name;
+  Log* log;
+  int runsLeft;
+  Gate* gate = NULL;
+  std::atomic<bool> started{false};
+  std::atomic<bool> inside{false};
+  std::atomic<bool> reentered{false};
+};
+
+// Keep the single worker busy until the returned gate opens
+void occupy(DecodeScheduler* scheduler, FakeTask* blocker, Gate* gate) {
+  blocker->gate = gate;
+  scheduler->wake(scheduler->add(blocker), 0);
+  while (!blocker->started) std::this_thread::yield();
+}
+
+TEST(DecodeSchedulerTest, RunsEarliestDeadlineFirst) {
+  DecodeScheduler scheduler(1);
+  Log log;
+  Gate gate;
+  FakeTask blocker("blocker", &log), a("a", &log), b("b", &log),
+      c("c", &log);
+  occupy(&scheduler, &blocker, &gate);
+
+  scheduler.wake(scheduler.add(&a), 300);
+  scheduler.wake(scheduler.add(&b), 100);
+  scheduler.wake(scheduler.add(&c), 200);
+  gate.open();
+
+  EXPECT_EQ(log.waitFor(4),
+            (std::vector<std::string>{"blocker", "b", "c", "a"}));
+}
+
+TEST(DecodeSchedulerTest, RunsUntilTheTaskIsIdle) {
+  DecodeScheduler scheduler(2);
+  Log log;
+  FakeTask task("t", &log, 5);
+  int id = scheduler.add(&task);
+  scheduler.wake(id, 0);
+
+  EXPECT_EQ(log.waitFor(5).size(), 5u);
+  scheduler.remove(id);
+  EXPECT_EQ(scheduler.getStats(id).runs, 5u);
+}
+
+TEST(DecodeSchedulerTest, IdleDeadlineDoesNotWake) {
+  DecodeScheduler scheduler(1);
+  Log log;
+  FakeTask task("t", &log);
+  int id = scheduler.add(&task);
+  scheduler.wake(id, DecodeScheduler::kIdle);
+  std::this_thread::sleep_for(std::chrono::milliseconds(20));
+  scheduler.remove(id);
+  EXPECT_EQ(scheduler.getStats(id).runs, 0u);
+}
+
+TEST(DecodeSchedulerTest, PausedStreamsWaitForResume) {
+  DecodeScheduler scheduler(1);
+  Log log;
+  FakeTask task("t", &log);
+  int id = scheduler.add(&task);
+  scheduler.pause(id);
+  scheduler.wake(id, 0);
+  EXPECT_EQ(log.waitFor(1), std::vector<std::string>{"t pause"});
+  std::this_thread::sleep_for(std::chrono::milliseconds(20));
+
+  scheduler.resume(id);
+  EXPECT_EQ(log.waitFor(3),
+            (std::vector<std::string>{"t pause", "t resume", "t"}));
+}
+
+TEST(DecodeSchedulerTest, RequestsGoAheadOfDeadlinesAndCollapse) {
+  DecodeScheduler scheduler(1);
+  Log log;
+  Gate gate;
+  FakeTask blocker("blocker", &log), early("early", &log), seeked("s", &log);
+  occupy(&scheduler, &blocker, &gate);
+
+  scheduler.wake(scheduler.add(&early), 0);
+  int id = scheduler.add(&seeked);
+  scheduler.pause(id);
+  scheduler.seek(id, 1000);
+  scheduler.resume(id);
+  scheduler.seek(id, 2000);
+  gate.open();
+
+  // one resume for the latest state, one seek to the latest position
+  EXPECT_EQ(log.waitFor(4), (std::vector<std::string>{"blocker", "s resume",
+                                                      "s seek 2000", "early"}));
+}
+
+TEST(DecodeSchedulerTest, RemoveWaitsForTheRunningTask) {
+  DecodeScheduler scheduler(1);
+  Log log;
+  Gate gate;
+  FakeTask task("t", &log);
+  task.gate = &gate;
+  int id = scheduler.add(&task);
+  scheduler.wake(id, 0);
+  while (!task.started) std::this_thread::yield();
+
+  std::atomic<bool> removed(false);
+  std::thread remover([&] {
+    scheduler.remove(id);
+    removed = true;
+  });
+  std::this_thread::sleep_for(std::chrono::milliseconds(20));
+  EXPECT_FALSE(removed);
+  gate.open();
+  remover.join();
+  EXPECT_EQ(log.waitFor(1), std::vector<std::string>{"t"});
+}
+
+TEST(DecodeSchedulerTest, RejectsStreamsBeyondTheLimit) {
+  DecodeScheduler scheduler(1);
+  Log log;
+  std::vector<FakeTask*> tasks;
+  for (int i = 0; i < DecodeScheduler::kMaxStreams; i++) {
+    tasks.push_back(new FakeTask("t", &log));
+    EXPECT_EQ(scheduler.add(tasks.back()), i);
+  }
+  FakeTask extra("extra", &log);
+  EXPECT_EQ(scheduler.add(&extra), -1);
+  scheduler.remove(3);
+  EXPECT_EQ(scheduler.add(&extra), 3);
+  for (int i = 0; i < DecodeScheduler::kMaxStreams; i++) scheduler.remove(i);
+  for (FakeTask* task : tasks) delete task;
+}
+
+// Many workers, each stream woken from outside while it runs: a task never
+// runs on two workers at once.
+TEST(DecodeSchedulerTest, NeverRunsATaskConcurrently) {
+  const int kStreams = 4;
+  const int kRuns = 2000;
+  DecodeScheduler scheduler(4);
+  Log log;
+  std::vector<FakeTask*> tasks;
+  std::vector<int> ids;
+  for (int i = 0; i < kStreams; i++) {
+    tasks.push_back(new FakeTask(std::to_string(i), &log, kRuns));
+    ids.push_back(scheduler.add(tasks.back()));
+  }
+  for (int round = 0; round < kRuns; round++) {
+    for (int id : ids) scheduler.wake(id, round);
+  }
+  log.waitFor(kStreams * kRuns);
+  for (int i = 0; i < kStreams; i++) {
+    scheduler.remove(ids[i]);
+    EXPECT_FALSE(tasks[i]->reentered);
+    delete tasks[i];
+  }
+}
+
+}  // namespace
@@ -0,0 +1,183 @@
+/*
+ * Copyright (C) 2014 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef NATIVE_CODEC_FAKE_MEDIA_H
+#define NATIVE_CODEC_FAKE_MEDIA_H
+
+#include <stdint.h>
+#include <string.h>
+
+#include <atomic>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <vector>
+
+#include "async_decoder.h"
+
+/*
+ * Stand-ins for the extractor, the codec and the display timer, so an
+ * AsyncDecoder runs on a host: the caller plays the codec callback thread
+ * and the display.
+ */
+
+const int64_t kFakeFrameUs = 33333;
+
+// Samples i = 0..count-1 at i * kFakeFrameUs, a sync sample every
+// syncInterval
+class FakeSource : public SampleSource {
+ public:
+  FakeSource(int count, int syncInterval)
+      : count(count), syncInterval(syncInterval) {}
+
+  ssize_t sampleSize() override { return next < count ? 100 + next : -1; }
+  ssize_t readSample(uint8_t* buf, size_t capacity, int64_t* ptsUs) override {
+    if (next >= count) return -1;
+    size_t size = 100 + next;
+    memset(buf, next, size < capacity ? size : capacity);
+    *ptsUs = next * kFakeFrameUs;
+    next++;
+    return size;
+  }
+  // AMEDIAEXTRACTOR_SEEK_PREVIOUS_SYNC
+  void seekTo(int64_t ptsUs) override {
+    next = static_cast<int>(ptsUs / kFakeFrameUs) / syncInterval *
+           syncInterval;
+    seeks++;
+  }
+
+  std::atomic<int> seeks{0};
+
+ private:
+  const int count;
+  const int syncInterval;
+  int next = 0;
+};
+
+/*
+ * A codec with kBuffers buffers that "decodes" when the test calls decode(),
+ * standing in for the codec callback thread.
+ */
+class FakeCodec : public CodecPort {
+ public:
+  static const int kBuffers = 4;
+
+  struct Release {
+    int64_t ptsUs;
+    bool render;
+    int64_t renderNs;
+  };
+
+  void attach(AsyncDecoder* d) {
+    decoder = d;
+    for (int i = 0; i < kBuffers; i++) decoder->onInputAvailable(i);
+  }
+
+  uint8_t* getInputBuffer(size_t index, size_t* capacity) override {
+    *capacity = sizeof(buffers[index]);
+    return buffers[index];
+  }
+  void queueInputBuffer(size_t index, size_t size, int64_t ptsUs,
+                        bool eos) override {
+    std::lock_guard<std::mutex> l(lock);
+    queued.push_back({index, ptsUs, size, eos});
+  }
+  void releaseOutputBuffer(size_t index, bool render,
+                           int64_t renderNs) override {
+    std::lock_guard<std::mutex> l(lock);
+    released.push_back({outputPts[index], render, renderNs});
+    outputPts.erase(index);
+  }
+  void flush() override {
+    std::lock_guard<std::mutex> l(lock);
+    queued.clear();
+  }
+  // asynchronous codecs offer all their input buffers again after a flush
+  void start() override {
+    for (int i = 0; i < kBuffers; i++) decoder->onInputAvailable(i);
+  }
+
+  // Decode up to max of the inputs queued so far, in order. Returns false if
+  // nothing was.
+  bool decode(size_t max = SIZE_MAX) {
+    bool any = false;
+    for (size_t i = 0; i < max; i++) {
+      Input in;
+      size_t output;
+      {
+        std::lock_guard<std::mutex> l(lock);
+        if (queued.empty()) return any;
+        in = queued.front();
+        queued.pop_front();
+        // output buffers are numbered apart from the input ones
+        output = nextOutput++;
+        outputPts[output] = in.ptsUs;
+      }
+      decoder->onOutputAvailable(output, in.eos ? 0 : in.ptsUs,
+                                 in.eos ? 0 : in.size, in.eos);
+      decoder->onInputAvailable(in.index);
+      any = true;
+    }
+    return any;
+  }
+
+  std::vector<Release> takeReleased() {
+    std::lock_guard<std::mutex> l(lock);
+    std::vector<Release> r;
+    r.swap(released);
+    return r;
+  }
+
+ private:
+  struct Input {
+    size_t index;
+    int64_t ptsUs;
+    size_t size;
+    bool eos;
+  };
+
+  AsyncDecoder* decoder = NULL;
+  uint8_t buffers[kBuffers][4096];
+  size_t nextOutput = 0;
+  std::map<size_t, int64_t> outputPts;
+  std::mutex lock;
+  std::deque<Input> queued;
+  std::vector<Release> released;
+};
+
+class FakeTimer : public PresentTimer {
+ public:
+  void wakeAt(int64_t whenNs) override {
+    std::lock_guard<std::mutex> l(lock);
+    wakes++;
+    if (dueNs < 0 || whenNs < dueNs) dueNs = whenNs;
+  }
+  // Whether a wake up is due at nowNs; it is consumed if so
+  bool fire(int64_t nowNs) {
+    std::lock_guard<std::mutex> l(lock);
+    if (dueNs < 0 || dueNs > nowNs) return false;
+    dueNs = -1;
+    return true;
+  }
+
+  int wakes = 0;
+
+ private:
+  std::mutex lock;
+  int64_t dueNs = -1;
+};
+
+#endif  // NATIVE_CODEC_FAKE_MEDIA_H
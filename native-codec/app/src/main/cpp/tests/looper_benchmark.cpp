@@ -0,0 +1,111 @@
+/*
+ * Copyright (C) 2014 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Post to handle latency of looper, and messages handled per second:
+ * one producer posting every 100 us, where the worker sleeps between
+ * messages, then 1, 2 and 4 producers posting as fast as they can, where
+ * the latency is mostly the time spent queued.
+ */
+#include <stdio.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include "looper.h"
+
+namespace {
+
+// Each message carries the looper::now() it was posted at.
+class LatencyLooper : public looper {
+ public:
+  explicit LatencyLooper(size_t messages) { latencies.reserve(messages); }
+  ~LatencyLooper() { quit(); }
+
+  void handle(int, void* data) override {
+    latencies.push_back(now() - *static_cast<int64_t*>(data));
+    handled.fetch_add(1, std::memory_order_release);
+  }
+
+  void waitFor(size_t messages) {
+    while (handled.load(std::memory_order_acquire) < messages) usleep(100);
+  }
+
+  std::vector<int64_t> latencies;  // worker thread until waitFor() returns
+  std::atomic<size_t> handled{0};
+};
+
+void report(const char* name, std::vector<int64_t>* latencies,
+            int64_t elapsedNs) {
+  std::sort(latencies->begin(), latencies->end());
+  size_t n = latencies->size();
+  printf(
+      "%-22s %9.0f msgs/s, latency p50 %8.1f us, p99 %8.1f us, max %8.1f "
+      "us\n",
+      name, n * 1e9 / elapsedNs, (*latencies)[n / 2] / 1e3,
+      (*latencies)[n * 99 / 100] / 1e3, latencies->back() / 1e3);
+}
+
+void paced() {
+  const size_t kMessages = 20000;
+  std::vector<int64_t> postedNs(kMessages);
+  LatencyLooper l(kMessages);
+  int64_t start = looper::now();
+  for (size_t i = 0; i < kMessages; i++) {
+    int64_t due = start + static_cast<int64_t>(i) * 100000;
+    while (looper::now() < due) {
+      int64_t leftUs = (due - looper::now()) / 1000;
+      if (leftUs > 50) usleep(leftUs - 50);
+    }
+    postedNs[i] = looper::now();
+    l.post(0, &postedNs[i]);
+  }
+  l.waitFor(kMessages);
+  report("1 producer, 10k/s", &l.latencies, looper::now() - start);
+}
+
+void flood(int producers) {
+  const size_t kPerProducer = 250000;
+  size_t messages = kPerProducer * producers;
+  std::vector<int64_t> postedNs(messages);
+  LatencyLooper l(messages);
+  int64_t start = looper::now();
+  std::vector<std::thread> threads;
+  for (int p = 0; p < producers; p++) {
+    threads.emplace_back([&l, &postedNs, p] {
+      for (size_t i = p * kPerProducer; i < (p + 1) * kPerProducer; i++) {
+        postedNs[i] = looper::now();
+        l.post(0, &postedNs[i]);
+      }
+    });
+  }
+  for (std::thread& t : threads) t.join();
+  l.waitFor(messages);
+  char name[32];
+  snprintf(name, sizeof(name), "%d producer(s), flood", producers);
+  report(name, &l.latencies, looper::now() - start);
+}
+
+}  // namespace
+
+int main() {
+  paced();
+  for (int producers : {1, 2, 4}) flood(producers);
+  return 0;
+}
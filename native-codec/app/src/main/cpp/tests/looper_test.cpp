@@ -0,0 +1,151 @@
+/*
+ * Copyright (C) 2014 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "looper.h"
+
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace {
+
+const int64_t kMs = 1000000;
+
+// Records what it handles; message kFanOut posts `fanOut` kCount messages
+// from the worker thread itself.
+class RecordingLooper : public looper {
+ public:
+  static const int kCount = 1;
+  static const int kFanOut = 2;
+
+  explicit RecordingLooper(int fanOut = 0) : fanOut(fanOut) {}
+  ~RecordingLooper() { quit(); }
+
+  void handle(int what, void* data) override {
+    if (what == kFanOut) {
+      for (int i = 0; i < fanOut; i++) post(kCount, NULL);
+    }
+    std::lock_guard<std::mutex> lock(mutex);
+    if (what == kCount) {
+      count++;
+    } else {
+      handled.push_back(what);
+    }
+    cond.notify_all();
+  }
+
+  // Wait up to 5s for n kCount messages
+  bool waitForCount(long n) {
+    std::unique_lock<std::mutex> lock(mutex);
+    return cond.wait_for(lock, std::chrono::seconds(5),
+                         [this, n] { return count >= n; });
+  }
+
+  // Wait up to 5s for n other messages
+  std::vector<int> waitForHandled(size_t n) {
+    std::unique_lock<std::mutex> lock(mutex);
+    cond.wait_for(lock, std::chrono::seconds(5),
+                  [this, n] { return handled.size() >= n; });
+    return handled;
+  }
+
+ private:
+  int fanOut;
+  std::mutex mutex;
+  std::condition_variable cond;
+  long count = 0;
+  std::vector<int> handled;
+};
+
+TEST(LooperTest, HandlesPostsInOrder) {
+  RecordingLooper l;
+  for (int what = 10; what < 15; what++) l.post(what, NULL);
+  EXPECT_EQ(l.waitForHandled(5), (std::vector<int>{10, 11, 12, 13, 14}));
+}
+
+TEST(LooperTest, HandlesDelayedPostsByDueTime) {
+  RecordingLooper l;
+  l.postDelayed(12, NULL, 30 * kMs);
+  l.postDelayed(11, NULL, 10 * kMs);
+  l.post(10, NULL);
+  l.postAt(13, NULL, looper::now() + 40 * kMs);
+  EXPECT_EQ(l.waitForHandled(4), (std::vector<int>{10, 11, 12, 13}));
+}
+
+TEST(LooperTest, FlushDropsEarlierPostsOnly) {
+  RecordingLooper l;
+  l.postDelayed(99, NULL, 20 * kMs);
+  l.postDelayed(11, NULL, 20 * kMs);
+  l.flush(99);
+  l.postDelayed(99, NULL, 30 * kMs);
+  EXPECT_EQ(l.waitForHandled(2), (std::vector<int>{11, 99}));
+}
+
+TEST(LooperTest, PostWithFlushDropsEverythingPending) {
+  RecordingLooper l;
+  l.postDelayed(11, NULL, 20 * kMs);
+  l.postDelayed(12, NULL, 20 * kMs);
+  l.post(13, NULL, true);
+  l.postDelayed(14, NULL, 30 * kMs);
+  EXPECT_EQ(l.waitForHandled(2), (std::vector<int>{13, 14}));
+}
+
+TEST(LooperTest, ConcurrentProducers) {
+  const int kProducers = 4;
+  const int kPosts = 20000;
+  RecordingLooper l;
+  std::vector<std::thread> producers;
+  for (int p = 0; p < kProducers; p++) {
+    producers.emplace_back([&l] {
+      for (int i = 0; i < kPosts; i++) l.post(RecordingLooper::kCount, NULL);
+    });
+  }
+  for (auto& producer : producers) producer.join();
+  EXPECT_TRUE(l.waitForCount(kProducers * kPosts));
+}
+
+// The worker posts more messages than the pool holds from handle(), as the
+// decoder does when it reschedules itself: nothing can return to the pool
+// until handle() returns.
+TEST(LooperTest, WorkerPostsBeyondThePool) {
+  RecordingLooper l(3 * looper::kPoolSize);
+  l.post(RecordingLooper::kFanOut, NULL);
+  EXPECT_TRUE(l.waitForCount(3 * looper::kPoolSize));
+}
+
+TEST(LooperTest, MoreDelayedPostsThanThePool) {
+  RecordingLooper l;
+  for (int i = 0; i < 2 * looper::kPoolSize; i++) {
+    l.postDelayed(RecordingLooper::kCount, NULL, (i % 3) * kMs);
+  }
+  EXPECT_TRUE(l.waitForCount(2 * looper::kPoolSize));
+}
+
+TEST(LooperTest, QuitDropsFarAwayPosts) {
+  RecordingLooper l;
+  for (int i = 0; i < 2 * looper::kPoolSize; i++) {
+    l.postDelayed(20, NULL, 3600 * 1000 * kMs);
+  }
+  l.post(10, NULL);
+  EXPECT_EQ(l.waitForHandled(1), std::vector<int>{10});
+  // ~RecordingLooper() quits with the rest still pending
+}
+
+}  // namespace
@@ -0,0 +1,146 @@
+/*
+ * Copyright (C) 2014 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Seek index of an hour of 30 fps video with a sync sample every 2 seconds:
+ * how long building, saving, loading and looking up a seek target take.
+ * Then seeks end to end, from AsyncDecoder::seekTo() to the target frame
+ * handed to the display, on ten minutes of the same video from a fake
+ * extractor and a fake codec taking 1 ms per frame, with and without the
+ * index.
+ */
+#include <stdio.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "async_decoder.h"
+#include "fake_media.h"
+#include "seek_index.h"
+
+namespace {
+
+const int64_t kFrameUs = 33333;
+const int kFrames = 3600 * 30;
+const int kLookups = 1000000;
+
+int64_t nowNs() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+const int kSeekFrames = 600 * 30;
+const int kSeeks = 100;
+const int kDecodeUs = 1000;
+
+// Time from seekTo() to the target frame handed to the display, with the
+// decoder paused so the target is shown as soon as it is decoded.
+void benchmarkSeeks(const SeekIndex* index) {
+  FakeSource source(kSeekFrames, 60);
+  FakeCodec codec;
+  FakeTimer timer;
+  AsyncDecoder decoder(&source, &codec, &timer);
+  codec.attach(&decoder);
+  if (index) decoder.setSeekIndex(index);
+  decoder.start();
+
+  std::mt19937 random(1);
+  std::vector<int64_t> latencies;
+  uint64_t skipped = decoder.getStats().framesSkipped;
+  for (int i = 0; i < kSeeks; i++) {
+    int64_t targetUs = random() % kSeekFrames * kFrameUs;
+    int64_t begin = nowNs();
+    decoder.seekTo(targetUs);
+    bool shown = false;
+    while (!shown && nowNs() - begin < 1000000000LL) {
+      if (codec.decode(1)) {
+        usleep(kDecodeUs);
+      } else {
+        usleep(50);  // let the extractor thread read ahead
+      }
+      int64_t now = nowNs();
+      if (timer.fire(now)) decoder.present(now);
+      for (const FakeCodec::Release& r : codec.takeReleased()) {
+        shown = shown || (r.render && r.ptsUs == targetUs);
+      }
+    }
+    latencies.push_back(nowNs() - begin);
+  }
+  decoder.stop();
+
+  std::sort(latencies.begin(), latencies.end());
+  printf(
+      "seek %s index: p50 %.1f ms, p99 %.1f ms, %.1f frames decoded and "
+      "dropped per seek\n",
+      index ? "with   " : "without", latencies[kSeeks / 2] / 1e6,
+      latencies[kSeeks * 99 / 100] / 1e6,
+      double(decoder.getStats().framesSkipped - skipped) / kSeeks);
+}
+
+}  // namespace
+
+int main() {
+  std::string path = "/tmp/seek_index_benchmark_" + std::to_string(getpid());
+
+  int64_t begin = nowNs();
+  SeekIndex index;
+  for (int i = 0; i < kFrames; i++) {
+    index.addSample(i * kFrameUs, i % 60 == 0);
+  }
+  index.finish();
+  int64_t built = nowNs();
+  if (!index.save(path.c_str(), 1)) {
+    fprintf(stderr, "cannot save %s\n", path.c_str());
+    return 1;
+  }
+  int64_t saved = nowNs();
+  SeekIndex loaded;
+  bool ok = loaded.load(path.c_str(), 1);
+  int64_t done = nowNs();
+  remove(path.c_str());
+  if (!ok) {
+    fprintf(stderr, "cannot load %s\n", path.c_str());
+    return 1;
+  }
+
+  printf("%zu entries: build %.2f ms, save %.2f ms, load %.2f ms\n",
+         loaded.size(), (built - begin) / 1e6, (saved - built) / 1e6,
+         (done - saved) / 1e6);
+
+  int64_t durationUs = loaded.durationUs();
+  int64_t sum = 0;
+  begin = nowNs();
+  for (int i = 0; i < kLookups; i++) {
+    sum += loaded.find(i * 7919LL % durationUs)->ptsUs;
+  }
+  done = nowNs();
+  printf("lookup %.1f ns (checksum %lld)\n",
+         double(done - begin) / kLookups, (long long)sum);
+
+  SeekIndex seekIndex;
+  for (int i = 0; i < kSeekFrames; i++) {
+    seekIndex.addSample(i * kFrameUs, i % 60 == 0);
+  }
+  seekIndex.finish();
+  benchmarkSeeks(NULL);
+  benchmarkSeeks(&seekIndex);
+  return 0;
+}
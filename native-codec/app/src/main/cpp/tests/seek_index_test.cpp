@@ -0,0 +1,188 @@
+/*
+ * Copyright (C) 2014 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "seek_index.h"
+
+#include <gtest/gtest.h>
+#include <stdio.h>
+#include <unistd.h>
+
+#include <string>
+
+namespace {
+
+const int64_t kFrameUs = 33333;
+const int kGop = 30;
+
+/*
+ * 10 GOPs of kGop samples in decode order. Inside a GOP the odd samples are
+ * displayed one frame later than they are decoded, like B-frames.
+ */
+void buildSyntheticIndex(SeekIndex* index) {
+  for (int i = 0; i < 10 * kGop; i++) {
+    bool sync = i % kGop == 0;
+    int64_t reorderUs = !sync && (i % 2) ? kFrameUs : 0;
+    index->addSample(i * kFrameUs + reorderUs, sync);
+  }
+  index->finish();
+}
+
+class SeekIndexFileTest : public testing::Test {
+ protected:
+  void SetUp() override {
+    path = testing::TempDir() + "seek_index_test_" +
+           std::to_string(getpid()) + ".seekidx";
+  }
+  void TearDown() override { remove(path.c_str()); }
+
+  // Overwrite the file at offset with size bytes of data
+  void patch(long offset, const void* data, size_t size) {
+    FILE* f = fopen(path.c_str(), "r+b");
+    ASSERT_NE(f, nullptr);
+    fseek(f, offset, SEEK_SET);
+    fwrite(data, size, 1, f);
+    fclose(f);
+  }
+
+  std::string path;
+};
+
+TEST(SeekIndexTest, FindsTheLastSyncSampleAtOrBefore) {
+  SeekIndex index;
+  buildSyntheticIndex(&index);
+  ASSERT_EQ(index.size(), 10u);
+
+  EXPECT_EQ(index.find(0)->ptsUs, 0);
+  EXPECT_EQ(index.find(-5)->ptsUs, 0);
+  EXPECT_EQ(index.find(30 * kFrameUs)->ptsUs, 30 * kFrameUs);
+  EXPECT_EQ(index.find(45 * kFrameUs)->ptsUs, 30 * kFrameUs);
+  EXPECT_EQ(index.find(int64_t(1) << 40)->ptsUs, 270 * kFrameUs);
+}
+
+TEST(SeekIndexTest, CountsTheSamplesOfEachSyncSample) {
+  SeekIndex index;
+  buildSyntheticIndex(&index);
+  for (int gop = 0; gop < 10; gop++) {
+    EXPECT_EQ(index.find(gop * kGop * kFrameUs)->samples,
+              static_cast<uint32_t>(kGop));
+  }
+  // the last sample is displayed after the last decoded one
+  EXPECT_EQ(index.durationUs(), 299 * kFrameUs + kFrameUs);
+}
+
+TEST(SeekIndexTest, SamplesBeforeTheFirstSyncGetAnEntry) {
+  SeekIndex index;
+  index.addSample(0, false);
+  index.addSample(kFrameUs, false);
+  index.addSample(2 * kFrameUs, true);
+  index.finish();
+  ASSERT_EQ(index.size(), 2u);
+  EXPECT_EQ(index.find(kFrameUs)->samples, 2u);
+}
+
+TEST(SeekIndexTest, EmptyIndexFindsNothing) {
+  SeekIndex index;
+  index.finish();
+  EXPECT_EQ(index.find(0), nullptr);
+}
+
+TEST_F(SeekIndexFileTest, RoundTrips) {
+  SeekIndex index;
+  buildSyntheticIndex(&index);
+  ASSERT_TRUE(index.save(path.c_str(), 42));
+
+  SeekIndex loaded;
+  ASSERT_TRUE(loaded.load(path.c_str(), 42));
+  EXPECT_TRUE(loaded.isFinished());
+  EXPECT_EQ(loaded.size(), index.size());
+  EXPECT_EQ(loaded.durationUs(), index.durationUs());
+  EXPECT_EQ(loaded.find(299 * kFrameUs)->ptsUs, 270 * kFrameUs);
+  EXPECT_EQ(loaded.find(299 * kFrameUs)->samples, static_cast<uint32_t>(kGop));
+}
+
+TEST_F(SeekIndexFileTest, UnfinishedIndexIsNotSaved) {
+  SeekIndex index;
+  index.addSample(0, true);
+  EXPECT_FALSE(index.save(path.c_str(), 42));
+}
+
+TEST_F(SeekIndexFileTest, RejectsAnotherKey) {
+  SeekIndex index;
+  buildSyntheticIndex(&index);
+  ASSERT_TRUE(index.save(path.c_str(), 42));
+  SeekIndex loaded;
+  EXPECT_FALSE(loaded.load(path.c_str(), 43));
+  EXPECT_EQ(loaded.size(), 0u);
+  EXPECT_FALSE(loaded.isFinished());
+}
+
+TEST_F(SeekIndexFileTest, RejectsCorruptEntries) {
+  SeekIndex index;
+  buildSyntheticIndex(&index);
+  ASSERT_TRUE(index.save(path.c_str(), 42));
+  // reserved word of the last entry
+  FILE* f = fopen(path.c_str(), "rb");
+  fseek(f, 0, SEEK_END);
+  long size = ftell(f);
+  fclose(f);
+  uint32_t one = 1;
+  patch(size - 4, &one, sizeof(one));
+
+  SeekIndex loaded;
+  EXPECT_FALSE(loaded.load(path.c_str(), 42));
+  EXPECT_EQ(loaded.size(), 0u);
+}
+
+// A count larger than the file holds must be rejected before it is used to
+// size anything.
+TEST_F(SeekIndexFileTest, RejectsACountTheFileDoesNotHold) {
+  SeekIndex index;
+  buildSyntheticIndex(&index);
+  ASSERT_TRUE(index.save(path.c_str(), 42));
+  uint32_t count = 0xffffffff;
+  patch(8, &count, sizeof(count));  // after magic and version
+
+  SeekIndex loaded;
+  EXPECT_FALSE(loaded.load(path.c_str(), 42));
+  EXPECT_EQ(loaded.size(), 0u);
+}
+
+TEST_F(SeekIndexFileTest, RejectsTrailingBytes) {
+  SeekIndex index;
+  buildSyntheticIndex(&index);
+  ASSERT_TRUE(index.save(path.c_str(), 42));
+  FILE* f = fopen(path.c_str(), "ab");
+  fputc(0, f);
+  fclose(f);
+
+  SeekIndex loaded;
+  EXPECT_FALSE(loaded.load(path.c_str(), 42));
+}
+
+TEST_F(SeekIndexFileTest, MissingFileIsNotLoaded) {
+  SeekIndex loaded;
+  EXPECT_FALSE(loaded.load(path.c_str(), 42));
+}
+
+TEST(SeekIndexTest, HashIsFnv1a) {
+  EXPECT_EQ(SeekIndex::hash("", 0), 14695981039346656037ULL);
+  EXPECT_EQ(SeekIndex::hash("a", 1), 0xaf63dc4c8601ec8cULL);
+  // chaining equals hashing the concatenation
+  EXPECT_EQ(SeekIndex::hash("b", 1, SeekIndex::hash("a", 1)),
+            SeekIndex::hash("ab", 2));
+}
+
+}  // namespace
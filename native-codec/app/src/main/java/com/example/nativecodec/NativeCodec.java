@@ -31,6 +31,7 @@ import android.widget.Button;
 import android.widget.CompoundButton;
 import android.widget.CompoundButton.OnCheckedChangeListener;
 import android.widget.RadioButton;
+import android.widget.SeekBar;
 import android.widget.Spinner;
 
 import java.io.IOException;
@@ -51,6 +52,9 @@ public class NativeCodec extends Activity {
 
     boolean mCreated = false;
     boolean mIsPlaying = false;
+    long mDurationUs = 0;
+
+    SeekBar mSeekBar;
 
     /** Called when the activity is first created. */
     @Override
@@ -58,6 +62,8 @@ public class NativeCodec extends Activity {
         super.onCreate(icicle);
         setContentView(R.layout.main);
 
+        setSeekIndexDirectory(getCacheDir().getAbsolutePath());
+
         mGLView1 = (MyGLSurfaceView) findViewById(R.id.glsurfaceview1);
 
         // set up the Surface 1 video sink
@@ -183,6 +189,7 @@ public class NativeCodec extends Activity {
                 if (mCreated) {
                     mIsPlaying = !mIsPlaying;
                     setPlayingStreamingMediaPlayer(mIsPlaying);
+                    mDurationUs = getStreamingMediaDurationUs();
                 }
             }
 
@@ -196,10 +203,33 @@ public class NativeCodec extends Activity {
             public void onClick(View view) {
                 if (mNativeCodecPlayerVideoSink != null) {
                     rewindStreamingMediaPlayer();
+                    mSeekBar.setProgress(0);
                 }
             }
 
         });
+
+        // native MediaPlayer seek: frame accurate, so dragging scrubs through
+        // the frames; the player only keeps the latest of queued seeks
+        mSeekBar = (SeekBar) findViewById(R.id.seek_native);
+        mSeekBar.setOnSeekBarChangeListener(new SeekBar.OnSeekBarChangeListener() {
+
+            @Override
+            public void onProgressChanged(SeekBar seekBar, int progress, boolean fromUser) {
+                if (fromUser && mCreated && mDurationUs > 0) {
+                    seekStreamingMediaPlayer(mDurationUs * progress / seekBar.getMax());
+                }
+            }
+
+            @Override
+            public void onStartTrackingTouch(SeekBar seekBar) {
+            }
+
+            @Override
+            public void onStopTrackingTouch(SeekBar seekBar) {
+            }
+
+        });
     }
 
     void switchSurface() {
@@ -214,6 +244,7 @@ public class NativeCodec extends Activity {
                 Log.i("@@@", "recreating player");
                 mCreated = createStreamingMediaPlayer(getResources().getAssets(),mSourceString);
                 mIsPlaying = false;
+                mDurationUs = getStreamingMediaDurationUs();
             }
         }
     }
@@ -258,6 +289,9 @@ public class NativeCodec extends Activity {
     public static native void shutdown();
     public static native void setSurface(Surface surface);
     public static native void rewindStreamingMediaPlayer();
+    public static native void seekStreamingMediaPlayer(long positionUs);
+    public static native long getStreamingMediaDurationUs();
+    public static native void setSeekIndexDirectory(String path);
 
     /** Load jni .so on initialization */
     static {
@@ -13,27 +13,13 @@
  * See the License for the specific language governing permissions and
  * limitations under the License.
  */
+package com.example.nativemedia;
 
-#ifndef ANDROID_FOPEN_H
-#define ANDROID_FOPEN_H
-#define __USE_BSD
-#include <android/asset_manager.h>
-#include <stdio.h>
+import androidx.test.ext.junitgtest.GtestRunner;
+import androidx.test.ext.junitgtest.TargetLibrary;
+import org.junit.runner.RunWith;
 
-#ifdef __cplusplus
-extern "C" {
-#endif
-
-/* hijack fopen and route it through the android asset system so that
-   we can pull things out of our packagesk APK */
-
-void android_fopen_set_asset_manager(AAssetManager* manager);
-FILE* android_fopen(const char* fname, const char* mode);
-
-#define fopen(name, mode) android_fopen(name, mode)
-
-#ifdef __cplusplus
-}
-#endif
-
-#endif
+/** Runs the googletest cases of libapp_tests.so on the device. */
+@RunWith(GtestRunner.class)
+@TargetLibrary(libraryName = "app_tests")
+public class NativeTests {}
@@ -28,6 +28,7 @@
 #include <pthread.h>
 #include <stdio.h>
 #include <string.h>
+#include <unistd.h>
 
 // for __android_log_print(ANDROID_LOG_INFO, "YourApp", "formatted message");
 #include <android/log.h>
@@ -42,7 +43,8 @@
 #include <android/asset_manager_jni.h>
 #include <android/native_window_jni.h>
 
-#include "android_fopen.h"
+#include "ts_feeder.h"
+#include "ts_parser.h"
 
 // engine interfaces
 static XAObjectItf engineObject = NULL;
@@ -65,27 +67,49 @@ static XAVolumeItf playerVolItf = NULL;
 // video sink for the player
 static ANativeWindow *theNativeWindow;
 
-// number of buffers in our buffer queue, an arbitrary number
+// default number of buffers in our buffer queue, an arbitrary number
 #define NB_BUFFERS 8
 
 // we're streaming MPEG-2 transport stream data, operate on transport stream
 // block size
-#define MPEG2_TS_PACKET_SIZE 188
+#define MPEG2_TS_PACKET_SIZE TS_FEEDER_PACKET_SIZE
 
-// number of MPEG-2 transport stream blocks per buffer, an arbitrary number
+// default number of MPEG-2 transport stream blocks per buffer, an arbitrary
+// number
 #define PACKETS_PER_BUFFER 10
 
-// determines how much memory we're dedicating to memory caching
-#define BUFFER_SIZE (PACKETS_PER_BUFFER * MPEG2_TS_PACKET_SIZE)
+// buffer queue geometry, see setBufferQueueConfig
+static XAuint32 nbBuffers = NB_BUFFERS;
+static XAuint32 packetsPerBuffer = PACKETS_PER_BUFFER;
 
-// where we cache in memory the data to play
-// note this memory is re-used by the buffer queue callback
-static char dataCache[BUFFER_SIZE * NB_BUFFERS];
+// how long to wait for the reader thread when (re)starting the queue
+#define INITIAL_BUFFER_TIMEOUT_MS 1000
 
-// handle of the file to play
-static FILE *file;
+// the asset to play, and the read-ahead ring it is read into; the ring holds
+// twice as many buffers as the queue, so a full queue still has as much read
+// ahead of it
+static AAsset *asset = NULL;
+static int assetFd = -1;
+static ts_feeder *feeder = NULL;
 static jobject android_java_asset_manager = NULL;
 
+// number of buffers (including EOS) enqueued and not processed yet
+static XAuint32 queuedBuffers = 0;
+
+// Each buffer from the feeder goes through the TS parser, and is queued as
+// the segments of whole packets it splits it into: without garbage, and with
+// a discontinuity marker on the exact packet where the timeline restarts.
+// Only the last segment of a buffer hands it back to the feeder.
+#define MAX_SEGMENTS 4
+static ts_parser *parser = NULL;
+static ts_segment segments[MAX_SEGMENTS];
+static const char *segmentsBuffer = NULL;
+static size_t nbSegments = 0;
+static size_t nextSegment = 0;
+
+// signal a discontinuity on the next segment queued
+static jboolean pendingDiscontinuity = JNI_FALSE;
+
 // has the app reached the end of the file
 static jboolean reachedEof = JNI_FALSE;
 
@@ -94,8 +118,13 @@ static jboolean reachedEof = JNI_FALSE;
 static const int kEosBufferCntxt =
     1980;  // a magic value we can compare against
 
+// constant to identify a buffer context which is a segment of a buffer, but
+// not its last one
+static const int kPartialBufferCntxt = 1981;
+
 // For mutual exclusion between callback thread and application thread(s).
-// The mutex protects reachedEof, discontinuity,
+// The mutex protects reachedEof, discontinuity, queuedBuffers and enqueueing
+// from the feeder's reader thread.
 // The condition is signalled when a discontinuity is acknowledged.
 
 static pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
@@ -106,6 +135,123 @@ static jboolean discontinuity = JNI_FALSE;
 
 static jboolean enqueueInitialBuffers(jboolean discontinuity);
 
+// Split a buffer from the feeder into the segments to queue.
+// Called with the mutex held.
+static void splitBuffer(void *data, size_t size) {
+  segmentsBuffer = (const char *)data;
+  nbSegments = ts_parser_parse(parser, data, size, segments, MAX_SEGMENTS);
+  nextSegment = 0;
+  if (nbSegments == 0) {
+    // nothing but garbage, the feeder frees it after the buffers before it
+    ts_feeder_release(feeder, data);
+  }
+}
+
+// Enqueue the next segment, splitting the next buffer from the feeder if
+// needed, or EOS once the whole file was queued. Called with the mutex held;
+// returns 1 if a segment was enqueued, 0 if the reader thread hasn't filled
+// the next buffer yet, or -1 at EOS.
+static int enqueueNextSegment(void) {
+  XAresult res;
+  while (nextSegment == nbSegments) {
+    void *data;
+    size_t size;
+    int ret = ts_feeder_acquire(feeder, &data, &size);
+    if (ret == 0) {
+      return 0;
+    }
+    if (ret < 0) {
+      // EOF or I/O error, signal EOS
+      XAAndroidBufferItem msgEos[1];
+      msgEos[0].itemKey = XA_ANDROID_ITEMKEY_EOS;
+      msgEos[0].itemSize = 0;
+      // EOS message has no parameters, so the total size of the message is
+      // the size of the key
+      //   plus the size if itemSize, both XAuint32
+      res = (*playerBQItf)
+                ->Enqueue(playerBQItf,
+                          (void *)&kEosBufferCntxt /*pBufferContext*/,
+                          NULL /*pData*/, 0 /*dataLength*/, msgEos /*pMsg*/,
+                          sizeof(XAuint32) * 2 /*msgLength*/);
+      assert(XA_RESULT_SUCCESS == res);
+      queuedBuffers++;
+      reachedEof = JNI_TRUE;
+      return -1;
+    }
+    splitBuffer(data, size);
+  }
+
+  const ts_segment *segment = &segments[nextSegment++];
+  void *context =
+      nextSegment < nbSegments ? (void *)&kPartialBufferCntxt : NULL;
+  if (segment->discontinuity || pendingDiscontinuity) {
+    // signal discontinuity
+    XAAndroidBufferItem items[1];
+    items[0].itemKey = XA_ANDROID_ITEMKEY_DISCONTINUITY;
+    items[0].itemSize = 0;
+    // DISCONTINUITY message has no parameters,
+    //   so the total size of the message is the size of the key
+    //   plus the size if itemSize, both XAuint32
+    res = (*playerBQItf)
+              ->Enqueue(playerBQItf, context /*pBufferContext*/,
+                        (void *)(segmentsBuffer + segment->offset),
+                        segment->size, items /*pMsg*/,
+                        sizeof(XAuint32) * 2 /*msgLength*/);
+    pendingDiscontinuity = JNI_FALSE;
+  } else {
+    res = (*playerBQItf)
+              ->Enqueue(playerBQItf, context /*pBufferContext*/,
+                        (void *)(segmentsBuffer + segment->offset),
+                        segment->size, NULL, 0);
+  }
+  assert(XA_RESULT_SUCCESS == res);
+  queuedBuffers++;
+  return 1;
+}
+
+// Top the buffer queue up with whatever the reader thread has filled.
+// Called with the mutex held.
+static void enqueueFilledBuffers(void) {
+  // don't bother trying to read more data once we've hit EOF
+  while (!reachedEof && queuedBuffers < nbBuffers &&
+         enqueueNextSegment() > 0) {
+  }
+}
+
+// ts_feeder callback: a buffer was filled after the queue ran dry
+static void feederReady(void *cookie) {
+  int ok = pthread_mutex_lock(&mutex);
+  assert(0 == ok);
+  // the player may be gone or about to be rewound
+  if (playerBQItf != NULL && !discontinuity) {
+    enqueueFilledBuffers();
+  }
+  ok = pthread_mutex_unlock(&mutex);
+  assert(0 == ok);
+}
+
+// ts_feeder read function for compressed assets, which have no file
+// descriptor; only ever called from the reader thread
+static ssize_t readAsset(void *cookie, void *buf, size_t size,
+                         uint64_t offset) {
+  AAsset *a = (AAsset *)cookie;
+  if (AAsset_seek64(a, (off64_t)offset, SEEK_SET) < 0) {
+    return -1;
+  }
+  return AAsset_read(a, buf, size);
+}
+
+// ts_parser callback: the PMT of the program we play changed
+static void ProgramChangeCallback(void *cookie, const ts_program *program) {
+  LOGV("Program %u: PCR PID %u, %u streams", program->program_number,
+       program->pcr_pid, program->nb_streams);
+  XAuint32 i;
+  for (i = 0; i < program->nb_streams; i++) {
+    LOGV("  PID %u stream type 0x%02x", program->streams[i].pid,
+         program->streams[i].stream_type);
+  }
+}
+
 // AndroidBufferQueueItf callback to supply MPEG-2 TS packets to the media
 // player
 static XAresult AndroidBufferQueueCallback(
@@ -136,9 +282,12 @@ static XAresult AndroidBufferQueueCallback(
       // clear the buffer queue
       res = (*playerBQItf)->Clear(playerBQItf);
       assert(XA_RESULT_SUCCESS == res);
+      queuedBuffers = 0;
+      nbSegments = nextSegment = 0;
       // rewind the data source so we are guaranteed to be at an appropriate
       // point
-      rewind(file);
+      ts_feeder_rewind(feeder);
+      ts_parser_reset(parser);
       // Enqueue the initial buffers, with a discontinuity indicator on first
       // buffer
       (void)enqueueInitialBuffers(JNI_TRUE);
@@ -156,48 +305,23 @@ static XAresult AndroidBufferQueueCallback(
       LOGV("EOS was processed\n");
       // our buffer with the EOS message has been consumed
       assert(0 == dataSize);
+      queuedBuffers--;
       goto exit;
     }
   }
 
-  // pBufferData is a pointer to a buffer that we previously Enqueued
+  // pBufferData is a pointer to a segment of a buffer that we previously
+  // Enqueued; once its last segment is done hand the buffer back to the
+  // reader thread
   assert((dataSize > 0) && ((dataSize % MPEG2_TS_PACKET_SIZE) == 0));
-  assert(dataCache <= (char *)pBufferData &&
-         (char *)pBufferData < &dataCache[BUFFER_SIZE * NB_BUFFERS]);
-  assert(0 == (((char *)pBufferData - dataCache) % BUFFER_SIZE));
-
-  // don't bother trying to read more data once we've hit EOF
-  if (reachedEof) {
-    goto exit;
+  if (pBufferContext == NULL) {
+    ts_feeder_release(feeder, pBufferData);
   }
+  queuedBuffers--;
 
-  // note we do call fread from multiple threads, but never concurrently
-  size_t bytesRead;
-  bytesRead = fread(pBufferData, 1, BUFFER_SIZE, file);
-  if (bytesRead > 0) {
-    if ((bytesRead % MPEG2_TS_PACKET_SIZE) != 0) {
-      LOGV("Dropping last packet because it is not whole");
-    }
-    size_t packetsRead = bytesRead / MPEG2_TS_PACKET_SIZE;
-    size_t bufferSize = packetsRead * MPEG2_TS_PACKET_SIZE;
-    res = (*caller)->Enqueue(caller, NULL /*pBufferContext*/,
-                             pBufferData /*pData*/, bufferSize /*dataLength*/,
-                             NULL /*pMsg*/, 0 /*msgLength*/);
-    assert(XA_RESULT_SUCCESS == res);
-  } else {
-    // EOF or I/O error, signal EOS
-    XAAndroidBufferItem msgEos[1];
-    msgEos[0].itemKey = XA_ANDROID_ITEMKEY_EOS;
-    msgEos[0].itemSize = 0;
-    // EOS message has no parameters, so the total size of the message is the
-    // size of the key
-    //   plus the size if itemSize, both XAuint32
-    res = (*caller)->Enqueue(
-        caller, (void *)&kEosBufferCntxt /*pBufferContext*/, NULL /*pData*/,
-        0 /*dataLength*/, msgEos /*pMsg*/, sizeof(XAuint32) * 2 /*msgLength*/);
-    assert(XA_RESULT_SUCCESS == res);
-    reachedEof = JNI_TRUE;
-  }
+  // queue the next buffer if it's been read already; if not, the reader
+  // thread queues it from feederReady as soon as it is
+  enqueueFilledBuffers();
 
 exit:
   ok = pthread_mutex_unlock(&mutex);
@@ -280,58 +404,26 @@ void Java_com_example_nativemedia_NativeMedia_createEngine(JNIEnv *env,
 // Enqueue the initial buffers, and optionally signal a discontinuity in the
 // first buffer
 static jboolean enqueueInitialBuffers(jboolean discontinuity) {
-  /* Fill our cache.
-   * We want to read whole packets (integral multiples of MPEG2_TS_PACKET_SIZE).
-   * fread returns units of "elements" not bytes, so we ask for 1-byte elements
-   * and then check that the number of elements is a multiple of the packet
-   * size.
+  /* When starting, wait for the reader thread to read the first buffer, we
+   * don't want to start the player on an empty queue. After a discontinuity
+   * we're on the callback thread, where we don't wait: the reader thread
+   * tops the queue up from feederReady as soon as it has read more.
    */
-  size_t bytesRead;
-  bytesRead = fread(dataCache, 1, BUFFER_SIZE * NB_BUFFERS, file);
-  if (bytesRead <= 0) {
-    // could be premature EOF or I/O error
-    return JNI_FALSE;
-  }
-  if ((bytesRead % MPEG2_TS_PACKET_SIZE) != 0) {
-    LOGV("Dropping last packet because it is not whole");
-  }
-  size_t packetsRead = bytesRead / MPEG2_TS_PACKET_SIZE;
-  LOGV("Initially queueing %zu packets", packetsRead);
-
-  /* Enqueue the content of our cache before starting to play,
-     we don't want to starve the player */
-  size_t i;
-  for (i = 0; i < NB_BUFFERS && packetsRead > 0; i++) {
-    // compute size of this buffer
-    size_t packetsThisBuffer = packetsRead;
-    if (packetsThisBuffer > PACKETS_PER_BUFFER) {
-      packetsThisBuffer = PACKETS_PER_BUFFER;
+  pendingDiscontinuity = discontinuity;
+  if (!discontinuity) {
+    void *data;
+    size_t size;
+    if (ts_feeder_acquire_wait(feeder, &data, &size,
+                               INITIAL_BUFFER_TIMEOUT_MS) <= 0) {
+      // could be premature EOF or I/O error
+      return JNI_FALSE;
     }
-    size_t bufferSize = packetsThisBuffer * MPEG2_TS_PACKET_SIZE;
-    XAresult res;
-    if (discontinuity) {
-      // signal discontinuity
-      XAAndroidBufferItem items[1];
-      items[0].itemKey = XA_ANDROID_ITEMKEY_DISCONTINUITY;
-      items[0].itemSize = 0;
-      // DISCONTINUITY message has no parameters,
-      //   so the total size of the message is the size of the key
-      //   plus the size if itemSize, both XAuint32
-      res = (*playerBQItf)
-                ->Enqueue(playerBQItf, NULL /*pBufferContext*/,
-                          dataCache + i * BUFFER_SIZE, bufferSize,
-                          items /*pMsg*/, sizeof(XAuint32) * 2 /*msgLength*/);
-      discontinuity = JNI_FALSE;
-    } else {
-      res = (*playerBQItf)
-                ->Enqueue(playerBQItf, NULL /*pBufferContext*/,
-                          dataCache + i * BUFFER_SIZE, bufferSize, NULL, 0);
-    }
-    assert(XA_RESULT_SUCCESS == res);
-    packetsRead -= packetsThisBuffer;
+    splitBuffer(data, size);
   }
+  enqueueFilledBuffers();
+  LOGV("Initially queueing %u buffers", queuedBuffers);
 
-  return JNI_TRUE;
+  return queuedBuffers > 0 ? JNI_TRUE : JNI_FALSE;
 }
 
 // create streaming media player
@@ -340,21 +432,38 @@ jboolean Java_com_example_nativemedia_NativeMedia_createStreamingMediaPlayer(
   XAresult res;
 
   android_java_asset_manager = (*env)->NewGlobalRef(env, assetMgr);
-  android_fopen_set_asset_manager(
-      AAssetManager_fromJava(env, android_java_asset_manager));
+  AAssetManager *mgr = AAssetManager_fromJava(env, android_java_asset_manager);
   // convert Java string to UTF-8
   const char *utf8 = (*env)->GetStringUTFChars(env, filename, NULL);
   assert(NULL != utf8);
 
   // open the file to play
-  file = android_fopen(utf8, "rb");
-  if (file == NULL) {
+  asset = AAssetManager_open(mgr, utf8, AASSET_MODE_STREAMING);
+  if (asset == NULL) {
+    (*env)->ReleaseStringUTFChars(env, filename, utf8);
+    return JNI_FALSE;
+  }
+
+  // read it ahead on a thread of its own: with pread() when the asset is
+  // stored uncompressed in the apk, through the asset otherwise
+  ts_feeder_config config = {nbBuffers * 2, packetsPerBuffer};
+  off64_t start, length;
+  assetFd = AAsset_openFileDescriptor64(asset, &start, &length);
+  if (assetFd >= 0) {
+    feeder = ts_feeder_create_fd(&config, assetFd, start, length, feederReady,
+                                 NULL);
+  } else {
+    feeder = ts_feeder_create(&config, readAsset, asset, feederReady, NULL);
+  }
+  parser = ts_parser_create(ProgramChangeCallback, NULL);
+  if (feeder == NULL || parser == NULL || ts_feeder_start(feeder) != 0) {
+    (*env)->ReleaseStringUTFChars(env, filename, utf8);
     return JNI_FALSE;
   }
 
   // configure data source
   XADataLocator_AndroidBufferQueue loc_abq = {XA_DATALOCATOR_ANDROIDBUFFERQUEUE,
-                                              NB_BUFFERS};
+                                              nbBuffers};
   XADataFormat_MIME format_mime = {XA_DATAFORMAT_MIME, XA_ANDROID_MIME_MP2TS,
                                    XA_CONTAINERTYPE_MPEG_TS};
   XADataSource dataSrc = {&loc_abq, &format_mime};
@@ -437,7 +546,12 @@ jboolean Java_com_example_nativemedia_NativeMedia_createStreamingMediaPlayer(
   assert(XA_RESULT_SUCCESS == res);
 
   // enqueue the initial buffers
-  if (!enqueueInitialBuffers(JNI_FALSE)) {
+  int ok = pthread_mutex_lock(&mutex);
+  assert(0 == ok);
+  jboolean queued = enqueueInitialBuffers(JNI_FALSE);
+  ok = pthread_mutex_unlock(&mutex);
+  assert(0 == ok);
+  if (!queued) {
     return JNI_FALSE;
   }
 
@@ -474,6 +588,12 @@ void Java_com_example_nativemedia_NativeMedia_setPlayingStreamingMediaPlayer(
 // shut down the native media system
 void Java_com_example_nativemedia_NativeMedia_shutdown(JNIEnv *env,
                                                        jclass clazz) {
+  // stop reading ahead first, so the reader thread doesn't enqueue into a
+  // player that's going away
+  if (feeder != NULL) {
+    ts_feeder_stop(feeder);
+  }
+
   // destroy streaming media player object, and invalidate all associated
   // interfaces
   if (playerObj != NULL) {
@@ -499,10 +619,40 @@ void Java_com_example_nativemedia_NativeMedia_shutdown(JNIEnv *env,
   }
 
   // close the file
-  if (file != NULL) {
-    fclose(file);
-    file = NULL;
+  if (feeder != NULL) {
+    ts_feeder_stats stats;
+    ts_feeder_get_stats(feeder, &stats);
+    LOGV("Read %llu buffers, %llu underruns, at most %u buffers ahead",
+         (unsigned long long)stats.buffers_filled,
+         (unsigned long long)stats.underruns, stats.max_filled);
+    ts_feeder_destroy(feeder);
+    feeder = NULL;
+  }
+  if (assetFd >= 0) {
+    close(assetFd);
+    assetFd = -1;
+  }
+  if (asset != NULL) {
+    AAsset_close(asset);
+    asset = NULL;
   }
+  if (parser != NULL) {
+    ts_parser_stats stats;
+    ts_parser_get_stats(parser, &stats);
+    LOGV("Parsed %llu packets: %llu sync losses, %llu bytes skipped, "
+         "%llu continuity errors, %llu discontinuities",
+         (unsigned long long)stats.packets,
+         (unsigned long long)stats.sync_losses,
+         (unsigned long long)stats.bytes_skipped,
+         (unsigned long long)stats.cc_errors,
+         (unsigned long long)stats.discontinuities);
+    ts_parser_destroy(parser);
+    parser = NULL;
+  }
+  reachedEof = JNI_FALSE;
+  queuedBuffers = 0;
+  nbSegments = nextSegment = 0;
+  pendingDiscontinuity = JNI_FALSE;
 
   if (android_java_asset_manager) {
     (*env)->DeleteGlobalRef(env, android_java_asset_manager);
@@ -541,7 +691,7 @@ void Java_com_example_nativemedia_NativeMedia_rewindStreamingMediaPlayer(
   }
 
   // make sure the streaming media player was created
-  if (NULL != playerBQItf && NULL != file) {
+  if (NULL != playerBQItf && NULL != feeder) {
     // first wait for buffers currently in queue to be drained
     int ok;
     ok = pthread_mutex_lock(&mutex);
@@ -558,3 +708,12 @@ void Java_com_example_nativemedia_NativeMedia_rewindStreamingMediaPlayer(
     assert(0 == ok);
   }
 }
+
+// set the buffer queue geometry used by the next createStreamingMediaPlayer
+void Java_com_example_nativemedia_NativeMedia_setBufferQueueConfig(
+    JNIEnv *env, jclass clazz, jint buffers, jint packets) {
+  if (buffers > 0 && packets > 0) {
+    nbBuffers = buffers;
+    packetsPerBuffer = packets;
+  }
+}
@@ -0,0 +1,367 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "ts_feeder.h"
+
+#include <gtest/gtest.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "ts_parser.h"
+#include "ts_writer.h"
+
+namespace {
+
+// A synthetic program of count packets.
+std::vector<uint8_t> makeStream(size_t count) {
+  TsWriter writer;
+  writer.pat();
+  writer.pmt();
+  for (size_t i = 2; i < count; i++) {
+    writer.es(i % 3 == 0 ? kVideoPid : kAudioPid);
+  }
+  return writer.stream;
+}
+
+/* A source the test lets read a number of times, to hold the reader thread
+   where it wants it. */
+class GatedSource {
+ public:
+  explicit GatedSource(std::vector<uint8_t> data) : data(std::move(data)) {}
+
+  static ssize_t read(void* cookie, void* buf, size_t size,
+                      uint64_t offset) {
+    GatedSource* self = static_cast<GatedSource*>(cookie);
+    std::unique_lock<std::mutex> lock(self->mutex);
+    self->blocked++;
+    self->cond.notify_all();
+    self->cond.wait(lock, [self] { return self->allowed != 0; });
+    self->blocked--;
+    if (self->allowed > 0) self->allowed--;
+    if (offset >= self->data.size()) return 0;
+    size = std::min<size_t>(size, self->data.size() - offset);
+    memcpy(buf, self->data.data() + offset, size);
+    return size;
+  }
+
+  static void ready(void* cookie) {
+    GatedSource* self = static_cast<GatedSource*>(cookie);
+    std::lock_guard<std::mutex> lock(self->mutex);
+    self->ready_++;
+    self->cond.notify_all();
+  }
+
+  // Let n more reads through, -1 for all of them.
+  void allow(int n) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (allowed >= 0) allowed = n < 0 ? n : allowed + n;
+    cond.notify_all();
+  }
+
+  // Wait until the reader thread is blocked in read().
+  bool waitBlocked() {
+    std::unique_lock<std::mutex> lock(mutex);
+    return cond.wait_for(lock, std::chrono::seconds(5),
+                         [this] { return blocked > 0; });
+  }
+
+  int readyCalls() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return ready_;
+  }
+
+  bool waitReady(int calls) {
+    std::unique_lock<std::mutex> lock(mutex);
+    return cond.wait_for(lock, std::chrono::seconds(5),
+                         [this, calls] { return ready_ >= calls; });
+  }
+
+  std::vector<uint8_t> data;
+
+ private:
+  std::mutex mutex;
+  std::condition_variable cond;
+  int allowed = 0;
+  int blocked = 0;
+  int ready_ = 0;
+};
+
+class TsFeederTest : public testing::Test {
+ protected:
+  void TearDown() override {
+    if (source) source->allow(-1);
+    ts_feeder_destroy(feeder);
+    if (fd >= 0) close(fd);
+  }
+
+  // Feed from a file holding prefix bytes of something else, then stream.
+  void openFile(const std::vector<uint8_t>& stream, const char* prefix,
+                uint32_t nbBuffers, uint32_t packetsPerBuffer) {
+    std::string path = testing::TempDir() + "ts_feeder_XXXXXX";
+    fd = mkstemp(&path[0]);
+    ASSERT_GE(fd, 0);
+    unlink(path.c_str());
+    size_t start = strlen(prefix);
+    ASSERT_EQ(write(fd, prefix, start), static_cast<ssize_t>(start));
+    ASSERT_EQ(write(fd, stream.data(), stream.size()),
+              static_cast<ssize_t>(stream.size()));
+    ts_feeder_config config = {nbBuffers, packetsPerBuffer};
+    feeder = ts_feeder_create_fd(&config, fd, start, stream.size(), NULL,
+                                 NULL);
+    ASSERT_NE(feeder, nullptr);
+  }
+
+  void openGated(std::vector<uint8_t> stream, uint32_t nbBuffers,
+                 uint32_t packetsPerBuffer) {
+    source.reset(new GatedSource(std::move(stream)));
+    ts_feeder_config config = {nbBuffers, packetsPerBuffer};
+    feeder = ts_feeder_create(&config, GatedSource::read, source.get(),
+                              GatedSource::ready, source.get());
+    ASSERT_NE(feeder, nullptr);
+  }
+
+  // Acquire and release everything left, return what was read.
+  std::vector<uint8_t> drain() {
+    std::vector<uint8_t> read;
+    void* data;
+    size_t size;
+    while (ts_feeder_acquire_wait(feeder, &data, &size, 5000) == 1) {
+      const uint8_t* bytes = static_cast<const uint8_t*>(data);
+      read.insert(read.end(), bytes, bytes + size);
+      ts_feeder_release(feeder, data);
+    }
+    return read;
+  }
+
+  ts_feeder_stats stats() {
+    ts_feeder_stats s;
+    ts_feeder_get_stats(feeder, &s);
+    return s;
+  }
+
+  ts_feeder* feeder = NULL;
+  int fd = -1;
+  std::unique_ptr<GatedSource> source;
+};
+
+TEST_F(TsFeederTest, HandsOutTheFileInOrder) {
+  std::vector<uint8_t> stream = makeStream(50);
+  openFile(stream, "not part of the stream", 4, 3);
+  EXPECT_EQ(ts_feeder_buffer_size(feeder), 3u * TS_FEEDER_PACKET_SIZE);
+  ASSERT_EQ(ts_feeder_start(feeder), 0);
+
+  EXPECT_EQ(drain(), stream);
+  void* data;
+  size_t size;
+  EXPECT_EQ(ts_feeder_acquire(feeder, &data, &size), -1);
+
+  ts_feeder_stats s = stats();
+  EXPECT_EQ(s.buffers_filled, 17u);  // 16 of 3 packets and one of 2
+  EXPECT_EQ(s.buffers_acquired, 17u);
+  EXPECT_EQ(s.bytes_read, stream.size());
+  EXPECT_EQ(s.bytes_dropped, 0u);
+  EXPECT_LE(s.max_filled, 4u);
+}
+
+TEST_F(TsFeederTest, FillsNoMoreThanTheRing) {
+  openFile(makeStream(50), "", 4, 2);
+  ASSERT_EQ(ts_feeder_start(feeder), 0);
+
+  void* data[5];
+  size_t size;
+  for (int i = 0; i < 4; i++) {
+    ASSERT_EQ(ts_feeder_acquire_wait(feeder, &data[i], &size, 5000), 1);
+  }
+  // every buffer is with the player
+  EXPECT_EQ(ts_feeder_acquire_wait(feeder, &data[4], &size, 100), 0);
+
+  ts_feeder_release(feeder, data[0]);
+  ASSERT_EQ(ts_feeder_acquire_wait(feeder, &data[4], &size, 5000), 1);
+  EXPECT_EQ(data[4], data[0]);  // the ring wrapped around
+}
+
+TEST_F(TsFeederTest, DropsATrailingPartialPacket) {
+  std::vector<uint8_t> stream = makeStream(10);
+  std::vector<uint8_t> file = stream;
+  file.insert(file.end(), 100, 0x47);
+  openFile(file, "", 4, 4);
+  ASSERT_EQ(ts_feeder_start(feeder), 0);
+
+  EXPECT_EQ(drain(), stream);
+  ts_feeder_stats s = stats();
+  EXPECT_EQ(s.buffers_filled, 3u);
+  EXPECT_EQ(s.bytes_read, file.size());
+  EXPECT_EQ(s.bytes_dropped, 100u);
+}
+
+TEST_F(TsFeederTest, EndsAnEmptyStreamRightAway) {
+  openFile({}, "", 2, 2);
+  ASSERT_EQ(ts_feeder_start(feeder), 0);
+  void* data;
+  size_t size;
+  EXPECT_EQ(ts_feeder_acquire_wait(feeder, &data, &size, 5000), -1);
+  EXPECT_EQ(stats().underruns, 0u);
+}
+
+TEST_F(TsFeederTest, FreesABufferReleasedEarlyAfterTheOlderOnes) {
+  openFile(makeStream(50), "", 4, 2);
+  ASSERT_EQ(ts_feeder_start(feeder), 0);
+
+  void* data[7];
+  size_t size;
+  for (int i = 0; i < 4; i++) {
+    ASSERT_EQ(ts_feeder_acquire_wait(feeder, &data[i], &size, 5000), 1);
+  }
+  ts_feeder_release(feeder, data[2]);
+  ts_feeder_release(feeder, data[1]);
+  // the oldest buffer is still with the player
+  EXPECT_EQ(ts_feeder_acquire_wait(feeder, &data[4], &size, 100), 0);
+
+  // releasing it frees the 3 of them
+  ts_feeder_release(feeder, data[0]);
+  for (int i = 4; i < 7; i++) {
+    ASSERT_EQ(ts_feeder_acquire_wait(feeder, &data[i], &size, 5000), 1);
+    EXPECT_EQ(data[i], data[i - 4]);
+  }
+  // data[3] is the oldest now, releasing a newer one twice frees nothing
+  ts_feeder_release(feeder, data[5]);
+  ts_feeder_release(feeder, data[5]);
+  EXPECT_EQ(ts_feeder_acquire_wait(feeder, &data[0], &size, 100), 0);
+}
+
+// What native-media-jni.c does: a buffer the parser finds nothing in is
+// released right away, while the ones before it are still queued in the
+// player. Playback goes on to the end.
+TEST_F(TsFeederTest, KeepsFlowingPastGarbageBetweenValidPackets) {
+  TsWriter writer;
+  writer.pat();
+  writer.pmt();
+  size_t valid = 2, garbage = 0;
+  for (int i = 0; i < 60; i++) {
+    if (i % 7 == 3) {
+      writer.stream.resize(writer.stream.size() + TS_FEEDER_PACKET_SIZE, 0);
+      garbage++;
+    } else {
+      writer.es(kVideoPid);
+      valid++;
+    }
+  }
+  openFile(writer.stream, "", 4, 1);
+  ts_parser* parser = ts_parser_create(NULL, NULL);
+  ASSERT_NE(parser, nullptr);
+  ASSERT_EQ(ts_feeder_start(feeder), 0);
+
+  std::deque<void*> queued;  // in the player, which holds on to 2 buffers
+  size_t played = 0, skipped = 0;
+  void* data;
+  size_t size;
+  int ret;
+  while ((ret = ts_feeder_acquire_wait(feeder, &data, &size, 5000)) == 1) {
+    ts_segment segments[4];
+    if (ts_parser_parse(parser, static_cast<const uint8_t*>(data), size,
+                        segments, 4) == 0) {
+      ts_feeder_release(feeder, data);
+      skipped++;
+      continue;
+    }
+    queued.push_back(data);
+    if (queued.size() > 2) {
+      ts_feeder_release(feeder, queued.front());
+      queued.pop_front();
+      played++;
+    }
+  }
+  EXPECT_EQ(ret, -1);
+  EXPECT_EQ(played + queued.size(), valid);
+  EXPECT_EQ(skipped, garbage);
+  ts_parser_destroy(parser);
+}
+
+// An acquire that finds nothing is an underrun, and the next fill calls
+// ready() once so the consumer can catch up.
+TEST_F(TsFeederTest, CountsUnderrunsAndCallsReady) {
+  openGated(makeStream(20), 4, 2);
+  ASSERT_EQ(ts_feeder_start(feeder), 0);
+  ASSERT_TRUE(source->waitBlocked());
+
+  void* data;
+  size_t size;
+  EXPECT_EQ(ts_feeder_acquire(feeder, &data, &size), 0);
+  EXPECT_EQ(ts_feeder_acquire(feeder, &data, &size), 0);
+  EXPECT_EQ(stats().underruns, 2u);
+
+  source->allow(1);
+  ASSERT_TRUE(source->waitReady(1));
+  EXPECT_EQ(ts_feeder_acquire(feeder, &data, &size), 1);
+  EXPECT_EQ(memcmp(data, source->data.data(), size), 0);
+
+  // Not starved since: filling more doesn't call ready() again.
+  source->allow(2);
+  ASSERT_EQ(ts_feeder_acquire_wait(feeder, &data, &size, 5000), 1);
+  ASSERT_EQ(ts_feeder_acquire_wait(feeder, &data, &size, 5000), 1);
+  EXPECT_EQ(source->readyCalls(), 1);
+  EXPECT_EQ(stats().underruns, 2u);
+  EXPECT_EQ(stats().buffers_acquired, 3u);
+}
+
+// A rewind forgets every buffer, and drops a read that was in flight.
+TEST_F(TsFeederTest, RewindStartsOverAndDropsReadsInFlight) {
+  std::vector<uint8_t> stream = makeStream(40);
+  openGated(stream, 4, 2);
+  source->allow(2);
+  ASSERT_EQ(ts_feeder_start(feeder), 0);
+
+  void* data;
+  size_t size;
+  ASSERT_EQ(ts_feeder_acquire_wait(feeder, &data, &size, 5000), 1);
+  ASSERT_EQ(ts_feeder_acquire_wait(feeder, &data, &size, 5000), 1);
+  EXPECT_EQ(memcmp(data, stream.data() + size, size), 0);
+  // the third read, at 4 packets, is held
+  ASSERT_TRUE(source->waitBlocked());
+
+  ts_feeder_rewind(feeder);
+  source->allow(-1);
+  EXPECT_EQ(drain(), stream);
+  EXPECT_EQ(stats().bytes_read, 2 * size + stream.size());
+}
+
+TEST_F(TsFeederTest, KeepsFilledBuffersAfterStop) {
+  std::vector<uint8_t> stream = makeStream(8);
+  openFile(stream, "", 4, 2);
+  ASSERT_EQ(ts_feeder_start(feeder), 0);
+  void* data;
+  size_t size;
+  ASSERT_EQ(ts_feeder_acquire_wait(feeder, &data, &size, 5000), 1);
+  ts_feeder_release(feeder, data);
+  // wait for the reader to reach the end
+  while (stats().bytes_read < stream.size()) usleep(1000);
+  ts_feeder_stop(feeder);
+
+  std::vector<uint8_t> rest = drain();
+  EXPECT_EQ(rest, std::vector<uint8_t>(stream.begin() + size, stream.end()));
+}
+
+}  // namespace
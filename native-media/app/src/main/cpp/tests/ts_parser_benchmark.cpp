@@ -0,0 +1,87 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Parses 64 MB of a clean synthetic program in buffers of 10 packets, the
+ * size the player queues, with a handler on the video PID.
+ */
+#include <stdio.h>
+#include <time.h>
+
+#include "ts_parser.h"
+#include "ts_writer.h"
+
+namespace {
+
+const size_t kPackets = 350000;
+const size_t kBufferSize = 10 * TS_PACKET_SIZE;
+const int kRepeats = 10;
+
+void onPacket(void* cookie, const ts_packet_info* packet) {
+  *static_cast<size_t*>(cookie) += packet->payload_size;
+}
+
+double nowS() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+}  // namespace
+
+int main() {
+  TsWriter writer;
+  writer.pat();
+  writer.pmt();
+  int64_t pcr = 0;
+  for (size_t i = 2; i < kPackets; i++) {
+    bool video = i % 3 == 0;
+    bool start = i % 30 == 0;
+    if (!video) {
+      writer.es(kAudioPid);
+    } else {
+      if (start) pcr += 27000 * 10;
+      writer.es(kVideoPid, start ? pcr : TsWriter::kNone,
+                start ? pcr / 300 : TsWriter::kNone);
+    }
+  }
+  const std::vector<uint8_t>& stream = writer.stream;
+
+  size_t payload = 0;
+  ts_parser* parser = ts_parser_create(nullptr, nullptr);
+  ts_parser_set_pid_handler(parser, kVideoPid, onPacket, &payload);
+  ts_segment segments[8];
+  size_t bytes = 0;
+  double begin = nowS();
+  for (int r = 0; r < kRepeats; r++) {
+    ts_parser_reset(parser);
+    for (size_t offset = 0; offset < stream.size(); offset += kBufferSize) {
+      size_t size = std::min(kBufferSize, stream.size() - offset);
+      ts_parser_parse(parser, stream.data() + offset, size, segments, 8);
+      bytes += size;
+    }
+  }
+  double seconds = nowS() - begin;
+
+  ts_parser_stats stats;
+  ts_parser_get_stats(parser, &stats);
+  ts_parser_destroy(parser);
+  printf("%.0f MB/s, %zu payload bytes demuxed, %llu cc errors, "
+         "%llu discontinuities\n",
+         bytes / seconds / 1e6, payload, (unsigned long long)stats.cc_errors,
+         (unsigned long long)stats.discontinuities);
+  return 0;
+}
@@ -0,0 +1,368 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "ts_parser.h"
+
+#include <gtest/gtest.h>
+
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#include "ts_writer.h"
+
+namespace {
+
+class TsParserTest : public testing::Test {
+ protected:
+  void SetUp() override {
+    parser = ts_parser_create(onProgram, this);
+    ASSERT_NE(parser, nullptr);
+    ASSERT_EQ(ts_parser_set_pid_handler(parser, kVideoPid, onPacket, this), 0);
+  }
+  void TearDown() override { ts_parser_destroy(parser); }
+
+  static void onProgram(void* cookie, const ts_program* program) {
+    static_cast<TsParserTest*>(cookie)->programs.push_back(*program);
+  }
+  static void onPacket(void* cookie, const ts_packet_info* packet) {
+    TsParserTest* self = static_cast<TsParserTest*>(cookie);
+    self->packets.push_back(*packet);
+    if (packet->pts != TS_NO_TIMESTAMP) self->pts.push_back(packet->pts);
+  }
+
+  // Parse the stream in buffers of chunk bytes like the player does, and
+  // return the segments with their offsets in the whole stream.
+  std::vector<ts_segment> parse(const std::vector<uint8_t>& stream,
+                                size_t chunk = 10 * TS_PACKET_SIZE,
+                                size_t maxSegments = 8) {
+    std::vector<ts_segment> all;
+    std::vector<ts_segment> segments(maxSegments);
+    for (size_t offset = 0; offset < stream.size(); offset += chunk) {
+      size_t size = std::min(chunk, stream.size() - offset);
+      size_t n = ts_parser_parse(parser, stream.data() + offset, size,
+                                 segments.data(), maxSegments);
+      for (size_t i = 0; i < n; i++) {
+        ts_segment s = segments[i];
+        s.offset += offset;
+        all.push_back(s);
+      }
+    }
+    return all;
+  }
+
+  ts_parser_stats stats() {
+    ts_parser_stats s;
+    ts_parser_get_stats(parser, &s);
+    return s;
+  }
+
+  ts_parser* parser = nullptr;
+  TsWriter writer;
+  std::vector<ts_program> programs;
+  std::vector<ts_packet_info> packets;
+  std::vector<int64_t> pts;
+};
+
+// Segments hold whole packets, in order, each one starting with a sync byte
+void expectAligned(const std::vector<uint8_t>& stream,
+                   const std::vector<ts_segment>& segments) {
+  size_t end = 0;
+  for (const ts_segment& s : segments) {
+    EXPECT_GE(s.offset, end);
+    EXPECT_EQ(s.size % TS_PACKET_SIZE, 0u);
+    ASSERT_LE(s.offset + s.size, stream.size());
+    for (size_t i = 0; i < s.size; i += TS_PACKET_SIZE) {
+      EXPECT_EQ(stream[s.offset + i], TS_SYNC_BYTE);
+    }
+    end = s.offset + s.size;
+  }
+}
+
+size_t forwarded(const std::vector<ts_segment>& segments) {
+  size_t size = 0;
+  for (const ts_segment& s : segments) size += s.size;
+  return size;
+}
+
+TEST_F(TsParserTest, FollowsThePatToTheProgram) {
+  writer.pat();
+  writer.pmt();
+  writer.pmt();  // repeated, not reported again
+  EXPECT_EQ(ts_parser_get_program(parser), nullptr);
+  parse(writer.stream);
+
+  ASSERT_EQ(programs.size(), 1u);
+  const ts_program* program = ts_parser_get_program(parser);
+  ASSERT_NE(program, nullptr);
+  EXPECT_EQ(program->program_number, 1);
+  EXPECT_EQ(program->pmt_pid, kPmtPid);
+  EXPECT_EQ(program->pcr_pid, kVideoPid);
+  ASSERT_EQ(program->nb_streams, 2u);
+  EXPECT_EQ(program->streams[0].pid, kVideoPid);
+  EXPECT_EQ(program->streams[0].stream_type, 0x1b);
+  EXPECT_EQ(program->streams[1].pid, kAudioPid);
+  EXPECT_EQ(program->streams[1].stream_type, 0x0f);
+  EXPECT_EQ(stats().psi_errors, 0u);
+}
+
+TEST_F(TsParserTest, ReportsANewPmtVersion) {
+  writer.pat();
+  writer.pmt(0);
+  writer.pmt(1);
+  parse(writer.stream);
+  ASSERT_EQ(programs.size(), 2u);
+  EXPECT_EQ(programs[1].version, 1);
+}
+
+TEST_F(TsParserTest, RejectsASectionWithABadCrc) {
+  writer.pat();
+  writer.pmt();
+  writer.stream[TS_PACKET_SIZE + 5 + 10] ^= 1;  // in the PMT section
+  parse(writer.stream);
+  EXPECT_TRUE(programs.empty());
+  EXPECT_EQ(stats().psi_errors, 1u);
+}
+
+TEST_F(TsParserTest, DemuxesRegisteredPidsWithTheirTimestamps) {
+  writer.pat();
+  writer.pmt();
+  for (int i = 0; i < 30; i++) {
+    bool start = i % 10 == 0;
+    writer.es(kVideoPid, start ? i * 27000 * 40 : TsWriter::kNone,
+              start ? 90000 + i * 360 : TsWriter::kNone);
+    writer.es(kAudioPid);
+  }
+  std::vector<ts_segment> segments = parse(writer.stream);
+
+  EXPECT_EQ(packets.size(), 30u);  // none of the audio PID
+  EXPECT_EQ(pts, (std::vector<int64_t>{90000, 90000 + 3600, 90000 + 7200}));
+  EXPECT_EQ(packets[10].pcr, 10 * 27000 * 40);
+  EXPECT_TRUE(packets[10].unit_start);
+  EXPECT_EQ(packets[1].pcr, TS_NO_TIMESTAMP);
+  EXPECT_FALSE(packets[1].unit_start);
+  for (const ts_packet_info& p : packets) {
+    EXPECT_EQ(p.pid, kVideoPid);
+    EXPECT_FALSE(p.discontinuity);
+    // payload runs to the end of its packet, in place
+    EXPECT_EQ((p.payload + p.payload_size - writer.stream.data()) %
+                  TS_PACKET_SIZE,
+              0);
+  }
+  // a clean stream is forwarded whole, in one segment per buffer
+  expectAligned(writer.stream, segments);
+  EXPECT_EQ(forwarded(segments), writer.stream.size());
+  EXPECT_EQ(segments.size(), (writer.stream.size() + 1879) / 1880);
+  EXPECT_EQ(stats().packets, writer.stream.size() / TS_PACKET_SIZE);
+  EXPECT_EQ(stats().bytes_skipped, 0u);
+}
+
+TEST_F(TsParserTest, StartsASegmentWhereThePcrJumps) {
+  writer.pat();
+  writer.pmt();
+  for (int i = 0; i < 5; i++) writer.es(kVideoPid, (i + 100) * 2700000);
+  size_t backwards = writer.stream.size();
+  writer.es(kVideoPid, 5 * 27000);
+  writer.es(kVideoPid, 6 * 27000);
+  size_t forwards = writer.stream.size();
+  writer.es(kVideoPid, 27000000 + 6 * 27000);  // 1 s later
+  writer.es(kAudioPid);
+
+  std::vector<ts_segment> segments = parse(writer.stream, writer.stream.size());
+  ASSERT_EQ(segments.size(), 3u);
+  EXPECT_FALSE(segments[0].discontinuity);
+  EXPECT_EQ(segments[1].offset, backwards);
+  EXPECT_TRUE(segments[1].discontinuity);
+  EXPECT_EQ(segments[2].offset, forwards);
+  EXPECT_TRUE(segments[2].discontinuity);
+  EXPECT_EQ(forwarded(segments), writer.stream.size());
+  EXPECT_EQ(stats().discontinuities, 2u);
+}
+
+TEST_F(TsParserTest, PcrWrapIsNotADiscontinuity) {
+  writer.pat();
+  writer.pmt();
+  const int64_t kModulus = (int64_t(1) << 33) * 300;
+  writer.es(kVideoPid, kModulus - 27000);
+  writer.es(kVideoPid, 27000);
+  std::vector<ts_segment> segments = parse(writer.stream);
+  ASSERT_EQ(segments.size(), 1u);
+  EXPECT_EQ(stats().discontinuities, 0u);
+}
+
+TEST_F(TsParserTest, StartsASegmentAtTheDiscontinuityIndicator) {
+  writer.pat();
+  writer.pmt();
+  writer.es(kVideoPid, 27000);
+  writer.es(kAudioPid);
+  size_t flagged = writer.stream.size();
+  writer.es(kVideoPid, TsWriter::kNone, TsWriter::kNone, true);
+  writer.es(kAudioPid);
+
+  std::vector<ts_segment> segments = parse(writer.stream);
+  ASSERT_EQ(segments.size(), 2u);
+  EXPECT_EQ(segments[1].offset, flagged);
+  EXPECT_TRUE(segments[1].discontinuity);
+  EXPECT_TRUE(packets.back().discontinuity);
+}
+
+TEST_F(TsParserTest, SkipsGarbageAndResyncs) {
+  writer.pat();
+  writer.pmt();
+  for (int i = 0; i < 3; i++) writer.es(kVideoPid);
+  size_t garbage = writer.stream.size();
+  // then sync bytes that are not followed by one a packet later
+  writer.stream.insert(writer.stream.end(), 5, 0);
+  writer.stream.insert(writer.stream.end(), 28, TS_SYNC_BYTE);
+  for (int i = 0; i < 3; i++) writer.es(kVideoPid);
+
+  std::vector<ts_segment> segments = parse(writer.stream, writer.stream.size());
+  expectAligned(writer.stream, segments);
+  ASSERT_EQ(segments.size(), 2u);
+  EXPECT_EQ(segments[0].offset + segments[0].size, garbage);
+  EXPECT_EQ(segments[1].offset, garbage + 33);
+  EXPECT_FALSE(segments[1].discontinuity);
+  EXPECT_EQ(packets.size(), 6u);
+  EXPECT_EQ(stats().sync_losses, 1u);
+  EXPECT_EQ(stats().bytes_skipped, 33u);
+}
+
+TEST_F(TsParserTest, SkipsThePacketCutByTheEndOfABuffer) {
+  writer.pat();
+  writer.pmt();
+  for (int i = 0; i < 4; i++) writer.es(kVideoPid);
+  // half of the last packet is lost between two buffers
+  std::vector<uint8_t> first(writer.stream.begin(),
+                             writer.stream.end() - TS_PACKET_SIZE / 2);
+  writer.stream.clear();
+  writer.es(kVideoPid);
+  std::vector<uint8_t> second = writer.stream;
+  second.insert(second.begin(), TS_PACKET_SIZE / 2, 0);
+
+  ts_segment segments[4];
+  ASSERT_EQ(ts_parser_parse(parser, first.data(), first.size(), segments, 4),
+            1u);
+  EXPECT_EQ(segments[0].size, 5u * TS_PACKET_SIZE);
+  ASSERT_EQ(ts_parser_parse(parser, second.data(), second.size(), segments, 4),
+            1u);
+  EXPECT_EQ(segments[0].offset, TS_PACKET_SIZE / 2u);
+  EXPECT_EQ(segments[0].size, size_t(TS_PACKET_SIZE));
+  EXPECT_EQ(stats().sync_losses, 0u);
+  EXPECT_EQ(stats().bytes_skipped, size_t(TS_PACKET_SIZE));
+  EXPECT_EQ(packets.size(), 4u);
+}
+
+TEST_F(TsParserTest, CountsLostAndDuplicatePackets) {
+  writer.pat();
+  writer.pmt();
+  writer.es(kVideoPid);
+  writer.es(kVideoPid);
+  writer.cc[kVideoPid] += 3;  // three packets lost
+  writer.es(kVideoPid);
+  // a duplicate is counted but not delivered again
+  writer.stream.insert(writer.stream.end(), writer.stream.end() - TS_PACKET_SIZE,
+                       writer.stream.end());
+  writer.es(kVideoPid);
+
+  parse(writer.stream);
+  EXPECT_EQ(stats().cc_errors, 1u);
+  ASSERT_EQ(packets.size(), 4u);
+  EXPECT_FALSE(packets[1].discontinuity);
+  EXPECT_TRUE(packets[2].discontinuity);
+  EXPECT_FALSE(packets[3].discontinuity);
+}
+
+TEST_F(TsParserTest, ResetForgetsTheStreamPosition) {
+  writer.pat();
+  writer.pmt();
+  writer.es(kVideoPid, int64_t(100) * 27000000);
+  parse(writer.stream);
+  ts_parser_reset(parser);
+
+  // the source starts over: counters and PCRs restart
+  writer.stream.clear();
+  writer.cc[kVideoPid] = 0;
+  writer.es(kVideoPid, 0);
+  std::vector<ts_segment> segments = parse(writer.stream);
+  ASSERT_EQ(segments.size(), 1u);
+  EXPECT_FALSE(segments[0].discontinuity);
+  EXPECT_EQ(stats().cc_errors, 0u);
+  EXPECT_EQ(stats().discontinuities, 0u);
+  EXPECT_NE(ts_parser_get_program(parser), nullptr);
+}
+
+TEST_F(TsParserTest, RunningOutOfSegmentsKeepsTheRestWhole) {
+  writer.pat();
+  writer.pmt();
+  for (int i = 0; i < 4; i++) {
+    writer.es(kVideoPid, (4 - i) * 27000000);  // jumps back every packet
+  }
+  std::vector<ts_segment> segments = parse(writer.stream, writer.stream.size(), 2);
+  ASSERT_EQ(segments.size(), 2u);
+  EXPECT_EQ(forwarded(segments), writer.stream.size());
+  EXPECT_TRUE(segments[1].discontinuity);
+}
+
+TEST_F(TsParserTest, HandlerTableIsBounded) {
+  int added = 0;
+  for (uint16_t pid = 0x200; pid < 0x240; pid++) {
+    if (ts_parser_set_pid_handler(parser, pid, onPacket, this) == 0) added++;
+  }
+  EXPECT_EQ(added, 15);  // one handler is taken by the video PID
+  // replacing one does not need a new slot
+  EXPECT_EQ(ts_parser_set_pid_handler(parser, kVideoPid, onPacket, this), 0);
+  EXPECT_EQ(ts_parser_set_pid_handler(parser, 0x2000, onPacket, this), -1);
+}
+
+// Random bytes with sync bytes and plausible headers sprinkled in: the
+// segments stay whole packets inside the buffer whatever comes in.
+TEST_F(TsParserTest, RandomInputKeepsSegmentsInTheBuffer) {
+  for (uint16_t pid = 0; pid < 8192; pid += 547) {
+    ts_parser_set_pid_handler(parser, pid, onPacket, this);
+  }
+  srand(1);
+  std::vector<uint8_t> buffer(4000);
+  ts_segment segments[4];
+  for (int iteration = 0; iteration < 20000; iteration++) {
+    size_t size = rand() % buffer.size();
+    for (size_t i = 0; i < size; i++) {
+      int r = rand() % 8;
+      buffer[i] = r == 0 ? TS_SYNC_BYTE : r == 1 ? 0 : r == 2 ? 0xff : rand();
+    }
+    if (size > TS_PACKET_SIZE && rand() % 2) {
+      for (size_t i = 0; i + TS_PACKET_SIZE <= size; i += TS_PACKET_SIZE) {
+        buffer[i] = TS_SYNC_BYTE;
+        buffer[i + 1] &= 0x5f;
+        if (rand() % 2) {
+          buffer[i + 1] &= 0x40;
+          buffer[i + 2] = rand() % 2 ? 0 : 1;
+        }
+      }
+    }
+    size_t max = 1 + rand() % 4;
+    size_t n = ts_parser_parse(parser, buffer.data(), size, segments, max);
+    ASSERT_LE(n, max);
+    for (size_t i = 0; i < n; i++) {
+      ASSERT_LE(segments[i].offset + segments[i].size, size);
+      ASSERT_EQ(segments[i].size % TS_PACKET_SIZE, 0u);
+    }
+    packets.clear();
+    pts.clear();
+    if (rand() % 100 == 0) ts_parser_reset(parser);
+  }
+}
+
+}  // namespace
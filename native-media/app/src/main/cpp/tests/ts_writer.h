@@ -0,0 +1,132 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef TS_WRITER_H
+#define TS_WRITER_H
+
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include "ts_parser.h"
+
+/* Writes the packets of a synthetic program for the tests and the
+   benchmark: a PAT pointing at kPmtPid, a PMT with an H.264 stream on
+   kVideoPid, which carries the PCR, and an AAC one on kAudioPid. */
+
+const uint16_t kPmtPid = 0x1000;
+const uint16_t kVideoPid = 0x100;
+const uint16_t kAudioPid = 0x101;
+
+class TsWriter {
+ public:
+  static const int64_t kNone = -1;
+
+  std::vector<uint8_t> stream;
+  uint8_t cc[8192] = {};  // next continuity counter of each PID
+
+  void pat() {
+    const uint8_t body[] = {0x00, 0x01, uint8_t(0xe0 | kPmtPid >> 8),
+                            uint8_t(kPmtPid)};
+    psi(TS_PID_PAT, 0x00, 1, 0, body, sizeof(body));
+  }
+
+  void pmt(uint8_t version = 0) {
+    const uint8_t body[] = {
+        uint8_t(0xe0 | kVideoPid >> 8), uint8_t(kVideoPid), 0xf0, 0x00,
+        0x1b, uint8_t(0xe0 | kVideoPid >> 8), uint8_t(kVideoPid), 0xf0, 0x00,
+        0x0f, uint8_t(0xe0 | kAudioPid >> 8), uint8_t(kAudioPid), 0xf0, 0x00};
+    psi(kPmtPid, 0x02, 1, version, body, sizeof(body));
+  }
+
+  // An elementary stream packet with an optional PCR (27 MHz), PES header
+  // with pts (90 kHz) and discontinuity_indicator.
+  void es(uint16_t pid, int64_t pcr = kNone, int64_t pts = kNone,
+          bool discontinuity = false) {
+    uint8_t* pkt = packet(pid, pts != kNone);
+    size_t offset = 4;
+    if (pcr != kNone || discontinuity) {
+      pkt[3] |= 0x20;
+      pkt[4] = 7;
+      pkt[5] = (discontinuity ? 0x80 : 0) | (pcr != kNone ? 0x10 : 0);
+      int64_t base = pcr / 300, ext = pcr % 300;
+      pkt[6] = base >> 25;
+      pkt[7] = base >> 17;
+      pkt[8] = base >> 9;
+      pkt[9] = base >> 1;
+      pkt[10] = ((base & 1) << 7) | 0x7e | (ext >> 8);
+      pkt[11] = ext;
+      offset = 12;
+    }
+    if (pts != kNone) {
+      uint8_t* pes = pkt + offset;
+      const uint8_t header[] = {0, 0, 1, 0xe0, 0, 0, 0x80, 0x80, 5};
+      memcpy(pes, header, sizeof(header));
+      pes[9] = 0x21 | ((pts >> 29) & 0x0e);
+      pes[10] = pts >> 22;
+      pes[11] = ((pts >> 14) & 0xfe) | 1;
+      pes[12] = pts >> 7;
+      pes[13] = ((pts << 1) & 0xfe) | 1;
+    }
+  }
+
+ private:
+  uint8_t* packet(uint16_t pid, bool unitStart) {
+    stream.resize(stream.size() + TS_PACKET_SIZE, 0xaa);
+    uint8_t* pkt = stream.data() + stream.size() - TS_PACKET_SIZE;
+    pkt[0] = TS_SYNC_BYTE;
+    pkt[1] = (unitStart ? 0x40 : 0) | pid >> 8;
+    pkt[2] = pid;
+    pkt[3] = 0x10 | (cc[pid]++ & 0x0f);
+    return pkt;
+  }
+
+  void psi(uint16_t pid, uint8_t table, uint16_t extension, uint8_t version,
+           const uint8_t* body, size_t size) {
+    uint8_t* pkt = packet(pid, true);
+    memset(pkt + 4, 0xff, TS_PACKET_SIZE - 4);
+    pkt[4] = 0;  // pointer_field
+    uint8_t* s = pkt + 5;
+    size_t length = 5 + size + 4;
+    s[0] = table;
+    s[1] = 0xb0 | length >> 8;
+    s[2] = length;
+    s[3] = extension >> 8;
+    s[4] = extension;
+    s[5] = 0xc1 | (version & 0x1f) << 1;
+    s[6] = 0;
+    s[7] = 0;
+    memcpy(s + 8, body, size);
+    uint32_t crc = crc32(s, 8 + size);
+    s[8 + size] = crc >> 24;
+    s[9 + size] = crc >> 16;
+    s[10 + size] = crc >> 8;
+    s[11 + size] = crc;
+  }
+
+  static uint32_t crc32(const uint8_t* data, size_t size) {
+    uint32_t crc = 0xffffffff;
+    for (size_t i = 0; i < size; i++) {
+      crc ^= uint32_t(data[i]) << 24;
+      for (int bit = 0; bit < 8; bit++) {
+        crc = crc & 0x80000000 ? (crc << 1) ^ 0x04c11db7 : crc << 1;
+      }
+    }
+    return crc;
+  }
+};
+
+#endif
@@ -0,0 +1,298 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "ts_feeder.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+typedef struct {
+  int fd;
+  off_t start;
+  off_t length;
+} fd_source;
+
+struct ts_feeder {
+  uint32_t nb_buffers;
+  uint32_t buffer_size;
+  char* data;    // nb_buffers * buffer_size
+  size_t* lens;  // bytes of whole packets in each filled buffer
+  char* done;    // acquired buffers released ahead of the oldest one
+
+  ts_feeder_read_func read;
+  void* read_cookie;
+  ts_feeder_ready_func ready;
+  void* ready_cookie;
+  fd_source fd_src;
+
+  pthread_mutex_t mutex;
+  pthread_cond_t space;   // signalled when a buffer is released
+  pthread_cond_t filled;  // signalled when a buffer is filled
+  pthread_t thread;
+  int running;
+
+  // monotonic counters, the ring index is the counter modulo nb_buffers:
+  // [release, acquire) acquired, [acquire, fill) filled, the rest free
+  uint64_t release;
+  uint64_t acquire;
+  uint64_t fill;
+
+  uint64_t offset;      // next byte to read
+  uint64_t generation;  // bumped by rewind, drops reads in flight
+  int eof;
+  int starved;  // acquire came back empty since the last fill
+
+  ts_feeder_stats stats;
+};
+
+static ssize_t fd_read(void* cookie, void* buf, size_t size,
+                       uint64_t offset) {
+  fd_source* src = (fd_source*)cookie;
+  if (offset >= (uint64_t)src->length) return 0;
+  if (size > (uint64_t)src->length - offset) {
+    size = (uint64_t)src->length - offset;
+  }
+  ssize_t ret;
+  do {
+    ret = pread(src->fd, buf, size, src->start + (off_t)offset);
+  } while (ret < 0 && errno == EINTR);
+  return ret;
+}
+
+ts_feeder* ts_feeder_create(const ts_feeder_config* config,
+                            ts_feeder_read_func read, void* read_cookie,
+                            ts_feeder_ready_func ready, void* ready_cookie) {
+  if (!config->nb_buffers || !config->packets_per_buffer) return NULL;
+
+  ts_feeder* f = (ts_feeder*)calloc(1, sizeof(ts_feeder));
+  if (!f) return NULL;
+  f->nb_buffers = config->nb_buffers;
+  f->buffer_size = config->packets_per_buffer * TS_FEEDER_PACKET_SIZE;
+  f->data = (char*)malloc((size_t)f->nb_buffers * f->buffer_size);
+  f->lens = (size_t*)calloc(f->nb_buffers, sizeof(size_t));
+  f->done = (char*)calloc(f->nb_buffers, 1);
+  if (!f->data || !f->lens || !f->done) {
+    free(f->data);
+    free(f->lens);
+    free(f->done);
+    free(f);
+    return NULL;
+  }
+  f->read = read;
+  f->read_cookie = read_cookie;
+  f->ready = ready;
+  f->ready_cookie = ready_cookie;
+  pthread_mutex_init(&f->mutex, NULL);
+  pthread_cond_init(&f->space, NULL);
+  pthread_cond_init(&f->filled, NULL);
+  return f;
+}
+
+ts_feeder* ts_feeder_create_fd(const ts_feeder_config* config, int fd,
+                               off_t start, off_t length,
+                               ts_feeder_ready_func ready, void* ready_cookie) {
+  ts_feeder* f = ts_feeder_create(config, fd_read, NULL, ready, ready_cookie);
+  if (!f) return NULL;
+  f->fd_src.fd = fd;
+  f->fd_src.start = start;
+  f->fd_src.length = length;
+  f->read_cookie = &f->fd_src;
+#ifdef POSIX_FADV_SEQUENTIAL
+  posix_fadvise(fd, start, length, POSIX_FADV_SEQUENTIAL);
+#endif
+  return f;
+}
+
+void ts_feeder_destroy(ts_feeder* f) {
+  if (!f) return;
+  ts_feeder_stop(f);
+  pthread_cond_destroy(&f->filled);
+  pthread_cond_destroy(&f->space);
+  pthread_mutex_destroy(&f->mutex);
+  free(f->done);
+  free(f->lens);
+  free(f->data);
+  free(f);
+}
+
+// Fill one buffer from offset, retrying short reads. Returns the bytes read;
+// less than the buffer size means the end of the stream.
+static size_t read_buffer(ts_feeder* f, char* buf, uint64_t offset) {
+  size_t got = 0;
+  while (got < f->buffer_size) {
+    ssize_t n = f->read(f->read_cookie, buf + got, f->buffer_size - got,
+                        offset + got);
+    if (n <= 0) break;  // EOF or I/O error, both end the stream
+    got += n;
+  }
+  return got;
+}
+
+static void* reader_thread(void* arg) {
+  ts_feeder* f = (ts_feeder*)arg;
+  pthread_mutex_lock(&f->mutex);
+  while (f->running) {
+    if (f->eof || f->fill - f->release == f->nb_buffers) {
+      pthread_cond_wait(&f->space, &f->mutex);
+      continue;
+    }
+    uint32_t index = f->fill % f->nb_buffers;
+    char* buf = f->data + (size_t)index * f->buffer_size;
+    uint64_t offset = f->offset;
+    uint64_t generation = f->generation;
+    pthread_mutex_unlock(&f->mutex);
+
+    size_t got = read_buffer(f, buf, offset);
+
+    pthread_mutex_lock(&f->mutex);
+    if (generation != f->generation) continue;  // rewound meanwhile
+
+    size_t whole = got - got % TS_FEEDER_PACKET_SIZE;
+    f->offset += got;
+    f->stats.bytes_read += got;
+    if (got < f->buffer_size) {
+      f->eof = 1;
+      f->stats.bytes_dropped += got - whole;
+    }
+    if (whole) {
+      f->lens[index] = whole;
+      f->fill++;
+      f->stats.buffers_filled++;
+      uint32_t ahead = f->fill - f->acquire;
+      if (ahead > f->stats.max_filled) f->stats.max_filled = ahead;
+    }
+    pthread_cond_broadcast(&f->filled);
+
+    if (f->starved && f->ready) {
+      f->starved = 0;
+      pthread_mutex_unlock(&f->mutex);
+      f->ready(f->ready_cookie);
+      pthread_mutex_lock(&f->mutex);
+    }
+  }
+  pthread_mutex_unlock(&f->mutex);
+  return NULL;
+}
+
+int ts_feeder_start(ts_feeder* f) {
+  pthread_mutex_lock(&f->mutex);
+  int ret = 0;
+  if (!f->running) {
+    f->running = 1;
+    ret = pthread_create(&f->thread, NULL, reader_thread, f);
+    if (ret) f->running = 0;
+  }
+  pthread_mutex_unlock(&f->mutex);
+  return ret;
+}
+
+void ts_feeder_stop(ts_feeder* f) {
+  pthread_mutex_lock(&f->mutex);
+  int running = f->running;
+  f->running = 0;
+  pthread_cond_broadcast(&f->space);
+  pthread_mutex_unlock(&f->mutex);
+  if (running) pthread_join(f->thread, NULL);
+}
+
+// mutex held
+static int take_locked(ts_feeder* f, void** data, size_t* size) {
+  if (f->acquire == f->fill) return f->eof ? -1 : 0;
+  uint32_t index = f->acquire % f->nb_buffers;
+  *data = f->data + (size_t)index * f->buffer_size;
+  *size = f->lens[index];
+  f->acquire++;
+  f->stats.buffers_acquired++;
+  return 1;
+}
+
+int ts_feeder_acquire(ts_feeder* f, void** data, size_t* size) {
+  pthread_mutex_lock(&f->mutex);
+  int ret = take_locked(f, data, size);
+  if (ret == 0) {
+    f->stats.underruns++;
+    f->starved = 1;
+  }
+  pthread_mutex_unlock(&f->mutex);
+  return ret;
+}
+
+int ts_feeder_acquire_wait(ts_feeder* f, void** data, size_t* size,
+                           int timeout_ms) {
+  struct timespec deadline;
+  clock_gettime(CLOCK_REALTIME, &deadline);
+  deadline.tv_sec += timeout_ms / 1000;
+  deadline.tv_nsec += (long)(timeout_ms % 1000) * 1000000;
+  if (deadline.tv_nsec >= 1000000000) {
+    deadline.tv_sec++;
+    deadline.tv_nsec -= 1000000000;
+  }
+
+  pthread_mutex_lock(&f->mutex);
+  int ret;
+  while ((ret = take_locked(f, data, size)) == 0 && f->running) {
+    if (pthread_cond_timedwait(&f->filled, &f->mutex, &deadline)) break;
+  }
+  pthread_mutex_unlock(&f->mutex);
+  return ret;
+}
+
+void ts_feeder_release(ts_feeder* f, void* data) {
+  size_t total = (size_t)f->nb_buffers * f->buffer_size;
+  if ((char*)data < f->data || (char*)data >= f->data + total) return;
+  uint32_t index = ((char*)data - f->data) / f->buffer_size;
+
+  pthread_mutex_lock(&f->mutex);
+  // ignore buffers that aren't acquired, e.g. from before a rewind
+  uint32_t age = (index + f->nb_buffers - f->release % f->nb_buffers) %
+                 f->nb_buffers;
+  if (age < f->acquire - f->release) {
+    f->done[index] = 1;
+    // a buffer only becomes free once all the older ones are released too
+    uint64_t release = f->release;
+    while (f->release < f->acquire && f->done[f->release % f->nb_buffers]) {
+      f->done[f->release % f->nb_buffers] = 0;
+      f->release++;
+    }
+    if (f->release != release) pthread_cond_signal(&f->space);
+  }
+  pthread_mutex_unlock(&f->mutex);
+}
+
+void ts_feeder_rewind(ts_feeder* f) {
+  pthread_mutex_lock(&f->mutex);
+  f->generation++;
+  f->release = f->acquire = f->fill = 0;
+  memset(f->done, 0, f->nb_buffers);
+  f->offset = 0;
+  f->eof = 0;
+  f->starved = 0;
+  pthread_cond_signal(&f->space);
+  pthread_mutex_unlock(&f->mutex);
+}
+
+uint32_t ts_feeder_buffer_size(const ts_feeder* f) { return f->buffer_size; }
+
+void ts_feeder_get_stats(ts_feeder* f, ts_feeder_stats* stats) {
+  pthread_mutex_lock(&f->mutex);
+  *stats = f->stats;
+  pthread_mutex_unlock(&f->mutex);
+}
@@ -0,0 +1,103 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef TS_FEEDER_H
+#define TS_FEEDER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* A read-ahead thread filling a ring of MPEG-2 TS buffers, so that whoever
+   hands buffers to the player (the buffer queue callback) never waits for
+   I/O. Buffers always hold whole 188 byte packets.
+
+   Each buffer goes round the ring: free -> filled by the reader thread ->
+   acquired by the consumer (queued in the player) -> released when the
+   player is done with it -> free. Buffers are acquired in ring order, and
+   may be released in any order: a buffer released early, such as one
+   holding nothing worth queueing, is freed once the older ones are. */
+
+#define TS_FEEDER_PACKET_SIZE 188
+
+typedef struct ts_feeder ts_feeder;
+
+typedef struct {
+  uint32_t nb_buffers;          // buffers in the ring
+  uint32_t packets_per_buffer;  // TS packets per buffer
+} ts_feeder_config;
+
+typedef struct {
+  uint64_t buffers_filled;
+  uint64_t buffers_acquired;
+  uint64_t underruns;      // acquire found no filled buffer before EOF
+  uint64_t bytes_read;
+  uint64_t bytes_dropped;  // trailing partial packet
+  uint32_t max_filled;     // most buffers ever filled ahead of the consumer
+} ts_feeder_stats;
+
+/* Read up to size bytes at offset into buf. Returns the number of bytes
+   read, 0 at the end of the stream, or -1 on error. Only ever called from
+   the reader thread. */
+typedef ssize_t (*ts_feeder_read_func)(void* cookie, void* buf, size_t size,
+                                       uint64_t offset);
+
+/* Called from the reader thread when it filled a buffer after acquire()
+   came back empty, so the consumer can pick it up outside of its usual
+   callback. */
+typedef void (*ts_feeder_ready_func)(void* cookie);
+
+ts_feeder* ts_feeder_create(const ts_feeder_config* config,
+                            ts_feeder_read_func read, void* read_cookie,
+                            ts_feeder_ready_func ready, void* ready_cookie);
+
+/* Same, reading length bytes at start of fd with pread(). The fd stays
+   owned by the caller. */
+ts_feeder* ts_feeder_create_fd(const ts_feeder_config* config, int fd,
+                               off_t start, off_t length,
+                               ts_feeder_ready_func ready, void* ready_cookie);
+
+void ts_feeder_destroy(ts_feeder* feeder);
+
+int ts_feeder_start(ts_feeder* feeder);
+/* Stop the reader thread. Buffers already filled can still be acquired. */
+void ts_feeder_stop(ts_feeder* feeder);
+
+/* Take the next filled buffer without blocking. Returns 1 and sets data and
+   size, 0 if nothing is ready yet, or -1 once the whole stream was handed
+   out. */
+int ts_feeder_acquire(ts_feeder* feeder, void** data, size_t* size);
+/* Same, waiting up to timeout_ms for a buffer; doesn't count underruns. */
+int ts_feeder_acquire_wait(ts_feeder* feeder, void** data, size_t* size,
+                           int timeout_ms);
+/* Give back an acquired buffer, data must point into that buffer. */
+void ts_feeder_release(ts_feeder* feeder, void* data);
+/* Forget all buffers, including acquired ones, and read from the start of
+   the stream again. */
+void ts_feeder_rewind(ts_feeder* feeder);
+
+uint32_t ts_feeder_buffer_size(const ts_feeder* feeder);
+void ts_feeder_get_stats(ts_feeder* feeder, ts_feeder_stats* stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
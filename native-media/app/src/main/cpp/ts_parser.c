@@ -0,0 +1,424 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "ts_parser.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define NB_PIDS 8192
+#define MAX_HANDLERS 16
+// 3 byte header plus the largest section_length PAT and PMT may have
+#define MAX_SECTION_SIZE 1024
+
+// PCRs wrap at 2^33 * 300; they must come at least every 100 ms, so a jump
+// of more than this, or backwards, is a new timeline
+#define PCR_MODULUS (((int64_t)1 << 33) * 300)
+#define PCR_MAX_GAP (27000000 / 2)
+
+typedef struct {
+  ts_pid_func func;
+  void* cookie;
+} pid_handler;
+
+typedef struct {
+  uint8_t data[MAX_SECTION_SIZE];
+  size_t size;
+  int active;  // data holds the start of a section
+} psi_section;
+
+struct ts_parser {
+  ts_program_func on_program;
+  void* cookie;
+
+  // last continuity counter of each PID, 0x10 set once one was seen
+  uint8_t cc[NB_PIDS];
+  // 1 + index in handlers, 0 for none
+  uint8_t handler_index[NB_PIDS];
+  pid_handler handlers[MAX_HANDLERS];
+  uint32_t nb_handlers;
+
+  psi_section pat;
+  psi_section pmt;
+  int have_pmt_pid;
+  uint16_t pmt_pid;
+  int have_program;
+  ts_program program;
+
+  int64_t last_pcr;
+  size_t skip;  // rest of a packet cut by the end of the last buffer
+
+  uint32_t crc_table[256];
+  ts_parser_stats stats;
+};
+
+static void init_crc_table(uint32_t* table) {
+  // CRC-32/MPEG-2: polynomial 0x04c11db7, MSB first, no reflection
+  for (uint32_t i = 0; i < 256; i++) {
+    uint32_t crc = i << 24;
+    for (int bit = 0; bit < 8; bit++) {
+      crc = (crc & 0x80000000) ? (crc << 1) ^ 0x04c11db7 : crc << 1;
+    }
+    table[i] = crc;
+  }
+}
+
+static uint32_t crc32_mpeg(const uint32_t* table, const uint8_t* data,
+                           size_t size) {
+  uint32_t crc = 0xffffffff;
+  for (size_t i = 0; i < size; i++) {
+    crc = (crc << 8) ^ table[(crc >> 24) ^ data[i]];
+  }
+  return crc;
+}
+
+ts_parser* ts_parser_create(ts_program_func on_program, void* cookie) {
+  ts_parser* p = (ts_parser*)calloc(1, sizeof(ts_parser));
+  if (!p) return NULL;
+  p->on_program = on_program;
+  p->cookie = cookie;
+  p->last_pcr = TS_NO_TIMESTAMP;
+  init_crc_table(p->crc_table);
+  return p;
+}
+
+void ts_parser_destroy(ts_parser* p) { free(p); }
+
+int ts_parser_set_pid_handler(ts_parser* p, uint16_t pid, ts_pid_func func,
+                              void* cookie) {
+  if (pid >= NB_PIDS) return -1;
+  uint8_t index = p->handler_index[pid];
+  if (!index) {
+    if (p->nb_handlers == MAX_HANDLERS) return -1;
+    index = ++p->nb_handlers;
+    p->handler_index[pid] = index;
+  }
+  p->handlers[index - 1].func = func;
+  p->handlers[index - 1].cookie = cookie;
+  return 0;
+}
+
+void ts_parser_reset(ts_parser* p) {
+  memset(p->cc, 0, sizeof(p->cc));
+  p->pat.active = 0;
+  p->pmt.active = 0;
+  p->last_pcr = TS_NO_TIMESTAMP;
+  p->skip = 0;
+}
+
+const ts_program* ts_parser_get_program(const ts_parser* p) {
+  return p->have_program ? &p->program : NULL;
+}
+
+void ts_parser_get_stats(const ts_parser* p, ts_parser_stats* stats) {
+  *stats = p->stats;
+}
+
+static void handle_pat(ts_parser* p, const uint8_t* sec, size_t end) {
+  // follow the first program, program 0 points at the network PID
+  for (size_t i = 8; i + 4 <= end; i += 4) {
+    uint16_t program_number = (sec[i] << 8) | sec[i + 1];
+    uint16_t pid = ((sec[i + 2] & 0x1f) << 8) | sec[i + 3];
+    if (program_number == 0) continue;
+    if (!p->have_pmt_pid || p->pmt_pid != pid) {
+      p->pmt_pid = pid;
+      p->have_pmt_pid = 1;
+      p->pmt.active = 0;
+    }
+    return;
+  }
+}
+
+static void handle_pmt(ts_parser* p, const uint8_t* sec, size_t end) {
+  ts_program program;
+  memset(&program, 0, sizeof(program));
+  program.program_number = (sec[3] << 8) | sec[4];
+  program.pmt_pid = p->pmt_pid;
+  program.version = (sec[5] >> 1) & 0x1f;
+  if (p->have_program &&
+      program.program_number == p->program.program_number &&
+      program.pmt_pid == p->program.pmt_pid &&
+      program.version == p->program.version) {
+    return;  // repeated PMT
+  }
+  program.pcr_pid = ((sec[8] & 0x1f) << 8) | sec[9];
+
+  size_t i = 12 + (((sec[10] & 0x0f) << 8) | sec[11]);
+  while (i + 5 <= end) {
+    size_t es_info_length = ((sec[i + 3] & 0x0f) << 8) | sec[i + 4];
+    if (program.nb_streams < TS_MAX_STREAMS) {
+      ts_stream* s = &program.streams[program.nb_streams++];
+      s->stream_type = sec[i];
+      s->pid = ((sec[i + 1] & 0x1f) << 8) | sec[i + 2];
+    }
+    i += 5 + es_info_length;
+  }
+  if (i != end) {
+    p->stats.psi_errors++;
+    return;
+  }
+
+  if (!p->have_program || program.pcr_pid != p->program.pcr_pid) {
+    p->last_pcr = TS_NO_TIMESTAMP;
+  }
+  p->program = program;
+  p->have_program = 1;
+  if (p->on_program) p->on_program(p->cookie, &p->program);
+}
+
+static void handle_section(ts_parser* p, uint16_t pid, const uint8_t* sec,
+                           size_t size) {
+  // long form header (8 bytes) and CRC, the CRC over all of it comes out 0
+  if (size < 12 || !(sec[1] & 0x80) ||
+      crc32_mpeg(p->crc_table, sec, size) != 0) {
+    p->stats.psi_errors++;
+    return;
+  }
+  if (!(sec[5] & 0x01)) return;  // not applicable yet
+
+  if (pid == TS_PID_PAT && sec[0] == 0x00) {
+    handle_pat(p, sec, size - 4);
+  } else if (pid != TS_PID_PAT && sec[0] == 0x02) {
+    handle_pmt(p, sec, size - 4);
+  }
+}
+
+// Add up to size bytes to the section being collected; returns how many
+// were used.
+static size_t append_section(ts_parser* p, psi_section* s, uint16_t pid,
+                             const uint8_t* data, size_t size) {
+  size_t used = 0;
+  if (s->size < 3) {
+    used = 3 - s->size;
+    if (used > size) used = size;
+    memcpy(s->data + s->size, data, used);
+    s->size += used;
+    if (s->size < 3) return used;
+  }
+  size_t want = 3 + (((s->data[1] & 0x0f) << 8) | s->data[2]);
+  if (want > MAX_SECTION_SIZE) {
+    p->stats.psi_errors++;
+    s->active = 0;
+    return size;
+  }
+  size_t n = want - s->size;
+  if (n > size - used) n = size - used;
+  memcpy(s->data + s->size, data + used, n);
+  s->size += n;
+  used += n;
+  if (s->size == want) {
+    s->active = 0;
+    handle_section(p, pid, s->data, want);
+  }
+  return used;
+}
+
+static void feed_psi(ts_parser* p, psi_section* s, uint16_t pid,
+                     int unit_start, int lost, const uint8_t* data,
+                     size_t size) {
+  if (lost) s->active = 0;
+  if (!unit_start) {
+    if (s->active) append_section(p, s, pid, data, size);
+    return;
+  }
+  if (!size) return;
+
+  // pointer_field: bytes finishing the previous section
+  size_t pointer = data[0];
+  data++;
+  size--;
+  if (pointer > size) {
+    p->stats.psi_errors++;
+    s->active = 0;
+    return;
+  }
+  if (s->active) append_section(p, s, pid, data, pointer);
+  data += pointer;
+  size -= pointer;
+
+  // then any number of sections, up to 0xff stuffing
+  while (size && data[0] != 0xff) {
+    s->size = 0;
+    s->active = 1;
+    size_t used = append_section(p, s, pid, data, size);
+    if (s->active) break;  // continues in the next packet
+    data += used;
+    size -= used;
+  }
+}
+
+static int64_t pes_pts(const uint8_t* pes, size_t size) {
+  if (size < 14 || pes[0] || pes[1] || pes[2] != 0x01) return TS_NO_TIMESTAMP;
+  switch (pes[3]) {
+    // streams without the optional PES header
+    case 0xbc: case 0xbe: case 0xbf: case 0xf0: case 0xf1: case 0xf2:
+    case 0xf8: case 0xff:
+      return TS_NO_TIMESTAMP;
+  }
+  if ((pes[6] & 0xc0) != 0x80 || !(pes[7] & 0x80)) return TS_NO_TIMESTAMP;
+  return ((int64_t)(pes[9] & 0x0e) << 29) | ((int64_t)pes[10] << 22) |
+         ((int64_t)(pes[11] & 0xfe) << 14) | ((int64_t)pes[12] << 7) |
+         (pes[13] >> 1);
+}
+
+// Parse one packet; returns whether the program's timeline restarts at it.
+static int parse_packet(ts_parser* p, const uint8_t* pkt) {
+  p->stats.packets++;
+  if (pkt[1] & 0x80) {
+    p->stats.transport_errors++;
+    return 0;
+  }
+  uint16_t pid = ((pkt[1] & 0x1f) << 8) | pkt[2];
+  if (pid == TS_PID_NULL) return 0;
+
+  int afc = (pkt[3] >> 4) & 0x03;
+  size_t offset = 4;
+  int flagged = 0;
+  int64_t pcr = TS_NO_TIMESTAMP;
+  if (afc & 0x02) {
+    size_t length = pkt[4];
+    if (length > (afc & 0x01 ? 182 : 183)) {
+      p->stats.transport_errors++;
+      return 0;
+    }
+    if (length) {
+      flagged = pkt[5] & 0x80;
+      if ((pkt[5] & 0x10) && length >= 7) {
+        int64_t base = ((int64_t)pkt[6] << 25) | ((int64_t)pkt[7] << 17) |
+                       ((int64_t)pkt[8] << 9) | ((int64_t)pkt[9] << 1) |
+                       (pkt[10] >> 7);
+        pcr = base * 300 + (((pkt[10] & 0x01) << 8) | pkt[11]);
+      }
+    }
+    offset += 1 + length;
+  }
+
+  // the counter only moves on packets with payload, and may repeat once
+  int lost = 0, duplicate = 0;
+  if (afc & 0x01) {
+    uint8_t cc = pkt[3] & 0x0f;
+    uint8_t last = p->cc[pid];
+    if (last && !flagged) {
+      if (cc == (last & 0x0f)) {
+        duplicate = 1;
+      } else if (cc != ((last + 1) & 0x0f)) {
+        p->stats.cc_errors++;
+        lost = 1;
+      }
+    }
+    p->cc[pid] = 0x10 | cc;
+  }
+
+  int timeline = 0;
+  if (p->have_program && pid == p->program.pcr_pid) {
+    if (flagged) {
+      timeline = 1;
+    } else if (pcr != TS_NO_TIMESTAMP && p->last_pcr != TS_NO_TIMESTAMP) {
+      int64_t delta = (pcr - p->last_pcr + PCR_MODULUS) % PCR_MODULUS;
+      timeline = delta > PCR_MAX_GAP;
+    }
+    if (pcr != TS_NO_TIMESTAMP || flagged) p->last_pcr = pcr;
+    if (timeline) p->stats.discontinuities++;
+  }
+  if (duplicate) return timeline;
+
+  const uint8_t* payload = pkt + offset;
+  size_t payload_size = (afc & 0x01) ? TS_PACKET_SIZE - offset : 0;
+  int unit_start = pkt[1] & 0x40;
+  if (pid == TS_PID_PAT) {
+    feed_psi(p, &p->pat, pid, unit_start, lost, payload, payload_size);
+  } else if (p->have_pmt_pid && pid == p->pmt_pid) {
+    feed_psi(p, &p->pmt, pid, unit_start, lost, payload, payload_size);
+  }
+
+  uint8_t index = p->handler_index[pid];
+  if (index) {
+    ts_packet_info info;
+    info.pid = pid;
+    info.unit_start = unit_start != 0;
+    info.discontinuity = lost || flagged;
+    info.pcr = pcr;
+    info.pts = unit_start ? pes_pts(payload, payload_size) : TS_NO_TIMESTAMP;
+    info.payload = payload;
+    info.payload_size = payload_size;
+    pid_handler* h = &p->handlers[index - 1];
+    h->func(h->cookie, &info);
+  }
+  return timeline;
+}
+
+// First offset from pos on that looks like a packet start: a sync byte
+// followed by another one a packet later, if the buffer goes that far.
+static size_t resync(const uint8_t* data, size_t pos, size_t size) {
+  for (;;) {
+    const uint8_t* sync = memchr(data + pos, TS_SYNC_BYTE, size - pos);
+    if (!sync) return size;
+    pos = sync - data;
+    if (pos + TS_PACKET_SIZE >= size ||
+        data[pos + TS_PACKET_SIZE] == TS_SYNC_BYTE) {
+      return pos;
+    }
+    pos++;
+  }
+}
+
+size_t ts_parser_parse(ts_parser* p, const uint8_t* data, size_t size,
+                       ts_segment* segments, size_t max_segments) {
+  size_t n = 0;
+  size_t start = 0;  // of the open segment
+  int open = 0, discontinuity = 0;
+
+  size_t pos = p->skip < size ? p->skip : size;
+  p->stats.bytes_skipped += pos;
+  p->skip -= pos;
+
+  while (pos + TS_PACKET_SIZE <= size) {
+    if (data[pos] != TS_SYNC_BYTE) {
+      if (open) {
+        segments[n++] = (ts_segment){start, pos - start, discontinuity};
+        open = 0;
+      }
+      size_t next = resync(data, pos + 1, size);
+      p->stats.sync_losses++;
+      p->stats.bytes_skipped += next - pos;
+      pos = next;
+      continue;
+    }
+    if (!open && n == max_segments) break;
+
+    int timeline = parse_packet(p, data + pos);
+    if (open && timeline && n + 1 < max_segments) {
+      segments[n++] = (ts_segment){start, pos - start, discontinuity};
+      open = 0;
+    }
+    if (!open) {
+      start = pos;
+      discontinuity = timeline;
+      open = 1;
+    }
+    pos += TS_PACKET_SIZE;
+  }
+  if (open) segments[n++] = (ts_segment){start, pos - start, discontinuity};
+
+  // a packet cut by the end of the buffer is lost, skip its rest too
+  if (pos < size) {
+    if (data[pos] == TS_SYNC_BYTE && pos + TS_PACKET_SIZE > size) {
+      p->skip = pos + TS_PACKET_SIZE - size;
+    }
+    p->stats.bytes_skipped += size - pos;
+  }
+  return n;
+}
@@ -0,0 +1,121 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef TS_PARSER_H
+#define TS_PARSER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* An MPEG-2 TS parser working in place on the buffers handed to the player.
+   It checks sync bytes and resyncs past garbage, follows the PAT and the PMT
+   of the first program, checks continuity counters, and extracts PCRs and
+   PES PTSs.
+
+   Each buffer is split into segments of whole, aligned packets: garbage is
+   left out, and a new segment starts at each packet where the program's
+   timeline is discontinuous (discontinuity_indicator on the PCR PID, or a
+   PCR jump), so the caller can queue the segments with a discontinuity
+   marker on exactly that packet. Nothing is copied but PSI sections. */
+
+#define TS_PACKET_SIZE 188
+#define TS_SYNC_BYTE 0x47
+#define TS_PID_PAT 0x0000
+#define TS_PID_NULL 0x1fff
+#define TS_MAX_STREAMS 16
+#define TS_NO_TIMESTAMP (-1)
+
+typedef struct ts_parser ts_parser;
+
+typedef struct {
+  uint16_t pid;
+  uint8_t stream_type;  // ISO/IEC 13818-1 table 2-34, e.g. 0x1b for H.264
+} ts_stream;
+
+typedef struct {
+  uint16_t program_number;
+  uint16_t pmt_pid;
+  uint16_t pcr_pid;
+  uint8_t version;
+  uint32_t nb_streams;
+  ts_stream streams[TS_MAX_STREAMS];
+} ts_program;
+
+typedef struct {
+  size_t offset;      // in the buffer passed to ts_parser_parse
+  size_t size;        // whole packets
+  int discontinuity;  // the timeline restarts at the first packet
+} ts_segment;
+
+/* One packet of a PID with a handler. payload points into the parsed
+   buffer and is only valid during the call. */
+typedef struct {
+  uint16_t pid;
+  int unit_start;     // payload starts a PES packet or PSI section
+  int discontinuity;  // packets were lost or the source flagged one
+  int64_t pcr;        // 27 MHz, or TS_NO_TIMESTAMP
+  int64_t pts;        // 90 kHz, of a PES packet starting here, or
+                      // TS_NO_TIMESTAMP
+  const uint8_t* payload;
+  size_t payload_size;
+} ts_packet_info;
+
+typedef struct {
+  uint64_t packets;
+  uint64_t bytes_skipped;     // garbage and packets cut by a resync
+  uint64_t sync_losses;
+  uint64_t cc_errors;         // continuity counter jumps
+  uint64_t transport_errors;  // transport_error_indicator set
+  uint64_t psi_errors;        // malformed sections or bad CRCs
+  uint64_t discontinuities;   // timeline discontinuities found
+} ts_parser_stats;
+
+typedef void (*ts_program_func)(void* cookie, const ts_program* program);
+typedef void (*ts_pid_func)(void* cookie, const ts_packet_info* packet);
+
+/* on_program is called whenever the PMT of the program changes. */
+ts_parser* ts_parser_create(ts_program_func on_program, void* cookie);
+void ts_parser_destroy(ts_parser* parser);
+
+/* Demux pid to func. Returns 0, or -1 if there are too many handlers. */
+int ts_parser_set_pid_handler(ts_parser* parser, uint16_t pid,
+                              ts_pid_func func, void* cookie);
+
+/* Parse size bytes of data, which continue the previously parsed buffer.
+   Fills at most max_segments segments and returns how many; if it runs out
+   of segments, later discontinuities aren't split out and data after later
+   garbage is skipped. */
+size_t ts_parser_parse(ts_parser* parser, const uint8_t* data, size_t size,
+                       ts_segment* segments, size_t max_segments);
+
+/* Forget the stream position (continuity counters, last PCR, partial
+   packets and sections), e.g. after the source was rewound. The program
+   and the handlers are kept. */
+void ts_parser_reset(ts_parser* parser);
+
+/* NULL until a PMT was found. */
+const ts_program* ts_parser_get_program(const ts_parser* parser);
+void ts_parser_get_stats(const ts_parser* parser, ts_parser_stats* stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -38,6 +38,11 @@ import java.io.IOException;
 public class NativeMedia extends Activity {
     static final String TAG = "NativeMedia";
 
+    // buffer queue geometry of the native player: number of buffers, and
+    // MPEG-2 TS packets per buffer
+    static final int NATIVE_BUFFERS = 8;
+    static final int NATIVE_PACKETS_PER_BUFFER = 10;
+
     String mSourceString = null;
     String mSinkString = null;
 
@@ -263,6 +268,7 @@ public class NativeMedia extends Activity {
                         mNativeMediaPlayerVideoSink = mSelectedVideoSink;
                     }
                     if (mSourceString != null) {
+                        setBufferQueueConfig(NATIVE_BUFFERS, NATIVE_PACKETS_PER_BUFFER);
                         created = createStreamingMediaPlayer(assetMgr, mSourceString);
                     }
                 }
@@ -346,6 +352,7 @@ public class NativeMedia extends Activity {
     public static native void shutdown();
     public static native void setSurface(Surface surface);
     public static native void rewindStreamingMediaPlayer();
+    public static native void setBufferQueueConfig(int nbBuffers, int packetsPerBuffer);
 
     /** Load jni .so on initialization */
     static {
@@ -18,6 +18,7 @@
 #include <jni.h>
 #include <pthread.h>
 #include <stdio.h>
+#include <string.h>
 #include <unistd.h>
 
 #include <atomic>
@@ -27,6 +28,8 @@
 #include <amidi/AMidi.h>
 
 #include "AndroidDebug.h"
+#include "MidiReceiver.h"
+#include "MidiSendScheduler.h"
 #include "MidiSpec.h"
 
 static AMidiDevice* sNativeReceiveDevice = NULL;
@@ -36,48 +39,38 @@ static AMidiOutputPort* sMidiOutputPort = NULL;
 static AMidiDevice* sNativeSendDevice = NULL;
 static AMidiInputPort* sMidiInputPort = NULL;
 
-static pthread_t sReadThread;
-static std::atomic<bool> sReading(false);
-
 // The Data Callback
-extern JavaVM* theJvm;           // Need this for allocating data buffer for...
+extern JavaVM* theJvm;           // Need this for attaching the read thread...
 extern jobject dataCallbackObj;  // This is the (Java) object that implements...
 extern jmethodID midDataCallback;  // ...this callback routine
 
-static void SendTheReceivedData(uint8_t* data, int numBytes) {
-  JNIEnv* env;
-  theJvm->AttachCurrentThread(&env, NULL);
-  if (env == NULL) {
-    LOGE("Error retrieving JNI Env");
-  }
-
-  // Allocate the Java array and fill with received data
-  jbyteArray ret = env->NewByteArray(numBytes);
-  env->SetByteArrayRegion(ret, 0, numBytes, (jbyte*)data);
-
-  // send it to the (Java) callback
-  env->CallVoidMethod(dataCallbackObj, midDataCallback, ret);
-}
+// The batches of received events, shared with Java as a direct ByteBuffer
+static const int32_t kReceiveBatchCapacity = 256;
+static MidiEvent sReceiveBatch[kReceiveBatchCapacity];
+static jobject sReceiveBatchBuffer = NULL;
 
 #if 0
 // unblock this method if logging of the midi messages is required.
 /**
- * Formats a midi message set and outputs to the log
- * @param   timestamp   The timestamp for when the message(s) was received
- * @param   dataBytes   The MIDI message bytes
- * @params  numDataBytew    The number of bytes in the MIDI message(s)
+ * Formats a batch of midi events and outputs them to the log
+ * @param   events      The decoded events
+ * @param   numEvents   The number of events in the batch
  */
-static void logMidiBuffer(int64_t timestamp, uint8_t* dataBytes, size_t numDataBytes) {
+static void logMidiBuffer(const MidiEvent* events, int32_t numEvents) {
 #define DUMP_BUFFER_SIZE 1024
-    char midiDumpBuffer[DUMP_BUFFER_SIZE];
-    memset(midiDumpBuffer, 0, sizeof(midiDumpBuffer));
-    int pos = snprintf(midiDumpBuffer, DUMP_BUFFER_SIZE,
-            "%" PRIx64 " ", timestamp);
-    for (uint8_t *b = dataBytes, *e = b + numDataBytes; b < e; ++b) {
-        pos += snprintf(midiDumpBuffer + pos, DUMP_BUFFER_SIZE - pos,
-                "%02x ", *b);
+    for (const MidiEvent *event = events, *end = events + numEvents;
+         event < end; ++event) {
+        char midiDumpBuffer[DUMP_BUFFER_SIZE];
+        memset(midiDumpBuffer, 0, sizeof(midiDumpBuffer));
+        int pos = snprintf(midiDumpBuffer, DUMP_BUFFER_SIZE,
+                "%" PRIx64 " %02x [%x] ", event->timestamp, event->status,
+                event->sysex);
+        for (int index = 0; index < event->length; ++index) {
+            pos += snprintf(midiDumpBuffer + pos, DUMP_BUFFER_SIZE - pos,
+                    "%02x ", event->data[index]);
+        }
+        LOGD("%s", midiDumpBuffer);
     }
-    LOGD("%s", midiDumpBuffer);
 }
 #endif
 
@@ -85,50 +78,59 @@ static void logMidiBuffer(int64_t timestamp, uint8_t* dataBytes, size_t numDataB
  * Receiving API
  */
 /**
- * This routine polls the input port and dispatches received data to the
- * application-provided (Java) callback.
+ * MidiReceivePort reading the AMidi output port.
  */
-static void* readThreadRoutine(void* context) {
-  (void)context;  // unused
-
-  sReading = true;
-  // AMidiOutputPort* outputPort = sMidiOutputPort.load();
-  AMidiOutputPort* outputPort = sMidiOutputPort;
+class AMidiReceivePort : public MidiReceivePort {
+ public:
+  explicit AMidiReceivePort(AMidiOutputPort* port) : mPort(port) {}
 
-  const size_t MAX_BYTES_TO_RECEIVE = 128;
-  uint8_t incomingMessage[MAX_BYTES_TO_RECEIVE];
+  ssize_t receive(int32_t* opcode, uint8_t* buffer, size_t maxBytes,
+                  size_t* numBytesReceived, int64_t* timestamp) override {
+    return AMidiOutputPort_receive(mPort, opcode, buffer, maxBytes,
+                                   numBytesReceived, timestamp);
+  }
 
-  while (sReading) {
-    // AMidiOutputPort_receive is non-blocking, so let's not burn up the CPU
-    // unnecessarily
-    usleep(2000);
+ private:
+  AMidiOutputPort* mPort;
+};
 
-    int32_t opcode;
-    size_t numBytesReceived;
-    int64_t timestamp;
-    ssize_t numMessagesReceived = AMidiOutputPort_receive(
-        outputPort, &opcode, incomingMessage, MAX_BYTES_TO_RECEIVE,
-        &numBytesReceived, &timestamp);
-
-    if (numMessagesReceived < 0) {
-      LOGW("Failure receiving MIDI data %zd", numMessagesReceived);
-      // Exit the thread
-      sReading = false;
+/**
+ * MidiBatchSink dispatching the batches to the application-provided (Java)
+ * callback. The read thread is attached to the VM once, for as long as it
+ * runs, and every batch goes through the same direct ByteBuffer, so a
+ * delivery allocates nothing.
+ */
+class JavaBatchSink : public MidiBatchSink {
+ public:
+  bool onThreadStart() override {
+    if (theJvm->AttachCurrentThread(&mEnv, NULL) != JNI_OK) {
+      LOGE("Error attaching the MIDI read thread");
+      return false;
     }
-    if (numMessagesReceived > 0 && numBytesReceived >= 0) {
-      if (opcode == AMIDI_OPCODE_DATA &&
-          (incomingMessage[0] & kMIDISysCmdChan) != kMIDISysCmdChan) {
-        // (optionally) Dump to log
-        // logMidiBuffer(timestamp, incomingMessage, numBytesReceived);
-        SendTheReceivedData(incomingMessage, numBytesReceived);
-      } else if (opcode == AMIDI_OPCODE_FLUSH) {
-        // ignore
-      }
+    return true;
+  }
+
+  void onBatch(const MidiEvent* events, int32_t numEvents) override {
+    (void)events;  // Java reads them through sReceiveBatchBuffer
+    // (optionally) Dump to log
+    // logMidiBuffer(events, numEvents);
+    mEnv->CallVoidMethod(dataCallbackObj, midDataCallback,
+                         sReceiveBatchBuffer, (jint)numEvents);
+    if (mEnv->ExceptionCheck()) {
+      mEnv->ExceptionDescribe();
+      mEnv->ExceptionClear();
     }
-  }  // end while(sReading)
+  }
 
-  return NULL;
-}
+  void onThreadStop() override { theJvm->DetachCurrentThread(); }
+
+ private:
+  JNIEnv* mEnv;
+};
+
+static AMidiReceivePort* sReceivePort = NULL;
+static JavaBatchSink sBatchSink;
+static MidiReceiver* sMidiReceiver = NULL;
 
 //
 // JNI Functions
@@ -155,10 +157,20 @@ void Java_com_example_nativemidi_AppMidiManager_startReadingMidi(
   // sMidiOutputPort.store(outputPort);
   sMidiOutputPort = outputPort;
 
+  if (sReceiveBatchBuffer == NULL) {
+    jobject buffer =
+        env->NewDirectByteBuffer(sReceiveBatch, sizeof(sReceiveBatch));
+    sReceiveBatchBuffer = env->NewGlobalRef(buffer);
+    env->DeleteLocalRef(buffer);
+  }
+
   // Start read thread
-  // pthread_init(true);
-  /*int pthread_result =*/pthread_create(&sReadThread, NULL, readThreadRoutine,
-                                         NULL);
+  sReceivePort = new AMidiReceivePort(sMidiOutputPort);
+  sMidiReceiver = new MidiReceiver(sReceivePort, &sBatchSink, sReceiveBatch,
+                                   kReceiveBatchCapacity);
+  if (!sMidiReceiver->start()) {
+    LOGE("Error starting the MIDI read thread");
+  }
 }
 
 /**
@@ -168,9 +180,19 @@ void Java_com_example_nativemidi_AppMidiManager_startReadingMidi(
  */
 void Java_com_example_nativemidi_AppMidiManager_stopReadingMidi(JNIEnv*,
                                                                 jobject) {
-  // need some synchronization here
-  sReading = false;
-  pthread_join(sReadThread, NULL);
+  if (sMidiReceiver != NULL) {
+    sMidiReceiver->stop();
+    LOGI("Received %" PRId64 " MIDI events in %" PRId64 " deliveries",
+         sMidiReceiver->numEvents(), sMidiReceiver->numBatches());
+    delete sMidiReceiver;
+    sMidiReceiver = NULL;
+    delete sReceivePort;
+    sReceivePort = NULL;
+  }
+  if (sMidiOutputPort != NULL) {
+    AMidiOutputPort_close(sMidiOutputPort);
+    sMidiOutputPort = NULL;
+  }
 
   /*media_status_t status =*/AMidiDevice_release(sNativeReceiveDevice);
   sNativeReceiveDevice = NULL;
@@ -179,16 +201,47 @@ void Java_com_example_nativemidi_AppMidiManager_stopReadingMidi(JNIEnv*,
 /*
  * Sending API
  */
+/**
+ * MidiSendPort writing to the AMidi input port.
+ */
+class AMidiSendPort : public MidiSendPort {
+ public:
+  explicit AMidiSendPort(AMidiInputPort* port) : mPort(port) {}
+
+  ssize_t sendWithTimestamp(const uint8_t* data, size_t numBytes,
+                            int64_t timestamp) override {
+    return AMidiInputPort_sendWithTimestamp(mPort, data, numBytes, timestamp);
+  }
+
+ private:
+  AMidiInputPort* mPort;
+};
+
+static AMidiSendPort* sSendPort = NULL;
+static MonotonicMidiClock sSendClock;
+static MidiSendScheduler* sSendScheduler = NULL;
+
+// The (Java) direct ByteBuffer messages are staged in, see scheduleMidi()
+static const uint8_t* sSendStaging = NULL;
+static jlong sSendStagingCapacity = 0;
+
+// A staged message: int64_t timestamp, uint16_t length, then its bytes,
+// unaligned and in native byte order.
+static const size_t kStagedHeaderSize = sizeof(int64_t) + sizeof(uint16_t);
+
 /**
  * Native implementation of TBMidiManager.startWritingMidi() method.
- * Opens the first "input" port from specified MIDI device for writing.
+ * Opens the first "input" port from specified MIDI device for writing and
+ * starts the thread sending the scheduled messages.
  * @param   env  JNI Env pointer.
  * @param   (unnamed)   TBMidiManager (Java) object.
  * @param   midiDeviceObj   (Java) MidiDevice object.
  * @param   portNumber      The index of the "input" port to open.
+ * @param   stagingBuffer   (Java) direct ByteBuffer messages are staged in.
  */
 void Java_com_example_nativemidi_AppMidiManager_startWritingMidi(
-    JNIEnv* env, jobject, jobject midiDeviceObj, jint portNumber) {
+    JNIEnv* env, jobject, jobject midiDeviceObj, jint portNumber,
+    jobject stagingBuffer) {
   AMidiDevice_fromJava(env, midiDeviceObj, &sNativeSendDevice);
   // int32_t deviceType = AMidiDevice_getType(sNativeReceiveDevice);
   // ssize_t numPorts = AMidiDevice_getNumInputPorts(sNativeSendDevice);
@@ -197,6 +250,17 @@ void Java_com_example_nativemidi_AppMidiManager_startWritingMidi(
   AMidiInputPort_open(sNativeSendDevice, portNumber, &inputPort);
   // sMidiInputPort.store(inputPort);
   sMidiInputPort = inputPort;
+
+  // The Java object keeps the buffer alive as long as it can send.
+  sSendStaging = (const uint8_t*)env->GetDirectBufferAddress(stagingBuffer);
+  sSendStagingCapacity = env->GetDirectBufferCapacity(stagingBuffer);
+
+  // Start send thread
+  sSendPort = new AMidiSendPort(sMidiInputPort);
+  sSendScheduler = new MidiSendScheduler(sSendPort, &sSendClock);
+  if (!sSendScheduler->start()) {
+    LOGE("Error starting the MIDI send thread");
+  }
 }
 
 /**
@@ -206,25 +270,60 @@ void Java_com_example_nativemidi_AppMidiManager_startWritingMidi(
  */
 void Java_com_example_nativemidi_AppMidiManager_stopWritingMidi(JNIEnv*,
                                                                 jobject) {
+  if (sSendScheduler != NULL) {
+    sSendScheduler->stop();
+    LOGI("Sent %" PRId64 " MIDI messages in %" PRId64 " calls",
+         sSendScheduler->numMessages(), sSendScheduler->numSends());
+    delete sSendScheduler;
+    sSendScheduler = NULL;
+    delete sSendPort;
+    sSendPort = NULL;
+  }
+  if (sMidiInputPort != NULL) {
+    AMidiInputPort_close(sMidiInputPort);
+    sMidiInputPort = NULL;
+  }
+  sSendStaging = NULL;
+  sSendStagingCapacity = 0;
+
   /*media_status_t status =*/AMidiDevice_release(sNativeSendDevice);
   sNativeSendDevice = NULL;
 }
 
 /**
- * Native implementation of the (Java) TBMidiManager.writeMidi() method.
- * Writes a byte buffer to the (already open) "input" port.
- * @param   env  JNI Env pointer.
+ * Native implementation of the (Java) TBMidiManager.scheduleMidi() method.
+ * Queues the messages staged in the buffer passed to startWritingMidi(),
+ * to be sent at their timestamps by the send thread.
+ * @param   (unnamed)   JNI Env pointer.
  * @param   (unnamed)   TBMidiManager (Java) object.
- * @param   data    The data buffer.
- * @param   numBytes    The number of bytes to send.
+ * @param   numBytes    The number of bytes staged.
  */
-void Java_com_example_nativemidi_AppMidiManager_writeMidi(JNIEnv* env, jobject,
-                                                          jbyteArray data,
-                                                          jint numBytes) {
-  jbyte* bufferPtr = env->GetByteArrayElements(data, NULL);
-  /*ssize_t numSent =*/AMidiInputPort_send(sMidiInputPort, (uint8_t*)bufferPtr,
-                                           numBytes);
-  env->ReleaseByteArrayElements(data, bufferPtr, JNI_ABORT);
+void Java_com_example_nativemidi_AppMidiManager_scheduleMidi(JNIEnv*, jobject,
+                                                             jint numBytes) {
+  if (sSendScheduler == NULL || numBytes > sSendStagingCapacity) {
+    return;
+  }
+  const uint8_t* staged = sSendStaging;
+  const uint8_t* end = sSendStaging + numBytes;
+  int32_t numDropped = 0;
+  while (end - staged >= (ptrdiff_t)kStagedHeaderSize) {
+    int64_t timestamp;
+    uint16_t length;
+    memcpy(&timestamp, staged, sizeof(timestamp));
+    memcpy(&length, staged + sizeof(timestamp), sizeof(length));
+    staged += kStagedHeaderSize;
+    if (length > end - staged) {
+      break;
+    }
+    if (!sSendScheduler->enqueue(staged, length, timestamp)) {
+      numDropped++;
+    }
+    staged += length;
+  }
+  sSendScheduler->notify();
+  if (numDropped > 0) {
+    LOGW("Dropped %d MIDI messages, the send queue is full", numDropped);
+  }
 }
 
 }  // extern "C"
@@ -36,7 +36,8 @@ JNICALL void Java_com_example_nativemidi_MainActivity_initNative(
       env->FindClass("com/example/nativemidi/MainActivity");
   dataCallbackObj = env->NewGlobalRef(instance);
   midDataCallback =
-      env->GetMethodID(clsMainActivity, "onNativeMessageReceive", "([B)V");
+      env->GetMethodID(clsMainActivity, "onNativeMessageReceive",
+                       "(Ljava/nio/ByteBuffer;I)V");
 }
 
 }  // extern "C"
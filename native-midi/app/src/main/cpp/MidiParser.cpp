@@ -0,0 +1,198 @@
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#include "MidiParser.h"
+
+#include <string.h>
+
+#include "MidiSpec.h"
+
+// Data bytes following a status byte, or -1 for a status that's undefined
+// or has no message of its own.
+static int dataLength(uint8_t status) {
+  switch (status >> 4) {
+    case kMIDIChanCmd_ProgramChange:
+    case kMIDIChanCmd_ChannelPress:
+      return 1;
+    case 0xF:
+      break;
+    default:
+      return 2;
+  }
+  switch (status) {
+    case kMIDISysCmd_MTCQuarterFrame:
+    case kMIDISysCmd_SongSelect:
+      return 1;
+    case kMIDISysCmd_SongPosition:
+      return 2;
+    case kMIDISysCmd_TuneRequest:
+    case kMIDISysCmd_TimingClock:
+    case kMIDISysCmd_Start:
+    case kMIDISysCmd_Continue:
+    case kMIDISysCmd_Stop:
+    case kMIDISysCmd_ActiveSensing:
+    case kMIDISysCmd_Reset:
+      return 0;
+    default:
+      return -1;
+  }
+}
+
+void MidiParser::reset() {
+  mStatus = 0;
+  mNeeded = 0;
+  mNumData = 0;
+  mInSysEx = false;
+  mSysExStarted = false;
+  mNumSysEx = 0;
+  mNumDroppedBytes = 0;
+}
+
+int32_t MidiParser::parse(const uint8_t* bytes, size_t numBytes,
+                          int64_t timestamp, MidiEvent* events,
+                          int32_t maxEvents, size_t* numBytesParsed) {
+  int32_t numEvents = 0;
+  size_t i = 0;
+
+  auto emit = [&](uint8_t status, const uint8_t* data, uint8_t length,
+                  uint8_t sysex) {
+    MidiEvent& event = events[numEvents++];
+    event.timestamp = timestamp;
+    event.status = status;
+    event.length = length;
+    event.sysex = sysex;
+    memset(event.data, 0, sizeof(event.data));
+    if (length > 0) {
+      memcpy(event.data, data, length);
+    }
+  };
+  auto emitSysExChunk = [&](bool end) {
+    emit(kMIDISysCmd_SysEx, mSysEx, mNumSysEx,
+         (mSysExStarted ? 0 : kMidiSysExStart) | (end ? kMidiSysExEnd : 0));
+    mSysExStarted = !end;
+    mNumSysEx = 0;
+  };
+
+  for (; i < numBytes; i++) {
+    uint8_t byte = bytes[i];
+
+    // Every byte makes at most one event, except a status byte ending a
+    // SysEx, which also flushes its last chunk.
+    bool endsSysEx = mInSysEx && (byte & kMIDIStatusBit) &&
+                     byte < kMIDISysCmd_RealTime;
+    if (maxEvents - numEvents < (endsSysEx ? 2 : 1)) {
+      break;
+    }
+
+    if (byte >= kMIDISysCmd_RealTime) {
+      if (dataLength(byte) == 0) {
+        emit(byte, NULL, 0, 0);
+      }
+      continue;
+    }
+
+    if (byte & kMIDIStatusBit) {
+      if (mInSysEx) {
+        // F7, or any other status, ends the SysEx.
+        emitSysExChunk(true);
+        mInSysEx = false;
+      }
+      mNumData = 0;
+      if (byte == kMIDISysCmd_SysEx) {
+        mInSysEx = true;
+        mSysExStarted = false;
+        mNumSysEx = 0;
+        mStatus = 0;
+        continue;
+      }
+      int length = dataLength(byte);
+      if (length < 0) {
+        // F7 outside a SysEx, or undefined: also clears the running status.
+        mStatus = 0;
+        continue;
+      }
+      if (length == 0) {
+        emit(byte, NULL, 0, 0);
+        mStatus = 0;
+        continue;
+      }
+      mStatus = byte;
+      mNeeded = static_cast<uint8_t>(length);
+      continue;
+    }
+
+    // Data byte
+    if (mInSysEx) {
+      if (mNumSysEx == kMidiSysExChunkSize) {
+        emitSysExChunk(false);
+      }
+      mSysEx[mNumSysEx++] = byte;
+      continue;
+    }
+    if (mStatus == 0) {
+      mNumDroppedBytes++;
+      continue;
+    }
+    mData[mNumData++] = byte;
+    if (mNumData == mNeeded) {
+      emit(mStatus, mData, mNumData, 0);
+      mNumData = 0;
+      // Only channel messages have a running status.
+      if (mStatus >= kMIDISysCmdChan) {
+        mStatus = 0;
+      }
+    }
+  }
+
+  if (numBytesParsed != NULL) {
+    *numBytesParsed = i;
+  }
+  return numEvents;
+}
+
+int32_t MidiEventToUmp(const MidiEvent& event, uint8_t group,
+                       uint32_t words[2]) {
+  uint32_t groupBits = static_cast<uint32_t>(group & 0xF) << 24;
+  if (event.status == kMIDISysCmd_SysEx) {
+    // SysEx7 status: 0 complete, 1 start, 2 continue, 3 end
+    uint32_t position;
+    if (event.sysex == (kMidiSysExStart | kMidiSysExEnd)) {
+      position = 0;
+    } else if (event.sysex & kMidiSysExStart) {
+      position = 1;
+    } else if (event.sysex & kMidiSysExEnd) {
+      position = 3;
+    } else {
+      position = 2;
+    }
+    uint8_t data[6] = {0};
+    if (event.length > 0) {
+      memcpy(data, event.data, event.length);
+    }
+    words[0] = 0x30000000u | groupBits | (position << 20) |
+               (static_cast<uint32_t>(event.length) << 16) |
+               (static_cast<uint32_t>(data[0]) << 8) | data[1];
+    words[1] = (static_cast<uint32_t>(data[2]) << 24) |
+               (static_cast<uint32_t>(data[3]) << 16) |
+               (static_cast<uint32_t>(data[4]) << 8) | data[5];
+    return 2;
+  }
+  uint32_t messageType = event.status >= kMIDISysCmdChan ? 0x1 : 0x2;
+  words[0] = (messageType << 28) | groupBits |
+             (static_cast<uint32_t>(event.status) << 16) |
+             (static_cast<uint32_t>(event.data[0]) << 8) | event.data[1];
+  return 1;
+}
@@ -0,0 +1,97 @@
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef NATIVEMIDI_MIDIPARSER_H
+#define NATIVEMIDI_MIDIPARSER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * A decoded MIDI 1.0 message, 16 bytes whatever its kind.
+ *
+ * status is the message's status byte: 0x80-0xEF for channel messages,
+ * 0xF1-0xFF for system common and real-time ones, kMIDISysCmd_SysEx for a
+ * SysEx chunk. data holds length data bytes: at most 2, except for SysEx
+ * chunks, which carry up to kMidiSysExChunkSize bytes of the message, the
+ * F0 and F7 excluded, with sysex flags telling where the chunk is in it.
+ */
+struct MidiEvent {
+  int64_t timestamp;
+  uint8_t status;
+  uint8_t length;
+  uint8_t sysex;
+  uint8_t data[5];
+};
+static_assert(sizeof(MidiEvent) == 16, "MidiEvent is shared with Java");
+
+static const uint8_t kMidiSysExChunkSize = 5;
+// MidiEvent.sysex flags: a whole SysEx message has both
+static const uint8_t kMidiSysExStart = 1;
+static const uint8_t kMidiSysExEnd = 2;
+
+/**
+ * MidiParser
+ * Decodes a MIDI 1.0 byte stream into MidiEvents, without allocating.
+ *
+ * The stream may be split anywhere across calls: the parser keeps the
+ * message in progress, the running status and the SysEx in progress from
+ * one call to the next. Real-time bytes are passed on wherever they are,
+ * without disturbing the message they interrupt. System common messages
+ * clear the running status, and any status byte but real-time ends a SysEx.
+ * Data bytes with no status to go with them are dropped.
+ */
+class MidiParser {
+ public:
+  MidiParser() { reset(); }
+
+  void reset();
+
+  /**
+   * Parse numBytes bytes received at timestamp into events. Returns the
+   * number of events written, at most maxEvents. If that is not enough, the
+   * parsing stops early and numBytesParsed tells how far it got;
+   * numBytes + 1 events are always enough.
+   */
+  int32_t parse(const uint8_t* bytes, size_t numBytes, int64_t timestamp,
+                MidiEvent* events, int32_t maxEvents, size_t* numBytesParsed);
+
+  // Data bytes dropped so far, for lack of a status.
+  uint32_t numDroppedBytes() const { return mNumDroppedBytes; }
+
+ private:
+  uint8_t mStatus;        // of the message in progress, 0 if none
+  uint8_t mNeeded;        // data bytes it takes
+  uint8_t mData[2];
+  uint8_t mNumData;
+  bool mInSysEx;
+  bool mSysExStarted;     // a chunk of the SysEx in progress went out
+  uint8_t mSysEx[kMidiSysExChunkSize];
+  uint8_t mNumSysEx;
+  uint32_t mNumDroppedBytes;
+};
+
+/**
+ * Converts an event to a MIDI 2.0 Universal MIDI Packet of group group:
+ * system messages to MT 1, channel messages to MT 2 (MIDI 1.0 channel
+ * voice), SysEx chunks to MT 3 (SysEx7). Writes 1 or 2 words and returns
+ * their number.
+ */
+int32_t MidiEventToUmp(const MidiEvent& event, uint8_t group,
+                       uint32_t words[2]);
+
+#endif  // NATIVEMIDI_MIDIPARSER_H
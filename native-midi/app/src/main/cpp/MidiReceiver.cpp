@@ -0,0 +1,145 @@
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#include "MidiReceiver.h"
+
+#include <unistd.h>
+
+#define LOG_TAG "MidiReceiver"
+#ifdef __ANDROID__
+#include <amidi/AMidi.h>
+
+#include "AndroidDebug.h"
+#else
+// Host builds, for tests and benchmarks: same values as <amidi/AMidi.h>.
+#include <stdio.h>
+#define AMIDI_OPCODE_DATA 1
+#define AMIDI_OPCODE_FLUSH 2
+#define LOGW(...) (fprintf(stderr, __VA_ARGS__), fputc('\n', stderr))
+#endif
+
+// Events a receive can make at most, see MidiParser::parse().
+static const int32_t kMaxEventsPerReceive = kMidiMaxMessageSize + 1;
+
+MidiReceiver::MidiReceiver(MidiReceivePort* port, MidiBatchSink* sink,
+                           MidiEvent* batch, int32_t batchCapacity)
+    : mPort(port),
+      mSink(sink),
+      mBatch(batch),
+      mBatchCapacity(batchCapacity),
+      mBatchEvents(0),
+      mThreadCreated(false),
+      mRunning(false),
+      mNumEvents(0),
+      mNumBatches(0) {}
+
+MidiReceiver::~MidiReceiver() { stop(); }
+
+bool MidiReceiver::start() {
+  if (mBatchCapacity < kMaxEventsPerReceive || mRunning) {
+    return false;
+  }
+  // The thread may have exited on its own, after a receive error.
+  join();
+  mRunning = true;
+  if (pthread_create(&mThread, NULL, threadRoutine, this) != 0) {
+    mRunning = false;
+    return false;
+  }
+  mThreadCreated = true;
+  return true;
+}
+
+void MidiReceiver::stop() {
+  mRunning = false;
+  join();
+}
+
+void MidiReceiver::join() {
+  if (mThreadCreated) {
+    pthread_join(mThread, NULL);
+    mThreadCreated = false;
+  }
+}
+
+void* MidiReceiver::threadRoutine(void* context) {
+  static_cast<MidiReceiver*>(context)->run();
+  return NULL;
+}
+
+void MidiReceiver::flush() {
+  if (mBatchEvents == 0) {
+    return;
+  }
+  mSink->onBatch(mBatch, mBatchEvents);
+  mNumEvents += mBatchEvents;
+  mNumBatches++;
+  mBatchEvents = 0;
+}
+
+void MidiReceiver::run() {
+  if (!mSink->onThreadStart()) {
+    return;
+  }
+
+  int32_t waitUs = kMinWaitUs;
+  int32_t idleUs = 0;
+  while (mRunning) {
+    usleep(waitUs);
+
+    bool received = false;
+    for (;;) {
+      if (mBatchCapacity - mBatchEvents < kMaxEventsPerReceive) {
+        flush();
+      }
+      int32_t opcode;
+      size_t numBytesReceived;
+      int64_t timestamp;
+      ssize_t numMessagesReceived =
+          mPort->receive(&opcode, mReceiveBuffer, sizeof(mReceiveBuffer),
+                         &numBytesReceived, &timestamp);
+      if (numMessagesReceived < 0) {
+        LOGW("Failure receiving MIDI data %zd", numMessagesReceived);
+        // Exit the thread
+        mRunning = false;
+        break;
+      }
+      if (numMessagesReceived == 0) {
+        break;
+      }
+      received = true;
+      if (opcode == AMIDI_OPCODE_FLUSH) {
+        // Whatever was in progress was flushed out.
+        mParser.reset();
+      } else if (opcode == AMIDI_OPCODE_DATA) {
+        mBatchEvents += mParser.parse(mReceiveBuffer, numBytesReceived,
+                                      timestamp, mBatch + mBatchEvents,
+                                      mBatchCapacity - mBatchEvents, NULL);
+      }
+    }
+    flush();
+
+    if (received) {
+      waitUs = kMinWaitUs;
+      idleUs = 0;
+    } else if ((idleUs += waitUs) >= kIdleBeforeBackOffUs &&
+               waitUs < kMaxWaitUs) {
+      waitUs = waitUs * 2 < kMaxWaitUs ? waitUs * 2 : kMaxWaitUs;
+    }
+  }
+
+  mSink->onThreadStop();
+}
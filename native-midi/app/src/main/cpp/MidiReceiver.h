@@ -0,0 +1,121 @@
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef NATIVEMIDI_MIDIRECEIVER_H
+#define NATIVEMIDI_MIDIRECEIVER_H
+
+#include <pthread.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+#include <atomic>
+
+#include "MidiParser.h"
+
+/**
+ * Where a MidiReceiver gets its messages: an AMidiOutputPort in the app, a
+ * simulated port in a test or benchmark.
+ */
+class MidiReceivePort {
+ public:
+  virtual ~MidiReceivePort() {}
+
+  /**
+   * Same contract as AMidiOutputPort_receive(): doesn't block, and returns
+   * the number of messages received, 0 or 1, or a negative error.
+   */
+  virtual ssize_t receive(int32_t* opcode, uint8_t* buffer, size_t maxBytes,
+                          size_t* numBytesReceived, int64_t* timestamp) = 0;
+};
+
+/**
+ * Where a MidiReceiver delivers its batches. All the calls are made on the
+ * receive thread: onThreadStart() once before any batch, onThreadStop()
+ * once after the last one.
+ */
+class MidiBatchSink {
+ public:
+  virtual ~MidiBatchSink() {}
+
+  virtual bool onThreadStart() { return true; }
+  /**
+   * The events are only valid during the call: their buffer is reused for
+   * the next batch.
+   */
+  virtual void onBatch(const MidiEvent* events, int32_t numEvents) = 0;
+  virtual void onThreadStop() {}
+};
+
+static const size_t kMidiMaxMessageSize = 128;
+
+/**
+ * MidiReceiver
+ * Reads a MidiReceivePort on a thread of its own, decodes the data with a
+ * MidiParser, and delivers the events to a MidiBatchSink in batches.
+ *
+ * AMidi has no way to block until data arrives, so the thread polls with an
+ * adaptive wait: kMinWaitUs while messages keep coming, then doubling up to
+ * kMaxWaitUs once the port has been idle for kIdleBeforeBackOffUs. Each
+ * wakeup drains every pending message into the batch, which is handed over
+ * when it is drained or full, so a burst costs one delivery instead of one
+ * per message.
+ */
+class MidiReceiver {
+ public:
+  static constexpr int32_t kMinWaitUs = 250;
+  static constexpr int32_t kMaxWaitUs = 2000;
+  static constexpr int32_t kIdleBeforeBackOffUs = 100000;
+
+  /**
+   * The batch is preallocated by the caller, and is where the sink reads
+   * the events from: it can be shared with Java as a direct ByteBuffer. It
+   * must hold more than kMidiMaxMessageSize events.
+   */
+  MidiReceiver(MidiReceivePort* port, MidiBatchSink* sink, MidiEvent* batch,
+               int32_t batchCapacity);
+  ~MidiReceiver();
+
+  bool start();
+  void stop();
+
+  // Counters, for the log and benchmarks.
+  int64_t numEvents() const { return mNumEvents.load(); }
+  int64_t numBatches() const { return mNumBatches.load(); }
+
+ private:
+  static void* threadRoutine(void* context);
+  void run();
+  void flush();
+  void join();
+
+  MidiReceivePort* mPort;
+  MidiBatchSink* mSink;
+  MidiParser mParser;
+  uint8_t mReceiveBuffer[kMidiMaxMessageSize];
+  MidiEvent* mBatch;
+  int32_t mBatchCapacity;
+  int32_t mBatchEvents;
+
+  pthread_t mThread;
+  bool mThreadCreated;  // and not joined yet
+  std::atomic<bool> mRunning;
+  std::atomic<int64_t> mNumEvents;
+  std::atomic<int64_t> mNumBatches;
+};
+
+#endif  // NATIVEMIDI_MIDIRECEIVER_H
@@ -0,0 +1,275 @@
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#include "MidiSendScheduler.h"
+
+#include <string.h>
+#include <time.h>
+
+#define LOG_TAG "MidiSendScheduler"
+#ifdef __ANDROID__
+#include "AndroidDebug.h"
+#else
+// Host builds, for tests and benchmarks.
+#include <stdio.h>
+#define LOGW(...) (fprintf(stderr, __VA_ARGS__), fputc('\n', stderr))
+#endif
+
+static_assert((MidiSendScheduler::kRingSlots &
+               (MidiSendScheduler::kRingSlots - 1)) == 0,
+              "kRingSlots is a power of two");
+
+static int64_t monotonicNowNs() {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (int64_t)now.tv_sec * 1000000000LL + now.tv_nsec;
+}
+
+int64_t MonotonicMidiClock::nowNs() { return monotonicNowNs(); }
+
+MidiSendScheduler::MidiSendScheduler(MidiSendPort* port, MidiClock* clock,
+                                     int64_t coalesceWindowNs, int64_t leadNs)
+    : mPort(port),
+      mClock(clock),
+      mCoalesceWindowNs(coalesceWindowNs),
+      mLeadNs(leadNs),
+      mHead(0),
+      mTail(0),
+      mNumPending(0),
+      mNextSequence(0),
+      mNotified(false),
+      mRunning(false),
+      mNumMessages(0),
+      mNumSends(0) {
+  pthread_mutex_init(&mMutex, NULL);
+  pthread_condattr_t attributes;
+  pthread_condattr_init(&attributes);
+  pthread_condattr_setclock(&attributes, CLOCK_MONOTONIC);
+  pthread_cond_init(&mCondition, &attributes);
+  pthread_condattr_destroy(&attributes);
+}
+
+MidiSendScheduler::~MidiSendScheduler() {
+  stop();
+  pthread_cond_destroy(&mCondition);
+  pthread_mutex_destroy(&mMutex);
+}
+
+int32_t MidiSendScheduler::slotsFor(size_t numBytes) {
+  return (int32_t)((numBytes + kSlotDataSize - 1) / kSlotDataSize);
+}
+
+/*
+ * Producer
+ */
+bool MidiSendScheduler::enqueue(const uint8_t* data, size_t numBytes,
+                                int64_t timestamp) {
+  if (numBytes == 0 || numBytes > kMidiMaxSendBytes) {
+    return false;
+  }
+  int32_t numSlots = slotsFor(numBytes);
+  uint32_t head = mHead.load(std::memory_order_relaxed);
+  uint32_t tail = mTail.load(std::memory_order_acquire);
+  if (kRingSlots - (int32_t)(head - tail) < numSlots) {
+    return false;
+  }
+  for (int32_t index = 0; index < numSlots; index++) {
+    Slot& slot = mRing[(head + index) & (kRingSlots - 1)];
+    size_t offset = index * kSlotDataSize;
+    size_t length = numBytes - offset < kSlotDataSize ? numBytes - offset
+                                                      : kSlotDataSize;
+    slot.timestamp = timestamp;
+    slot.length = (uint16_t)length;
+    slot.messageLength = index == 0 ? (uint16_t)numBytes : 0;
+    memcpy(slot.data, data + offset, length);
+  }
+  mHead.store(head + numSlots, std::memory_order_release);
+  return true;
+}
+
+void MidiSendScheduler::notify() {
+  pthread_mutex_lock(&mMutex);
+  mNotified = true;
+  pthread_cond_signal(&mCondition);
+  pthread_mutex_unlock(&mMutex);
+}
+
+/*
+ * Consumer
+ */
+bool MidiSendScheduler::sendsBefore(const Slot& a, const Slot& b) {
+  if (a.timestamp != b.timestamp) {
+    return a.timestamp < b.timestamp;
+  }
+  return (int32_t)(a.sequence - b.sequence) < 0;
+}
+
+void MidiSendScheduler::pushPending(const Slot& slot) {
+  int32_t child = mNumPending++;
+  while (child > 0) {
+    int32_t parent = (child - 1) / 2;
+    if (!sendsBefore(slot, mPending[parent])) {
+      break;
+    }
+    mPending[child] = mPending[parent];
+    child = parent;
+  }
+  mPending[child] = slot;
+}
+
+void MidiSendScheduler::popPending() {
+  const Slot& last = mPending[--mNumPending];
+  int32_t parent = 0;
+  for (;;) {
+    int32_t child = parent * 2 + 1;
+    if (child >= mNumPending) {
+      break;
+    }
+    if (child + 1 < mNumPending &&
+        sendsBefore(mPending[child + 1], mPending[child])) {
+      child++;
+    }
+    if (!sendsBefore(mPending[child], last)) {
+      break;
+    }
+    mPending[parent] = mPending[child];
+    parent = child;
+  }
+  mPending[parent] = last;
+}
+
+void MidiSendScheduler::drainRing() {
+  uint32_t tail = mTail.load(std::memory_order_relaxed);
+  uint32_t head = mHead.load(std::memory_order_acquire);
+  while (tail != head) {
+    // Whole messages only, so their slots come out of the queue together.
+    const Slot& first = mRing[tail & (kRingSlots - 1)];
+    int32_t numSlots = slotsFor(first.messageLength);
+    if (kMaxPending - mNumPending < numSlots) {
+      break;
+    }
+    for (int32_t index = 0; index < numSlots; index++) {
+      Slot& slot = mRing[(tail + index) & (kRingSlots - 1)];
+      slot.sequence = mNextSequence++;
+      pushPending(slot);
+    }
+    tail += numSlots;
+  }
+  mTail.store(tail, std::memory_order_release);
+}
+
+void MidiSendScheduler::sendDue() {
+  // The slots of a message share its timestamp and have consecutive
+  // sequences, so they come out one after the other.
+  int64_t timestamp = mPending[0].timestamp;
+  size_t numBytes = 0;
+  int64_t numMessages = 0;
+  while (mNumPending > 0 &&
+         mPending[0].timestamp - timestamp <= mCoalesceWindowNs) {
+    const Slot& slot = mPending[0];
+    if (slot.messageLength > 0) {
+      if (numBytes + slot.messageLength > sizeof(mSendBuffer)) {
+        break;
+      }
+      numMessages++;
+    }
+    memcpy(mSendBuffer + numBytes, slot.data, slot.length);
+    numBytes += slot.length;
+    popPending();
+  }
+
+  ssize_t numSent = mPort->sendWithTimestamp(mSendBuffer, numBytes, timestamp);
+  if (numSent < 0) {
+    LOGW("Failure sending MIDI data %zd", numSent);
+  }
+  mNumMessages += numMessages;
+  mNumSends++;
+}
+
+int64_t MidiSendScheduler::service(int64_t nowNs) {
+  for (;;) {
+    drainRing();
+    if (mNumPending == 0) {
+      return INT64_MAX;
+    }
+    if (mPending[0].timestamp - mLeadNs > nowNs) {
+      return mPending[0].timestamp - mLeadNs;
+    }
+    sendDue();
+  }
+}
+
+/*
+ * Thread
+ */
+bool MidiSendScheduler::start() {
+  if (mRunning) {
+    return false;
+  }
+  mRunning = true;
+  if (pthread_create(&mThread, NULL, threadRoutine, this) != 0) {
+    mRunning = false;
+    return false;
+  }
+  return true;
+}
+
+void MidiSendScheduler::stop() {
+  pthread_mutex_lock(&mMutex);
+  bool running = mRunning.exchange(false);
+  pthread_cond_signal(&mCondition);
+  pthread_mutex_unlock(&mMutex);
+  if (!running) {
+    return;
+  }
+  pthread_join(mThread, NULL);
+
+  drainRing();
+  if (mNumPending > 0) {
+    LOGW("Dropping %d unsent MIDI slots", mNumPending);
+    mNumPending = 0;
+  }
+}
+
+void* MidiSendScheduler::threadRoutine(void* context) {
+  static_cast<MidiSendScheduler*>(context)->run();
+  return NULL;
+}
+
+void MidiSendScheduler::run() {
+  pthread_mutex_lock(&mMutex);
+  while (mRunning) {
+    mNotified = false;
+    pthread_mutex_unlock(&mMutex);
+    int64_t clockNs = mClock->nowNs();
+    int64_t nextNs = service(clockNs);
+    pthread_mutex_lock(&mMutex);
+    if (mNotified || !mRunning) {
+      continue;
+    }
+    if (nextNs == INT64_MAX) {
+      pthread_cond_wait(&mCondition, &mMutex);
+    } else {
+      // The condition waits on CLOCK_MONOTONIC, whatever mClock is.
+      int64_t deadlineNs = monotonicNowNs() + (nextNs - clockNs);
+      struct timespec deadline;
+      deadline.tv_sec = deadlineNs / 1000000000LL;
+      deadline.tv_nsec = deadlineNs % 1000000000LL;
+      pthread_cond_timedwait(&mCondition, &mMutex, &deadline);
+    }
+  }
+  pthread_mutex_unlock(&mMutex);
+}
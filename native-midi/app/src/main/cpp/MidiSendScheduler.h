@@ -0,0 +1,159 @@
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef NATIVEMIDI_MIDISENDSCHEDULER_H
+#define NATIVEMIDI_MIDISENDSCHEDULER_H
+
+#include <pthread.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+#include <atomic>
+
+/**
+ * Where a MidiSendScheduler sends to: an AMidiInputPort in the app, a fake
+ * port in a test.
+ */
+class MidiSendPort {
+ public:
+  virtual ~MidiSendPort() {}
+
+  // Same contract as AMidiInputPort_sendWithTimestamp().
+  virtual ssize_t sendWithTimestamp(const uint8_t* data, size_t numBytes,
+                                    int64_t timestamp) = 0;
+};
+
+/**
+ * The time MIDI timestamps are in: CLOCK_MONOTONIC, in nanoseconds, like
+ * System.nanoTime(). Tests use a fake one.
+ */
+class MidiClock {
+ public:
+  virtual ~MidiClock() {}
+  virtual int64_t nowNs() = 0;
+};
+
+class MonotonicMidiClock : public MidiClock {
+ public:
+  int64_t nowNs() override;
+};
+
+// Most bytes sent in one call: what fits in one AMidi packet.
+static const size_t kMidiMaxSendBytes = 1015;
+
+/**
+ * MidiSendScheduler
+ * Sends MIDI messages at their timestamps, from a thread of its own.
+ *
+ * enqueue() puts a message in a lock-free ring, from any one thread. The
+ * scheduler thread moves the messages to a queue ordered by timestamp, and
+ * sends each one leadNs ahead of its timestamp, which the receiving end
+ * schedules by. The messages due within coalesceWindowNs of it go in the
+ * same AMidiInputPort_sendWithTimestamp() call, with its timestamp, so a
+ * chord or a burst costs one call.
+ *
+ * service() does one round of that work at a given time. The thread calls
+ * it with the clock's time, and tests can call it directly with a fake
+ * clock and port, without starting the thread.
+ */
+class MidiSendScheduler {
+ public:
+  static constexpr int32_t kRingSlots = 1024;
+  static constexpr int32_t kMaxPending = 1024;
+  static constexpr int64_t kDefaultCoalesceWindowNs = 1000000;
+  static constexpr int64_t kDefaultLeadNs = 2000000;
+
+  MidiSendScheduler(MidiSendPort* port, MidiClock* clock,
+                    int64_t coalesceWindowNs = kDefaultCoalesceWindowNs,
+                    int64_t leadNs = kDefaultLeadNs);
+  ~MidiSendScheduler();
+
+  /**
+   * Queue a message of at most kMidiMaxSendBytes to be sent at timestamp;
+   * past timestamps are sent right away. Producer side: call it from one
+   * thread at a time. Returns false if the message doesn't fit in the ring.
+   */
+  bool enqueue(const uint8_t* data, size_t numBytes, int64_t timestamp);
+
+  // Wake the thread up to look at what was enqueued.
+  void notify();
+
+  /**
+   * Consumer side: take the new messages, send those due at nowNs and
+   * return when the next one is due, or INT64_MAX if none is pending.
+   */
+  int64_t service(int64_t nowNs);
+
+  bool start();
+  // Stops the thread. The messages not yet sent are dropped.
+  void stop();
+
+  // Counters, for the log and tests.
+  int64_t numMessages() const { return mNumMessages.load(); }
+  int64_t numSends() const { return mNumSends.load(); }
+
+ private:
+  /**
+   * A message takes one slot, or consecutive ones if it is longer than
+   * kSlotDataSize. Its first slot has messageLength set, the others 0.
+   */
+  static constexpr size_t kSlotDataSize = 48;
+  struct Slot {
+    int64_t timestamp;
+    uint32_t sequence;  // order of arrival, set by the consumer
+    uint16_t length;    // bytes in this slot
+    uint16_t messageLength;
+    uint8_t data[kSlotDataSize];
+  };
+  static_assert(sizeof(Slot) == 64, "Slot is one cache line");
+
+  static void* threadRoutine(void* context);
+  void run();
+  void drainRing();
+  void sendDue();
+  void pushPending(const Slot& slot);
+  void popPending();
+  static bool sendsBefore(const Slot& a, const Slot& b);
+  static int32_t slotsFor(size_t numBytes);
+
+  MidiSendPort* mPort;
+  MidiClock* mClock;
+  int64_t mCoalesceWindowNs;
+  int64_t mLeadNs;
+
+  // Producer to consumer
+  Slot mRing[kRingSlots];
+  std::atomic<uint32_t> mHead;  // next slot to write, producer
+  std::atomic<uint32_t> mTail;  // next slot to read, consumer
+
+  // Consumer only: min-heap on (timestamp, sequence)
+  Slot mPending[kMaxPending];
+  int32_t mNumPending;
+  uint32_t mNextSequence;
+  uint8_t mSendBuffer[kMidiMaxSendBytes];
+
+  pthread_t mThread;
+  pthread_mutex_t mMutex;
+  pthread_cond_t mCondition;
+  bool mNotified;
+  std::atomic<bool> mRunning;
+  std::atomic<int64_t> mNumMessages;
+  std::atomic<int64_t> mNumSends;
+};
+
+#endif  // NATIVEMIDI_MIDISENDSCHEDULER_H
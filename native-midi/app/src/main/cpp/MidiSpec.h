@@ -17,6 +17,8 @@
 
 #ifndef NATIVEMIDITESTBED_MIDISPEC_H
 
+#include <stdint.h>
+
 //
 // MIDI Messages
 //
@@ -31,9 +33,22 @@ static const uint8_t kMIDIChanCmd_PitchWheel = 14;
 // System Commands
 static const uint8_t kMIDISysCmdChan = 0xF0;
 static const uint8_t kMIDISysCmd_SysEx = 0xF0;
+static const uint8_t kMIDISysCmd_MTCQuarterFrame = 0xF1;
+static const uint8_t kMIDISysCmd_SongPosition = 0xF2;
+static const uint8_t kMIDISysCmd_SongSelect = 0xF3;
+static const uint8_t kMIDISysCmd_TuneRequest = 0xF6;
 static const uint8_t kMIDISysCmd_EndOfSysEx = 0xF7;
+// System Real-Time, which may appear anywhere, even inside other messages
+static const uint8_t kMIDISysCmd_RealTime = 0xF8;
+static const uint8_t kMIDISysCmd_TimingClock = 0xF8;
+static const uint8_t kMIDISysCmd_Start = 0xFA;
+static const uint8_t kMIDISysCmd_Continue = 0xFB;
+static const uint8_t kMIDISysCmd_Stop = 0xFC;
 static const uint8_t kMIDISysCmd_ActiveSensing = 0xFE;
 static const uint8_t kMIDISysCmd_Reset = 0xFF;
 
+// Status bytes have the top bit set, data bytes don't
+static const uint8_t kMIDIStatusBit = 0x80;
+
 #define NATIVEMIDITESTBED_MIDISPEC_H
 #endif
@@ -0,0 +1,126 @@
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#ifndef NATIVEMIDI_FAKEMIDIPORTS_H
+#define NATIVEMIDI_FAKEMIDIPORTS_H
+
+#include <string.h>
+
+#include <deque>
+#include <mutex>
+#include <vector>
+
+#include "MidiReceiver.h"
+#include "MidiSendScheduler.h"
+
+/**
+ * A MidiReceivePort fed by the test: each message put in is what one
+ * AMidiOutputPort_receive() returns.
+ */
+class FakeMidiReceivePort : public MidiReceivePort {
+ public:
+  // Same values as <amidi/AMidi.h>.
+  static const int32_t kOpcodeData = 1;
+  static const int32_t kOpcodeFlush = 2;
+
+  void put(std::vector<uint8_t> bytes, int64_t timestamp,
+           int32_t opcode = kOpcodeData) {
+    std::lock_guard<std::mutex> lock(mMutex);
+    mMessages.push_back({opcode, std::move(bytes), timestamp});
+  }
+
+  // The next receive fails with this error.
+  void failWith(ssize_t error) {
+    std::lock_guard<std::mutex> lock(mMutex);
+    mError = error;
+  }
+
+  size_t numPending() {
+    std::lock_guard<std::mutex> lock(mMutex);
+    return mMessages.size();
+  }
+
+  ssize_t receive(int32_t* opcode, uint8_t* buffer, size_t maxBytes,
+                  size_t* numBytesReceived, int64_t* timestamp) override {
+    std::lock_guard<std::mutex> lock(mMutex);
+    if (mError < 0) {
+      return mError;
+    }
+    if (mMessages.empty()) {
+      return 0;
+    }
+    const Message& message = mMessages.front();
+    *opcode = message.opcode;
+    *numBytesReceived =
+        message.bytes.size() < maxBytes ? message.bytes.size() : maxBytes;
+    if (*numBytesReceived > 0) {
+      memcpy(buffer, message.bytes.data(), *numBytesReceived);
+    }
+    *timestamp = message.timestamp;
+    mMessages.pop_front();
+    return 1;
+  }
+
+ private:
+  struct Message {
+    int32_t opcode;
+    std::vector<uint8_t> bytes;
+    int64_t timestamp;
+  };
+  std::mutex mMutex;
+  std::deque<Message> mMessages;
+  ssize_t mError = 0;
+};
+
+/**
+ * A MidiSendPort that keeps what is sent. The sends happen on the
+ * scheduler's thread, or on the test's when it calls service() itself.
+ */
+class FakeMidiSendPort : public MidiSendPort {
+ public:
+  struct Send {
+    std::vector<uint8_t> bytes;
+    int64_t timestamp;
+  };
+
+  ssize_t sendWithTimestamp(const uint8_t* data, size_t numBytes,
+                            int64_t timestamp) override {
+    std::lock_guard<std::mutex> lock(mMutex);
+    mSends.push_back({std::vector<uint8_t>(data, data + numBytes), timestamp});
+    return numBytes;
+  }
+
+  std::vector<Send> takeSends() {
+    std::lock_guard<std::mutex> lock(mMutex);
+    std::vector<Send> sends;
+    sends.swap(mSends);
+    return sends;
+  }
+
+ private:
+  std::mutex mMutex;
+  std::vector<Send> mSends;
+};
+
+// A MidiClock the test sets.
+class FakeMidiClock : public MidiClock {
+ public:
+  int64_t nowNs() override { return mNowNs; }
+
+  int64_t mNowNs = 0;
+};
+
+#endif  // NATIVEMIDI_FAKEMIDIPORTS_H
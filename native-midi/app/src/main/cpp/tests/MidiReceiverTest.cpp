@@ -0,0 +1,206 @@
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#include "MidiReceiver.h"
+
+#include <gtest/gtest.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <mutex>
+#include <vector>
+
+#include "FakeMidiPorts.h"
+
+namespace {
+
+// Keeps what the receive thread delivers.
+class RecordingSink : public MidiBatchSink {
+ public:
+  explicit RecordingSink(bool startThread = true)
+      : mStartThread(startThread) {}
+
+  bool onThreadStart() override {
+    mStarted = true;
+    return mStartThread;
+  }
+  void onBatch(const MidiEvent* events, int32_t numEvents) override {
+    std::lock_guard<std::mutex> lock(mMutex);
+    mEvents.insert(mEvents.end(), events, events + numEvents);
+    mBatchSizes.push_back(numEvents);
+  }
+  void onThreadStop() override { mStopped = true; }
+
+  std::vector<MidiEvent> events() {
+    std::lock_guard<std::mutex> lock(mMutex);
+    return mEvents;
+  }
+  std::vector<int32_t> batchSizes() {
+    std::lock_guard<std::mutex> lock(mMutex);
+    return mBatchSizes;
+  }
+
+  std::atomic<bool> mStarted{false};
+  std::atomic<bool> mStopped{false};
+
+ private:
+  bool mStartThread;
+  std::mutex mMutex;
+  std::vector<MidiEvent> mEvents;
+  std::vector<int32_t> mBatchSizes;
+};
+
+// Waits up to a second for the port to be drained and the batch delivered.
+void waitForEvents(MidiReceiver* receiver, int64_t numEvents) {
+  for (int i = 0; i < 1000 && receiver->numEvents() < numEvents; i++) {
+    usleep(1000);
+  }
+}
+
+std::vector<uint8_t> noteOn(int note) {
+  return {0x90, static_cast<uint8_t>(note & 0x7F), 100};
+}
+
+class MidiReceiverTest : public testing::Test {
+ protected:
+  static const int32_t kBatchCapacity = 1024;
+
+  FakeMidiReceivePort mPort;
+  RecordingSink mSink;
+  MidiEvent mBatch[kBatchCapacity];
+};
+
+TEST_F(MidiReceiverTest, DeliversEveryMessageInOrder) {
+  MidiReceiver receiver(&mPort, &mSink, mBatch, kBatchCapacity);
+  ASSERT_TRUE(receiver.start());
+  for (int i = 0; i < 300; i++) {
+    mPort.put(noteOn(i), 1000 + i);
+    if (i % 50 == 0) usleep(500);
+  }
+  waitForEvents(&receiver, 300);
+  receiver.stop();
+
+  std::vector<MidiEvent> events = mSink.events();
+  ASSERT_EQ(events.size(), 300u);
+  for (int i = 0; i < 300; i++) {
+    EXPECT_EQ(events[i].timestamp, 1000 + i);
+    EXPECT_EQ(events[i].status, 0x90);
+    EXPECT_EQ(events[i].length, 2);
+    EXPECT_EQ(events[i].data[0], i & 0x7F);
+    EXPECT_EQ(events[i].data[1], 100);
+  }
+  EXPECT_EQ(receiver.numEvents(), 300);
+  EXPECT_EQ(receiver.numBatches(),
+            static_cast<int64_t>(mSink.batchSizes().size()));
+  EXPECT_TRUE(mSink.mStarted);
+  EXPECT_TRUE(mSink.mStopped);
+}
+
+// A burst waiting in the port goes out in one delivery, not one per message.
+TEST_F(MidiReceiverTest, DeliversABurstInOneBatch) {
+  for (int i = 0; i < 500; i++) {
+    mPort.put(noteOn(i), i);
+  }
+  MidiReceiver receiver(&mPort, &mSink, mBatch, kBatchCapacity);
+  ASSERT_TRUE(receiver.start());
+  waitForEvents(&receiver, 500);
+  receiver.stop();
+  EXPECT_EQ(mSink.batchSizes(), std::vector<int32_t>{500});
+}
+
+// Past what the batch holds, the burst is split, and nothing is lost.
+TEST_F(MidiReceiverTest, SplitsABurstLargerThanTheBatch) {
+  const int32_t kSmallBatch = kMidiMaxMessageSize + 1;
+  for (int i = 0; i < 1000; i++) {
+    mPort.put(noteOn(i), i);
+  }
+  MidiReceiver receiver(&mPort, &mSink, mBatch, kSmallBatch);
+  ASSERT_TRUE(receiver.start());
+  waitForEvents(&receiver, 1000);
+  receiver.stop();
+
+  std::vector<MidiEvent> events = mSink.events();
+  ASSERT_EQ(events.size(), 1000u);
+  for (int i = 0; i < 1000; i++) {
+    ASSERT_EQ(events[i].timestamp, i);
+  }
+  for (int32_t size : mSink.batchSizes()) {
+    EXPECT_LE(size, kSmallBatch);
+  }
+  EXPECT_GE(mSink.batchSizes().size(), 1000u / kSmallBatch);
+}
+
+TEST_F(MidiReceiverTest, RefusesABatchTooSmallForOneReceive) {
+  MidiReceiver receiver(&mPort, &mSink, mBatch, kMidiMaxMessageSize);
+  EXPECT_FALSE(receiver.start());
+}
+
+TEST_F(MidiReceiverTest, DropsWhatWasInProgressOnAFlush) {
+  mPort.put({0x90, 60}, 1);
+  mPort.put({}, 2, FakeMidiReceivePort::kOpcodeFlush);
+  // Without the flush, 62 would complete the note on of 60.
+  mPort.put({62, 0x80, 61, 0}, 3);
+  MidiReceiver receiver(&mPort, &mSink, mBatch, kBatchCapacity);
+  ASSERT_TRUE(receiver.start());
+  waitForEvents(&receiver, 1);
+  receiver.stop();
+
+  std::vector<MidiEvent> events = mSink.events();
+  ASSERT_EQ(events.size(), 1u);
+  EXPECT_EQ(events[0].status, 0x80);
+  EXPECT_EQ(events[0].data[0], 61);
+  EXPECT_EQ(events[0].timestamp, 3);
+}
+
+TEST_F(MidiReceiverTest, StopsOnAReceiveError) {
+  MidiReceiver receiver(&mPort, &mSink, mBatch, kBatchCapacity);
+  ASSERT_TRUE(receiver.start());
+  mPort.failWith(-5);
+  for (int i = 0; i < 1000 && !mSink.mStopped; i++) {
+    usleep(1000);
+  }
+  EXPECT_TRUE(mSink.mStopped);
+  receiver.stop();
+}
+
+TEST_F(MidiReceiverTest, DoesNotReceiveIfTheSinkCannotStart) {
+  RecordingSink sink(false);
+  mPort.put(noteOn(60), 1);
+  MidiReceiver receiver(&mPort, &sink, mBatch, kBatchCapacity);
+  ASSERT_TRUE(receiver.start());
+  for (int i = 0; i < 1000 && !sink.mStarted; i++) {
+    usleep(1000);
+  }
+  receiver.stop();
+  EXPECT_TRUE(sink.events().empty());
+  EXPECT_FALSE(sink.mStopped);
+  EXPECT_EQ(mPort.numPending(), 1u);
+}
+
+TEST_F(MidiReceiverTest, StopsOnceAndRestarts) {
+  MidiReceiver receiver(&mPort, &mSink, mBatch, kBatchCapacity);
+  ASSERT_TRUE(receiver.start());
+  EXPECT_FALSE(receiver.start());
+  receiver.stop();
+  receiver.stop();
+
+  mPort.put(noteOn(60), 1);
+  ASSERT_TRUE(receiver.start());
+  waitForEvents(&receiver, 1);
+  EXPECT_EQ(receiver.numEvents(), 1);
+}
+
+}  // namespace
@@ -0,0 +1,115 @@
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+/*
+ * How close to their lead time MidiSendScheduler sends messages, on its
+ * thread with the real clock: 1000 messages in chords of three 3 ms apart,
+ * and 300 single notes every 3.1 ms. Then the cost of enqueue().
+ */
+#include <stdio.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <mutex>
+#include <vector>
+
+#include "MidiSendScheduler.h"
+
+namespace {
+
+// Keeps how late each send is after its timestamp minus the lead.
+class LatenessPort : public MidiSendPort {
+ public:
+  explicit LatenessPort(MidiClock* clock) : mClock(clock) {}
+
+  ssize_t sendWithTimestamp(const uint8_t*, size_t numBytes,
+                            int64_t timestamp) override {
+    int64_t late = mClock->nowNs() -
+                   (timestamp - MidiSendScheduler::kDefaultLeadNs);
+    std::lock_guard<std::mutex> lock(mMutex);
+    mLateness.push_back(late);
+    return numBytes;
+  }
+
+  std::vector<int64_t> mLateness;
+
+ private:
+  MidiClock* mClock;
+  std::mutex mMutex;
+};
+
+// Sends everything as soon as it can, to time enqueue().
+class NullPort : public MidiSendPort {
+ public:
+  ssize_t sendWithTimestamp(const uint8_t*, size_t numBytes,
+                            int64_t) override {
+    return numBytes;
+  }
+};
+
+}  // namespace
+
+int main() {
+  const uint8_t kNoteOn[] = {0x90, 60, 100};
+  MonotonicMidiClock clock;
+  {
+    LatenessPort port(&clock);
+    MidiSendScheduler scheduler(&port, &clock);
+    scheduler.start();
+    int64_t start = clock.nowNs() + 10000000;
+    for (int i = 0; i < 1000; i++) {
+      scheduler.enqueue(kNoteOn, sizeof(kNoteOn), start + i / 3 * 3000000LL);
+    }
+    scheduler.notify();
+    for (int i = 0; i < 300; i++) {
+      scheduler.enqueue(kNoteOn, sizeof(kNoteOn), start + i * 3100000LL);
+    }
+    scheduler.notify();
+    usleep(1100000);
+    scheduler.stop();
+
+    std::vector<int64_t>& lateness = port.mLateness;
+    std::sort(lateness.begin(), lateness.end());
+    printf(
+        "%lld messages in %lld sends, late by p50 %.1f us, p99 %.1f us, "
+        "max %.1f us\n",
+        (long long)scheduler.numMessages(), (long long)scheduler.numSends(),
+        lateness[lateness.size() / 2] / 1e3,
+        lateness[lateness.size() * 99 / 100] / 1e3, lateness.back() / 1e3);
+  }
+  {
+    NullPort port;
+    MidiSendScheduler scheduler(&port, &clock);
+    const int kMessages = 1000000;
+    int64_t numQueued = 0;
+    auto begin = std::chrono::steady_clock::now();
+    for (int i = 0; i < kMessages; i++) {
+      if (!scheduler.enqueue(kNoteOn, sizeof(kNoteOn), i)) {
+        scheduler.service(INT64_MAX / 2);
+        scheduler.enqueue(kNoteOn, sizeof(kNoteOn), i);
+      }
+      numQueued++;
+    }
+    scheduler.service(INT64_MAX / 2);
+    double seconds = std::chrono::duration<double>(
+                         std::chrono::steady_clock::now() - begin)
+                         .count();
+    printf("enqueue and send: %.1f ns per message (%lld)\n",
+           seconds * 1e9 / kMessages, (long long)numQueued);
+  }
+  return 0;
+}
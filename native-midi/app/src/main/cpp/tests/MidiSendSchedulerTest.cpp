@@ -0,0 +1,182 @@
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#include "MidiSendScheduler.h"
+
+#include <gtest/gtest.h>
+#include <unistd.h>
+
+#include <random>
+#include <vector>
+
+#include "FakeMidiPorts.h"
+
+namespace {
+
+const int64_t kMs = 1000000;
+const std::vector<uint8_t> kNoteOn60 = {0x90, 60, 100};
+const std::vector<uint8_t> kNoteOn64 = {0x90, 64, 100};
+const std::vector<uint8_t> kNoteOff60 = {0x80, 60, 0};
+
+std::vector<uint8_t> concat(std::vector<std::vector<uint8_t>> messages) {
+  std::vector<uint8_t> bytes;
+  for (const auto& message : messages) {
+    bytes.insert(bytes.end(), message.begin(), message.end());
+  }
+  return bytes;
+}
+
+// service() is called by the test, with the scheduler's thread not started.
+class MidiSendSchedulerTest : public testing::Test {
+ protected:
+  MidiSendSchedulerTest() : mScheduler(&mPort, &mClock, 1 * kMs, 2 * kMs) {}
+
+  bool enqueue(const std::vector<uint8_t>& message, int64_t timestamp) {
+    return mScheduler.enqueue(message.data(), message.size(), timestamp);
+  }
+
+  FakeMidiSendPort mPort;
+  FakeMidiClock mClock;
+  MidiSendScheduler mScheduler;
+};
+
+TEST_F(MidiSendSchedulerTest, SendsAheadInTimestampOrder) {
+  ASSERT_TRUE(enqueue(kNoteOff60, 100 * kMs));
+  ASSERT_TRUE(enqueue(kNoteOn64, 10 * kMs + kMs / 2));
+  ASSERT_TRUE(enqueue(kNoteOn60, 10 * kMs));
+
+  // Nothing is due until 2 ms before the first timestamp.
+  EXPECT_EQ(mScheduler.service(0), 8 * kMs);
+  EXPECT_TRUE(mPort.takeSends().empty());
+
+  // The two notes within 1 ms of each other go out in one call.
+  EXPECT_EQ(mScheduler.service(8 * kMs), 98 * kMs);
+  std::vector<FakeMidiSendPort::Send> sends = mPort.takeSends();
+  ASSERT_EQ(sends.size(), 1u);
+  EXPECT_EQ(sends[0].timestamp, 10 * kMs);
+  EXPECT_EQ(sends[0].bytes, concat({kNoteOn60, kNoteOn64}));
+
+  EXPECT_EQ(mScheduler.service(200 * kMs), INT64_MAX);
+  sends = mPort.takeSends();
+  ASSERT_EQ(sends.size(), 1u);
+  EXPECT_EQ(sends[0].timestamp, 100 * kMs);
+  EXPECT_EQ(sends[0].bytes, kNoteOff60);
+  EXPECT_EQ(mScheduler.numMessages(), 3);
+  EXPECT_EQ(mScheduler.numSends(), 2);
+}
+
+TEST_F(MidiSendSchedulerTest, SendsPastMessagesRightAway) {
+  mClock.mNowNs = 50 * kMs;
+  ASSERT_TRUE(enqueue(kNoteOn60, 10 * kMs));
+  EXPECT_EQ(mScheduler.service(mClock.nowNs()), INT64_MAX);
+  EXPECT_EQ(mPort.takeSends().size(), 1u);
+}
+
+// A long SysEx takes several slots, and stays whole between messages of
+// the same time, in the order they were queued.
+TEST_F(MidiSendSchedulerTest, KeepsLongMessagesWholeAndInOrder) {
+  std::vector<uint8_t> sysex(300);
+  sysex[0] = 0xF0;
+  for (size_t i = 1; i < sysex.size() - 1; i++) sysex[i] = i & 0x7F;
+  sysex.back() = 0xF7;
+  ASSERT_TRUE(enqueue(kNoteOn60, 300 * kMs));
+  ASSERT_TRUE(enqueue(sysex, 300 * kMs));
+  ASSERT_TRUE(enqueue(kNoteOn64, 300 * kMs));
+  mScheduler.service(300 * kMs);
+
+  std::vector<FakeMidiSendPort::Send> sends = mPort.takeSends();
+  ASSERT_EQ(sends.size(), 1u);
+  EXPECT_EQ(sends[0].bytes, concat({kNoteOn60, sysex, kNoteOn64}));
+}
+
+TEST_F(MidiSendSchedulerTest, SplitsSendsLargerThanAPacket) {
+  std::vector<uint8_t> large(900, 0x11);
+  large[0] = 0xF0;
+  ASSERT_TRUE(enqueue(large, 400 * kMs));
+  ASSERT_TRUE(enqueue(large, 400 * kMs));
+  mScheduler.service(400 * kMs);
+  std::vector<FakeMidiSendPort::Send> sends = mPort.takeSends();
+  ASSERT_EQ(sends.size(), 2u);
+  EXPECT_EQ(sends[0].bytes, large);
+  EXPECT_EQ(sends[1].bytes, large);
+}
+
+TEST_F(MidiSendSchedulerTest, RefusesEmptyAndOversizedMessages) {
+  EXPECT_FALSE(enqueue({}, 0));
+  EXPECT_FALSE(enqueue(std::vector<uint8_t>(kMidiMaxSendBytes + 1), 0));
+  EXPECT_TRUE(enqueue(std::vector<uint8_t>(kMidiMaxSendBytes, 0x11), 0));
+}
+
+// Fill the ring with random timestamps: every message comes out, in order.
+TEST_F(MidiSendSchedulerTest, SendsAFullRingInOrder) {
+  std::mt19937 random(1);
+  int32_t numQueued = 0;
+  while (enqueue(kNoteOn60, 1000 * kMs + (random() % 1000) * 10 * kMs)) {
+    numQueued++;
+  }
+  EXPECT_EQ(numQueued, MidiSendScheduler::kRingSlots);
+  EXPECT_EQ(mScheduler.service(INT64_MAX / 2), INT64_MAX);
+
+  int64_t last = 0;
+  size_t numMessages = 0;
+  for (const FakeMidiSendPort::Send& send : mPort.takeSends()) {
+    EXPECT_GE(send.timestamp, last);
+    last = send.timestamp;
+    numMessages += send.bytes.size() / kNoteOn60.size();
+  }
+  EXPECT_EQ(numMessages, static_cast<size_t>(numQueued));
+  EXPECT_TRUE(enqueue(kNoteOn60, 0));
+}
+
+TEST(MidiSendSchedulerThreadTest, SendsOnItsThread) {
+  FakeMidiSendPort port;
+  MonotonicMidiClock clock;
+  MidiSendScheduler scheduler(&port, &clock);
+  ASSERT_TRUE(scheduler.start());
+  EXPECT_FALSE(scheduler.start());
+  int64_t start = clock.nowNs();
+  for (int i = 0; i < 50; i++) {
+    scheduler.enqueue(kNoteOn60.data(), kNoteOn60.size(),
+                      start + 20 * kMs + i * 5 * kMs);
+  }
+  scheduler.notify();
+  for (int i = 0; i < 2000 && scheduler.numMessages() < 50; i++) {
+    usleep(1000);
+  }
+  scheduler.stop();
+  EXPECT_EQ(scheduler.numMessages(), 50);
+
+  // None went out before its lead time.
+  for (const FakeMidiSendPort::Send& send : port.takeSends()) {
+    EXPECT_GE(send.timestamp, start + 20 * kMs);
+  }
+}
+
+TEST(MidiSendSchedulerThreadTest, DropsWhatIsLeftOnStop) {
+  FakeMidiSendPort port;
+  MonotonicMidiClock clock;
+  MidiSendScheduler scheduler(&port, &clock);
+  ASSERT_TRUE(scheduler.start());
+  scheduler.enqueue(kNoteOn60.data(), kNoteOn60.size(),
+                    clock.nowNs() + 60000 * kMs);
+  scheduler.notify();
+  scheduler.stop();
+  scheduler.stop();
+  EXPECT_TRUE(port.takeSends().empty());
+  EXPECT_EQ(scheduler.service(INT64_MAX / 2), INT64_MAX);
+}
+
+}  // namespace
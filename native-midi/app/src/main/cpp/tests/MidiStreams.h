@@ -0,0 +1,56 @@
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#ifndef NATIVEMIDI_MIDISTREAMS_H
+#define NATIVEMIDI_MIDISTREAMS_H
+
+#include <stdint.h>
+
+#include <random>
+#include <vector>
+
+/**
+ * A random MIDI 1.0 byte stream of at least numBytes bytes: channel
+ * messages with and without running status, SysEx messages with real-time
+ * bytes inside and sometimes no F7, system messages and random bytes.
+ */
+inline std::vector<uint8_t> randomMidiStream(size_t numBytes,
+                                             std::mt19937* random) {
+  auto below = [random](int n) {
+    return static_cast<int>((*random)() % static_cast<uint32_t>(n));
+  };
+  std::vector<uint8_t> stream;
+  while (stream.size() < numBytes) {
+    int kind = below(10);
+    if (kind < 5) {
+      if (below(3)) stream.push_back(0x80 | below(0x70));
+      for (int i = below(4); i > 0; i--) stream.push_back(below(0x80));
+    } else if (kind < 6) {
+      stream.push_back(0xF0);
+      for (int i = below(30); i > 0; i--) {
+        stream.push_back(below(3) ? below(0x80) : 0xF8 + below(8));
+      }
+      if (below(4)) stream.push_back(0xF7);
+    } else if (kind < 8) {
+      stream.push_back(0xF0 + below(16));
+    } else {
+      stream.push_back(below(256));
+    }
+  }
+  return stream;
+}
+
+#endif  // NATIVEMIDI_MIDISTREAMS_H
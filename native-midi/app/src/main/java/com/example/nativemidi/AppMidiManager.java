@@ -22,6 +22,8 @@ import android.media.midi.MidiDeviceInfo;
 import android.media.midi.MidiManager;
 import android.media.midi.MidiInputPort;
 
+import java.nio.ByteBuffer;
+import java.nio.ByteOrder;
 import java.util.ArrayList;
 
 public class AppMidiManager {
@@ -37,6 +39,15 @@ public class AppMidiManager {
 
     private boolean mUseRunningStatus = true;
 
+    // Scheduled messages are staged here as (long timestamp, short length,
+    // bytes) until scheduleMidi() hands them to the native send queue.
+    private static final int SEND_STAGING_SIZE = 4096;
+    private static final int STAGED_HEADER_SIZE = 10;
+    // Largest message the native send queue takes
+    private static final int MAX_SCHEDULED_MESSAGE_SIZE = 1015;
+    private final ByteBuffer mSendStaging =
+            ByteBuffer.allocateDirect(SEND_STAGING_SIZE).order(ByteOrder.nativeOrder());
+
     public AppMidiManager(MidiManager midiManager) {
         mMidiManager = midiManager;
     }
@@ -102,7 +113,7 @@ public class AppMidiManager {
         @Override
         public void onDeviceOpened(MidiDevice device) {
             mSendDevice = device;
-            startWritingMidi(mSendDevice, 0/*mPortNumber*/);
+            startWritingMidi(mSendDevice, 0/*mPortNumber*/, mSendStaging);
         }
     }
 
@@ -117,8 +128,38 @@ public class AppMidiManager {
         }
     }
 
+    /**
+     * Queues MIDI messages to be sent at a given time. They are sent by a native thread,
+     * a little ahead so the receiver can play them on time, and together with the other
+     * messages due at about the same time. Call flushScheduledMessages() after a batch.
+     * @param msgBuff, one or more complete messages
+     * @param timestampNs, when to play them, in System.nanoTime() time
+     */
+    public synchronized void scheduleMessages(byte[] msgBuff, long timestampNs) {
+        if (msgBuff.length == 0 || msgBuff.length > MAX_SCHEDULED_MESSAGE_SIZE) {
+            return;
+        }
+        if (mSendStaging.remaining() < STAGED_HEADER_SIZE + msgBuff.length) {
+            flushScheduledMessages();
+        }
+        mSendStaging.putLong(timestampNs);
+        mSendStaging.putShort((short)msgBuff.length);
+        mSendStaging.put(msgBuff);
+    }
+
+    /**
+     * Hands the messages queued by scheduleMessages() over to the send thread.
+     */
+    public synchronized void flushScheduledMessages() {
+        if (mSendStaging.position() > 0) {
+            scheduleMidi(mSendStaging.position());
+            mSendStaging.clear();
+        }
+    }
+
     private void sendMessages(byte[] msgBuff) {
-        writeMidi(msgBuff, msgBuff.length);
+        scheduleMessages(msgBuff, System.nanoTime());
+        flushScheduledMessages();
     }
 
     //
@@ -169,7 +210,8 @@ public class AppMidiManager {
     public native void startReadingMidi(MidiDevice receiveDevice, int portNumber);
     public native void stopReadingMidi();
 
-    public native void startWritingMidi(MidiDevice sendDevice, int portNumber);
+    public native void startWritingMidi(MidiDevice sendDevice, int portNumber,
+                                        ByteBuffer stagingBuffer);
     public native void stopWritingMidi();
-    public native void writeMidi(byte[] data, int length);
+    public native void scheduleMidi(int numBytes);
 }
@@ -37,6 +37,7 @@ import android.widget.TextView;
 
 import android.os.Handler;
 
+import java.nio.ByteBuffer;
 import java.util.ArrayList;
 
 /**
@@ -308,11 +309,37 @@ public class MainActivity extends Activity
     //
     private native void initNative();
 
+    // MidiEvent layout, see MidiParser.h
+    private static final int EVENT_SIZE = 16;
+    private static final int EVENT_STATUS = 8;      // after the int64 timestamp
+    private static final int EVENT_LENGTH = 9;
+    private static final int EVENT_DATA = 11;
+
     /**
-     * Called from the native code when MIDI messages are received.
-     * @param message
+     * Called from the native code when MIDI messages are received, with a batch of
+     * decoded events in a direct buffer that is reused for the next batch: anything
+     * kept has to be copied out before returning.
+     * @param batch         The events, EVENT_SIZE bytes each.
+     * @param numEvents     The number of events in the batch.
      */
-    private void onNativeMessageReceive(final byte[] message) {
+    private void onNativeMessageReceive(ByteBuffer batch, int numEvents) {
+        // Only the latest channel message of a batch is shown.
+        int lastOffset = -1;
+        for (int index = 0; index < numEvents; index++) {
+            int offset = index * EVENT_SIZE;
+            if ((batch.get(offset + EVENT_STATUS) & 0xF0) != (MidiSpec.MIDICODE_SYSEX & 0xF0)) {
+                lastOffset = offset;
+            }
+        }
+        if (lastOffset < 0) {
+            return;
+        }
+        final byte[] message = new byte[1 + batch.get(lastOffset + EVENT_LENGTH)];
+        message[0] = batch.get(lastOffset + EVENT_STATUS);
+        for (int index = 1; index < message.length; index++) {
+            message[index] = batch.get(lastOffset + EVENT_DATA + index - 1);
+        }
+
         // Messages are received on some other thread, so switch to the UI thread
         // before attempting to access the UI
         runOnUiThread(new Runnable() {
@@ -0,0 +1,40 @@
+/**
+ * Copyright 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "cpu_simple_model.h"
+
+CpuSimpleModel::CpuSimpleModel(const float *weights, size_t count)
+    : tensorSize_(TENSOR_SIZE),
+      inputTensor1_(tensorSize_),
+      inputTensor2_(tensorSize_),
+      outputTensor_(tensorSize_) {
+  if (count >= 2 * tensorSize_) {
+    weights_.assign(weights, weights + 2 * tensorSize_);
+  }
+}
+
+bool CpuSimpleModel::CreateCompiledModel() {
+  if (weights_.empty()) {
+    LOGE("CpuSimpleModel needs %u weights", 2 * tensorSize_);
+    return false;
+  }
+  return SimpleModel::BuildGraph(&graph_, weights_.data(), tensorSize_);
+}
+
+bool CpuSimpleModel::Execute() {
+  const float *inputs[] = {inputTensor1_.data(), inputTensor2_.data()};
+  float *outputs[] = {outputTensor_.data()};
+  return graph_.Compute(inputs, outputs);
+}
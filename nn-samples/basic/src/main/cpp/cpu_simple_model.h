@@ -0,0 +1,58 @@
+/**
+ * Copyright 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef NNAPI_CPU_SIMPLE_MODEL_H
+#define NNAPI_CPU_SIMPLE_MODEL_H
+
+#include <stddef.h>
+
+#include <vector>
+
+#include "cpu_graph.h"
+#include "simple_model.h"
+
+/**
+ * CpuSimpleModel
+ * SimpleModel backend running the graph on the nn_graph::CpuGraph reference
+ * executor. It has no Android dependencies: the host tests and benchmark in
+ * nn-samples/tests run the sample's graph with it, as a reference for the
+ * NNAPI results.
+ */
+class CpuSimpleModel : public SimpleModelBackend {
+ public:
+  // weights holds the two constant tensors back to back, as in
+  // model_data.bin.
+  CpuSimpleModel(const float *weights, size_t count);
+
+  bool CreateCompiledModel() override;
+
+  float *input1() override { return inputTensor1_.data(); }
+  float *input2() override { return inputTensor2_.data(); }
+  const float *output() override { return outputTensor_.data(); }
+
+  bool Execute() override;
+
+ private:
+  uint32_t tensorSize_;
+  nn_graph::CpuGraph graph_;
+
+  std::vector<float> weights_;
+  std::vector<float> inputTensor1_;
+  std::vector<float> inputTensor2_;
+  std::vector<float> outputTensor_;
+};
+
+#endif  // NNAPI_CPU_SIMPLE_MODEL_H
@@ -25,13 +25,15 @@
 #include <sstream>
 #include <string>
 
+#include "nnapi_simple_model.h"
 #include "simple_model.h"
 
 extern "C" JNIEXPORT jlong JNICALL
 Java_com_example_android_basic_MainActivity_initModel(JNIEnv *env,
                                                       jobject /* this */,
                                                       jobject _assetManager,
-                                                      jstring _assetName) {
+                                                      jstring _assetName,
+                                                      jstring _cacheDir) {
   // Get the file descriptor of the model data file.
   AAssetManager *assetManager = AAssetManager_fromJava(env, _assetManager);
   const char *assetName = env->GetStringUTFChars(_assetName, NULL);
@@ -43,7 +45,12 @@ Java_com_example_android_basic_MainActivity_initModel(JNIEnv *env,
     return 0;
   }
   env->ReleaseStringUTFChars(_assetName, assetName);
-  SimpleModel *nn_model = new SimpleModel(asset);
+  const char *cacheDirChars = env->GetStringUTFChars(_cacheDir, NULL);
+  std::string cacheDir(cacheDirChars);
+  env->ReleaseStringUTFChars(_cacheDir, cacheDirChars);
+  SimpleModel *nn_model =
+      new SimpleModel(std::unique_ptr<SimpleModelBackend>(
+          new NnapiSimpleModel(asset, cacheDir)));
   AAsset_close(asset);
   if (!nn_model->CreateCompiledModel()) {
     __android_log_print(ANDROID_LOG_ERROR, LOG_TAG,
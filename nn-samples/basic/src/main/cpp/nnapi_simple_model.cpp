@@ -0,0 +1,424 @@
+/**
+ * Copyright 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "nnapi_simple_model.h"
+
+#include <android/asset_manager_jni.h>
+#include <android/log.h>
+#include <android/sharedmem.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <string>
+
+#include "cache_token.h"
+#include "compilation_cache.h"
+#include "nnapi_model_builder.h"
+
+namespace {
+
+// Map a shared memory region holding size floats, or return nullptr.
+float *mapTensor(int fd, uint32_t size, int prot) {
+  if (fd < 0) {
+    return nullptr;
+  }
+  void *data = mmap(nullptr, size * sizeof(float), prot, MAP_SHARED, fd, 0);
+  if (data == MAP_FAILED) {
+    __android_log_print(ANDROID_LOG_ERROR, LOG_TAG,
+                        "Failed to map a shared memory");
+    return nullptr;
+  }
+  return reinterpret_cast<float *>(data);
+}
+
+// Create ANeuralNetworksMemory from an asset file, and leave the copy of the
+// data mapped at *data for the graph construction to refer to.
+//
+// Note that, at API level 30 or earlier, the NNAPI drivers may not have the
+// permission to access the asset file. To work around this issue, here we will:
+// 1. Allocate a large-enough shared memory to hold the model data;
+// 2. Copy the asset file to the shared memory;
+// 3. Create the NNAPI memory with the file descriptor of the shared memory.
+ANeuralNetworksMemory *createMemoryFromAsset(AAsset *asset, void **data,
+                                             size_t *size) {
+  // Allocate a large-enough shared memory to hold the model data.
+  off_t length = AAsset_getLength(asset);
+  int fd = ASharedMemory_create("model_data", length);
+  if (fd < 0) {
+    __android_log_print(ANDROID_LOG_ERROR, LOG_TAG,
+                        "ASharedMemory_create failed with size %d", length);
+    return nullptr;
+  }
+
+  // Copy the asset file to the shared memory.
+  void *mapped =
+      mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  if (mapped == MAP_FAILED) {
+    __android_log_print(ANDROID_LOG_ERROR, LOG_TAG,
+                        "Failed to map a shared memory");
+    close(fd);
+    return nullptr;
+  }
+  AAsset_read(asset, mapped, length);
+
+  // Create the NNAPI memory with the file descriptor of the shared memory.
+  ANeuralNetworksMemory *memory;
+  int status = ANeuralNetworksMemory_createFromFd(
+      length, PROT_READ | PROT_WRITE, fd, 0, &memory);
+
+  // It is safe to close the file descriptor here because
+  // ANeuralNetworksMemory_createFromFd will create a dup.
+  close(fd);
+  if (status != ANEURALNETWORKS_NO_ERROR) {
+    __android_log_print(
+        ANDROID_LOG_ERROR, LOG_TAG,
+        "ANeuralNetworksMemory_createFromFd failed for trained weights");
+    munmap(mapped, length);
+    return nullptr;
+  }
+  *data = mapped;
+  *size = length;
+  return memory;
+}
+
+}  // namespace
+
+/**
+ * NnapiSimpleModel Constructor.
+ *
+ * Initialize the member variables, including the shared memory objects.
+ */
+NnapiSimpleModel::NnapiSimpleModel(AAsset *asset, const std::string &cacheDir)
+    : model_(nullptr),
+      compilation_(nullptr),
+      memoryInput2_(nullptr),
+      memoryOutput_(nullptr),
+      execution_(nullptr),
+      burst_(nullptr),
+      dimLength_(TENSOR_SIZE),
+      cacheDir_(cacheDir),
+      modelData_(nullptr),
+      modelDataSize_(0) {
+  tensorSize_ = dimLength_;
+  inputTensor1_.resize(tensorSize_);
+
+  // Create ANeuralNetworksMemory from a file containing the trained data.
+  memoryModel_ = createMemoryFromAsset(asset, &modelData_, &modelDataSize_);
+
+  // Create ASharedMemory to hold the data for the second input tensor and
+  // output output tensor.
+  inputTensor2Fd_ = ASharedMemory_create("input2", tensorSize_ * sizeof(float));
+  outputTensorFd_ = ASharedMemory_create("output", tensorSize_ * sizeof(float));
+
+  // Map them once for the lifetime of the model, Compute only writes the
+  // inputs and reads the output.
+  inputTensor2_ =
+      mapTensor(inputTensor2Fd_, tensorSize_, PROT_READ | PROT_WRITE);
+  outputTensor_ = mapTensor(outputTensorFd_, tensorSize_, PROT_READ);
+
+  // Create ANeuralNetworksMemory objects from the corresponding ASharedMemory
+  // objects.
+  int status =
+      ANeuralNetworksMemory_createFromFd(tensorSize_ * sizeof(float), PROT_READ,
+                                         inputTensor2Fd_, 0, &memoryInput2_);
+  if (status != ANEURALNETWORKS_NO_ERROR) {
+    __android_log_print(ANDROID_LOG_ERROR, LOG_TAG,
+                        "ANeuralNetworksMemory_createFromFd failed for Input2");
+    return;
+  }
+  status = ANeuralNetworksMemory_createFromFd(
+      tensorSize_ * sizeof(float), PROT_READ | PROT_WRITE, outputTensorFd_, 0,
+      &memoryOutput_);
+  if (status != ANEURALNETWORKS_NO_ERROR) {
+    __android_log_print(ANDROID_LOG_ERROR, LOG_TAG,
+                        "ANeuralNetworksMemory_createFromFd failed for Output");
+    return;
+  }
+}
+
+/**
+ * Build the graph of SimpleModel::BuildGraph() and compile it.
+ *
+ * @return true for success, false otherwise
+ */
+bool NnapiSimpleModel::CreateCompiledModel() {
+  int32_t status;
+
+  if (!memoryModel_ || !memoryInput2_ || !memoryOutput_ || !inputTensor2_ ||
+      !outputTensor_) {
+    return false;
+  }
+  if (modelDataSize_ < 2 * tensorSize_ * sizeof(float)) {
+    __android_log_print(ANDROID_LOG_ERROR, LOG_TAG,
+                        "The model data holds %zu bytes, %zu are needed",
+                        modelDataSize_, 2 * tensorSize_ * sizeof(float));
+    return false;
+  }
+
+  // The weights are read from memoryModel_, which the builder finds from
+  // their address in the mapping.
+  nn_graph::NnapiModelBuilder builder;
+  builder.AddMemory(memoryModel_, modelData_, modelDataSize_);
+  if (!SimpleModel::BuildGraph(&builder,
+                               static_cast<const float *>(modelData_),
+                               dimLength_)) {
+    return false;
+  }
+  model_ = builder.Release();
+
+  // The cache token covers everything the compiled model depends on: the
+  // graph, the weights, and the compilation preference. Building the graph
+  // again through a CacheTokenBuilder hashes the first two.
+  nn_graph::CacheTokenBuilder token;
+  token.AddTag("PREFER_FAST_SINGLE_ANSWER");
+  if (!SimpleModel::BuildGraph(&token, static_cast<const float *>(modelData_),
+                               dimLength_)) {
+    return false;
+  }
+  bool warm = false;
+  std::string cacheDir =
+      nn_graph::PrepareCompilationCache(cacheDir_, "basic", token, &warm);
+
+  auto compileStart = std::chrono::steady_clock::now();
+
+  // Create the ANeuralNetworksCompilation object for the constructed model.
+  status = ANeuralNetworksCompilation_create(model_, &compilation_);
+  if (status != ANEURALNETWORKS_NO_ERROR) {
+    __android_log_print(ANDROID_LOG_ERROR, LOG_TAG,
+                        "ANeuralNetworksCompilation_create failed");
+    return false;
+  }
+
+  // Let the drivers save the compiled model in the cache directory, or load
+  // it from there if a previous run did.
+  bool cached = false;
+  if (!cacheDir.empty()) {
+    if (__builtin_available(android 29, *)) {
+      status = ANeuralNetworksCompilation_setCaching(
+          compilation_, cacheDir.c_str(), token.token());
+      if (status != ANEURALNETWORKS_NO_ERROR) {
+        __android_log_print(ANDROID_LOG_WARN, LOG_TAG,
+                            "ANeuralNetworksCompilation_setCaching failed");
+      }
+      cached = status == ANEURALNETWORKS_NO_ERROR;
+    }
+  }
+
+  // Set the preference for the compilation, so that the runtime and drivers
+  // can make better decisions.
+  // Here we prefer to get the answer quickly, so we choose
+  // ANEURALNETWORKS_PREFER_FAST_SINGLE_ANSWER.
+  status = ANeuralNetworksCompilation_setPreference(
+      compilation_, ANEURALNETWORKS_PREFER_FAST_SINGLE_ANSWER);
+  if (status != ANEURALNETWORKS_NO_ERROR) {
+    __android_log_print(ANDROID_LOG_ERROR, LOG_TAG,
+                        "ANeuralNetworksCompilation_setPreference failed");
+    return false;
+  }
+
+  // Finish the compilation.
+  status = ANeuralNetworksCompilation_finish(compilation_);
+  if (status != ANEURALNETWORKS_NO_ERROR) {
+    __android_log_print(ANDROID_LOG_ERROR, LOG_TAG,
+                        "ANeuralNetworksCompilation_finish failed");
+    return false;
+  }
+  __android_log_print(
+      ANDROID_LOG_INFO, LOG_TAG, "Compiled in %.1f ms (%s)",
+      std::chrono::duration<double, std::milli>(
+          std::chrono::steady_clock::now() - compileStart)
+          .count(),
+      !cached ? "no cache" : warm ? "warm cache" : "cold cache");
+
+  // A burst object lets the runtime and driver keep the resources of an
+  // execution around for the next one, which cuts the per call overhead of
+  // back to back computations.
+  if (__builtin_available(android 29, *)) {
+    status = ANeuralNetworksBurst_create(compilation_, &burst_);
+    if (status != ANEURALNETWORKS_NO_ERROR) {
+      __android_log_print(ANDROID_LOG_WARN, LOG_TAG,
+                          "ANeuralNetworksBurst_create failed, not using it");
+      burst_ = nullptr;
+    }
+  }
+
+  // Since the inputs and the output of every computation are the same
+  // memories, a reusable execution can be set up once for all of them.
+  if (__builtin_available(android 31, *)) {
+    if (!CreateExecution(true, &execution_)) {
+      __android_log_print(ANDROID_LOG_WARN, LOG_TAG,
+                          "Reusable execution failed, creating one per call");
+      execution_ = nullptr;
+    }
+  }
+
+  return true;
+}
+
+/**
+ * Create an execution and associate the input and output tensors with it.
+ */
+bool NnapiSimpleModel::CreateExecution(bool reusable,
+                                       ANeuralNetworksExecution **execution) {
+  // Create an ANeuralNetworksExecution object from the compiled model.
+  // Note:
+  //   1. All the input and output data are tied to the ANeuralNetworksExecution
+  //   object.
+  //   2. Multiple concurrent execution instances could be created from the same
+  //   compiled model.
+  // This sample only uses one execution of the compiled model.
+  int32_t status = ANeuralNetworksExecution_create(compilation_, execution);
+  if (status != ANEURALNETWORKS_NO_ERROR) {
+    __android_log_print(ANDROID_LOG_ERROR, LOG_TAG,
+                        "ANeuralNetworksExecution_create failed");
+    return false;
+  }
+
+  if (reusable) {
+    status = ANEURALNETWORKS_BAD_STATE;
+    if (__builtin_available(android 31, *)) {
+      status = ANeuralNetworksExecution_setReusable(*execution, true);
+    }
+    if (status != ANEURALNETWORKS_NO_ERROR) {
+      __android_log_print(ANDROID_LOG_ERROR, LOG_TAG,
+                          "ANeuralNetworksExecution_setReusable failed");
+      ANeuralNetworksExecution_free(*execution);
+      return false;
+    }
+  }
+
+  // Tell the execution to associate inputTensor1 to the first of the two model
+  // inputs. Note that the index "0" here means the first operand of the
+  // modelInput list {tensor1, tensor3}, which means tensor1. The values are
+  // read from inputTensor1_ when the execution runs.
+  status = ANeuralNetworksExecution_setInput(*execution, 0, nullptr,
+                                             inputTensor1_.data(),
+                                             tensorSize_ * sizeof(float));
+  if (status != ANEURALNETWORKS_NO_ERROR) {
+    __android_log_print(ANDROID_LOG_ERROR, LOG_TAG,
+                        "ANeuralNetworksExecution_setInput failed for input1");
+    ANeuralNetworksExecution_free(*execution);
+    return false;
+  }
+
+  // ANeuralNetworksExecution_setInputFromMemory associates the operand with a
+  // shared memory region to minimize the number of copies of raw data. Note
+  // that the index "1" here means the second operand of the modelInput list
+  // {tensor1, tensor3}, which means tensor3.
+  status = ANeuralNetworksExecution_setInputFromMemory(
+      *execution, 1, nullptr, memoryInput2_, 0, tensorSize_ * sizeof(float));
+  if (status != ANEURALNETWORKS_NO_ERROR) {
+    __android_log_print(
+        ANDROID_LOG_ERROR, LOG_TAG,
+        "ANeuralNetworksExecution_setInputFromMemory failed for input2");
+    ANeuralNetworksExecution_free(*execution);
+    return false;
+  }
+
+  // Set the output tensor that will be filled by executing the model.
+  // We use shared memory here to minimize the copies needed for getting the
+  // output data.
+  status = ANeuralNetworksExecution_setOutputFromMemory(
+      *execution, 0, nullptr, memoryOutput_, 0, tensorSize_ * sizeof(float));
+  if (status != ANEURALNETWORKS_NO_ERROR) {
+    __android_log_print(
+        ANDROID_LOG_ERROR, LOG_TAG,
+        "ANeuralNetworksExecution_setOutputFromMemory failed for output");
+    ANeuralNetworksExecution_free(*execution);
+    return false;
+  }
+  return true;
+}
+
+/**
+ * Run the model on the current contents of the input tensors.
+ */
+bool NnapiSimpleModel::Execute() {
+  ANeuralNetworksExecution *execution = execution_;
+  if (!execution && !CreateExecution(false, &execution)) {
+    return false;
+  }
+
+  int32_t status;
+  bool computed = false;
+  if (__builtin_available(android 29, *)) {
+    if (burst_) {
+      // Synchronous, through the burst.
+      status = ANeuralNetworksExecution_burstCompute(execution, burst_);
+      if (status == ANEURALNETWORKS_NO_ERROR) {
+        computed = true;
+      } else {
+        __android_log_print(ANDROID_LOG_ERROR, LOG_TAG,
+                            "ANeuralNetworksExecution_burstCompute failed, "
+                            "computing without the burst");
+      }
+    }
+  }
+  if (!computed) {
+    // Start the execution of the model.
+    // Note that the execution here is asynchronous, and an ANeuralNetworksEvent
+    // object will be created to monitor the status of the execution.
+    ANeuralNetworksEvent *event = nullptr;
+    status = ANeuralNetworksExecution_startCompute(execution, &event);
+    if (status != ANEURALNETWORKS_NO_ERROR) {
+      __android_log_print(ANDROID_LOG_ERROR, LOG_TAG,
+                          "ANeuralNetworksExecution_startCompute failed");
+    } else {
+      // Wait until the completion of the execution. This could be done on a
+      // different thread. By waiting immediately, we effectively make this a
+      // synchronous call.
+      status = ANeuralNetworksEvent_wait(event);
+      if (status != ANEURALNETWORKS_NO_ERROR) {
+        __android_log_print(ANDROID_LOG_ERROR, LOG_TAG,
+                            "ANeuralNetworksEvent_wait failed");
+      }
+      ANeuralNetworksEvent_free(event);
+    }
+  }
+
+  if (execution != execution_) {
+    ANeuralNetworksExecution_free(execution);
+  }
+  return status == ANEURALNETWORKS_NO_ERROR;
+}
+
+/**
+ * NnapiSimpleModel Destructor.
+ *
+ * Release NN API objects, unmap the tensors and close the file descriptors.
+ */
+NnapiSimpleModel::~NnapiSimpleModel() {
+  ANeuralNetworksExecution_free(execution_);
+  if (__builtin_available(android 29, *)) {
+    ANeuralNetworksBurst_free(burst_);
+  }
+  ANeuralNetworksCompilation_free(compilation_);
+  ANeuralNetworksModel_free(model_);
+  ANeuralNetworksMemory_free(memoryModel_);
+  ANeuralNetworksMemory_free(memoryInput2_);
+  ANeuralNetworksMemory_free(memoryOutput_);
+  if (modelData_) {
+    munmap(modelData_, modelDataSize_);
+  }
+  if (inputTensor2_) {
+    munmap(inputTensor2_, tensorSize_ * sizeof(float));
+  }
+  if (outputTensor_) {
+    munmap(outputTensor_, tensorSize_ * sizeof(float));
+  }
+  close(inputTensor2Fd_);
+  close(outputTensorFd_);
+}
@@ -0,0 +1,81 @@
+/**
+ * Copyright 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef NNAPI_NNAPI_SIMPLE_MODEL_H
+#define NNAPI_NNAPI_SIMPLE_MODEL_H
+
+#include <android/NeuralNetworks.h>
+#include <android/asset_manager_jni.h>
+
+#include <string>
+#include <vector>
+
+#include "simple_model.h"
+
+/**
+ * NnapiSimpleModel
+ * SimpleModel backend running the graph through NNAPI.
+ *
+ * The second input and the output live in ASharedMemory regions that stay
+ * mapped, so Compute only writes and reads them. On API 31+ a single
+ * reusable execution is bound to the tensors once; before that, each call
+ * creates one. On API 29+ executions run through a burst object, which lets
+ * the driver keep its state between calls, and the compilation is cached in
+ * cacheDir, under a token derived from the graph and the weights.
+ */
+class NnapiSimpleModel : public SimpleModelBackend {
+ public:
+  // cacheDir may be empty, to compile without caching.
+  NnapiSimpleModel(AAsset *asset, const std::string &cacheDir);
+  ~NnapiSimpleModel() override;
+
+  bool CreateCompiledModel() override;
+
+  float *input1() override { return inputTensor1_.data(); }
+  float *input2() override { return inputTensor2_; }
+  const float *output() override { return outputTensor_; }
+
+  bool Execute() override;
+
+ private:
+  bool CreateExecution(bool reusable, ANeuralNetworksExecution **execution);
+
+  ANeuralNetworksModel *model_;
+  ANeuralNetworksCompilation *compilation_;
+  ANeuralNetworksMemory *memoryModel_;
+  ANeuralNetworksMemory *memoryInput2_;
+  ANeuralNetworksMemory *memoryOutput_;
+
+  // reusable execution (API 31+) and burst (API 29+), null if unsupported
+  ANeuralNetworksExecution *execution_;
+  ANeuralNetworksBurst *burst_;
+
+  uint32_t dimLength_;
+  uint32_t tensorSize_;
+  std::string cacheDir_;
+
+  // model_data.bin, copied to the memory behind memoryModel_
+  void *modelData_;
+  size_t modelDataSize_;
+
+  std::vector<float> inputTensor1_;
+  int inputTensor2Fd_;
+  int outputTensorFd_;
+  float *inputTensor2_;
+  float *outputTensor_;
+};
+
+#endif  // NNAPI_NNAPI_SIMPLE_MODEL_H
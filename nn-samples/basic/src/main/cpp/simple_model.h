@@ -17,15 +17,44 @@
 #ifndef NNAPI_SIMPLE_MODEL_H
 #define NNAPI_SIMPLE_MODEL_H
 
-#include <android/NeuralNetworks.h>
-#include <android/asset_manager_jni.h>
+#include <stdint.h>
 
-#include <vector>
+#include <memory>
+
+#include "model_builder.h"
 
 #define FLOAT_EPISILON (1e-6)
 #define TENSOR_SIZE 200
 #define LOG_TAG "NNAPI_BASIC"
 
+#ifdef __ANDROID__
+#include <android/log.h>
+#define LOGE(...) __android_log_print(ANDROID_LOG_ERROR, LOG_TAG, __VA_ARGS__)
+#else
+#include <stdio.h>
+#define LOGE(...) (fprintf(stderr, __VA_ARGS__), fputc('\n', stderr))
+#endif
+
+/**
+ * SimpleModelBackend
+ * Where the graph runs: owns the two input tensors and the output tensor,
+ * each TENSOR_SIZE floats and mapped for the lifetime of the backend, and
+ * executes the graph on them.
+ */
+class SimpleModelBackend {
+ public:
+  virtual ~SimpleModelBackend() = default;
+
+  virtual bool CreateCompiledModel() = 0;
+
+  virtual float *input1() = 0;
+  virtual float *input2() = 0;
+  virtual const float *output() = 0;
+
+  // Run the graph on the current input values.
+  virtual bool Execute() = 0;
+};
+
 /**
  * SimpleModel
  * Build up the hardcoded graph of
@@ -37,28 +66,24 @@
  *       dimLength x dimLength
  *   with NO fused_activation operation
  *
+ * on the NNAPI (NnapiSimpleModel) or the CPU (CpuSimpleModel) backend.
  */
 class SimpleModel {
  public:
-  explicit SimpleModel(AAsset *asset);
-  ~SimpleModel();
+  explicit SimpleModel(std::unique_ptr<SimpleModelBackend> backend);
+
+  // Add the graph to builder, for a backend to compile. weights holds
+  // tensor0 and tensor2 back to back, as in model_data.bin, and has to
+  // outlive the model.
+  static bool BuildGraph(nn_graph::ModelBuilder *builder,
+                         const float *weights, uint32_t dimLength);
 
   bool CreateCompiledModel();
   bool Compute(float inputValue1, float inputValue2, float *result);
 
  private:
-  ANeuralNetworksModel *model_;
-  ANeuralNetworksCompilation *compilation_;
-  ANeuralNetworksMemory *memoryModel_;
-  ANeuralNetworksMemory *memoryInput2_;
-  ANeuralNetworksMemory *memoryOutput_;
-
-  uint32_t dimLength_;
+  std::unique_ptr<SimpleModelBackend> backend_;
   uint32_t tensorSize_;
-
-  std::vector<float> inputTensor1_;
-  int inputTensor2Fd_;
-  int outputTensorFd_;
 };
 
-#endif  // NNAPI_SIMPLE_MODEL_H
\ No newline at end of file
+#endif  // NNAPI_SIMPLE_MODEL_H
@@ -35,7 +35,8 @@ class MainActivity : Activity() {
        3 JNI functions managing NN models, refer to basic/README.md
        for model structure
      */
-    private external fun initModel(assetManager: AssetManager?, assetName: String?): Long
+    private external fun initModel(assetManager: AssetManager?, assetName: String?,
+                                   cacheDir: String): Long
     private external fun startCompute(modelHandle: Long, input1: Float, input2: Float): Float
     private external fun destroyModel(modelHandle: Long)
 
@@ -47,7 +48,8 @@ class MainActivity : Activity() {
         binding = ActivityMainBinding.inflate(layoutInflater)
         setContentView(binding.root)
         CoroutineScope(Dispatchers.IO + activityJob).async(Dispatchers.IO) {
-            modelHandle = this@MainActivity.initModel(assets, "model_data.bin")
+            modelHandle = this@MainActivity.initModel(assets, "model_data.bin",
+                    codeCacheDir.absolutePath)
         }
 
         binding.computButton.setOnClickListener {
@@ -0,0 +1,239 @@
+/**
+ * Copyright 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "cache_token.h"
+
+#include <string.h>
+
+#include <algorithm>
+
+namespace nn_graph {
+
+namespace {
+
+const uint32_t kRoundConstants[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1,
+    0x923f82a4, 0xab1c5ed5, 0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3,
+    0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174, 0xe49b69c1, 0xefbe4786,
+    0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147,
+    0x06ca6351, 0x14292967, 0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13,
+    0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85, 0xa2bfe8a1, 0xa81a664b,
+    0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a,
+    0x5b9cca4f, 0x682e6ff3, 0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208,
+    0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2,
+};
+
+inline uint32_t rotr(uint32_t x, int n) { return (x >> n) | (x << (32 - n)); }
+
+// Record kinds, hashed ahead of each builder call.
+enum : uint32_t {
+  kTag = 1,
+  kTensorOperand,
+  kFusedActivationNone,
+  kTensorValue,
+  kOperation,
+  kInputsAndOutputs,
+};
+
+}  // namespace
+
+CacheTokenBuilder::CacheTokenBuilder()
+    : operandCount_(0),
+      finished_(false),
+      state_{0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f,
+             0x9b05688c, 0x1f83d9ab, 0x5be0cd19},
+      blockSize_(0),
+      length_(0),
+      token_{} {}
+
+void CacheTokenBuilder::ProcessBlock(const uint8_t* block) {
+  uint32_t w[64];
+  for (int i = 0; i < 16; i++) {
+    w[i] = (uint32_t)block[4 * i] << 24 | (uint32_t)block[4 * i + 1] << 16 |
+           (uint32_t)block[4 * i + 2] << 8 | block[4 * i + 3];
+  }
+  for (int i = 16; i < 64; i++) {
+    uint32_t s0 = rotr(w[i - 15], 7) ^ rotr(w[i - 15], 18) ^ (w[i - 15] >> 3);
+    uint32_t s1 = rotr(w[i - 2], 17) ^ rotr(w[i - 2], 19) ^ (w[i - 2] >> 10);
+    w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+  }
+  uint32_t a = state_[0], b = state_[1], c = state_[2], d = state_[3];
+  uint32_t e = state_[4], f = state_[5], g = state_[6], h = state_[7];
+  for (int i = 0; i < 64; i++) {
+    uint32_t s1 = rotr(e, 6) ^ rotr(e, 11) ^ rotr(e, 25);
+    uint32_t ch = (e & f) ^ (~e & g);
+    uint32_t t1 = h + s1 + ch + kRoundConstants[i] + w[i];
+    uint32_t s0 = rotr(a, 2) ^ rotr(a, 13) ^ rotr(a, 22);
+    uint32_t maj = (a & b) ^ (a & c) ^ (b & c);
+    uint32_t t2 = s0 + maj;
+    h = g;
+    g = f;
+    f = e;
+    e = d + t1;
+    d = c;
+    c = b;
+    b = a;
+    a = t1 + t2;
+  }
+  state_[0] += a;
+  state_[1] += b;
+  state_[2] += c;
+  state_[3] += d;
+  state_[4] += e;
+  state_[5] += f;
+  state_[6] += g;
+  state_[7] += h;
+}
+
+void CacheTokenBuilder::Update(const void* data, size_t size) {
+  const uint8_t* bytes = static_cast<const uint8_t*>(data);
+  length_ += size;
+  if (blockSize_) {
+    size_t n = std::min(size, sizeof(block_) - blockSize_);
+    memcpy(block_ + blockSize_, bytes, n);
+    blockSize_ += n;
+    bytes += n;
+    size -= n;
+    if (blockSize_ < sizeof(block_)) {
+      return;
+    }
+    ProcessBlock(block_);
+    blockSize_ = 0;
+  }
+  for (; size >= sizeof(block_); bytes += sizeof(block_),
+                                 size -= sizeof(block_)) {
+    ProcessBlock(bytes);
+  }
+  memcpy(block_, bytes, size);
+  blockSize_ = size;
+}
+
+// Numbers are hashed little-endian whatever the host, so a token computed on
+// a build host matches the device's.
+void CacheTokenBuilder::AddRecord(uint32_t kind, const uint32_t* values,
+                                  size_t count) {
+  uint8_t bytes[4];
+  auto add = [&](uint32_t value) {
+    for (int i = 0; i < 4; i++) {
+      bytes[i] = value >> (8 * i);
+    }
+    Update(bytes, sizeof(bytes));
+  };
+  add(kind);
+  add(count);
+  for (size_t i = 0; i < count; i++) {
+    add(values[i]);
+  }
+}
+
+void CacheTokenBuilder::AddTag(const char* tag) {
+  uint32_t size = strlen(tag);
+  AddRecord(kTag, &size, 1);
+  Update(tag, size);
+}
+
+bool CacheTokenBuilder::AddTensorOperand(
+    const std::vector<uint32_t>& dimensions, uint32_t* index) {
+  if (finished_) {
+    return false;
+  }
+  AddRecord(kTensorOperand, dimensions.data(), dimensions.size());
+  *index = operandCount_++;
+  return true;
+}
+
+bool CacheTokenBuilder::AddFusedActivationNone(uint32_t* index) {
+  if (finished_) {
+    return false;
+  }
+  AddRecord(kFusedActivationNone, nullptr, 0);
+  *index = operandCount_++;
+  return true;
+}
+
+bool CacheTokenBuilder::SetTensorValue(uint32_t index, const float* data,
+                                       size_t count) {
+  if (finished_) {
+    return false;
+  }
+  uint32_t header[] = {index, static_cast<uint32_t>(count)};
+  AddRecord(kTensorValue, header, 2);
+  for (size_t i = 0; i < count; i++) {
+    uint32_t bits;
+    memcpy(&bits, &data[i], sizeof(bits));
+    uint8_t bytes[4] = {static_cast<uint8_t>(bits),
+                        static_cast<uint8_t>(bits >> 8),
+                        static_cast<uint8_t>(bits >> 16),
+                        static_cast<uint8_t>(bits >> 24)};
+    Update(bytes, sizeof(bytes));
+  }
+  return true;
+}
+
+bool CacheTokenBuilder::AddOperation(OperationType type, uint32_t input1,
+                                     uint32_t input2, uint32_t fusedActivation,
+                                     uint32_t output) {
+  if (finished_) {
+    return false;
+  }
+  uint32_t values[] = {static_cast<uint32_t>(type), input1, input2,
+                       fusedActivation, output};
+  AddRecord(kOperation, values, sizeof(values) / sizeof(values[0]));
+  return true;
+}
+
+bool CacheTokenBuilder::IdentifyInputsAndOutputs(
+    const std::vector<uint32_t>& inputs, const std::vector<uint32_t>& outputs) {
+  if (finished_) {
+    return false;
+  }
+  AddRecord(kInputsAndOutputs, inputs.data(), inputs.size());
+  AddRecord(kInputsAndOutputs, outputs.data(), outputs.size());
+  return true;
+}
+
+bool CacheTokenBuilder::Finish() {
+  if (finished_) {
+    return false;
+  }
+  uint64_t bits = length_ * 8;
+  uint8_t padding[72] = {0x80};
+  size_t paddingSize = (blockSize_ < 56 ? 56 : 120) - blockSize_;
+  for (int i = 0; i < 8; i++) {
+    padding[paddingSize + i] = bits >> (56 - 8 * i);
+  }
+  Update(padding, paddingSize + 8);
+  for (int i = 0; i < 8; i++) {
+    for (int j = 0; j < 4; j++) {
+      token_[4 * i + j] = state_[i] >> (24 - 8 * j);
+    }
+  }
+  finished_ = true;
+  return true;
+}
+
+std::string CacheTokenBuilder::hexToken() const {
+  static const char kDigits[] = "0123456789abcdef";
+  std::string hex;
+  for (uint8_t byte : token_) {
+    hex += kDigits[byte >> 4];
+    hex += kDigits[byte & 0xf];
+  }
+  return hex;
+}
+
+}  // namespace nn_graph
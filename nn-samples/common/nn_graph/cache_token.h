@@ -0,0 +1,84 @@
+/**
+ * Copyright 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef NN_GRAPH_CACHE_TOKEN_H
+#define NN_GRAPH_CACHE_TOKEN_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+#include "model_builder.h"
+
+namespace nn_graph {
+
+// ANEURALNETWORKS_BYTE_SIZE_OF_CACHE_TOKEN
+constexpr size_t kCacheTokenSize = 32;
+
+/**
+ * CacheTokenBuilder
+ * ModelBuilder computing the token under which NNAPI caches the compilation
+ * of a model: the SHA-256 of the operands, operations, inputs and outputs
+ * as they are added, and of the values of the constant tensors. Building
+ * the same graph with the same weights always gives the same token, and
+ * changing either gives a new one.
+ *
+ * Anything else the compiled model depends on, such as a model wrapping the
+ * graph or the compilation preference, goes in with AddTag().
+ */
+class CacheTokenBuilder : public ModelBuilder {
+ public:
+  CacheTokenBuilder();
+
+  void AddTag(const char* tag);
+
+  bool AddTensorOperand(const std::vector<uint32_t>& dimensions,
+                        uint32_t* index) override;
+  bool AddFusedActivationNone(uint32_t* index) override;
+  bool SetTensorValue(uint32_t index, const float* data,
+                      size_t count) override;
+  bool AddOperation(OperationType type, uint32_t input1, uint32_t input2,
+                    uint32_t fusedActivation, uint32_t output) override;
+  bool IdentifyInputsAndOutputs(const std::vector<uint32_t>& inputs,
+                                const std::vector<uint32_t>& outputs) override;
+  bool Finish() override;
+
+  // Available after Finish().
+  const uint8_t* token() const { return token_; }
+  std::string hexToken() const;
+
+ private:
+  void AddRecord(uint32_t kind, const uint32_t* values, size_t count);
+  void Update(const void* data, size_t size);
+  void ProcessBlock(const uint8_t* block);
+
+  uint32_t operandCount_;
+  bool finished_;
+
+  // SHA-256 state.
+  uint32_t state_[8];
+  uint8_t block_[64];
+  size_t blockSize_;
+  uint64_t length_;
+
+  uint8_t token_[kCacheTokenSize];
+};
+
+}  // namespace nn_graph
+
+#endif  // NN_GRAPH_CACHE_TOKEN_H
@@ -0,0 +1,100 @@
+/**
+ * Copyright 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "compilation_cache.h"
+
+#include <dirent.h>
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#ifdef __ANDROID__
+#include <android/log.h>
+#define LOGE(...) \
+  __android_log_print(ANDROID_LOG_ERROR, "NN_GRAPH", __VA_ARGS__)
+#else
+#define LOGE(...) (fprintf(stderr, __VA_ARGS__), fputc('\n', stderr))
+#endif
+
+namespace nn_graph {
+
+namespace {
+
+const char kTokenFile[] = "token";
+
+// Delete the files of directory, which has no subdirectories.
+void ClearDirectory(const std::string& directory) {
+  DIR* dir = opendir(directory.c_str());
+  if (!dir) {
+    return;
+  }
+  while (struct dirent* entry = readdir(dir)) {
+    if (strcmp(entry->d_name, ".") && strcmp(entry->d_name, "..")) {
+      unlink((directory + "/" + entry->d_name).c_str());
+    }
+  }
+  closedir(dir);
+}
+
+}  // namespace
+
+std::string PrepareCompilationCache(const std::string& cacheDir,
+                                    const char* name,
+                                    const CacheTokenBuilder& token,
+                                    bool* warm) {
+  *warm = false;
+  if (cacheDir.empty()) {
+    return "";
+  }
+  std::string directory = cacheDir + "/" + name;
+  if (mkdir(directory.c_str(), 0700) && errno != EEXIST) {
+    LOGE("Can't create the cache directory %s: %s", directory.c_str(),
+         strerror(errno));
+    return "";
+  }
+
+  std::string tokenPath = directory + "/" + kTokenFile;
+  std::string hexToken = token.hexToken();
+  char stored[2 * kCacheTokenSize + 1] = {};
+  if (FILE* file = fopen(tokenPath.c_str(), "r")) {
+    size_t size = fread(stored, 1, sizeof(stored) - 1, file);
+    stored[size] = '\0';
+    fclose(file);
+  }
+  if (hexToken == stored) {
+    *warm = true;
+    return directory;
+  }
+
+  // A different model was cached here.
+  ClearDirectory(directory);
+  FILE* file = fopen(tokenPath.c_str(), "w");
+  if (!file) {
+    LOGE("Can't write %s: %s", tokenPath.c_str(), strerror(errno));
+    return "";
+  }
+  bool written = fwrite(hexToken.data(), 1, hexToken.size(), file) ==
+                 hexToken.size();
+  if (fclose(file) || !written) {
+    LOGE("Can't write %s", tokenPath.c_str());
+    unlink(tokenPath.c_str());
+    return "";
+  }
+  return directory;
+}
+
+}  // namespace nn_graph
@@ -0,0 +1,45 @@
+/**
+ * Copyright 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef NN_GRAPH_COMPILATION_CACHE_H
+#define NN_GRAPH_COMPILATION_CACHE_H
+
+#include <string>
+
+#include "cache_token.h"
+
+namespace nn_graph {
+
+/**
+ * Get the directory to give ANeuralNetworksCompilation_setCaching() for the
+ * model called name: <cacheDir>/<name>, created if needed.
+ *
+ * The directory remembers the token of the last model cached there. When
+ * the token changes, because the graph or its weights did, the files the
+ * drivers left for the old one are stale and get deleted.
+ *
+ * @param warm  set to whether the directory was last used for this token, so
+ *              the compilation can come from the cache
+ * @return the directory, or an empty string if it can't be used
+ */
+std::string PrepareCompilationCache(const std::string& cacheDir,
+                                    const char* name,
+                                    const CacheTokenBuilder& token,
+                                    bool* warm);
+
+}  // namespace nn_graph
+
+#endif  // NN_GRAPH_COMPILATION_CACHE_H
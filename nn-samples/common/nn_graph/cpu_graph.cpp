@@ -0,0 +1,348 @@
+/**
+ * Copyright 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "cpu_graph.h"
+
+#include <algorithm>
+
+#include "tensor_ops.h"
+
+#ifdef __ANDROID__
+#include <android/log.h>
+#define LOGE(...) \
+  __android_log_print(ANDROID_LOG_ERROR, "NN_GRAPH", __VA_ARGS__)
+#else
+#include <stdio.h>
+#define LOGE(...) (fprintf(stderr, __VA_ARGS__), fputc('\n', stderr))
+#endif
+
+namespace nn_graph {
+
+namespace {
+
+const uint32_t kNoSlot = UINT32_MAX;
+
+}  // namespace
+
+bool CpuGraph::IsTensor(uint32_t index) const {
+  return index < operands_.size() &&
+         operands_[index].lifetime != Lifetime::kFusedActivation;
+}
+
+bool CpuGraph::AddTensorOperand(const std::vector<uint32_t>& dimensions,
+                                uint32_t* index) {
+  if (finished_) {
+    LOGE("AddTensorOperand: graph already finished");
+    return false;
+  }
+  size_t count = 1;
+  for (uint32_t dimension : dimensions) {
+    count *= dimension;
+  }
+  if (count == 0) {
+    LOGE("AddTensorOperand: empty or unspecified dimensions");
+    return false;
+  }
+  // No broadcasting: the element-wise operations need equal sizes, which
+  // also lets every operand be cut into the same tiles.
+  if (tensorSize_ && count != tensorSize_) {
+    LOGE("AddTensorOperand: %zu elements, the graph uses %zu", count,
+         tensorSize_);
+    return false;
+  }
+  tensorSize_ = count;
+  *index = operands_.size();
+  operands_.push_back({Lifetime::kTemporary, count, nullptr, kNoSlot});
+  return true;
+}
+
+bool CpuGraph::AddFusedActivationNone(uint32_t* index) {
+  if (finished_) {
+    LOGE("AddFusedActivationNone: graph already finished");
+    return false;
+  }
+  *index = operands_.size();
+  operands_.push_back({Lifetime::kFusedActivation, 0, nullptr, kNoSlot});
+  return true;
+}
+
+bool CpuGraph::SetTensorValue(uint32_t index, const float* data,
+                              size_t count) {
+  if (finished_ || !IsTensor(index) ||
+      operands_[index].lifetime != Lifetime::kTemporary || !data ||
+      count != operands_[index].count) {
+    LOGE("SetTensorValue failed for operand (%u)", index);
+    return false;
+  }
+  operands_[index].lifetime = Lifetime::kConstant;
+  operands_[index].value = data;
+  return true;
+}
+
+bool CpuGraph::AddOperation(OperationType type, uint32_t input1,
+                            uint32_t input2, uint32_t fusedActivation,
+                            uint32_t output) {
+  if (finished_ || !IsTensor(input1) || !IsTensor(input2) ||
+      !IsTensor(output) || fusedActivation >= operands_.size() ||
+      operands_[fusedActivation].lifetime != Lifetime::kFusedActivation) {
+    LOGE("AddOperation failed for output operand (%u)", output);
+    return false;
+  }
+  operations_.push_back({type, {input1, input2}, output});
+  return true;
+}
+
+bool CpuGraph::IdentifyInputsAndOutputs(const std::vector<uint32_t>& inputs,
+                                        const std::vector<uint32_t>& outputs) {
+  if (finished_ || !inputs_.empty() || !outputs_.empty()) {
+    LOGE("IdentifyInputsAndOutputs: called twice or after Finish");
+    return false;
+  }
+  for (uint32_t input : inputs) {
+    if (!IsTensor(input) ||
+        operands_[input].lifetime != Lifetime::kTemporary) {
+      LOGE("IdentifyInputsAndOutputs: bad input operand (%u)", input);
+      return false;
+    }
+    operands_[input].lifetime = Lifetime::kModelInput;
+  }
+  for (uint32_t output : outputs) {
+    if (!IsTensor(output) ||
+        operands_[output].lifetime != Lifetime::kTemporary) {
+      LOGE("IdentifyInputsAndOutputs: bad output operand (%u)", output);
+      return false;
+    }
+    operands_[output].lifetime = Lifetime::kModelOutput;
+  }
+  inputs_ = inputs;
+  outputs_ = outputs;
+  return true;
+}
+
+/**
+ * Put the operations in an order where each one runs after the ones
+ * producing its inputs. NNAPI accepts them in any order, so the builder
+ * does too.
+ */
+bool CpuGraph::SortOperations() {
+  std::vector<int32_t> producer(operands_.size(), -1);
+  for (size_t i = 0; i < operations_.size(); i++) {
+    const Operation& operation = operations_[i];
+    Lifetime lifetime = operands_[operation.output].lifetime;
+    if ((lifetime != Lifetime::kTemporary &&
+         lifetime != Lifetime::kModelOutput) ||
+        producer[operation.output] >= 0) {
+      LOGE("Operand (%u) can't be written by an operation", operation.output);
+      return false;
+    }
+    producer[operation.output] = i;
+  }
+
+  // Repeatedly take the operations whose inputs are all available. The
+  // graphs are tiny, so the quadratic scan is fine.
+  std::vector<bool> available(operands_.size());
+  for (size_t i = 0; i < operands_.size(); i++) {
+    available[i] = producer[i] < 0;
+  }
+  std::vector<Operation> sorted;
+  std::vector<bool> done(operations_.size());
+  while (sorted.size() < operations_.size()) {
+    size_t before = sorted.size();
+    for (size_t i = 0; i < operations_.size(); i++) {
+      const Operation& operation = operations_[i];
+      if (done[i] || !available[operation.inputs[0]] ||
+          !available[operation.inputs[1]]) {
+        continue;
+      }
+      sorted.push_back(operation);
+      available[operation.output] = true;
+      done[i] = true;
+    }
+    if (sorted.size() == before) {
+      LOGE("The graph has a cycle");
+      return false;
+    }
+  }
+  operations_.swap(sorted);
+
+  for (size_t i = 0; i < operands_.size(); i++) {
+    if (operands_[i].lifetime == Lifetime::kTemporary && producer[i] < 0) {
+      LOGE("Operand (%zu) is never set", i);
+      return false;
+    }
+    if (operands_[i].lifetime == Lifetime::kModelOutput && producer[i] < 0) {
+      LOGE("Model output (%zu) is never written", i);
+      return false;
+    }
+  }
+  return true;
+}
+
+/**
+ * Give every temporary a scratch tile, sharing tiles between temporaries
+ * whose lifetimes don't overlap.
+ */
+void CpuGraph::PlanScratch() {
+  // Position of the last operation reading each temporary.
+  std::vector<size_t> lastUse(operands_.size(), 0);
+  for (size_t i = 0; i < operations_.size(); i++) {
+    for (uint32_t input : operations_[i].inputs) {
+      lastUse[input] = i;
+    }
+  }
+
+  std::vector<uint32_t> freeSlots;
+  uint32_t slotCount = 0;
+  for (size_t i = 0; i < operations_.size(); i++) {
+    const Operation& operation = operations_[i];
+    // The kernels allow the output to alias an input, so the tiles of the
+    // inputs read for the last time can take the output.
+    for (int j = 0; j < 2; j++) {
+      uint32_t input = operation.inputs[j];
+      if (operands_[input].lifetime == Lifetime::kTemporary &&
+          lastUse[input] == i &&
+          (j == 0 || input != operation.inputs[0])) {
+        freeSlots.push_back(operands_[input].slot);
+      }
+    }
+    Operand& output = operands_[operation.output];
+    if (output.lifetime != Lifetime::kTemporary) {
+      continue;
+    }
+    if (freeSlots.empty()) {
+      output.slot = slotCount++;
+    } else {
+      output.slot = freeSlots.back();
+      freeSlots.pop_back();
+    }
+    // Nobody reads it: the tile is free again after the write.
+    if (lastUse[operation.output] <= i) {
+      freeSlots.push_back(output.slot);
+    }
+  }
+  scratch_.assign(slotCount * kTileSize, 0.0f);
+}
+
+bool CpuGraph::Finish() {
+  if (finished_) {
+    LOGE("Finish: graph already finished");
+    return false;
+  }
+  if (outputs_.empty()) {
+    LOGE("Finish: the model has no outputs");
+    return false;
+  }
+  if (!SortOperations()) {
+    return false;
+  }
+  PlanScratch();
+
+  base_.assign(operands_.size(), nullptr);
+  stride_.assign(operands_.size(), kTileSize);
+  for (size_t i = 0; i < operands_.size(); i++) {
+    const Operand& operand = operands_[i];
+    if (operand.lifetime == Lifetime::kTemporary) {
+      base_[i] = scratch_.data() + operand.slot * kTileSize;
+      stride_[i] = 0;
+    } else if (operand.lifetime == Lifetime::kConstant) {
+      // Never written through: outputs are temporaries or model outputs.
+      base_[i] = const_cast<float*>(operand.value);
+    }
+  }
+  finished_ = true;
+  return true;
+}
+
+void CpuGraph::RunTile(size_t tile, size_t size) {
+  for (const Operation& operation : operations_) {
+    const float* a =
+        base_[operation.inputs[0]] + tile * stride_[operation.inputs[0]];
+    const float* b =
+        base_[operation.inputs[1]] + tile * stride_[operation.inputs[1]];
+    float* out = base_[operation.output] + tile * stride_[operation.output];
+    switch (operation.type) {
+      case OperationType::kAdd:
+        AddTensors(a, b, out, size);
+        break;
+      case OperationType::kMul:
+        MulTensors(a, b, out, size);
+        break;
+    }
+  }
+}
+
+bool CpuGraph::Compute(const float* const* inputs, float* const* outputs) {
+  if (!finished_) {
+    LOGE("Compute: graph not finished");
+    return false;
+  }
+  for (size_t i = 0; i < inputs_.size(); i++) {
+    // Model inputs are only read.
+    base_[inputs_[i]] = const_cast<float*>(inputs[i]);
+    stride_[inputs_[i]] = kTileSize;
+  }
+  for (size_t i = 0; i < outputs_.size(); i++) {
+    base_[outputs_[i]] = outputs[i];
+    stride_[outputs_[i]] = kTileSize;
+  }
+
+  for (size_t tile = 0, begin = 0; begin < tensorSize_;
+       tile++, begin += kTileSize) {
+    RunTile(tile, std::min(kTileSize, tensorSize_ - begin));
+  }
+  return true;
+}
+
+bool CpuGraph::ComputeLoop(const float* const* inputs, float* const* outputs,
+                           uint32_t steps) {
+  if (!finished_ || inputs_.size() != outputs_.size()) {
+    LOGE("ComputeLoop: graph not finished or not a loop body");
+    return false;
+  }
+  size_t values = inputs_.size();
+  loopScratch_.resize(2 * values * kTileSize);
+  float* current = loopScratch_.data();
+  float* next = current + values * kTileSize;
+
+  // The loop-carried tiles are addressed with a stride of 0, like the
+  // temporaries; constants still move to the tile being computed.
+  for (size_t i = 0; i < values; i++) {
+    stride_[inputs_[i]] = 0;
+    stride_[outputs_[i]] = 0;
+  }
+  for (size_t tile = 0, begin = 0; begin < tensorSize_;
+       tile++, begin += kTileSize) {
+    size_t size = std::min(kTileSize, tensorSize_ - begin);
+    for (size_t i = 0; i < values; i++) {
+      std::copy(inputs[i] + begin, inputs[i] + begin + size,
+                current + i * kTileSize);
+    }
+    for (uint32_t step = 0; step < steps; step++) {
+      for (size_t i = 0; i < values; i++) {
+        base_[inputs_[i]] = current + i * kTileSize;
+        base_[outputs_[i]] = next + i * kTileSize;
+      }
+      RunTile(tile, size);
+      std::swap(current, next);
+    }
+    for (size_t i = 0; i < values; i++) {
+      std::copy(current + i * kTileSize, current + i * kTileSize + size,
+                outputs[i] + begin);
+    }
+  }
+  return true;
+}
+
+}  // namespace nn_graph
@@ -0,0 +1,127 @@
+/**
+ * Copyright 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef NN_GRAPH_CPU_GRAPH_H
+#define NN_GRAPH_CPU_GRAPH_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <vector>
+
+#include "model_builder.h"
+
+namespace nn_graph {
+
+/**
+ * CpuGraph
+ * Portable reference executor for the graphs built through ModelBuilder,
+ * running the operations with the tensor_ops kernels. It has no Android
+ * dependencies, so models can be checked and profiled on a build host, and
+ * its results serve as the golden reference for NNAPI ones.
+ *
+ * All the operations are element-wise and every tensor has the same number
+ * of elements, so Finish() plans the execution in tiles of kTileSize
+ * elements: the whole graph runs on one tile before moving to the next, and
+ * intermediate tensors only need a tile of scratch memory each, which stays
+ * in the cache. Intermediates whose last reader has run give their scratch
+ * tile to the next operation output.
+ */
+class CpuGraph : public ModelBuilder {
+ public:
+  // 4 KiB per tensor, so an operation's three tiles and a few live
+  // intermediates fit in the L1 data cache.
+  static constexpr size_t kTileSize = 1024;
+
+  CpuGraph() = default;
+
+  bool AddTensorOperand(const std::vector<uint32_t>& dimensions,
+                        uint32_t* index) override;
+  bool AddFusedActivationNone(uint32_t* index) override;
+  bool SetTensorValue(uint32_t index, const float* data,
+                      size_t count) override;
+  bool AddOperation(OperationType type, uint32_t input1, uint32_t input2,
+                    uint32_t fusedActivation, uint32_t output) override;
+  bool IdentifyInputsAndOutputs(const std::vector<uint32_t>& inputs,
+                                const std::vector<uint32_t>& outputs) override;
+  bool Finish() override;
+
+  // Run the graph. inputs and outputs hold one tensor per model input and
+  // output, in the order given to IdentifyInputsAndOutputs(). The outputs
+  // must not overlap the inputs.
+  bool Compute(const float* const* inputs, float* const* outputs);
+
+  // Run the graph as the body of a loop, steps times, each output feeding
+  // the input of the same position to the next step; the graph needs as
+  // many outputs as inputs. The steps run a tile at a time, so the values
+  // carried between them never leave the cache. With 0 steps the inputs are
+  // copied to the outputs.
+  bool ComputeLoop(const float* const* inputs, float* const* outputs,
+                   uint32_t steps);
+
+  // Elements in each tensor of the graph.
+  size_t tensorSize() const { return tensorSize_; }
+  // Scratch memory reserved for the intermediates, in bytes.
+  size_t scratchBytes() const { return scratch_.size() * sizeof(float); }
+
+ private:
+  enum class Lifetime {
+    kTemporary,
+    kConstant,
+    kModelInput,
+    kModelOutput,
+    kFusedActivation,
+  };
+
+  struct Operand {
+    Lifetime lifetime;
+    size_t count;
+    const float* value;
+    // Scratch tile of a temporary, assigned by Finish().
+    uint32_t slot;
+  };
+
+  struct Operation {
+    OperationType type;
+    uint32_t inputs[2];
+    uint32_t output;
+  };
+
+  bool IsTensor(uint32_t index) const;
+  bool SortOperations();
+  void PlanScratch();
+  void RunTile(size_t tile, size_t size);
+
+  std::vector<Operand> operands_;
+  std::vector<Operation> operations_;
+  std::vector<uint32_t> inputs_;
+  std::vector<uint32_t> outputs_;
+  size_t tensorSize_ = 0;
+  bool finished_ = false;
+
+  std::vector<float> scratch_;
+  // Two tiles per loop-carried value, for ComputeLoop().
+  std::vector<float> loopScratch_;
+  // Tile addressing, per operand: tile i of the operand starts at
+  // base_[operand] + i * stride_[operand]. Temporaries have a stride of 0 so
+  // every tile reuses their scratch tile.
+  std::vector<float*> base_;
+  std::vector<size_t> stride_;
+};
+
+}  // namespace nn_graph
+
+#endif  // NN_GRAPH_CPU_GRAPH_H
@@ -0,0 +1,75 @@
+/**
+ * Copyright 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef NN_GRAPH_MODEL_BUILDER_H
+#define NN_GRAPH_MODEL_BUILDER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <vector>
+
+namespace nn_graph {
+
+// The operations the samples use. Both take two float tensors and a fused
+// activation scalar, like ANEURALNETWORKS_ADD and ANEURALNETWORKS_MUL.
+enum class OperationType {
+  kAdd,
+  kMul,
+};
+
+/**
+ * ModelBuilder
+ * The subset of ANeuralNetworksModel the samples build their graphs with, so
+ * the same construction code can target NNAPI (NnapiModelBuilder) or the CPU
+ * reference executor (CpuGraph).
+ *
+ * As with NNAPI, operands are numbered from 0 in the order they are added,
+ * and the graph can't be changed after Finish(). Every method logs and
+ * returns false on error.
+ */
+class ModelBuilder {
+ public:
+  virtual ~ModelBuilder() = default;
+
+  // Add a TENSOR_FLOAT32 operand of the given dimensions.
+  virtual bool AddTensorOperand(const std::vector<uint32_t>& dimensions,
+                                uint32_t* index) = 0;
+
+  // Add a constant INT32 operand holding ANEURALNETWORKS_FUSED_NONE.
+  virtual bool AddFusedActivationNone(uint32_t* index) = 0;
+
+  // Make a tensor operand constant. data is not copied: it has to stay
+  // valid and unchanged for as long as the model is used.
+  virtual bool SetTensorValue(uint32_t index, const float* data,
+                              size_t count) = 0;
+
+  // Add a two-input operation; fusedActivation is an operand added with
+  // AddFusedActivationNone().
+  virtual bool AddOperation(OperationType type, uint32_t input1,
+                            uint32_t input2, uint32_t fusedActivation,
+                            uint32_t output) = 0;
+
+  virtual bool IdentifyInputsAndOutputs(
+      const std::vector<uint32_t>& inputs,
+      const std::vector<uint32_t>& outputs) = 0;
+
+  virtual bool Finish() = 0;
+};
+
+}  // namespace nn_graph
+
+#endif  // NN_GRAPH_MODEL_BUILDER_H
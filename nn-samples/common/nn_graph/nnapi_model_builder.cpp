@@ -0,0 +1,210 @@
+/**
+ * Copyright 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "nnapi_model_builder.h"
+
+#include <android/log.h>
+
+#define LOG_TAG "NN_GRAPH"
+
+namespace nn_graph {
+
+NnapiModelBuilder::NnapiModelBuilder() : model_(nullptr), operandCount_(0) {
+  if (ANeuralNetworksModel_create(&model_) != ANEURALNETWORKS_NO_ERROR) {
+    __android_log_print(ANDROID_LOG_ERROR, LOG_TAG,
+                        "ANeuralNetworksModel_create failed");
+    model_ = nullptr;
+  }
+}
+
+NnapiModelBuilder::~NnapiModelBuilder() { ANeuralNetworksModel_free(model_); }
+
+void NnapiModelBuilder::AddMemory(const ANeuralNetworksMemory* memory,
+                                  const void* mapped, size_t size) {
+  memories_.push_back({memory, static_cast<const char*>(mapped), size});
+}
+
+ANeuralNetworksModel* NnapiModelBuilder::Release() {
+  ANeuralNetworksModel* model = model_;
+  model_ = nullptr;
+  return model;
+}
+
+bool NnapiModelBuilder::AddOperand(const ANeuralNetworksOperandType& type,
+                                   uint32_t* index) {
+  if (!model_) {
+    return false;
+  }
+  int32_t status = ANeuralNetworksModel_addOperand(model_, &type);
+  if (status != ANEURALNETWORKS_NO_ERROR) {
+    __android_log_print(
+        ANDROID_LOG_ERROR, LOG_TAG,
+        "ANeuralNetworksModel_addOperand failed for operand (%u)",
+        operandCount_);
+    return false;
+  }
+  *index = operandCount_++;
+  return true;
+}
+
+bool NnapiModelBuilder::SetOperandValue(uint32_t index, const void* data,
+                                        size_t length) {
+  if (!model_) {
+    return false;
+  }
+  int32_t status =
+      ANeuralNetworksModel_setOperandValue(model_, index, data, length);
+  if (status != ANEURALNETWORKS_NO_ERROR) {
+    __android_log_print(
+        ANDROID_LOG_ERROR, LOG_TAG,
+        "ANeuralNetworksModel_setOperandValue failed for operand (%u)", index);
+    return false;
+  }
+  return true;
+}
+
+bool NnapiModelBuilder::SetOperandValueFromModel(
+    uint32_t index, const ANeuralNetworksModel* model) {
+  if (!model_) {
+    return false;
+  }
+  int32_t status = ANEURALNETWORKS_BAD_STATE;
+  if (__builtin_available(android 30, *)) {
+    status =
+        ANeuralNetworksModel_setOperandValueFromModel(model_, index, model);
+  }
+  if (status != ANEURALNETWORKS_NO_ERROR) {
+    __android_log_print(
+        ANDROID_LOG_ERROR, LOG_TAG,
+        "ANeuralNetworksModel_setOperandValueFromModel failed for operand (%u)",
+        index);
+    return false;
+  }
+  return true;
+}
+
+bool NnapiModelBuilder::AddOperation(ANeuralNetworksOperationType type,
+                                     const std::vector<uint32_t>& inputs,
+                                     const std::vector<uint32_t>& outputs) {
+  if (!model_) {
+    return false;
+  }
+  int32_t status =
+      ANeuralNetworksModel_addOperation(model_, type, inputs.size(),
+                                        inputs.data(), outputs.size(),
+                                        outputs.data());
+  if (status != ANEURALNETWORKS_NO_ERROR) {
+    __android_log_print(ANDROID_LOG_ERROR, LOG_TAG,
+                        "ANeuralNetworksModel_addOperation failed for "
+                        "operation type %d",
+                        type);
+    return false;
+  }
+  return true;
+}
+
+bool NnapiModelBuilder::AddTensorOperand(
+    const std::vector<uint32_t>& dimensions, uint32_t* index) {
+  ANeuralNetworksOperandType float32TensorType{
+      .type = ANEURALNETWORKS_TENSOR_FLOAT32,
+      .dimensionCount = static_cast<uint32_t>(dimensions.size()),
+      .dimensions = dimensions.data(),
+      .scale = 0.0f,
+      .zeroPoint = 0,
+  };
+  return AddOperand(float32TensorType, index);
+}
+
+bool NnapiModelBuilder::AddFusedActivationNone(uint32_t* index) {
+  ANeuralNetworksOperandType scalarInt32Type{
+      .type = ANEURALNETWORKS_INT32,
+      .dimensionCount = 0,
+      .dimensions = nullptr,
+      .scale = 0.0f,
+      .zeroPoint = 0,
+  };
+  FuseCode fusedActivationCodeValue = ANEURALNETWORKS_FUSED_NONE;
+  return AddOperand(scalarInt32Type, index) &&
+         SetOperandValue(*index, &fusedActivationCodeValue,
+                         sizeof(fusedActivationCodeValue));
+}
+
+bool NnapiModelBuilder::SetTensorValue(uint32_t index, const float* data,
+                                       size_t count) {
+  if (!model_) {
+    return false;
+  }
+  const char* begin = reinterpret_cast<const char*>(data);
+  size_t length = count * sizeof(float);
+  for (const Memory& memory : memories_) {
+    if (begin >= memory.mapped &&
+        begin + length <= memory.mapped + memory.size) {
+      int32_t status = ANeuralNetworksModel_setOperandValueFromMemory(
+          model_, index, memory.memory, begin - memory.mapped, length);
+      if (status != ANEURALNETWORKS_NO_ERROR) {
+        __android_log_print(ANDROID_LOG_ERROR, LOG_TAG,
+                            "ANeuralNetworksModel_setOperandValueFromMemory "
+                            "failed for operand (%u)",
+                            index);
+        return false;
+      }
+      return true;
+    }
+  }
+
+  // Values over 128 bytes are referenced rather than copied, which is what
+  // the ModelBuilder contract asks of the caller anyway.
+  return SetOperandValue(index, data, length);
+}
+
+bool NnapiModelBuilder::AddOperation(OperationType type, uint32_t input1,
+                                     uint32_t input2, uint32_t fusedActivation,
+                                     uint32_t output) {
+  return AddOperation(
+      type == OperationType::kAdd ? ANEURALNETWORKS_ADD : ANEURALNETWORKS_MUL,
+      {input1, input2, fusedActivation}, {output});
+}
+
+bool NnapiModelBuilder::IdentifyInputsAndOutputs(
+    const std::vector<uint32_t>& inputs, const std::vector<uint32_t>& outputs) {
+  if (!model_) {
+    return false;
+  }
+  int32_t status = ANeuralNetworksModel_identifyInputsAndOutputs(
+      model_, inputs.size(), inputs.data(), outputs.size(), outputs.data());
+  if (status != ANEURALNETWORKS_NO_ERROR) {
+    __android_log_print(ANDROID_LOG_ERROR, LOG_TAG,
+                        "ANeuralNetworksModel_identifyInputsAndOutputs failed");
+    return false;
+  }
+  return true;
+}
+
+bool NnapiModelBuilder::Finish() {
+  if (!model_) {
+    return false;
+  }
+  // The values of constant and intermediate operands cannot be altered after
+  // the finish function is called.
+  int32_t status = ANeuralNetworksModel_finish(model_);
+  if (status != ANEURALNETWORKS_NO_ERROR) {
+    __android_log_print(ANDROID_LOG_ERROR, LOG_TAG,
+                        "ANeuralNetworksModel_finish failed");
+    return false;
+  }
+  return true;
+}
+
+}  // namespace nn_graph
@@ -0,0 +1,87 @@
+/**
+ * Copyright 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef NN_GRAPH_NNAPI_MODEL_BUILDER_H
+#define NN_GRAPH_NNAPI_MODEL_BUILDER_H
+
+#include <android/NeuralNetworks.h>
+
+#include <vector>
+
+#include "model_builder.h"
+
+namespace nn_graph {
+
+/**
+ * NnapiModelBuilder
+ * ModelBuilder writing into an ANeuralNetworksModel.
+ *
+ * Constant tensors lying in a memory registered with AddMemory() are set
+ * with ANeuralNetworksModel_setOperandValueFromMemory(), so the drivers can
+ * read them without a copy; others are passed by pointer.
+ *
+ * The raw AddOperand(), SetOperandValue() and AddOperation() overloads cover
+ * what ModelBuilder doesn't, like the operands of control flow operations.
+ */
+class NnapiModelBuilder : public ModelBuilder {
+ public:
+  NnapiModelBuilder();
+  ~NnapiModelBuilder() override;
+
+  // mapped is where the memory's first size bytes are mapped in this
+  // process.
+  void AddMemory(const ANeuralNetworksMemory* memory, const void* mapped,
+                 size_t size);
+
+  bool AddTensorOperand(const std::vector<uint32_t>& dimensions,
+                        uint32_t* index) override;
+  bool AddFusedActivationNone(uint32_t* index) override;
+  bool SetTensorValue(uint32_t index, const float* data,
+                      size_t count) override;
+  bool AddOperation(OperationType type, uint32_t input1, uint32_t input2,
+                    uint32_t fusedActivation, uint32_t output) override;
+  bool IdentifyInputsAndOutputs(const std::vector<uint32_t>& inputs,
+                                const std::vector<uint32_t>& outputs) override;
+  bool Finish() override;
+
+  bool AddOperand(const ANeuralNetworksOperandType& type, uint32_t* index);
+  // Values of up to 128 bytes are copied, longer ones referenced.
+  bool SetOperandValue(uint32_t index, const void* data, size_t length);
+  // model has to be finished, and outlive this one. Fails before API 30.
+  bool SetOperandValueFromModel(uint32_t index,
+                                const ANeuralNetworksModel* model);
+  bool AddOperation(ANeuralNetworksOperationType type,
+                    const std::vector<uint32_t>& inputs,
+                    const std::vector<uint32_t>& outputs);
+
+  // Hand the model over to the caller, who frees it.
+  ANeuralNetworksModel* Release();
+
+ private:
+  struct Memory {
+    const ANeuralNetworksMemory* memory;
+    const char* mapped;
+    size_t size;
+  };
+
+  ANeuralNetworksModel* model_;
+  uint32_t operandCount_;
+  std::vector<Memory> memories_;
+};
+
+}  // namespace nn_graph
+
+#endif  // NN_GRAPH_NNAPI_MODEL_BUILDER_H
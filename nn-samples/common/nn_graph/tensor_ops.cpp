@@ -0,0 +1,119 @@
+/**
+ * Copyright 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "tensor_ops.h"
+
+#include <math.h>
+
+#if defined(__ARM_NEON)
+#include <arm_neon.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+void FillTensor(float *tensor, size_t size, float value) {
+  size_t i = 0;
+#if defined(__ARM_NEON)
+  float32x4_t v = vdupq_n_f32(value);
+  for (; i + 8 <= size; i += 8) {
+    vst1q_f32(tensor + i, v);
+    vst1q_f32(tensor + i + 4, v);
+  }
+#elif defined(__SSE2__)
+  __m128 v = _mm_set1_ps(value);
+  for (; i + 8 <= size; i += 8) {
+    _mm_storeu_ps(tensor + i, v);
+    _mm_storeu_ps(tensor + i + 4, v);
+  }
+#endif
+  for (; i < size; i++) {
+    tensor[i] = value;
+  }
+}
+
+void AddTensors(const float *a, const float *b, float *out, size_t size) {
+  size_t i = 0;
+#if defined(__ARM_NEON)
+  for (; i + 4 <= size; i += 4) {
+    vst1q_f32(out + i, vaddq_f32(vld1q_f32(a + i), vld1q_f32(b + i)));
+  }
+#elif defined(__SSE2__)
+  for (; i + 4 <= size; i += 4) {
+    _mm_storeu_ps(out + i,
+                  _mm_add_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i)));
+  }
+#endif
+  for (; i < size; i++) {
+    out[i] = a[i] + b[i];
+  }
+}
+
+void MulTensors(const float *a, const float *b, float *out, size_t size) {
+  size_t i = 0;
+#if defined(__ARM_NEON)
+  for (; i + 4 <= size; i += 4) {
+    vst1q_f32(out + i, vmulq_f32(vld1q_f32(a + i), vld1q_f32(b + i)));
+  }
+#elif defined(__SSE2__)
+  for (; i + 4 <= size; i += 4) {
+    _mm_storeu_ps(out + i,
+                  _mm_mul_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i)));
+  }
+#endif
+  for (; i < size; i++) {
+    out[i] = a[i] * b[i];
+  }
+}
+
+size_t CountMismatches(const float *tensor, size_t size, float expected,
+                       float epsilon, size_t *firstIndex) {
+  // Check a block at a time with SIMD and only look at single elements of
+  // the blocks that have a mismatch. NaNs count as mismatches.
+  size_t count = 0;
+  size_t i = 0;
+#if defined(__ARM_NEON)
+  float32x4_t e = vdupq_n_f32(expected);
+  float32x4_t eps = vdupq_n_f32(epsilon);
+  for (; i + 4 <= size; i += 4) {
+    uint32x4_t ok = vcleq_f32(vabdq_f32(vld1q_f32(tensor + i), e), eps);
+    uint32x2_t ok2 = vand_u32(vget_low_u32(ok), vget_high_u32(ok));
+    if (vget_lane_u32(ok2, 0) & vget_lane_u32(ok2, 1)) continue;
+    for (size_t j = i; j < i + 4; j++) {
+      if (!(fabsf(tensor[j] - expected) <= epsilon) && count++ == 0) {
+        *firstIndex = j;
+      }
+    }
+  }
+#elif defined(__SSE2__)
+  __m128 e = _mm_set1_ps(expected);
+  __m128 eps = _mm_set1_ps(epsilon);
+  __m128 absMask = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+  for (; i + 4 <= size; i += 4) {
+    __m128 delta = _mm_and_ps(_mm_sub_ps(_mm_loadu_ps(tensor + i), e), absMask);
+    if (_mm_movemask_ps(_mm_cmple_ps(delta, eps)) == 0xf) continue;
+    for (size_t j = i; j < i + 4; j++) {
+      if (!(fabsf(tensor[j] - expected) <= epsilon) && count++ == 0) {
+        *firstIndex = j;
+      }
+    }
+  }
+#endif
+  for (; i < size; i++) {
+    if (!(fabsf(tensor[i] - expected) <= epsilon) && count++ == 0) {
+      *firstIndex = i;
+    }
+  }
+  return count;
+}
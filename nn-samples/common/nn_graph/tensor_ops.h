@@ -0,0 +1,41 @@
+/**
+ * Copyright 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef NNAPI_TENSOR_OPS_H
+#define NNAPI_TENSOR_OPS_H
+
+#include <stddef.h>
+
+/**
+ * Float tensor kernels, with NEON or SSE2 versions where available. The
+ * tensors are flat arrays of size floats and may be unaligned.
+ */
+
+// Set every element of tensor to value.
+void FillTensor(float *tensor, size_t size, float value);
+
+// out = a + b, element-wise. out may be a or b.
+void AddTensors(const float *a, const float *b, float *out, size_t size);
+
+// out = a * b, element-wise. out may be a or b.
+void MulTensors(const float *a, const float *b, float *out, size_t size);
+
+// Number of elements further than epsilon from expected; *firstIndex is set
+// to the first of them, if any.
+size_t CountMismatches(const float *tensor, size_t size, float expected,
+                       float epsilon, size_t *firstIndex);
+
+#endif  // NNAPI_TENSOR_OPS_H
@@ -0,0 +1,59 @@
+/**
+ * Copyright 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "cpu_sequence_model.h"
+
+#include "sequence_graph.h"
+#include "tensor_ops.h"
+
+std::unique_ptr<CpuSequenceModel> CpuSequenceModel::Create(float ratio) {
+  auto model = std::make_unique<CpuSequenceModel>(ratio);
+  if (BuildSequenceStepGraph(&model->graph_, model->ratio_.data(),
+                             dimLength_)) {
+    return model;
+  }
+  return nullptr;
+}
+
+CpuSequenceModel::CpuSequenceModel(float ratio)
+    : ratio_(tensorSize_, ratio),
+      initialSum_(tensorSize_, 0.0f),
+      initialState_(tensorSize_),
+      sumOut_(tensorSize_),
+      stateOut_(tensorSize_) {}
+
+/**
+ * Compute the sum of a geometric progression, running all the steps on a
+ * tile of the tensors before moving on to the next.
+ *
+ * @param   initialValue  the initial value of the geometric progression
+ * @param   steps         the number of terms to accumulate
+ * @return  computed result, or 0.0f if there is error.
+ */
+bool CpuSequenceModel::Compute(float initialValue, uint32_t steps,
+                               float* result) {
+  if (!result) {
+    return false;
+  }
+  FillTensor(initialState_.data(), tensorSize_, initialValue);
+
+  const float* inputs[] = {initialSum_.data(), initialState_.data()};
+  float* outputs[] = {sumOut_.data(), stateOut_.data()};
+  if (!graph_.ComputeLoop(inputs, outputs, steps)) {
+    return false;
+  }
+  *result = sumOut_[0];
+  return true;
+}
@@ -0,0 +1,56 @@
+/**
+ * Copyright 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef NNAPI_CPU_SEQUENCE_MODEL_H
+#define NNAPI_CPU_SEQUENCE_MODEL_H
+
+#include <stdint.h>
+
+#include <memory>
+#include <vector>
+
+#include "cpu_graph.h"
+
+/**
+ * CpuSequenceModel
+ * SimpleSequenceModel computed on the nn_graph::CpuGraph reference executor,
+ * from the same step graph. It has no Android dependencies: the host tests
+ * and benchmark in nn-samples/tests use it for the expected results and a
+ * performance baseline of the NNAPI model.
+ */
+class CpuSequenceModel {
+ public:
+  static std::unique_ptr<CpuSequenceModel> Create(float ratio);
+
+  // Prefer using CpuSequenceModel::Create.
+  explicit CpuSequenceModel(float ratio);
+
+  bool Compute(float initialValue, uint32_t steps, float* result);
+
+ private:
+  static constexpr uint32_t dimLength_ = 200;
+  static constexpr uint32_t tensorSize_ = dimLength_ * dimLength_;
+
+  nn_graph::CpuGraph graph_;
+
+  std::vector<float> ratio_;
+  std::vector<float> initialSum_;
+  std::vector<float> initialState_;
+  std::vector<float> sumOut_;
+  std::vector<float> stateOut_;
+};
+
+#endif  // NNAPI_CPU_SEQUENCE_MODEL_H
@@ -30,8 +30,12 @@
 extern "C" JNIEXPORT jlong JNICALL
 Java_com_example_android_sequence_MainActivity_initModel(JNIEnv* env,
                                                          jobject /* this */,
-                                                         jfloat ratio) {
-  auto model = SimpleSequenceModel::Create(ratio);
+                                                         jfloat ratio,
+                                                         jstring _cacheDir) {
+  const char* cacheDirChars = env->GetStringUTFChars(_cacheDir, NULL);
+  std::string cacheDir(cacheDirChars);
+  env->ReleaseStringUTFChars(_cacheDir, cacheDirChars);
+  auto model = SimpleSequenceModel::Create(ratio, cacheDir);
   if (model == nullptr) {
     __android_log_print(ANDROID_LOG_ERROR, LOG_TAG,
                         "Failed to create the model.");
@@ -53,6 +57,15 @@ Java_com_example_android_sequence_MainActivity_compute(JNIEnv* env,
   return result;
 }
 
+// Log what a step costs in the WHILE loop and chained modes. This runs many
+// computations, so it is only done on request.
+extern "C" JNIEXPORT void JNICALL
+Java_com_example_android_sequence_MainActivity_reportStepOverhead(
+    JNIEnv* env, jobject /* this */, jint steps, jlong _nnModel) {
+  SimpleSequenceModel* nn_model = (SimpleSequenceModel*)_nnModel;
+  nn_model->ReportStepOverhead(static_cast<uint32_t>(steps));
+}
+
 extern "C" JNIEXPORT void JNICALL
 Java_com_example_android_sequence_MainActivity_destroyModel(JNIEnv* env,
                                                             jobject /* this */,
@@ -0,0 +1,83 @@
+/**
+ * Copyright 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "sequence_graph.h"
+
+#include <vector>
+
+/**
+ * The ratio is a constant tensor, defined in the model. It represents the
+ * weights that would have been learned during a training process.
+ *
+ * The sumIn and stateIn are input tensors. Their values will be provided when
+ * we execute the model. These values can change from execution to execution.
+ *
+ * To compute the sum of a geometric progression, the graph will be executed
+ * multiple times with inputs and outputs chained together.
+ *
+ *                 +----------+   +----------+         +----------+
+ *   initialSum -->| Simple   |-->| Simple   |-->   -->| Simple   |--> sumOut
+ *                 | Sequence |   | Sequence |   ...   | Sequence |
+ * initialState -->| Model    |-->| Model    |-->   -->| Model    |--> stateOut
+ *                 +----------+   +----------+         +----------+
+ */
+bool BuildSequenceStepGraph(nn_graph::ModelBuilder* builder,
+                            const float* ratio, uint32_t dimLength) {
+  SequenceStepOperands step;
+  if (!AddSequenceStep(builder, ratio, dimLength, &step)) {
+    return false;
+  }
+
+  // Identify the input and output tensors to the model.
+  // Inputs: {sumIn, stateIn}
+  // Outputs: {sumOut, stateOut}
+  return builder->IdentifyInputsAndOutputs({step.sumIn, step.stateIn},
+                                           {step.sumOut, step.stateOut}) &&
+         builder->Finish();
+}
+
+bool AddSequenceStep(nn_graph::ModelBuilder* builder, const float* ratio,
+                     uint32_t dimLength, SequenceStepOperands* operands) {
+  using nn_graph::OperationType;
+  std::vector<uint32_t> dimensions = {dimLength, dimLength};
+
+  // Operands are implicitly identified by the order in which they are added
+  // to the model, starting from 0. The builder hands the indexes back.
+  //
+  // The NONE activation function is used for both ADD and MUL.
+  uint32_t fusedActivationFuncNone;
+  uint32_t sumIn, stateIn, ratioTensor, sumOut, stateOut;
+  if (!builder->AddFusedActivationNone(&fusedActivationFuncNone) ||
+      !builder->AddTensorOperand(dimensions, &sumIn) ||
+      !builder->AddTensorOperand(dimensions, &stateIn) ||
+      !builder->AddTensorOperand(dimensions, &ratioTensor) ||
+      !builder->AddTensorOperand(dimensions, &sumOut) ||
+      !builder->AddTensorOperand(dimensions, &stateOut)) {
+    return false;
+  }
+
+  if (!builder->SetTensorValue(ratioTensor, ratio, dimLength * dimLength)) {
+    return false;
+  }
+
+  if (!builder->AddOperation(OperationType::kAdd, sumIn, stateIn,
+                             fusedActivationFuncNone, sumOut) ||
+      !builder->AddOperation(OperationType::kMul, stateIn, ratioTensor,
+                             fusedActivationFuncNone, stateOut)) {
+    return false;
+  }
+  *operands = {sumIn, stateIn, sumOut, stateOut};
+  return true;
+}
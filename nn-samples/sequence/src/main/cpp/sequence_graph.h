@@ -0,0 +1,58 @@
+/**
+ * Copyright 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef NNAPI_SEQUENCE_GRAPH_H
+#define NNAPI_SEQUENCE_GRAPH_H
+
+#include <stdint.h>
+
+#include "model_builder.h"
+
+#define LOG_TAG "NNAPI_SEQUENCE"
+
+/**
+ * Add the graph of a single step of accumulating a geometric progression to
+ * builder:
+ *
+ *     sumIn ---+
+ *              +--- ADD ---> sumOut
+ *   stateIn ---+
+ *              +--- MUL ---> stateOut
+ *     ratio ---+
+ *
+ * Operands are all 2-D TENSOR_FLOAT32 of dimLength x dimLength. ratio holds
+ * dimLength * dimLength floats and has to outlive the model.
+ *
+ * @return true for success, false otherwise
+ */
+bool BuildSequenceStepGraph(nn_graph::ModelBuilder* builder,
+                            const float* ratio, uint32_t dimLength);
+
+// The tensors of the step graph, as added by AddSequenceStep().
+struct SequenceStepOperands {
+  uint32_t sumIn;
+  uint32_t stateIn;
+  uint32_t sumOut;
+  uint32_t stateOut;
+};
+
+// Add the operands and operations of the step graph to builder, without
+// identifying the inputs and outputs or finishing, so the step can be part of
+// a larger model such as the body of a loop.
+bool AddSequenceStep(nn_graph::ModelBuilder* builder, const float* ratio,
+                     uint32_t dimLength, SequenceStepOperands* operands);
+
+#endif  // NNAPI_SEQUENCE_GRAPH_H
@@ -21,10 +21,15 @@
 #include <unistd.h>
 
 #include <algorithm>
+#include <chrono>
 #include <string>
 #include <utility>
 #include <vector>
 
+#include "cache_token.h"
+#include "compilation_cache.h"
+#include "nnapi_model_builder.h"
+
 /**
  * A helper method to allocate an ASharedMemory region and create an
  * ANeuralNetworksMemory object.
@@ -63,6 +68,45 @@ static void fillMemory(int fd, uint32_t size, float value) {
   munmap(data, size * sizeof(float));
 }
 
+/**
+ * Have the drivers cache compilation in <cacheDir>/<name>. The token hashes
+ * the step graph with the ratio, and tag for what else the compiled model
+ * depends on.
+ *
+ * @return the state of the cache, for the compilation time log
+ */
+static const char* SetCompilationCaching(
+    ANeuralNetworksCompilation* compilation, const std::string& cacheDir,
+    const char* name, const char* tag, const float* ratio,
+    uint32_t dimLength) {
+  nn_graph::CacheTokenBuilder token;
+  token.AddTag(tag);
+  if (cacheDir.empty() || !BuildSequenceStepGraph(&token, ratio, dimLength)) {
+    return "no cache";
+  }
+  bool warm = false;
+  std::string directory =
+      nn_graph::PrepareCompilationCache(cacheDir, name, token, &warm);
+  if (directory.empty()) {
+    return "no cache";
+  }
+  int32_t status = ANeuralNetworksCompilation_setCaching(
+      compilation, directory.c_str(), token.token());
+  if (status != ANEURALNETWORKS_NO_ERROR) {
+    __android_log_print(ANDROID_LOG_WARN, LOG_TAG,
+                        "ANeuralNetworksCompilation_setCaching failed for %s",
+                        name);
+    return "no cache";
+  }
+  return warm ? "warm cache" : "cold cache";
+}
+
+static double MillisecondsSince(std::chrono::steady_clock::time_point start) {
+  return std::chrono::duration<double, std::milli>(
+             std::chrono::steady_clock::now() - start)
+      .count();
+}
+
 /**
  * Factory method of SimpleSequenceModel.
  *
@@ -71,19 +115,34 @@ static void fillMemory(int fd, uint32_t size, float value) {
  *
  * @return A pointer to the created model on success, nullptr otherwise
  */
-std::unique_ptr<SimpleSequenceModel> SimpleSequenceModel::Create(float ratio) {
-  auto model = std::make_unique<SimpleSequenceModel>(ratio);
-  if (model->CreateSharedMemories() && model->CreateModel() &&
-      model->CreateCompilation() && model->CreateOpaqueMemories()) {
-    return model;
-  }
-  return nullptr;
+std::unique_ptr<SimpleSequenceModel> SimpleSequenceModel::Create(
+    float ratio, const std::string& cacheDir) {
+  auto model = std::make_unique<SimpleSequenceModel>(ratio, cacheDir);
+  if (!model->CreateSharedMemories() || !model->CreateModel() ||
+      !model->CreateCompilation() || !model->CreateOpaqueMemories()) {
+    return nullptr;
+  }
+  if (__builtin_available(android 31, *)) {
+    model->reusableExecutions_ = true;
+  }
+
+  // The WHILE loop is optional: fall back to chaining the executions if the
+  // device can't compile it.
+  if (model->CreateLoopModel()) {
+    model->mode_ = Mode::kWhileLoop;
+  } else {
+    __android_log_print(ANDROID_LOG_WARN, LOG_TAG,
+                        "WHILE loop model unavailable, chaining executions");
+  }
+  return model;
 }
 
 /**
  * SimpleSequenceModel Constructor.
  */
-SimpleSequenceModel::SimpleSequenceModel(float ratio) : ratio_(ratio) {}
+SimpleSequenceModel::SimpleSequenceModel(float ratio,
+                                         const std::string& cacheDir)
+    : ratio_(ratio), cacheDir_(cacheDir) {}
 
 /**
  * Initialize the shared memory objects. In reality, the values in the shared
@@ -102,225 +161,40 @@ bool SimpleSequenceModel::CreateSharedMemories() {
   std::tie(sumOutFd_, memorySumOut_) =
       CreateASharedMemory("sumOut", tensorSize_, PROT_READ | PROT_WRITE);
 
-  // Initialize the ratio tensor.
-  fillMemory(ratioFd_, tensorSize_, ratio_);
+  if (ratioFd_ < 0) {
+    return false;
+  }
+
+  // Initialize the ratio tensor, and keep it mapped for the model
+  // construction to refer to.
+  void* ratioData = mmap(nullptr, tensorSize_ * sizeof(float),
+                         PROT_READ | PROT_WRITE, MAP_SHARED, ratioFd_, 0);
+  if (ratioData == MAP_FAILED) {
+    __android_log_print(ANDROID_LOG_ERROR, LOG_TAG,
+                        "Failed to map the ratio memory");
+    return false;
+  }
+  ratioData_ = reinterpret_cast<float*>(ratioData);
+  std::fill(ratioData_, ratioData_ + tensorSize_, ratio_);
   return true;
 }
 
 /**
  * Create a graph that consists of two operations: one addition and one
- * multiplication. This graph is used for computing a single step of
- * accumulating a geometric progression.
- *
- *   sumIn ---+
- *            +--- ADD ---> sumOut
- * stateIn ---+
- *            +--- MUL ---> stateOut
- *   ratio ---+
- *
- * The ratio is a constant tensor, defined in the model. It represents the
- * weights that would have been learned during a training process.
- *
- * The sumIn and stateIn are input tensors. Their values will be provided when
- * we execute the model. These values can change from execution to execution.
- *
- * To compute the sum of a geometric progression, the graph will be executed
- * multiple times with inputs and outputs chained together.
- *
- *                 +----------+   +----------+         +----------+
- *   initialSum -->| Simple   |-->| Simple   |-->   -->| Simple   |--> sumOut
- *                 | Sequence |   | Sequence |   ...   | Sequence |
- * initialState -->| Model    |-->| Model    |-->   -->| Model    |--> stateOut
- *                 +----------+   +----------+         +----------+
+ * multiplication, see BuildSequenceStepGraph(). This graph is used for
+ * computing a single step of accumulating a geometric progression.
  *
  * @return true for success, false otherwise
  */
 bool SimpleSequenceModel::CreateModel() {
-  int32_t status;
-
-  // Create the ANeuralNetworksModel handle.
-  status = ANeuralNetworksModel_create(&model_);
-  if (status != ANEURALNETWORKS_NO_ERROR) {
-    __android_log_print(ANDROID_LOG_ERROR, LOG_TAG,
-                        "ANeuralNetworksModel_create failed");
-    return false;
-  }
-
-  uint32_t dimensions[] = {dimLength_, dimLength_};
-  ANeuralNetworksOperandType float32TensorType{
-      .type = ANEURALNETWORKS_TENSOR_FLOAT32,
-      .dimensionCount = sizeof(dimensions) / sizeof(dimensions[0]),
-      .dimensions = dimensions,
-      .scale = 0.0f,
-      .zeroPoint = 0,
-  };
-  ANeuralNetworksOperandType scalarInt32Type{
-      .type = ANEURALNETWORKS_INT32,
-      .dimensionCount = 0,
-      .dimensions = nullptr,
-      .scale = 0.0f,
-      .zeroPoint = 0,
-  };
-
-  /**
-   * Add operands and operations to construct the model.
-   *
-   * Operands are implicitly identified by the order in which they are added to
-   * the model, starting from 0.
-   *
-   * These indexes are not returned by the model_addOperand call. The
-   * application must manage these values. Here, we use opIdx to do the
-   * bookkeeping.
-   */
-  uint32_t opIdx = 0;
-
-  // We first add the operand for the NONE activation function, and set its
-  // value to ANEURALNETWORKS_FUSED_NONE.
-  // This constant scalar operand will be used for both ADD and MUL.
-  status = ANeuralNetworksModel_addOperand(model_, &scalarInt32Type);
-  uint32_t fusedActivationFuncNone = opIdx++;
-  if (status != ANEURALNETWORKS_NO_ERROR) {
-    __android_log_print(
-        ANDROID_LOG_ERROR, LOG_TAG,
-        "ANeuralNetworksModel_addOperand failed for operand (%d)",
-        fusedActivationFuncNone);
-    return false;
-  }
-  FuseCode fusedActivationCodeValue = ANEURALNETWORKS_FUSED_NONE;
-  status = ANeuralNetworksModel_setOperandValue(
-      model_, fusedActivationFuncNone, &fusedActivationCodeValue,
-      sizeof(fusedActivationCodeValue));
-  if (status != ANEURALNETWORKS_NO_ERROR) {
-    __android_log_print(
-        ANDROID_LOG_ERROR, LOG_TAG,
-        "ANeuralNetworksModel_setOperandValue failed for operand (%d)",
-        fusedActivationFuncNone);
-    return false;
-  }
-
-  // sumIn is one of the user provided input tensors to the trained model.
-  // Its value is determined pre-execution.
-  status = ANeuralNetworksModel_addOperand(model_, &float32TensorType);
-  uint32_t sumIn = opIdx++;
-  if (status != ANEURALNETWORKS_NO_ERROR) {
-    __android_log_print(
-        ANDROID_LOG_ERROR, LOG_TAG,
-        "ANeuralNetworksModel_addOperand failed for operand (%d)", sumIn);
-    return false;
-  }
-
-  // stateIn is one of the user provided input tensors to the trained model.
-  // Its value is determined pre-execution.
-  status = ANeuralNetworksModel_addOperand(model_, &float32TensorType);
-  uint32_t stateIn = opIdx++;
-  if (status != ANEURALNETWORKS_NO_ERROR) {
-    __android_log_print(
-        ANDROID_LOG_ERROR, LOG_TAG,
-        "ANeuralNetworksModel_addOperand failed for operand (%d)", stateIn);
-    return false;
-  }
-
-  // ratio is a constant tensor that was established during training.
-  // We read these values from the corresponding ANeuralNetworksMemory object.
-  status = ANeuralNetworksModel_addOperand(model_, &float32TensorType);
-  uint32_t ratio = opIdx++;
-  if (status != ANEURALNETWORKS_NO_ERROR) {
-    __android_log_print(
-        ANDROID_LOG_ERROR, LOG_TAG,
-        "ANeuralNetworksModel_addOperand failed for operand (%d)", ratio);
-    return false;
-  }
-  status = ANeuralNetworksModel_setOperandValueFromMemory(
-      model_, ratio, memoryRatio_, 0, tensorSize_ * sizeof(float));
-  if (status != ANEURALNETWORKS_NO_ERROR) {
-    __android_log_print(ANDROID_LOG_ERROR, LOG_TAG,
-                        "ANeuralNetworksModel_setOperandValueFromMemory failed "
-                        "for operand (%d)",
-                        ratio);
-    return false;
-  }
-
-  // sumOut is the output of the ADD operation.
-  // Its value will be computed during execution.
-  status = ANeuralNetworksModel_addOperand(model_, &float32TensorType);
-  uint32_t sumOut = opIdx++;
-  if (status != ANEURALNETWORKS_NO_ERROR) {
-    __android_log_print(
-        ANDROID_LOG_ERROR, LOG_TAG,
-        "ANeuralNetworksModel_addOperand failed for operand (%d)", sumOut);
-    return false;
-  }
-
-  // stateOut is the output of the MUL operation.
-  // Its value will be computed during execution.
-  status = ANeuralNetworksModel_addOperand(model_, &float32TensorType);
-  uint32_t stateOut = opIdx++;
-  if (status != ANEURALNETWORKS_NO_ERROR) {
-    __android_log_print(
-        ANDROID_LOG_ERROR, LOG_TAG,
-        "ANeuralNetworksModel_addOperand failed for operand (%d)", stateOut);
-    return false;
-  }
-
-  // Add the ADD operation.
-  std::vector<uint32_t> addInputOperands = {
-      sumIn,
-      stateIn,
-      fusedActivationFuncNone,
-  };
-  status = ANeuralNetworksModel_addOperation(
-      model_, ANEURALNETWORKS_ADD, addInputOperands.size(),
-      addInputOperands.data(), 1, &sumOut);
-  if (status != ANEURALNETWORKS_NO_ERROR) {
-    __android_log_print(ANDROID_LOG_ERROR, LOG_TAG,
-                        "ANeuralNetworksModel_addOperation failed for ADD");
-    return false;
-  }
-
-  // Add the MUL operation.
-  std::vector<uint32_t> mulInputOperands = {
-      stateIn,
-      ratio,
-      fusedActivationFuncNone,
-  };
-  status = ANeuralNetworksModel_addOperation(
-      model_, ANEURALNETWORKS_MUL, mulInputOperands.size(),
-      mulInputOperands.data(), 1, &stateOut);
-  if (status != ANEURALNETWORKS_NO_ERROR) {
-    __android_log_print(ANDROID_LOG_ERROR, LOG_TAG,
-                        "ANeuralNetworksModel_addOperation failed for MUL");
-    return false;
-  }
-
-  // Identify the input and output tensors to the model.
-  // Inputs: {sumIn, stateIn}
-  // Outputs: {sumOut, stateOut}
-  std::vector<uint32_t> modelInputs = {
-      sumIn,
-      stateIn,
-  };
-  std::vector<uint32_t> modelOutputs = {
-      sumOut,
-      stateOut,
-  };
-  status = ANeuralNetworksModel_identifyInputsAndOutputs(
-      model_, modelInputs.size(), modelInputs.data(), modelOutputs.size(),
-      modelOutputs.data());
-  if (status != ANEURALNETWORKS_NO_ERROR) {
-    __android_log_print(ANDROID_LOG_ERROR, LOG_TAG,
-                        "ANeuralNetworksModel_identifyInputsAndOutputs failed");
-    return false;
-  }
-
-  // Finish constructing the model.
-  // The values of constant operands cannot be altered after
-  // the finish function is called.
-  status = ANeuralNetworksModel_finish(model_);
-  if (status != ANEURALNETWORKS_NO_ERROR) {
-    __android_log_print(ANDROID_LOG_ERROR, LOG_TAG,
-                        "ANeuralNetworksModel_finish failed");
+  // The ratio is read from memoryRatio_, which the builder finds from its
+  // address in the mapping.
+  nn_graph::NnapiModelBuilder builder;
+  builder.AddMemory(memoryRatio_, ratioData_, tensorSize_ * sizeof(float));
+  if (!BuildSequenceStepGraph(&builder, ratioData_, dimLength_)) {
     return false;
   }
+  model_ = builder.Release();
   return true;
 }
 
@@ -331,6 +205,7 @@ bool SimpleSequenceModel::CreateModel() {
  */
 bool SimpleSequenceModel::CreateCompilation() {
   int32_t status;
+  auto start = std::chrono::steady_clock::now();
 
   // Create the ANeuralNetworksCompilation object for the constructed model.
   status = ANeuralNetworksCompilation_create(model_, &compilation_);
@@ -340,6 +215,13 @@ bool SimpleSequenceModel::CreateCompilation() {
     return false;
   }
 
+  // Let the drivers save the compiled model in the cache directory, or load
+  // it from there if a previous run did.
+  const char* cacheState =
+      SetCompilationCaching(compilation_, cacheDir_, "sequence_step",
+                            "step PREFER_FAST_SINGLE_ANSWER", ratioData_,
+                            dimLength_);
+
   // Set the preference for the compilation_, so that the runtime and drivers
   // can make better decisions.
   // Here we prefer to get the answer quickly, so we choose
@@ -359,6 +241,9 @@ bool SimpleSequenceModel::CreateCompilation() {
                         "ANeuralNetworksCompilation_finish failed");
     return false;
   }
+  __android_log_print(ANDROID_LOG_INFO, LOG_TAG,
+                      "Compiled the step in %.1f ms (%s)",
+                      MillisecondsSince(start), cacheState);
   return true;
 }
 
@@ -424,9 +309,10 @@ bool SimpleSequenceModel::CreateOpaqueMemories() {
   }
 
   // Create two opaque memories from the finished descriptor: one for input
-  // and one for output. We will swap the two memories after each single
+  // and one for output. The two memories swap roles after each single
   // execution step.
-  status = ANeuralNetworksMemory_createFromDesc(sumDesc, &memoryOpaqueSumIn_);
+  status =
+      ANeuralNetworksMemory_createFromDesc(sumDesc, &memoryOpaqueSums_[0]);
   if (status != ANEURALNETWORKS_NO_ERROR) {
     __android_log_print(
         ANDROID_LOG_ERROR, LOG_TAG,
@@ -434,7 +320,8 @@ bool SimpleSequenceModel::CreateOpaqueMemories() {
     ANeuralNetworksMemoryDesc_free(sumDesc);
     return false;
   }
-  status = ANeuralNetworksMemory_createFromDesc(sumDesc, &memoryOpaqueSumOut_);
+  status =
+      ANeuralNetworksMemory_createFromDesc(sumDesc, &memoryOpaqueSums_[1]);
   if (status != ANEURALNETWORKS_NO_ERROR) {
     __android_log_print(
         ANDROID_LOG_ERROR, LOG_TAG,
@@ -493,10 +380,11 @@ bool SimpleSequenceModel::CreateOpaqueMemories() {
   }
 
   // Create two opaque memories from the finished descriptor: one for input
-  // and one for output. We will swap the two memories after each single
+  // and one for output. The two memories swap roles after each single
   // execution step.
   status =
-      ANeuralNetworksMemory_createFromDesc(stateDesc, &memoryOpaqueStateIn_);
+      ANeuralNetworksMemory_createFromDesc(stateDesc,
+                                           &memoryOpaqueStates_[0]);
   if (status != ANEURALNETWORKS_NO_ERROR) {
     __android_log_print(
         ANDROID_LOG_ERROR, LOG_TAG,
@@ -505,7 +393,8 @@ bool SimpleSequenceModel::CreateOpaqueMemories() {
     return false;
   }
   status =
-      ANeuralNetworksMemory_createFromDesc(stateDesc, &memoryOpaqueStateOut_);
+      ANeuralNetworksMemory_createFromDesc(stateDesc,
+                                           &memoryOpaqueStates_[1]);
   if (status != ANEURALNETWORKS_NO_ERROR) {
     __android_log_print(
         ANDROID_LOG_ERROR, LOG_TAG,
@@ -521,88 +410,413 @@ bool SimpleSequenceModel::CreateOpaqueMemories() {
 }
 
 /**
- * Dispatch a single computation step of accumulating the geometric progression.
+ * Create the models of a WHILE loop running the step graph until a counter
+ * reaches the number of steps, and compile it.
+ *
+ *   condition(counter, sum, state, steps) = counter < steps
+ *   body(counter, sum, state, steps) =
+ *       (counter + 1, sum + state, state * ratio)
+ *
+ * The model computes
+ *
+ *   counterOut, sumOut, stateOut =
+ *       WHILE(condition, body, 0, sumIn, stateIn, steps)
+ *
+ * so all the steps run in a single execution, and the intermediate sums and
+ * states never leave the driver.
+ *
+ * @return true for success, false otherwise
  */
-static bool DispatchSingleStep(
-    ANeuralNetworksCompilation* compilation, ANeuralNetworksMemory* sumIn,
-    uint32_t sumInLength, ANeuralNetworksMemory* stateIn,
-    uint32_t stateInLength, ANeuralNetworksMemory* sumOut,
-    uint32_t sumOutLength, ANeuralNetworksMemory* stateOut,
-    uint32_t stateOutLength, const ANeuralNetworksEvent* waitFor,
-    ANeuralNetworksEvent** event) {
-  // Create an ANeuralNetworksExecution object from the compiled model.
-  ANeuralNetworksExecution* execution;
-  int32_t status = ANeuralNetworksExecution_create(compilation, &execution);
+bool SimpleSequenceModel::CreateLoopModel() {
+  uint32_t dimensions[] = {dimLength_, dimLength_};
+  ANeuralNetworksOperandType float32TensorType{
+      .type = ANEURALNETWORKS_TENSOR_FLOAT32,
+      .dimensionCount = sizeof(dimensions) / sizeof(dimensions[0]),
+      .dimensions = dimensions,
+      .scale = 0.0f,
+      .zeroPoint = 0,
+  };
+  uint32_t scalarDimensions[] = {1};
+  ANeuralNetworksOperandType int32TensorType{
+      .type = ANEURALNETWORKS_TENSOR_INT32,
+      .dimensionCount = 1,
+      .dimensions = scalarDimensions,
+      .scale = 0.0f,
+      .zeroPoint = 0,
+  };
+  ANeuralNetworksOperandType bool8TensorType{
+      .type = ANEURALNETWORKS_TENSOR_BOOL8,
+      .dimensionCount = 1,
+      .dimensions = scalarDimensions,
+      .scale = 0.0f,
+      .zeroPoint = 0,
+  };
+  ANeuralNetworksOperandType modelType{
+      .type = ANEURALNETWORKS_MODEL,
+      .dimensionCount = 0,
+      .dimensions = nullptr,
+      .scale = 0.0f,
+      .zeroPoint = 0,
+  };
+
+  // The condition model takes the same inputs as the body.
+  nn_graph::NnapiModelBuilder condition;
+  uint32_t counter, sum, state, steps, less;
+  if (!condition.AddOperand(int32TensorType, &counter) ||
+      !condition.AddOperand(float32TensorType, &sum) ||
+      !condition.AddOperand(float32TensorType, &state) ||
+      !condition.AddOperand(int32TensorType, &steps) ||
+      !condition.AddOperand(bool8TensorType, &less) ||
+      !condition.AddOperation(ANEURALNETWORKS_LESS, {counter, steps},
+                              {less}) ||
+      !condition.IdentifyInputsAndOutputs({counter, sum, state, steps},
+                                          {less}) ||
+      !condition.Finish()) {
+    return false;
+  }
+  loopConditionModel_ = condition.Release();
+
+  // The body is the step graph, plus the increment of the counter.
+  nn_graph::NnapiModelBuilder body;
+  body.AddMemory(memoryRatio_, ratioData_, tensorSize_ * sizeof(float));
+  SequenceStepOperands step;
+  uint32_t fusedActivationFuncNone, one, counterOut;
+  const int32_t oneValue = 1;
+  if (!AddSequenceStep(&body, ratioData_, dimLength_, &step) ||
+      !body.AddFusedActivationNone(&fusedActivationFuncNone) ||
+      !body.AddOperand(int32TensorType, &counter) ||
+      !body.AddOperand(int32TensorType, &one) ||
+      !body.SetOperandValue(one, &oneValue, sizeof(oneValue)) ||
+      !body.AddOperand(int32TensorType, &counterOut) ||
+      !body.AddOperand(int32TensorType, &steps) ||
+      !body.AddOperation(ANEURALNETWORKS_ADD,
+                         {counter, one, fusedActivationFuncNone},
+                         {counterOut}) ||
+      !body.IdentifyInputsAndOutputs(
+          {counter, step.sumIn, step.stateIn, steps},
+          {counterOut, step.sumOut, step.stateOut}) ||
+      !body.Finish()) {
+    return false;
+  }
+  loopBodyModel_ = body.Release();
+
+  // The WHILE inputs are the condition and body models, then the loop
+  // carried values {counter, sum, state}, then the input only value steps.
+  nn_graph::NnapiModelBuilder loop;
+  uint32_t conditionOperand, bodyOperand, counterIn, sumIn, stateIn, sumOut,
+      stateOut;
+  const int32_t zeroValue = 0;
+  if (!loop.AddOperand(modelType, &conditionOperand) ||
+      !loop.SetOperandValueFromModel(conditionOperand, loopConditionModel_) ||
+      !loop.AddOperand(modelType, &bodyOperand) ||
+      !loop.SetOperandValueFromModel(bodyOperand, loopBodyModel_) ||
+      !loop.AddOperand(int32TensorType, &counterIn) ||
+      !loop.SetOperandValue(counterIn, &zeroValue, sizeof(zeroValue)) ||
+      !loop.AddOperand(float32TensorType, &sumIn) ||
+      !loop.AddOperand(float32TensorType, &stateIn) ||
+      !loop.AddOperand(int32TensorType, &steps) ||
+      !loop.AddOperand(int32TensorType, &counterOut) ||
+      !loop.AddOperand(float32TensorType, &sumOut) ||
+      !loop.AddOperand(float32TensorType, &stateOut) ||
+      !loop.AddOperation(
+          ANEURALNETWORKS_WHILE,
+          {conditionOperand, bodyOperand, counterIn, sumIn, stateIn, steps},
+          {counterOut, sumOut, stateOut}) ||
+      !loop.IdentifyInputsAndOutputs({sumIn, stateIn, steps},
+                                     {counterOut, sumOut, stateOut}) ||
+      !loop.Finish()) {
+    return false;
+  }
+  loopModel_ = loop.Release();
+
+  auto start = std::chrono::steady_clock::now();
+  int32_t status = ANeuralNetworksCompilation_create(loopModel_,
+                                                     &loopCompilation_);
   if (status != ANEURALNETWORKS_NO_ERROR) {
     __android_log_print(ANDROID_LOG_ERROR, LOG_TAG,
-                        "ANeuralNetworksExecution_create failed");
+                        "ANeuralNetworksCompilation_create failed for the "
+                        "loop");
     return false;
   }
+  const char* cacheState =
+      SetCompilationCaching(loopCompilation_, cacheDir_, "sequence_loop",
+                            "WHILE loop PREFER_FAST_SINGLE_ANSWER", ratioData_,
+                            dimLength_);
+  status = ANeuralNetworksCompilation_setPreference(
+      loopCompilation_, ANEURALNETWORKS_PREFER_FAST_SINGLE_ANSWER);
+  if (status != ANEURALNETWORKS_NO_ERROR) {
+    __android_log_print(ANDROID_LOG_ERROR, LOG_TAG,
+                        "ANeuralNetworksCompilation_setPreference failed for "
+                        "the loop");
+    ANeuralNetworksCompilation_free(loopCompilation_);
+    loopCompilation_ = nullptr;
+    return false;
+  }
+  status = ANeuralNetworksCompilation_finish(loopCompilation_);
+  if (status != ANEURALNETWORKS_NO_ERROR) {
+    __android_log_print(ANDROID_LOG_ERROR, LOG_TAG,
+                        "ANeuralNetworksCompilation_finish failed for the "
+                        "loop");
+    ANeuralNetworksCompilation_free(loopCompilation_);
+    loopCompilation_ = nullptr;
+    return false;
+  }
+  __android_log_print(ANDROID_LOG_INFO, LOG_TAG,
+                      "Compiled the loop in %.1f ms (%s)",
+                      MillisecondsSince(start), cacheState);
+  loopStateOut_.resize(tensorSize_);
+  return true;
+}
 
-  // Set the memory for the sumIn tensor.
-  // Note that the index "0" here means the first operand of the modelInputs
-  // list {sumIn, stateIn}, which means sumIn.
-  status = ANeuralNetworksExecution_setInputFromMemory(
-      execution, 0, nullptr, sumIn, 0, sumInLength * sizeof(float));
+bool SimpleSequenceModel::SetMode(Mode mode) {
+  if (mode == Mode::kWhileLoop && !loopCompilation_) {
+    return false;
+  }
+  mode_ = mode;
+  return true;
+}
+
+/**
+ * Bind the memories step of steps reads and writes to execution.
+ *
+ * We will only use ASharedMemory for boundary step executions, and use
+ * opaque memories for intermediate results to minimize the data copying.
+ * Note that when setting an opaque memory as the input or output of an
+ * execution, the offset and length must be set to 0 to indicate the
+ * entire memory region is used.
+ */
+bool SimpleSequenceModel::BindStep(ANeuralNetworksExecution* execution,
+                                   uint32_t step, uint32_t steps) {
+  ANeuralNetworksMemory* sumInMemory;
+  ANeuralNetworksMemory* stateInMemory;
+  uint32_t inLength;
+  if (step == 0) {
+    sumInMemory = memorySumIn_;
+    stateInMemory = memoryInitialState_;
+    inLength = tensorSize_ * sizeof(float);
+  } else {
+    sumInMemory = memoryOpaqueSums_[(step - 1) % 2];
+    stateInMemory = memoryOpaqueStates_[(step - 1) % 2];
+    inLength = 0;
+  }
+  ANeuralNetworksMemory* sumOutMemory;
+  uint32_t sumOutLength;
+  if (step == steps - 1) {
+    sumOutMemory = memorySumOut_;
+    sumOutLength = tensorSize_ * sizeof(float);
+  } else {
+    sumOutMemory = memoryOpaqueSums_[step % 2];
+    sumOutLength = 0;
+  }
+  ANeuralNetworksMemory* stateOutMemory = memoryOpaqueStates_[step % 2];
+
+  // Note that the indexes here refer to the modelInputs list
+  // {sumIn, stateIn} and the modelOutputs list {sumOut, stateOut}.
+  int32_t status = ANeuralNetworksExecution_setInputFromMemory(
+      execution, 0, nullptr, sumInMemory, 0, inLength);
   if (status != ANEURALNETWORKS_NO_ERROR) {
     __android_log_print(
         ANDROID_LOG_ERROR, LOG_TAG,
         "ANeuralNetworksExecution_setInputFromMemory failed for sumIn");
     return false;
   }
-
-  // Set the memory for the stateIn tensor.
-  // Note that the index "1" here means the first operand of the modelInputs
-  // list {sumIn, stateIn}, which means stateIn.
   status = ANeuralNetworksExecution_setInputFromMemory(
-      execution, 1, nullptr, stateIn, 0, stateInLength * sizeof(float));
+      execution, 1, nullptr, stateInMemory, 0, inLength);
   if (status != ANEURALNETWORKS_NO_ERROR) {
     __android_log_print(
         ANDROID_LOG_ERROR, LOG_TAG,
         "ANeuralNetworksExecution_setInputFromMemory failed for stateIn");
     return false;
   }
-
-  // Set the sumOut tensor that will be filled by executing the model.
   status = ANeuralNetworksExecution_setOutputFromMemory(
-      execution, 0, nullptr, sumOut, 0, sumOutLength * sizeof(float));
+      execution, 0, nullptr, sumOutMemory, 0, sumOutLength);
   if (status != ANEURALNETWORKS_NO_ERROR) {
     __android_log_print(
         ANDROID_LOG_ERROR, LOG_TAG,
         "ANeuralNetworksExecution_setOutputFromMemory failed for sumOut");
     return false;
   }
-
-  // Set the stateOut tensor that will be filled by executing the model.
   status = ANeuralNetworksExecution_setOutputFromMemory(
-      execution, 1, nullptr, stateOut, 0, stateOutLength * sizeof(float));
+      execution, 1, nullptr, stateOutMemory, 0, 0);
   if (status != ANEURALNETWORKS_NO_ERROR) {
     __android_log_print(
         ANDROID_LOG_ERROR, LOG_TAG,
         "ANeuralNetworksExecution_setOutputFromMemory failed for stateOut");
     return false;
   }
+  return true;
+}
+
+/**
+ * Run the steps as executions of the step graph, each one waiting for the
+ * previous one, with the outputs of a step fed in as the inputs of the next.
+ *
+ * On API 31+ the executions come from executionPool_ and are bound to their
+ * memories once; before that, one is created per step.
+ */
+bool SimpleSequenceModel::ComputeChained(uint32_t steps) {
+  // The event objects for all computation steps.
+  std::vector<ANeuralNetworksEvent*> events(steps, nullptr);
+
+  bool dispatched = true;
+  for (uint32_t i = 0; i < steps && dispatched; i++) {
+    ANeuralNetworksExecution* execution = nullptr;
+    uint32_t slot;
+    if (i == 0) {
+      slot = steps == 1 ? 0 : 1;
+    } else if (i == steps - 1) {
+      slot = 2 + i % 2;
+    } else {
+      slot = 4 + i % kMiddleExecutions;
+    }
+
+    if (reusableExecutions_) {
+      // A pooled execution can't be started again before its last
+      // computation, kMiddleExecutions steps ago, has finished.
+      if (slot >= 4 && i >= kMiddleExecutions &&
+          events[i - kMiddleExecutions]) {
+        ANeuralNetworksEvent_wait(events[i - kMiddleExecutions]);
+        ANeuralNetworksEvent_free(events[i - kMiddleExecutions]);
+        events[i - kMiddleExecutions] = nullptr;
+      }
+      execution = executionPool_[slot];
+    }
+    if (!execution) {
+      int32_t status = ANeuralNetworksExecution_create(compilation_,
+                                                       &execution);
+      if (status != ANEURALNETWORKS_NO_ERROR) {
+        __android_log_print(ANDROID_LOG_ERROR, LOG_TAG,
+                            "ANeuralNetworksExecution_create failed");
+        dispatched = false;
+        break;
+      }
+      bool bound = true;
+      if (reusableExecutions_) {
+        bound = false;
+        if (__builtin_available(android 31, *)) {
+          bound = ANeuralNetworksExecution_setReusable(execution, true) ==
+                  ANEURALNETWORKS_NO_ERROR;
+        }
+      }
+      if (!bound || !BindStep(execution, i, steps)) {
+        __android_log_print(ANDROID_LOG_ERROR, LOG_TAG,
+                            "Failed to set up the execution of step %u", i);
+        ANeuralNetworksExecution_free(execution);
+        dispatched = false;
+        break;
+      }
+      if (reusableExecutions_) {
+        executionPool_[slot] = execution;
+      }
+    }
+
+    // Dispatch a single computation step with a dependency on the previous
+    // step, if any. The actual computation will start once its dependency has
+    // finished.
+    const ANeuralNetworksEvent* waitFor = i == 0 ? nullptr : events[i - 1];
+    int32_t status = ANeuralNetworksExecution_startComputeWithDependencies(
+        execution, waitFor ? &waitFor : nullptr, waitFor ? 1 : 0,
+        0,  // infinite timeout duration
+        &events[i]);
+    if (status != ANEURALNETWORKS_NO_ERROR) {
+      __android_log_print(
+          ANDROID_LOG_ERROR, LOG_TAG,
+          "ANeuralNetworksExecution_startComputeWithDependencies failed for "
+          "step %u",
+          i);
+      events[i] = nullptr;
+      dispatched = false;
+    }
+    if (!reusableExecutions_) {
+      // Freed once the computation completes.
+      ANeuralNetworksExecution_free(execution);
+    }
+  }
+
+  // Since the events are chained, we only need to wait for the last one.
+  int32_t status = ANEURALNETWORKS_NO_ERROR;
+  for (auto it = events.rbegin(); it != events.rend(); ++it) {
+    if (*it) {
+      status = ANeuralNetworksEvent_wait(*it);
+      break;
+    }
+  }
 
-  // Dispatch the execution of the model.
-  // Note that the execution here is asynchronous with dependencies.
-  const ANeuralNetworksEvent* const* dependencies = nullptr;
-  uint32_t numDependencies = 0;
-  if (waitFor != nullptr) {
-    dependencies = &waitFor;
-    numDependencies = 1;
+  // Cleanup event objects.
+  for (auto* event : events) {
+    ANeuralNetworksEvent_free(event);
   }
-  status = ANeuralNetworksExecution_startComputeWithDependencies(
-      execution, dependencies, numDependencies,
-      0,  // infinite timeout duration
-      event);
+  return dispatched && status == ANEURALNETWORKS_NO_ERROR;
+}
+
+/**
+ * Run all the steps in a single execution of the WHILE loop model.
+ */
+bool SimpleSequenceModel::ComputeWhileLoop(uint32_t steps) {
+  // The values of setInput() buffers are read when the computation starts,
+  // so a reusable execution picks up the new number of steps.
+  loopSteps_ = static_cast<int32_t>(steps);
+
+  ANeuralNetworksExecution* execution = loopExecution_;
+  if (!execution) {
+    int32_t status =
+        ANeuralNetworksExecution_create(loopCompilation_, &execution);
+    if (status != ANEURALNETWORKS_NO_ERROR) {
+      __android_log_print(ANDROID_LOG_ERROR, LOG_TAG,
+                          "ANeuralNetworksExecution_create failed");
+      return false;
+    }
+    bool reusable = false;
+    if (__builtin_available(android 31, *)) {
+      reusable = ANeuralNetworksExecution_setReusable(execution, true) ==
+                 ANEURALNETWORKS_NO_ERROR;
+    }
+
+    // The loop runs until it is done: lift the default timeout of 2 seconds.
+    // The indexes refer to the model inputs {sumIn, stateIn, steps} and
+    // outputs {counterOut, sumOut, stateOut}.
+    const uint32_t length = tensorSize_ * sizeof(float);
+    if (ANeuralNetworksExecution_setLoopTimeout(
+            execution, ANeuralNetworks_getMaximumLoopTimeout()) !=
+            ANEURALNETWORKS_NO_ERROR ||
+        ANeuralNetworksExecution_setInputFromMemory(
+            execution, 0, nullptr, memorySumIn_, 0, length) !=
+            ANEURALNETWORKS_NO_ERROR ||
+        ANeuralNetworksExecution_setInputFromMemory(
+            execution, 1, nullptr, memoryInitialState_, 0, length) !=
+            ANEURALNETWORKS_NO_ERROR ||
+        ANeuralNetworksExecution_setInput(execution, 2, nullptr, &loopSteps_,
+                                          sizeof(loopSteps_)) !=
+            ANEURALNETWORKS_NO_ERROR ||
+        ANeuralNetworksExecution_setOutput(execution, 0, nullptr,
+                                           &loopCounter_,
+                                           sizeof(loopCounter_)) !=
+            ANEURALNETWORKS_NO_ERROR ||
+        ANeuralNetworksExecution_setOutputFromMemory(
+            execution, 1, nullptr, memorySumOut_, 0, length) !=
+            ANEURALNETWORKS_NO_ERROR ||
+        ANeuralNetworksExecution_setOutput(execution, 2, nullptr,
+                                           loopStateOut_.data(), length) !=
+            ANEURALNETWORKS_NO_ERROR) {
+      __android_log_print(ANDROID_LOG_ERROR, LOG_TAG,
+                          "Failed to set up the loop execution");
+      ANeuralNetworksExecution_free(execution);
+      return false;
+    }
+    if (reusable) {
+      loopExecution_ = execution;
+    }
+  }
+
+  int32_t status = ANeuralNetworksExecution_compute(execution);
   if (status != ANEURALNETWORKS_NO_ERROR) {
     __android_log_print(ANDROID_LOG_ERROR, LOG_TAG,
-                        "ANeuralNetworksExecution_compute failed");
-    return false;
+                        "ANeuralNetworksExecution_compute failed for the loop");
   }
-
-  ANeuralNetworksExecution_free(execution);
-  return true;
+  if (execution != loopExecution_) {
+    ANeuralNetworksExecution_free(execution);
+  }
+  return status == ANEURALNETWORKS_NO_ERROR;
 }
 
 /**
@@ -628,75 +842,64 @@ bool SimpleSequenceModel::Compute(float initialValue, uint32_t steps,
   fillMemory(sumInFd_, tensorSize_, 0);
   fillMemory(initialStateFd_, tensorSize_, initialValue);
 
-  // The event objects for all computation steps.
-  std::vector<ANeuralNetworksEvent*> events(steps, nullptr);
-
-  for (uint32_t i = 0; i < steps; i++) {
-    // We will only use ASharedMemory for boundary step executions, and use
-    // opaque memories for intermediate results to minimize the data copying.
-    // Note that when setting an opaque memory as the input or output of an
-    // execution, the offset and length must be set to 0 to indicate the
-    // entire memory region is used.
-    ANeuralNetworksMemory* sumInMemory;
-    ANeuralNetworksMemory* sumOutMemory;
-    ANeuralNetworksMemory* stateInMemory;
-    ANeuralNetworksMemory* stateOutMemory;
-    uint32_t sumInLength, sumOutLength, stateInLength, stateOutLength;
-    if (i == 0) {
-      sumInMemory = memorySumIn_;
-      sumInLength = tensorSize_;
-      stateInMemory = memoryInitialState_;
-      stateInLength = tensorSize_;
-    } else {
-      sumInMemory = memoryOpaqueSumIn_;
-      sumInLength = 0;
-      stateInMemory = memoryOpaqueStateIn_;
-      stateInLength = 0;
-    }
-    if (i == steps - 1) {
-      sumOutMemory = memorySumOut_;
-      sumOutLength = tensorSize_;
-    } else {
-      sumOutMemory = memoryOpaqueSumOut_;
-      sumOutLength = 0;
-    }
-    stateOutMemory = memoryOpaqueStateOut_;
-    stateOutLength = 0;
-
-    // Dispatch a single computation step with a dependency on the previous
-    // step, if any. The actual computation will start once its dependency has
-    // finished.
-    const ANeuralNetworksEvent* waitFor = i == 0 ? nullptr : events[i - 1];
-    if (!DispatchSingleStep(compilation_, sumInMemory, sumInLength,
-                            stateInMemory, stateInLength, sumOutMemory,
-                            sumOutLength, stateOutMemory, stateOutLength,
-                            waitFor, &events[i])) {
-      __android_log_print(ANDROID_LOG_ERROR, LOG_TAG,
-                          "DispatchSingleStep failed for step %d", i);
-      return false;
-    }
-
-    // Swap the memory handles: the outputs from the current step execution
-    // will be fed in as the inputs of the next step execution.
-    std::swap(memoryOpaqueSumIn_, memoryOpaqueSumOut_);
-    std::swap(memoryOpaqueStateIn_, memoryOpaqueStateOut_);
+  bool computed = mode_ == Mode::kWhileLoop ? ComputeWhileLoop(steps)
+                                            : ComputeChained(steps);
+  if (!computed) {
+    return false;
   }
 
-  // Since the events are chained, we only need to wait for the last one.
-  ANeuralNetworksEvent_wait(events.back());
-
   // Get the results.
   float* outputTensorPtr =
       reinterpret_cast<float*>(mmap(nullptr, tensorSize_ * sizeof(float),
                                     PROT_READ, MAP_SHARED, sumOutFd_, 0));
+  if (outputTensorPtr == MAP_FAILED) {
+    __android_log_print(ANDROID_LOG_ERROR, LOG_TAG,
+                        "Failed to map the sumOut memory");
+    return false;
+  }
   *result = outputTensorPtr[0];
   munmap(outputTensorPtr, tensorSize_ * sizeof(float));
+  return true;
+}
 
-  // Cleanup event objects.
-  for (auto* event : events) {
-    ANeuralNetworksEvent_free(event);
+/**
+ * The fixed costs of a computation (filling the inputs, creating executions,
+ * reading the result) cancel out between the 1 step and the multi-step
+ * runs, leaving what every additional step costs in each mode.
+ */
+void SimpleSequenceModel::ReportStepOverhead(uint32_t steps) {
+  if (steps < 2) {
+    return;
+  }
+  Mode savedMode = mode_;
+  for (Mode mode : {Mode::kChained, Mode::kWhileLoop}) {
+    if (!SetMode(mode)) {
+      continue;
+    }
+    const char* name = mode == Mode::kWhileLoop ? "WHILE loop" : "chained";
+    float result;
+    double elapsed[2];
+    uint32_t counts[2] = {1, steps};
+    bool ok = Compute(1.0f, steps, &result);  // warm up
+    for (int i = 0; i < 2 && ok; i++) {
+      auto start = std::chrono::steady_clock::now();
+      ok = Compute(1.0f, counts[i], &result);
+      elapsed[i] = std::chrono::duration<double, std::micro>(
+                       std::chrono::steady_clock::now() - start)
+                       .count();
+    }
+    if (!ok) {
+      __android_log_print(ANDROID_LOG_ERROR, LOG_TAG,
+                          "%s: computation failed", name);
+      continue;
+    }
+    __android_log_print(ANDROID_LOG_INFO, LOG_TAG,
+                        "%s: %.1f us per step (1 step in %.1f us, %u in "
+                        "%.1f us)",
+                        name, (elapsed[1] - elapsed[0]) / (steps - 1),
+                        elapsed[0], steps, elapsed[1]);
   }
-  return true;
+  mode_ = savedMode;
 }
 
 /**
@@ -705,6 +908,15 @@ bool SimpleSequenceModel::Compute(float initialValue, uint32_t steps,
  * Release NN API objects and close the file descriptors.
  */
 SimpleSequenceModel::~SimpleSequenceModel() {
+  for (auto* execution : executionPool_) {
+    ANeuralNetworksExecution_free(execution);
+  }
+  ANeuralNetworksExecution_free(loopExecution_);
+  ANeuralNetworksCompilation_free(loopCompilation_);
+  ANeuralNetworksModel_free(loopModel_);
+  ANeuralNetworksModel_free(loopBodyModel_);
+  ANeuralNetworksModel_free(loopConditionModel_);
+
   ANeuralNetworksCompilation_free(compilation_);
   ANeuralNetworksModel_free(model_);
 
@@ -716,9 +928,12 @@ SimpleSequenceModel::~SimpleSequenceModel() {
   close(sumInFd_);
   close(sumOutFd_);
   close(ratioFd_);
+  if (ratioData_) {
+    munmap(ratioData_, tensorSize_ * sizeof(float));
+  }
 
-  ANeuralNetworksMemory_free(memoryOpaqueStateIn_);
-  ANeuralNetworksMemory_free(memoryOpaqueStateOut_);
-  ANeuralNetworksMemory_free(memoryOpaqueSumIn_);
-  ANeuralNetworksMemory_free(memoryOpaqueSumOut_);
+  for (int i = 0; i < 2; i++) {
+    ANeuralNetworksMemory_free(memoryOpaqueStates_[i]);
+    ANeuralNetworksMemory_free(memoryOpaqueSums_[i]);
+  }
 }
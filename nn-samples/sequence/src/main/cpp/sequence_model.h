@@ -21,6 +21,10 @@
 #include <android/NeuralNetworks.h>
 
 #include <memory>
+#include <string>
+#include <vector>
+
+#include "sequence_graph.h"
 
 /**
  * SimpleSequenceModel
@@ -39,35 +43,88 @@
  * This graph is used for computing a single step of accumulating a finite
  * geometry progression.
  *
+ * The steps run either as a single execution of a model wrapping the graph
+ * in a WHILE loop (Mode::kWhileLoop), or as one execution per step chained
+ * with events (Mode::kChained). The loop is used when the device can
+ * compile it.
  */
 class SimpleSequenceModel {
  public:
-  static std::unique_ptr<SimpleSequenceModel> Create(float ratio);
+  enum class Mode {
+    kWhileLoop,
+    kChained,
+  };
+
+  // The compilations are cached in cacheDir, which may be empty to compile
+  // without caching.
+  static std::unique_ptr<SimpleSequenceModel> Create(
+      float ratio, const std::string& cacheDir);
 
   // Prefer using SimpleSequenceModel::Create.
-  explicit SimpleSequenceModel(float ratio);
+  SimpleSequenceModel(float ratio, const std::string& cacheDir);
   ~SimpleSequenceModel();
 
   bool Compute(float initialValue, uint32_t steps, float* result);
 
+  Mode mode() const { return mode_; }
+  // Fails if the WHILE loop model is not available.
+  bool SetMode(Mode mode);
+
+  // Time computations of 1 and steps steps in each available mode, and log
+  // the cost of every extra step.
+  void ReportStepOverhead(uint32_t steps);
+
  private:
   bool CreateSharedMemories();
   bool CreateModel();
   bool CreateCompilation();
   bool CreateOpaqueMemories();
+  bool CreateLoopModel();
+
+  bool ComputeChained(uint32_t steps);
+  bool ComputeWhileLoop(uint32_t steps);
+  bool BindStep(ANeuralNetworksExecution* execution, uint32_t step,
+                uint32_t steps);
 
   ANeuralNetworksModel* model_ = nullptr;
   ANeuralNetworksCompilation* compilation_ = nullptr;
 
+  // The loop: its condition and body models, and the model running it.
+  ANeuralNetworksModel* loopConditionModel_ = nullptr;
+  ANeuralNetworksModel* loopBodyModel_ = nullptr;
+  ANeuralNetworksModel* loopModel_ = nullptr;
+  ANeuralNetworksCompilation* loopCompilation_ = nullptr;
+  ANeuralNetworksExecution* loopExecution_ = nullptr;
+  // Host side operands of the loop executions.
+  int32_t loopSteps_ = 0;
+  int32_t loopCounter_ = 0;
+  std::vector<float> loopStateOut_;
+
+  Mode mode_ = Mode::kChained;
+
   static constexpr uint32_t dimLength_ = 200;
   static constexpr uint32_t tensorSize_ = dimLength_ * dimLength_;
 
+  // Reusable executions of the chained mode (API 31+), each bound to the
+  // memories of the steps it runs: one for a single step computation, the
+  // first step, the last step of either parity, then kMiddleExecutions in
+  // turn for the others. The latter count is even, so the parity of the
+  // steps an execution runs, and the opaque memories it reads and writes,
+  // don't change.
+  static constexpr uint32_t kMiddleExecutions = 4;
+  static constexpr uint32_t kExecutionPoolSize = 4 + kMiddleExecutions;
+  ANeuralNetworksExecution* executionPool_[kExecutionPoolSize] = {};
+  bool reusableExecutions_ = false;
+
   const float ratio_;
+  const std::string cacheDir_;
 
   // ASharedMemories. In reality, the values in the shared memory region will
   // be manipulated by other modules or processes.
   int initialStateFd_ = -1;
   int ratioFd_ = -1;
+  // The ratio tensor, mapped for the lifetime of the model.
+  float* ratioData_ = nullptr;
   int sumInFd_ = -1;
   int sumOutFd_ = -1;
   ANeuralNetworksMemory* memoryInitialState_ = nullptr;
@@ -75,13 +132,10 @@ class SimpleSequenceModel {
   ANeuralNetworksMemory* memorySumIn_ = nullptr;
   ANeuralNetworksMemory* memorySumOut_ = nullptr;
 
-  // Opaque memories.
-  ANeuralNetworksMemory* memoryOpaqueStateIn_ = nullptr;
-  ANeuralNetworksMemory* memoryOpaqueStateOut_ = nullptr;
-  ANeuralNetworksMemory* memoryOpaqueSumIn_ = nullptr;
-  ANeuralNetworksMemory* memoryOpaqueSumOut_ = nullptr;
+  // Opaque memories. Step i of a chained computation writes the ones at
+  // i % 2, which step i + 1 reads.
+  ANeuralNetworksMemory* memoryOpaqueSums_[2] = {};
+  ANeuralNetworksMemory* memoryOpaqueStates_[2] = {};
 };
 
-#define LOG_TAG "NNAPI_SEQUENCE"
-
 #endif  // NNAPI_SIMPLE_MODEL_H
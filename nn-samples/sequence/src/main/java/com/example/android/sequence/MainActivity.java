@@ -33,10 +33,12 @@ public class MainActivity extends Activity {
     private final String LOG_TAG = "NNAPI_SEQUENCE";
     private long modelHandle = 0;
 
-    public native long initModel(float ratio);
+    public native long initModel(float ratio, String cacheDir);
 
     public native float compute(float initialValue, int steps, long modelHandle);
 
+    public native void reportStepOverhead(int steps, long modelHandle);
+
     public native void destroyModel(long modelHandle);
 
     @Override
@@ -91,6 +93,17 @@ public class MainActivity extends Activity {
                 }
             }
         });
+        // A long press logs what a step costs in each execution mode.
+        computeButton.setOnLongClickListener(new View.OnLongClickListener() {
+            @Override
+            public boolean onLongClick(View v) {
+                if (modelHandle == 0) {
+                    return false;
+                }
+                new ReportStepOverheadTask().execute(64);
+                return true;
+            }
+        });
     }
 
     @Override
@@ -110,7 +123,7 @@ public class MainActivity extends Activity {
                 return 0L;
             }
             // Prepare the model in a separate thread.
-            return initModel(inputs[0]);
+            return initModel(inputs[0], getCodeCacheDir().getAbsolutePath());
         }
 
         @Override
@@ -119,6 +132,14 @@ public class MainActivity extends Activity {
         }
     }
 
+    private class ReportStepOverheadTask extends AsyncTask<Integer, Void, Void> {
+        @Override
+        protected Void doInBackground(Integer... steps) {
+            reportStepOverhead(steps[0], modelHandle);
+            return null;
+        }
+    }
+
     private class ComputeTask extends AsyncTask<String, Void, Float> {
         @Override
         protected Float doInBackground(String... inputs) {
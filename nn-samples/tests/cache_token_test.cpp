@@ -0,0 +1,122 @@
+/**
+ * Copyright 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "cache_token.h"
+
+#include <gtest/gtest.h>
+
+#include <string>
+#include <vector>
+
+#include "simple_model.h"
+
+namespace nn_graph {
+namespace {
+
+std::string TagToken(const std::string& tag) {
+  CacheTokenBuilder builder;
+  builder.AddTag(tag.c_str());
+  EXPECT_TRUE(builder.Finish());
+  return builder.hexToken();
+}
+
+// A tag is hashed as the little-endian words {1, 1, length} and its bytes,
+// so these are the SHA-256 digests of those messages. The lengths put the
+// end of the message on both sides of the 56-byte padding boundary and
+// across several blocks.
+TEST(CacheTokenTest, IsTheSha256OfTheRecords) {
+  EXPECT_EQ(TagToken(""),
+            "7d450465ceb49083708a6970827f0e0b116ed285072a95b451e55f583f56da8d");
+  EXPECT_EQ(TagToken("abc"),
+            "3ba20e584d075cfd6700afd7ad9b2b7a65a11dd19c418cee863b025fc393813e");
+  EXPECT_EQ(TagToken(std::string(43, 'a')),
+            "f30856aa7d3ebdb7afc7b966382abd5fca884774234732e0153168c469e30a46");
+  EXPECT_EQ(TagToken(std::string(44, 'a')),
+            "342e4f4d4d72c2353e24be48bb59b781c9d5bd22d86e3f8602342eb97423203b");
+  EXPECT_EQ(TagToken(std::string(52, 'a')),
+            "7573c524b566655863612a5d38d238cd0dd0cbb8f901d614444e491e7cc3eba1");
+  EXPECT_EQ(TagToken(std::string(53, 'a')),
+            "58ec8aa1523acc015f6b3be2a6b293daed7a292ea313d548273b12c8996a8370");
+  EXPECT_EQ(TagToken(std::string(116, 'a')),
+            "eb74555207577370d8dbac6959b5c07ff4ebc1bf52521b78bb970d263326ab39");
+  EXPECT_EQ(TagToken(std::string(1000, 'a')),
+            "794a932a8d883443249f5ca15d4b60f30236e31b7492bbba701701bc9796f829");
+}
+
+TEST(CacheTokenTest, HashesRecordsInOrder) {
+  CacheTokenBuilder builder;
+  builder.AddTag("abc");
+  builder.AddTag("de");
+  ASSERT_TRUE(builder.Finish());
+  EXPECT_EQ(builder.hexToken(),
+            "26123ba62ab5a44802c490bc981872c37a8ce4d6aaf79f2605cf45e50ab11cf3");
+  EXPECT_EQ(builder.hexToken().size(), 2 * kCacheTokenSize);
+}
+
+TEST(CacheTokenTest, IsFinishedOnce) {
+  CacheTokenBuilder builder;
+  ASSERT_TRUE(builder.Finish());
+  EXPECT_FALSE(builder.Finish());
+  uint32_t index;
+  EXPECT_FALSE(builder.AddTensorOperand({4}, &index));
+}
+
+std::string BasicToken(const std::vector<float>& weights) {
+  CacheTokenBuilder builder;
+  EXPECT_TRUE(SimpleModel::BuildGraph(&builder, weights.data(), TENSOR_SIZE));
+  return builder.hexToken();
+}
+
+TEST(CacheTokenTest, FollowsTheWeights) {
+  std::vector<float> weights(2 * TENSOR_SIZE, 0.5f);
+  std::string token = BasicToken(weights);
+  EXPECT_EQ(BasicToken(weights), token);
+  weights[123] = 0.25f;
+  EXPECT_NE(BasicToken(weights), token);
+  weights[123] = 0.5f;
+  EXPECT_EQ(BasicToken(weights), token);
+}
+
+TEST(CacheTokenTest, FollowsTheTags) {
+  std::vector<float> weights(2 * TENSOR_SIZE, 0.5f);
+  CacheTokenBuilder tagged;
+  tagged.AddTag("fast single answer");
+  ASSERT_TRUE(SimpleModel::BuildGraph(&tagged, weights.data(), TENSOR_SIZE));
+  EXPECT_NE(tagged.hexToken(), BasicToken(weights));
+}
+
+std::string OperationToken(OperationType type) {
+  CacheTokenBuilder builder;
+  uint32_t act, a, b, out;
+  EXPECT_TRUE(builder.AddFusedActivationNone(&act));
+  EXPECT_TRUE(builder.AddTensorOperand({4}, &a));
+  EXPECT_TRUE(builder.AddTensorOperand({4}, &b));
+  EXPECT_TRUE(builder.AddTensorOperand({4}, &out));
+  EXPECT_TRUE(builder.AddOperation(type, a, b, act, out));
+  EXPECT_TRUE(builder.IdentifyInputsAndOutputs({a, b}, {out}));
+  EXPECT_TRUE(builder.Finish());
+  return builder.hexToken();
+}
+
+TEST(CacheTokenTest, FollowsTheGraph) {
+  EXPECT_EQ(OperationToken(OperationType::kAdd),
+            OperationToken(OperationType::kAdd));
+  EXPECT_NE(OperationToken(OperationType::kAdd),
+            OperationToken(OperationType::kMul));
+}
+
+}  // namespace
+}  // namespace nn_graph
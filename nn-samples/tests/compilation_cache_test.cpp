@@ -0,0 +1,110 @@
+/**
+ * Copyright 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "compilation_cache.h"
+
+#include <gtest/gtest.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <string>
+
+namespace nn_graph {
+namespace {
+
+class CompilationCacheTest : public testing::Test {
+ protected:
+  void SetUp() override {
+    std::string pattern = testing::TempDir() + "compilation_cache_XXXXXX";
+    ASSERT_NE(mkdtemp(&pattern[0]), nullptr);
+    cacheDir_ = pattern;
+    first_.AddTag("first");
+    first_.Finish();
+    second_.AddTag("second");
+    second_.Finish();
+  }
+  void TearDown() override {
+    std::string command = "rm -rf '" + cacheDir_ + "'";
+    system(command.c_str());
+  }
+
+  // What a driver would leave in the directory.
+  void WriteDriverFile(const std::string& directory) {
+    FILE* file = fopen((directory + "/driver.bin").c_str(), "w");
+    ASSERT_NE(file, nullptr);
+    fputs("compiled", file);
+    fclose(file);
+  }
+  bool HasDriverFile(const std::string& directory) {
+    return access((directory + "/driver.bin").c_str(), F_OK) == 0;
+  }
+
+  std::string cacheDir_;
+  CacheTokenBuilder first_;
+  CacheTokenBuilder second_;
+};
+
+TEST_F(CompilationCacheTest, IsWarmForTheSameToken) {
+  bool warm = true;
+  std::string directory =
+      PrepareCompilationCache(cacheDir_, "model", first_, &warm);
+  EXPECT_EQ(directory, cacheDir_ + "/model");
+  EXPECT_FALSE(warm);
+  WriteDriverFile(directory);
+
+  EXPECT_EQ(PrepareCompilationCache(cacheDir_, "model", first_, &warm),
+            directory);
+  EXPECT_TRUE(warm);
+  EXPECT_TRUE(HasDriverFile(directory));
+}
+
+TEST_F(CompilationCacheTest, ClearsTheFilesOfAnotherToken) {
+  bool warm;
+  std::string directory =
+      PrepareCompilationCache(cacheDir_, "model", first_, &warm);
+  WriteDriverFile(directory);
+
+  EXPECT_EQ(PrepareCompilationCache(cacheDir_, "model", second_, &warm),
+            directory);
+  EXPECT_FALSE(warm);
+  EXPECT_FALSE(HasDriverFile(directory));
+  PrepareCompilationCache(cacheDir_, "model", second_, &warm);
+  EXPECT_TRUE(warm);
+}
+
+TEST_F(CompilationCacheTest, KeepsModelsApart) {
+  bool warm;
+  std::string a = PrepareCompilationCache(cacheDir_, "a", first_, &warm);
+  WriteDriverFile(a);
+  std::string b = PrepareCompilationCache(cacheDir_, "b", second_, &warm);
+  EXPECT_NE(a, b);
+  PrepareCompilationCache(cacheDir_, "a", first_, &warm);
+  EXPECT_TRUE(warm);
+  EXPECT_TRUE(HasDriverFile(a));
+}
+
+TEST_F(CompilationCacheTest, IsNotUsedWithoutADirectory) {
+  bool warm = true;
+  EXPECT_EQ(PrepareCompilationCache("", "model", first_, &warm), "");
+  EXPECT_FALSE(warm);
+  EXPECT_EQ(PrepareCompilationCache(cacheDir_ + "/missing", "model", first_,
+                                    &warm),
+            "");
+}
+
+}  // namespace
+}  // namespace nn_graph
@@ -0,0 +1,261 @@
+/**
+ * Copyright 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "cpu_graph.h"
+
+#include <gtest/gtest.h>
+
+#include <random>
+#include <vector>
+
+namespace nn_graph {
+namespace {
+
+std::vector<float> RandomTensor(size_t size, uint32_t seed) {
+  std::mt19937 random(seed);
+  std::uniform_real_distribution<float> value(-2.0f, 2.0f);
+  std::vector<float> tensor(size);
+  for (float& x : tensor) x = value(random);
+  return tensor;
+}
+
+// Operations may be added in any order, as with NNAPI; tensors span
+// several tiles and end in a partial one.
+TEST(CpuGraphTest, RunsOperationsAddedOutOfOrder) {
+  CpuGraph graph;
+  const std::vector<uint32_t> dimensions = {3, 1001};
+  uint32_t act, a, b, t1, t2, t3, out;
+  ASSERT_TRUE(graph.AddFusedActivationNone(&act));
+  for (uint32_t* operand : {&a, &b, &t1, &t2, &t3, &out}) {
+    ASSERT_TRUE(graph.AddTensorOperand(dimensions, operand));
+  }
+  // out = t3 * t3, t3 = t2 + b, t2 = t1 * a, t1 = a + b
+  ASSERT_TRUE(graph.AddOperation(OperationType::kMul, t3, t3, act, out));
+  ASSERT_TRUE(graph.AddOperation(OperationType::kAdd, t2, b, act, t3));
+  ASSERT_TRUE(graph.AddOperation(OperationType::kMul, t1, a, act, t2));
+  ASSERT_TRUE(graph.AddOperation(OperationType::kAdd, a, b, act, t1));
+  ASSERT_TRUE(graph.IdentifyInputsAndOutputs({a, b}, {out}));
+  ASSERT_TRUE(graph.Finish());
+  EXPECT_EQ(graph.tensorSize(), 3003u);
+  // each intermediate is last read by the operation writing the next one
+  EXPECT_EQ(graph.scratchBytes(), CpuGraph::kTileSize * sizeof(float));
+
+  std::vector<float> inputA = RandomTensor(3003, 1);
+  std::vector<float> inputB = RandomTensor(3003, 2);
+  std::vector<float> output(3003);
+  const float* inputs[] = {inputA.data(), inputB.data()};
+  float* outputs[] = {output.data()};
+  ASSERT_TRUE(graph.Compute(inputs, outputs));
+  for (size_t i = 0; i < output.size(); i++) {
+    float t = (inputA[i] + inputB[i]) * inputA[i] + inputB[i];
+    ASSERT_EQ(output[i], t * t) << i;
+  }
+}
+
+TEST(CpuGraphTest, UsesConstantsInPlace) {
+  CpuGraph graph;
+  std::vector<float> weights = RandomTensor(10, 3);
+  uint32_t act, w, in, out;
+  ASSERT_TRUE(graph.AddFusedActivationNone(&act));
+  ASSERT_TRUE(graph.AddTensorOperand({10}, &w));
+  ASSERT_TRUE(graph.AddTensorOperand({10}, &in));
+  ASSERT_TRUE(graph.AddTensorOperand({10}, &out));
+  ASSERT_TRUE(graph.SetTensorValue(w, weights.data(), weights.size()));
+  ASSERT_TRUE(graph.AddOperation(OperationType::kMul, w, in, act, out));
+  ASSERT_TRUE(graph.IdentifyInputsAndOutputs({in}, {out}));
+  ASSERT_TRUE(graph.Finish());
+  EXPECT_EQ(graph.scratchBytes(), 0u);
+
+  std::vector<float> input = RandomTensor(10, 4);
+  std::vector<float> output(10);
+  const float* inputs[] = {input.data()};
+  float* outputs[] = {output.data()};
+  ASSERT_TRUE(graph.Compute(inputs, outputs));
+  for (size_t i = 0; i < 10; i++) ASSERT_EQ(output[i], weights[i] * input[i]);
+}
+
+// A chain of n additions needs two scratch tiles whatever n is.
+TEST(CpuGraphTest, ReusesScratchTiles) {
+  CpuGraph graph;
+  uint32_t act, in, previous;
+  ASSERT_TRUE(graph.AddFusedActivationNone(&act));
+  ASSERT_TRUE(graph.AddTensorOperand({5000}, &in));
+  previous = in;
+  for (int i = 0; i < 20; i++) {
+    uint32_t next;
+    ASSERT_TRUE(graph.AddTensorOperand({5000}, &next));
+    ASSERT_TRUE(graph.AddOperation(OperationType::kAdd, previous, in, act,
+                                   next));
+    previous = next;
+  }
+  ASSERT_TRUE(graph.IdentifyInputsAndOutputs({in}, {previous}));
+  ASSERT_TRUE(graph.Finish());
+  EXPECT_LE(graph.scratchBytes(), 2 * CpuGraph::kTileSize * sizeof(float));
+
+  std::vector<float> input(5000, 0.25f);
+  std::vector<float> output(5000);
+  const float* inputs[] = {input.data()};
+  float* outputs[] = {output.data()};
+  ASSERT_TRUE(graph.Compute(inputs, outputs));
+  for (float x : output) ASSERT_EQ(x, 21 * 0.25f);
+}
+
+class CpuGraphLoopTest : public testing::Test {
+ protected:
+  // sum' = sum + state, state' = state * ratio, the sequence sample's step
+  void SetUp() override {
+    ratio_ = RandomTensor(kSize, 5);
+    uint32_t act, ratio;
+    ASSERT_TRUE(graph_.AddFusedActivationNone(&act));
+    for (uint32_t* operand : {&sumIn_, &stateIn_, &ratio, &sumOut_,
+                              &stateOut_}) {
+      ASSERT_TRUE(graph_.AddTensorOperand({kSize}, operand));
+    }
+    ASSERT_TRUE(graph_.SetTensorValue(ratio, ratio_.data(), kSize));
+    ASSERT_TRUE(
+        graph_.AddOperation(OperationType::kAdd, sumIn_, stateIn_, act, sumOut_));
+    ASSERT_TRUE(graph_.AddOperation(OperationType::kMul, stateIn_, ratio, act,
+                                    stateOut_));
+    ASSERT_TRUE(graph_.IdentifyInputsAndOutputs({sumIn_, stateIn_},
+                                                {sumOut_, stateOut_}));
+    ASSERT_TRUE(graph_.Finish());
+  }
+
+  static constexpr uint32_t kSize = 2500;
+  CpuGraph graph_;
+  std::vector<float> ratio_;
+  uint32_t sumIn_, stateIn_, sumOut_, stateOut_;
+};
+
+TEST_F(CpuGraphLoopTest, MatchesComputingStepByStep) {
+  std::vector<float> sum = RandomTensor(kSize, 6);
+  std::vector<float> state = RandomTensor(kSize, 7);
+  std::vector<float> loopSum(kSize), loopState(kSize);
+  const float* loopInputs[] = {sum.data(), state.data()};
+  float* loopOutputs[] = {loopSum.data(), loopState.data()};
+  ASSERT_TRUE(graph_.ComputeLoop(loopInputs, loopOutputs, 9));
+
+  std::vector<float> nextSum(kSize), nextState(kSize);
+  for (int step = 0; step < 9; step++) {
+    const float* inputs[] = {sum.data(), state.data()};
+    float* outputs[] = {nextSum.data(), nextState.data()};
+    ASSERT_TRUE(graph_.Compute(inputs, outputs));
+    sum.swap(nextSum);
+    state.swap(nextState);
+  }
+  for (size_t i = 0; i < kSize; i++) {
+    ASSERT_EQ(loopSum[i], sum[i]) << i;
+    ASSERT_EQ(loopState[i], state[i]) << i;
+  }
+}
+
+TEST_F(CpuGraphLoopTest, ZeroStepsCopyTheInputs) {
+  std::vector<float> sum = RandomTensor(kSize, 8);
+  std::vector<float> state = RandomTensor(kSize, 9);
+  std::vector<float> outSum(kSize), outState(kSize);
+  const float* inputs[] = {sum.data(), state.data()};
+  float* outputs[] = {outSum.data(), outState.data()};
+  ASSERT_TRUE(graph_.ComputeLoop(inputs, outputs, 0));
+  EXPECT_EQ(outSum, sum);
+  EXPECT_EQ(outState, state);
+}
+
+TEST(CpuGraphErrorTest, RejectsTensorsOfAnotherSize) {
+  CpuGraph graph;
+  uint32_t a, b;
+  ASSERT_TRUE(graph.AddTensorOperand({4}, &a));
+  EXPECT_FALSE(graph.AddTensorOperand({5}, &b));
+  EXPECT_FALSE(graph.AddTensorOperand({}, &b));
+  EXPECT_FALSE(graph.AddTensorOperand({2, 0}, &b));
+  EXPECT_TRUE(graph.AddTensorOperand({2, 2}, &b));
+}
+
+TEST(CpuGraphErrorTest, RejectsACycle) {
+  CpuGraph graph;
+  uint32_t act, a, b, out;
+  ASSERT_TRUE(graph.AddFusedActivationNone(&act));
+  for (uint32_t* operand : {&a, &b, &out}) {
+    ASSERT_TRUE(graph.AddTensorOperand({4}, operand));
+  }
+  ASSERT_TRUE(graph.AddOperation(OperationType::kAdd, a, out, act, b));
+  ASSERT_TRUE(graph.AddOperation(OperationType::kAdd, a, b, act, out));
+  ASSERT_TRUE(graph.IdentifyInputsAndOutputs({a}, {out}));
+  EXPECT_FALSE(graph.Finish());
+}
+
+TEST(CpuGraphErrorTest, RejectsMisusedOperands) {
+  CpuGraph graph;
+  uint32_t act, a, b, out;
+  std::vector<float> values(4);
+  ASSERT_TRUE(graph.AddFusedActivationNone(&act));
+  for (uint32_t* operand : {&a, &b, &out}) {
+    ASSERT_TRUE(graph.AddTensorOperand({4}, operand));
+  }
+  // a tensor as the activation, the activation as a tensor
+  EXPECT_FALSE(graph.AddOperation(OperationType::kAdd, a, b, a, out));
+  EXPECT_FALSE(graph.AddOperation(OperationType::kAdd, act, b, act, out));
+  EXPECT_FALSE(graph.SetTensorValue(act, values.data(), 4));
+  EXPECT_FALSE(graph.SetTensorValue(a, values.data(), 3));
+  ASSERT_TRUE(graph.SetTensorValue(b, values.data(), 4));
+  EXPECT_FALSE(graph.IdentifyInputsAndOutputs({b}, {out}));
+}
+
+TEST(CpuGraphErrorTest, RejectsOutputsWrittenTwiceOrNever) {
+  {
+    CpuGraph graph;
+    uint32_t act, a, out;
+    ASSERT_TRUE(graph.AddFusedActivationNone(&act));
+    ASSERT_TRUE(graph.AddTensorOperand({4}, &a));
+    ASSERT_TRUE(graph.AddTensorOperand({4}, &out));
+    ASSERT_TRUE(graph.AddOperation(OperationType::kAdd, a, a, act, out));
+    ASSERT_TRUE(graph.AddOperation(OperationType::kMul, a, a, act, out));
+    ASSERT_TRUE(graph.IdentifyInputsAndOutputs({a}, {out}));
+    EXPECT_FALSE(graph.Finish());
+  }
+  {
+    CpuGraph graph;
+    uint32_t a, out;
+    ASSERT_TRUE(graph.AddTensorOperand({4}, &a));
+    ASSERT_TRUE(graph.AddTensorOperand({4}, &out));
+    ASSERT_TRUE(graph.IdentifyInputsAndOutputs({a}, {out}));
+    EXPECT_FALSE(graph.Finish());
+  }
+}
+
+TEST(CpuGraphErrorTest, ComputesOnlyWhenFinished) {
+  CpuGraph graph;
+  uint32_t act, a, out;
+  ASSERT_TRUE(graph.AddFusedActivationNone(&act));
+  ASSERT_TRUE(graph.AddTensorOperand({4}, &a));
+  ASSERT_TRUE(graph.AddTensorOperand({4}, &out));
+  ASSERT_TRUE(graph.AddOperation(OperationType::kAdd, a, a, act, out));
+  ASSERT_TRUE(graph.IdentifyInputsAndOutputs({a}, {out}));
+
+  std::vector<float> input(4), output(4);
+  const float* inputs[] = {input.data()};
+  float* outputs[] = {output.data()};
+  EXPECT_FALSE(graph.Compute(inputs, outputs));
+  ASSERT_TRUE(graph.Finish());
+  EXPECT_FALSE(graph.Finish());
+  uint32_t late;
+  EXPECT_FALSE(graph.AddTensorOperand({4}, &late));
+  EXPECT_TRUE(graph.Compute(inputs, outputs));
+  // as many inputs as outputs: it runs as a loop body too
+  EXPECT_TRUE(graph.ComputeLoop(inputs, outputs, 1));
+}
+
+}  // namespace
+}  // namespace nn_graph
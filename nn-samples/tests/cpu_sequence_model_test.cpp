@@ -0,0 +1,61 @@
+/**
+ * Copyright 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "cpu_sequence_model.h"
+
+#include <gtest/gtest.h>
+
+namespace {
+
+// The chained NNAPI executions compute sum += state, then state *= ratio,
+// in float32; the CPU model has to give the same bits.
+float ChainedSteps(float initialValue, float ratio, uint32_t steps) {
+  float sum = 0.0f, state = initialValue;
+  for (uint32_t i = 0; i < steps; i++) {
+    sum = sum + state;
+    state = state * ratio;
+  }
+  return sum;
+}
+
+TEST(CpuSequenceModelTest, MatchesTheChainedSteps) {
+  std::unique_ptr<CpuSequenceModel> model = CpuSequenceModel::Create(0.5f);
+  ASSERT_NE(model, nullptr);
+  for (uint32_t steps : {1u, 2u, 10u, 64u, 300u}) {
+    float result = -1.0f;
+    ASSERT_TRUE(model->Compute(1.0f, steps, &result));
+    EXPECT_EQ(result, ChainedSteps(1.0f, 0.5f, steps)) << steps;
+  }
+}
+
+TEST(CpuSequenceModelTest, ConvergesToTheSeriesSum) {
+  std::unique_ptr<CpuSequenceModel> model = CpuSequenceModel::Create(0.9f);
+  ASSERT_NE(model, nullptr);
+  float result = 0.0f;
+  ASSERT_TRUE(model->Compute(3.0f, 1000, &result));
+  EXPECT_NEAR(result, 3.0f / (1.0f - 0.9f), 1e-3f);
+}
+
+TEST(CpuSequenceModelTest, ZeroStepsSumNothing) {
+  std::unique_ptr<CpuSequenceModel> model = CpuSequenceModel::Create(0.5f);
+  ASSERT_NE(model, nullptr);
+  float result = -1.0f;
+  ASSERT_TRUE(model->Compute(3.0f, 0, &result));
+  EXPECT_EQ(result, 0.0f);
+  EXPECT_FALSE(model->Compute(3.0f, 1, nullptr));
+}
+
+}  // namespace
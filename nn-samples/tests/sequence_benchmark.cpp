@@ -0,0 +1,90 @@
+/**
+ * Copyright 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Cost of a sequence step on the CPU: the whole computation run as a loop,
+ * where every step is done on a tile before moving on to the next, against
+ * one Compute() per step over the whole tensors, as chained executions do.
+ */
+#include <stdio.h>
+
+#include <chrono>
+#include <vector>
+
+#include "cpu_graph.h"
+#include "cpu_sequence_model.h"
+#include "sequence_graph.h"
+
+namespace {
+
+const uint32_t kDimLength = 200;
+const uint32_t kTensorSize = kDimLength * kDimLength;
+const uint32_t kSteps = 100;
+const int kRuns = 100;
+
+double NsPerElementStep(double seconds) {
+  return seconds * 1e9 / (double(kRuns) * kSteps * kTensorSize);
+}
+
+}  // namespace
+
+int main() {
+  std::unique_ptr<CpuSequenceModel> model = CpuSequenceModel::Create(0.5f);
+  if (!model) {
+    fprintf(stderr, "cannot build the model\n");
+    return 1;
+  }
+  float result = 0.0f;
+  auto begin = std::chrono::steady_clock::now();
+  for (int i = 0; i < kRuns; i++) {
+    model->Compute(1.0f, kSteps, &result);
+  }
+  double loop = std::chrono::duration<double>(
+                    std::chrono::steady_clock::now() - begin)
+                    .count();
+
+  std::vector<float> ratio(kTensorSize, 0.5f);
+  nn_graph::CpuGraph graph;
+  if (!BuildSequenceStepGraph(&graph, ratio.data(), kDimLength)) {
+    fprintf(stderr, "cannot build the step graph\n");
+    return 1;
+  }
+  std::vector<float> sum[2], state[2];
+  for (int i = 0; i < 2; i++) {
+    sum[i].resize(kTensorSize);
+    state[i].resize(kTensorSize);
+  }
+  begin = std::chrono::steady_clock::now();
+  for (int i = 0; i < kRuns; i++) {
+    std::fill(sum[0].begin(), sum[0].end(), 0.0f);
+    std::fill(state[0].begin(), state[0].end(), 1.0f);
+    for (uint32_t step = 0; step < kSteps; step++) {
+      int in = step % 2;
+      const float* inputs[] = {sum[in].data(), state[in].data()};
+      float* outputs[] = {sum[1 - in].data(), state[1 - in].data()};
+      graph.Compute(inputs, outputs);
+    }
+  }
+  double chained = std::chrono::duration<double>(
+                       std::chrono::steady_clock::now() - begin)
+                       .count();
+
+  printf("loop: %.3f ns per element and step (result %f)\n",
+         NsPerElementStep(loop), result);
+  printf("one Compute() per step: %.3f ns per element and step\n",
+         NsPerElementStep(chained));
+  return 0;
+}
@@ -0,0 +1,52 @@
+/**
+ * Copyright 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Calls per second of SimpleModel::Compute() on the CPU backend: filling
+ * the inputs, running the graph and checking the output, as the sample does
+ * for every button press.
+ */
+#include <stdio.h>
+
+#include <chrono>
+#include <memory>
+#include <vector>
+
+#include "cpu_simple_model.h"
+#include "simple_model.h"
+
+int main() {
+  std::vector<float> weights(2 * TENSOR_SIZE, 0.5f);
+  SimpleModel model(std::unique_ptr<SimpleModelBackend>(
+      new CpuSimpleModel(weights.data(), weights.size())));
+  if (!model.CreateCompiledModel()) {
+    fprintf(stderr, "cannot build the model\n");
+    return 1;
+  }
+
+  const int kCalls = 2000000;
+  float result = 0.0f;
+  auto begin = std::chrono::steady_clock::now();
+  for (int i = 0; i < kCalls; i++) {
+    model.Compute(i & 7, 1.0f, &result);
+  }
+  double seconds = std::chrono::duration<double>(
+                       std::chrono::steady_clock::now() - begin)
+                       .count();
+  printf("%.0f calls/s, %.1f ns per call\n", kCalls / seconds,
+         seconds * 1e9 / kCalls);
+  return 0;
+}
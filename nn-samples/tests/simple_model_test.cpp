@@ -0,0 +1,95 @@
+/**
+ * Copyright 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "simple_model.h"
+
+#include <gtest/gtest.h>
+#include <stdio.h>
+
+#include <memory>
+#include <random>
+#include <vector>
+
+#include "cpu_graph.h"
+#include "cpu_simple_model.h"
+
+namespace {
+
+std::vector<float> ReadModelData() {
+  std::vector<float> weights(2 * TENSOR_SIZE);
+  FILE* file = fopen(MODEL_DATA_PATH, "rb");
+  if (!file) return {};
+  size_t count = fread(weights.data(), sizeof(float), weights.size(), file);
+  fclose(file);
+  weights.resize(count);
+  return weights;
+}
+
+// The sample's graph with the weights it ships: every element of the
+// output is (input1 + 0.5) * (input2 + 0.5), which Compute() checks too.
+TEST(SimpleModelTest, ComputesTheGraphWithTheShippedWeights) {
+  std::vector<float> weights = ReadModelData();
+  ASSERT_EQ(weights.size(), 2u * TENSOR_SIZE);
+  SimpleModel model(std::unique_ptr<SimpleModelBackend>(
+      new CpuSimpleModel(weights.data(), weights.size())));
+  ASSERT_TRUE(model.CreateCompiledModel());
+
+  float result = 0.0f;
+  ASSERT_TRUE(model.Compute(1.0f, 2.0f, &result));
+  EXPECT_EQ(result, 1.5f * 2.5f);
+  // the tensors are reused between calls
+  ASSERT_TRUE(model.Compute(-0.5f, 7.0f, &result));
+  EXPECT_EQ(result, 0.0f);
+}
+
+TEST(SimpleModelTest, NeedsBothWeightTensors) {
+  std::vector<float> weights(2 * TENSOR_SIZE - 1, 0.5f);
+  CpuSimpleModel backend(weights.data(), weights.size());
+  EXPECT_FALSE(backend.CreateCompiledModel());
+}
+
+TEST(SimpleModelTest, ComputeNeedsAResult) {
+  std::vector<float> weights(2 * TENSOR_SIZE, 0.5f);
+  SimpleModel model(std::unique_ptr<SimpleModelBackend>(
+      new CpuSimpleModel(weights.data(), weights.size())));
+  ASSERT_TRUE(model.CreateCompiledModel());
+  EXPECT_FALSE(model.Compute(1.0f, 2.0f, nullptr));
+}
+
+// ANEURALNETWORKS_ADD and MUL with FUSED_NONE on same-shaped float32
+// tensors are IEEE single precision element-wise operations, so the CPU
+// backend has to give exactly (w0[i] + in1[i]) * (w1[i] + in2[i]).
+TEST(SimpleModelTest, BackendFollowsTheNnapiOperations) {
+  std::mt19937 random(7);
+  std::uniform_real_distribution<float> value(-10.0f, 10.0f);
+  std::vector<float> weights(2 * TENSOR_SIZE);
+  for (float& w : weights) w = value(random);
+  CpuSimpleModel backend(weights.data(), weights.size());
+  ASSERT_TRUE(backend.CreateCompiledModel());
+
+  for (int i = 0; i < TENSOR_SIZE; i++) {
+    backend.input1()[i] = value(random);
+    backend.input2()[i] = value(random);
+  }
+  ASSERT_TRUE(backend.Execute());
+  for (int i = 0; i < TENSOR_SIZE; i++) {
+    float sum0 = weights[i] + backend.input1()[i];
+    float sum1 = weights[TENSOR_SIZE + i] + backend.input2()[i];
+    ASSERT_EQ(backend.output()[i], sum0 * sum1) << i;
+  }
+}
+
+}  // namespace
@@ -0,0 +1,94 @@
+/**
+ * Copyright 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "tensor_ops.h"
+
+#include <gtest/gtest.h>
+#include <math.h>
+
+#include <random>
+#include <vector>
+
+namespace {
+
+// Sizes around the vector widths, at every misalignment of a 16-byte vector.
+class TensorOpsTest : public testing::TestWithParam<size_t> {
+ protected:
+  void SetUp() override {
+    std::mt19937 random(GetParam());
+    std::uniform_real_distribution<float> value(-100.0f, 100.0f);
+    for (std::vector<float>* v : {&a_, &b_}) {
+      v->resize(kMaxSize + 4);
+      for (float& x : *v) x = value(random);
+    }
+    out_.assign(kMaxSize + 4, -1.0f);
+  }
+
+  static constexpr size_t kMaxSize = 67;
+  std::vector<float> a_, b_, out_;
+};
+
+TEST_P(TensorOpsTest, MatchesScalarArithmetic) {
+  for (size_t offset = 0; offset < 4; offset++) {
+    size_t size = GetParam();
+    const float* a = a_.data() + offset;
+    const float* b = b_.data() + offset;
+    float* out = out_.data() + offset;
+
+    AddTensors(a, b, out, size);
+    for (size_t i = 0; i < size; i++) ASSERT_EQ(out[i], a[i] + b[i]) << i;
+    MulTensors(a, b, out, size);
+    for (size_t i = 0; i < size; i++) ASSERT_EQ(out[i], a[i] * b[i]) << i;
+    FillTensor(out, size, 2.5f);
+    for (size_t i = 0; i < size; i++) ASSERT_EQ(out[i], 2.5f) << i;
+    // nothing past the end is touched
+    EXPECT_EQ(out[size], -1.0f);
+  }
+}
+
+TEST_P(TensorOpsTest, OutputMayBeAnInput) {
+  size_t size = GetParam();
+  std::vector<float> expected(size);
+  for (size_t i = 0; i < size; i++) expected[i] = (a_[i] + b_[i]) * b_[i];
+  AddTensors(a_.data(), b_.data(), a_.data(), size);
+  MulTensors(a_.data(), b_.data(), a_.data(), size);
+  for (size_t i = 0; i < size; i++) ASSERT_EQ(a_[i], expected[i]) << i;
+}
+
+TEST_P(TensorOpsTest, CountsMismatchesAndFindsTheFirst) {
+  size_t size = GetParam();
+  FillTensor(out_.data(), size, 1.0f);
+  size_t first = 12345;
+  EXPECT_EQ(CountMismatches(out_.data(), size, 1.0f, 1e-6f, &first), 0u);
+  EXPECT_EQ(first, 12345u);
+  if (size < 2) return;
+
+  out_[size - 1] = 1.5f;
+  EXPECT_EQ(CountMismatches(out_.data(), size, 1.0f, 1e-6f, &first), 1u);
+  EXPECT_EQ(first, size - 1);
+  // NaN is a mismatch, a value within epsilon is not
+  out_[size / 2] = NAN;
+  out_[0] = 1.0f + 1e-7f;
+  EXPECT_EQ(CountMismatches(out_.data(), size, 1.0f, 1e-6f, &first),
+            size / 2 == size - 1 ? 1u : 2u);
+  EXPECT_EQ(first, size / 2);
+}
+
+INSTANTIATE_TEST_SUITE_P(Sizes, TensorOpsTest,
+                         testing::Values(0, 1, 3, 4, 5, 7, 8, 9, 15, 16, 17,
+                                         31, 64, 67));
+
+}  // namespace
@@ -0,0 +1,44 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "history_ring.h"
+
+HistoryRing::HistoryRing(int32_t capacity) : capacity_(capacity), head_(0) {}
+
+int32_t HistoryRing::Push(int32_t count, Span *spans) {
+  if (count <= 0) {
+    return 0;
+  }
+  int32_t skipped = count > capacity_ ? count - capacity_ : 0;
+  int32_t written = count - skipped;
+  int32_t slot = (head_ + skipped) % capacity_;
+  head_ = (slot + written) % capacity_;
+
+  // Written from slot, the samples run into the mirrors of the first slots
+  // when they wrap, which keeps them in one span. Their other copies start
+  // at the mirror of slot and wrap around the end of the buffer.
+  int32_t spanCount = 0;
+  spans[spanCount++] = {slot, skipped, written};
+  int32_t mirror = slot + capacity_;
+  int32_t beforeEnd = slots() - mirror;
+  if (written <= beforeEnd) {
+    spans[spanCount++] = {mirror, skipped, written};
+  } else {
+    spans[spanCount++] = {mirror, skipped, beforeEnd};
+    spans[spanCount++] = {0, skipped + beforeEnd, written - beforeEnd};
+  }
+  return spanCount;
+}
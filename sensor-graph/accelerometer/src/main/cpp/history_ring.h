@@ -0,0 +1,63 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SENSORGRAPH_HISTORY_RING_H
+#define SENSORGRAPH_HISTORY_RING_H
+
+#include <cstdint>
+
+/*
+ * HistoryRing
+ * Where the samples of a scrolling history go in a vertex buffer of twice
+ * its capacity. Each sample is written to its slot and to the mirror of
+ * that slot, capacity further, so the latest capacity samples are always
+ * consecutive from first(): the graph is drawn from one offset, and a new
+ * sample costs a couple of small sub-data writes instead of a new buffer.
+ *
+ * The ring only does the bookkeeping; the caller owns the buffer.
+ */
+class HistoryRing {
+ public:
+  // Consecutive slots taking consecutive samples.
+  struct Span {
+    int32_t slot;    // first slot written
+    int32_t sample;  // index of its sample among those pushed
+    int32_t count;
+  };
+  static constexpr int32_t kMaxSpans = 3;
+
+  explicit HistoryRing(int32_t capacity);
+
+  int32_t capacity() const { return capacity_; }
+  int32_t slots() const { return 2 * capacity_; }
+
+  // Slot of the oldest sample of the history.
+  int32_t first() const { return head_; }
+
+  /*
+   * Add count samples, oldest first, and return the number of spans, at
+   * most kMaxSpans, written to spans: copying each span's samples to its
+   * slots brings the buffer up to date. Only the last capacity samples of
+   * a larger push are written.
+   */
+  int32_t Push(int32_t count, Span *spans);
+
+ private:
+  int32_t capacity_;
+  int32_t head_;
+};
+
+#endif  // SENSORGRAPH_HISTORY_RING_H
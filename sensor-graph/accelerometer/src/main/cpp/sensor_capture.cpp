@@ -0,0 +1,144 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "sensor_capture.h"
+
+#include <android/log.h>
+#include <dlfcn.h>
+
+#include <algorithm>
+
+#define LOG_TAG "accelerometergraph"
+#define LOGI(...) __android_log_print(ANDROID_LOG_INFO, LOG_TAG, __VA_ARGS__)
+
+static const int LOOPER_ID_CAPTURE = 4;
+// Fastest rate asked for: 400 Hz.
+static const int32_t CAPTURE_MIN_PERIOD_US = 2500;
+// How long the sensor hub may hold events before reporting them.
+static const int64_t CAPTURE_MAX_LATENCY_US = 20000;
+// Longest the thread sleeps before checking whether it was stopped.
+static const int CAPTURE_POLL_TIMEOUT_MS = 100;
+static const int CAPTURE_EVENT_BATCH = 64;
+
+/*
+ * RegisterSensor()
+ *    ASensorEventQueue_registerSensor() is API 26, later than this sample's
+ *    minimum: look it up at run time, like AcquireASensorManagerInstance().
+ */
+static int RegisterSensor(ASensorEventQueue *queue, const ASensor *sensor,
+                          int32_t periodUs, int64_t maxLatencyUs) {
+  typedef int (*PF_REGISTERSENSOR)(ASensorEventQueue *, const ASensor *,
+                                   int32_t, int64_t);
+  static PF_REGISTERSENSOR registerSensorFunc = (PF_REGISTERSENSOR)dlsym(
+      dlopen("libandroid.so", RTLD_NOW), "ASensorEventQueue_registerSensor");
+  if (registerSensorFunc) {
+    return registerSensorFunc(queue, sensor, periodUs, maxLatencyUs);
+  }
+  int status = ASensorEventQueue_enableSensor(queue, sensor);
+  if (status < 0) {
+    return status;
+  }
+  return ASensorEventQueue_setEventRate(queue, sensor, periodUs);
+}
+
+SensorCapture::SensorCapture(ASensorManager *manager,
+                             std::vector<const ASensor *> sensors,
+                             SensorEventRing *ring)
+    : manager_(manager),
+      sensors_(std::move(sensors)),
+      ring_(ring),
+      running_(false),
+      looper_(nullptr),
+      failed_(0) {
+  for (const ASensor *sensor : sensors_) {
+    types_.push_back(ASensor_getType(sensor));
+  }
+}
+
+SensorCapture::~SensorCapture() { Stop(); }
+
+void SensorCapture::Start() {
+  if (running_.exchange(true)) {
+    return;
+  }
+  failed_.store(0, std::memory_order_relaxed);
+  thread_ = std::thread(&SensorCapture::Run, this);
+}
+
+void SensorCapture::Stop() {
+  if (!running_.exchange(false)) {
+    return;
+  }
+  // The thread may not have its looper yet; it then sees running_ within
+  // one poll timeout.
+  ALooper *looper = looper_.load();
+  if (looper) {
+    ALooper_wake(looper);
+  }
+  thread_.join();
+  // The thread's reference kept the looper valid for the wake.
+  looper = looper_.exchange(nullptr);
+  if (looper) {
+    ALooper_release(looper);
+  }
+  if (ring_->dropped()) {
+    LOGI("Sensor capture dropped %u events so far", ring_->dropped());
+  }
+}
+
+void SensorCapture::Run() {
+  ALooper *looper = ALooper_prepare(ALOOPER_PREPARE_ALLOW_NON_CALLBACKS);
+  ALooper_acquire(looper);
+  looper_.store(looper);
+  ASensorEventQueue *queue = ASensorManager_createEventQueue(
+      manager_, looper, LOOPER_ID_CAPTURE, NULL, NULL);
+  for (size_t i = 0; i < sensors_.size(); i++) {
+    const ASensor *sensor = sensors_[i];
+    int32_t periodUs =
+        std::max(ASensor_getMinDelay(sensor), CAPTURE_MIN_PERIOD_US);
+    if (RegisterSensor(queue, sensor, periodUs, CAPTURE_MAX_LATENCY_US) < 0) {
+      LOGI("Can't capture %s", ASensor_getName(sensor));
+      failed_.fetch_or(1u << i, std::memory_order_relaxed);
+      continue;
+    }
+    LOGI("Capturing %s at %d Hz", ASensor_getName(sensor),
+         1000000 / periodUs);
+  }
+
+  ASensorEvent events[CAPTURE_EVENT_BATCH];
+  while (running_.load()) {
+    ALooper_pollOnce(CAPTURE_POLL_TIMEOUT_MS, NULL, NULL, NULL);
+    ssize_t eventCount;
+    while ((eventCount = ASensorEventQueue_getEvents(
+                queue, events, CAPTURE_EVENT_BATCH)) > 0) {
+      for (ssize_t i = 0; i < eventCount; i++) {
+        auto type = std::find(types_.begin(), types_.end(), events[i].type);
+        if (type == types_.end()) {
+          continue;
+        }
+        ring_->Push({{events[i].data[0], events[i].data[1],
+                      events[i].data[2], 0.f},
+                     events[i].timestamp,
+                     static_cast<int32_t>(type - types_.begin())});
+      }
+    }
+  }
+
+  for (const ASensor *sensor : sensors_) {
+    ASensorEventQueue_disableSensor(queue, sensor);
+  }
+  ASensorManager_destroyEventQueue(manager_, queue);
+}
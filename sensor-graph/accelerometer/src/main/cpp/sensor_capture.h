@@ -0,0 +1,70 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SENSORGRAPH_SENSOR_CAPTURE_H
+#define SENSORGRAPH_SENSOR_CAPTURE_H
+
+#include <android/looper.h>
+#include <android/sensor.h>
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include "sensor_event_ring.h"
+
+/*
+ * SensorCapture
+ * Reads sensors at their highest rate, up to 400 Hz, on a thread of its own,
+ * and pushes every event with its timestamp to a SensorEventRing. The
+ * TimedSample sensor is the index of the sensor in the list given.
+ *
+ * The sensors are registered with a report latency, so their hardware FIFO
+ * batches the events and the thread wakes up a few times per latency
+ * instead of once per event. Before API 26 they are only set to the rate.
+ * A sensor that can't be registered never sends events, and reports it
+ * through failed().
+ */
+class SensorCapture {
+ public:
+  SensorCapture(ASensorManager *manager, std::vector<const ASensor *> sensors,
+                SensorEventRing *ring);
+  ~SensorCapture();
+
+  void Start();
+  void Stop();
+
+  // True if the sensor, an index in the list given, couldn't be registered
+  // by the capture thread since the last Start().
+  bool failed(int32_t sensor) const {
+    return (failed_.load(std::memory_order_relaxed) >> sensor) & 1;
+  }
+
+ private:
+  void Run();
+
+  ASensorManager *manager_;
+  std::vector<const ASensor *> sensors_;
+  std::vector<int> types_;
+  SensorEventRing *ring_;
+
+  std::thread thread_;
+  std::atomic<bool> running_;
+  std::atomic<ALooper *> looper_;
+  std::atomic<uint32_t> failed_;  // one bit per sensor
+};
+
+#endif  // SENSORGRAPH_SENSOR_CAPTURE_H
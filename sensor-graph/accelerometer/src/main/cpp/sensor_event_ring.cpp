@@ -0,0 +1,58 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "sensor_event_ring.h"
+
+#include <algorithm>
+
+static uint32_t RoundUpToPowerOfTwo(uint32_t value) {
+  uint32_t power = 1;
+  while (power < value) {
+    power <<= 1;
+  }
+  return power;
+}
+
+SensorEventRing::SensorEventRing(uint32_t capacity)
+    : entries_(RoundUpToPowerOfTwo(capacity)),
+      mask_(static_cast<uint32_t>(entries_.size()) - 1),
+      head_(0),
+      tail_(0),
+      dropped_(0) {}
+
+bool SensorEventRing::Push(const TimedSample &sample) {
+  uint32_t head = head_.load(std::memory_order_relaxed);
+  uint32_t tail = tail_.load(std::memory_order_acquire);
+  if (head - tail > mask_) {
+    dropped_.fetch_add(1, std::memory_order_relaxed);
+    return false;
+  }
+  entries_[head & mask_] = sample;
+  head_.store(head + 1, std::memory_order_release);
+  return true;
+}
+
+int32_t SensorEventRing::Pop(TimedSample *out, int32_t maxCount) {
+  uint32_t tail = tail_.load(std::memory_order_relaxed);
+  uint32_t head = head_.load(std::memory_order_acquire);
+  int32_t count =
+      static_cast<int32_t>(std::min<uint32_t>(head - tail, maxCount));
+  for (int32_t i = 0; i < count; i++) {
+    out[i] = entries_[(tail + i) & mask_];
+  }
+  tail_.store(tail + count, std::memory_order_release);
+  return count;
+}
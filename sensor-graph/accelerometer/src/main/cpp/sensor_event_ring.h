@@ -0,0 +1,67 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SENSORGRAPH_SENSOR_EVENT_RING_H
+#define SENSORGRAPH_SENSOR_EVENT_RING_H
+
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+#include "sensor_filter.h"
+
+// A sensor event as it crossed the ring: which graphed sensor, when, what.
+struct TimedSample {
+  SensorSample value;
+  int64_t timestampNs;
+  int32_t sensor;
+};
+
+/*
+ * SensorEventRing
+ * Fixed-size queue of TimedSample from one producer thread to one consumer
+ * thread, with no lock: each side owns one index and publishes it with a
+ * release store once the entries it covers are written or read.
+ *
+ * A full ring drops the new samples and counts them, so the capture thread
+ * never waits on the renderer.
+ */
+class SensorEventRing {
+ public:
+  // capacity is rounded up to a power of two.
+  explicit SensorEventRing(uint32_t capacity);
+
+  // Producer side. Returns false if the ring is full.
+  bool Push(const TimedSample &sample);
+
+  // Consumer side. Moves at most maxCount samples, oldest first, to out and
+  // returns their number.
+  int32_t Pop(TimedSample *out, int32_t maxCount);
+
+  uint32_t capacity() const { return mask_ + 1; }
+  uint32_t dropped() const { return dropped_.load(std::memory_order_relaxed); }
+
+ private:
+  std::vector<TimedSample> entries_;
+  uint32_t mask_;
+  // Free-running: the entry of an index is index & mask_, and head_ - tail_
+  // is the number of entries in the ring.
+  alignas(64) std::atomic<uint32_t> head_;  // next to write, producer
+  alignas(64) std::atomic<uint32_t> tail_;  // next to read, consumer
+  std::atomic<uint32_t> dropped_;
+};
+
+#endif  // SENSORGRAPH_SENSOR_EVENT_RING_H
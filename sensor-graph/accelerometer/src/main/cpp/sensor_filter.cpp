@@ -0,0 +1,59 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "sensor_filter.h"
+
+#if defined(__ARM_NEON)
+#include <arm_neon.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+LowPassFilter::LowPassFilter(float alpha)
+    : alpha_(alpha), value_{0.f, 0.f, 0.f, 0.f} {}
+
+void LowPassFilter::Apply(const SensorSample *samples, int32_t count) {
+  // value = a * sample + (1 - a) * value, kept as two products and a sum
+  // so the vector paths round like the scalar one.
+#if defined(__ARM_NEON)
+  const float32x4_t a = vdupq_n_f32(alpha_);
+  const float32x4_t b = vdupq_n_f32(1.0f - alpha_);
+  float32x4_t value = vld1q_f32(&value_.x);
+  for (int32_t i = 0; i < count; i++) {
+    value = vaddq_f32(vmulq_f32(a, vld1q_f32(&samples[i].x)),
+                      vmulq_f32(b, value));
+  }
+  vst1q_f32(&value_.x, value);
+#elif defined(__SSE2__)
+  const __m128 a = _mm_set1_ps(alpha_);
+  const __m128 b = _mm_set1_ps(1.0f - alpha_);
+  __m128 value = _mm_load_ps(&value_.x);
+  for (int32_t i = 0; i < count; i++) {
+    value = _mm_add_ps(_mm_mul_ps(a, _mm_load_ps(&samples[i].x)),
+                       _mm_mul_ps(b, value));
+  }
+  _mm_store_ps(&value_.x, value);
+#else
+  const float a = alpha_;
+  const float b = 1.0f - alpha_;
+  for (int32_t i = 0; i < count; i++) {
+    value_.x = a * samples[i].x + b * value_.x;
+    value_.y = a * samples[i].y + b * value_.y;
+    value_.z = a * samples[i].z + b * value_.z;
+    value_.w = a * samples[i].w + b * value_.w;
+  }
+#endif
+}
@@ -0,0 +1,51 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SENSORGRAPH_SENSOR_FILTER_H
+#define SENSORGRAPH_SENSOR_FILTER_H
+
+#include <cstdint>
+
+// A three-axis sensor value, padded to a 16-byte vector.
+struct alignas(16) SensorSample {
+  float x;
+  float y;
+  float z;
+  float w;
+};
+
+/*
+ * LowPassFilter
+ * Exponential smoothing of a three-axis sensor: each sample moves the value
+ * alpha of the way towards it. A batch of samples goes through in order,
+ * with all the axes updated in one vector operation per sample.
+ */
+class LowPassFilter {
+ public:
+  explicit LowPassFilter(float alpha);
+
+  // Filter the samples, oldest first.
+  void Apply(const SensorSample *samples, int32_t count);
+
+  void Reset(const SensorSample &value) { value_ = value; }
+  const SensorSample &value() const { return value_; }
+
+ private:
+  float alpha_;
+  SensorSample value_;
+};
+
+#endif  // SENSORGRAPH_SENSOR_FILTER_H
@@ -0,0 +1,103 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "sensor_resampler.h"
+
+#include <algorithm>
+#include <cmath>
+
+// Below this sum of weights, less than about half of the kernel has inputs
+// under it, and the output is held instead of averaged. The kernel covered
+// end to end weighs 1.
+static const float kMinWeight = 0.5f;
+
+static float Sinc(float x) {
+  if (x == 0.0f) {
+    return 1.0f;
+  }
+  float px = static_cast<float>(M_PI) * x;
+  return std::sin(px) / px;
+}
+
+// Lanczos-2 kernel, x in output periods.
+static float Lanczos2(float x) {
+  return std::fabs(x) < 2.0f ? Sinc(x) * Sinc(x / 2.0f) : 0.0f;
+}
+
+SensorResampler::SensorResampler(int64_t outputPeriodNs, int32_t capacity)
+    : periodNs_(outputPeriodNs), inputs_(capacity), first_(0), count_(0) {}
+
+void SensorResampler::Add(int64_t timestampNs, const SensorSample &sample) {
+  if (count_ > 0 && timestampNs <= at(count_ - 1).timestampNs) {
+    return;
+  }
+  if (count_ == static_cast<int32_t>(inputs_.size())) {
+    first_ = (first_ + 1) % inputs_.size();
+    count_--;
+  }
+  inputs_[(first_ + count_) % inputs_.size()] = {sample, timestampNs};
+  count_++;
+}
+
+int64_t SensorResampler::readyUntil() const {
+  return at(count_ - 1).timestampNs - halfWidthNs();
+}
+
+int64_t SensorResampler::coveredNs(int32_t i) const {
+  // Half of the time to each neighbour, at most one output period each way,
+  // so an input alone across a gap doesn't stand for all of it.
+  int64_t before = i > 0 ? at(i).timestampNs - at(i - 1).timestampNs : 0;
+  int64_t after =
+      i + 1 < count_ ? at(i + 1).timestampNs - at(i).timestampNs : 0;
+  if (!before) before = after ? after : periodNs_;
+  if (!after) after = before;
+  return std::min(before / 2, periodNs_) + std::min(after / 2, periodNs_);
+}
+
+SensorSample SensorResampler::Sample(int64_t timeNs) {
+  // Keep the last input before the window, to hold if nothing is in it.
+  int64_t windowStart = timeNs - halfWidthNs();
+  while (count_ > 1 && at(1).timestampNs <= windowStart) {
+    first_ = (first_ + 1) % inputs_.size();
+    count_--;
+  }
+
+  // Each input is weighted by the kernel and by the time it covers: uneven
+  // timestamps then sum like even ones, and only leak a little of the
+  // frequencies the kernel stops.
+  float x = 0.f, y = 0.f, z = 0.f, weight = 0.f;
+  const Input *held = &at(0);
+  for (int32_t i = 0; i < count_; i++) {
+    const Input &input = at(i);
+    int64_t offsetNs = input.timestampNs - timeNs;
+    if (offsetNs >= halfWidthNs()) {
+      break;
+    }
+    if (offsetNs <= 0) {
+      held = &input;
+    }
+    float w = Lanczos2(static_cast<float>(offsetNs) / periodNs_) *
+              static_cast<float>(coveredNs(i)) / periodNs_;
+    x += w * input.value.x;
+    y += w * input.value.y;
+    z += w * input.value.z;
+    weight += w;
+  }
+  if (weight < kMinWeight) {
+    return held->value;
+  }
+  return {x / weight, y / weight, z / weight, 0.f};
+}
@@ -0,0 +1,78 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SENSORGRAPH_SENSOR_RESAMPLER_H
+#define SENSORGRAPH_SENSOR_RESAMPLER_H
+
+#include <cstdint>
+#include <vector>
+
+#include "sensor_filter.h"
+
+/*
+ * SensorResampler
+ * Turns one sensor's events, at their own rate and timestamps, into values
+ * on an output grid of a given period, such as the display's frames.
+ *
+ * Each output is a Lanczos-2 weighted average of the inputs within two
+ * output periods of it: the kernel is a low-pass filter at the output's
+ * Nyquist frequency, so faster motion is attenuated instead of aliased.
+ * Inputs are also weighted by the time they cover, and the weights are
+ * normalized by their sum, which accounts for uneven timestamps and for
+ * any input rate.
+ */
+class SensorResampler {
+ public:
+  // capacity is the number of inputs kept; past it the oldest are dropped.
+  explicit SensorResampler(int64_t outputPeriodNs, int32_t capacity = 512);
+
+  // Add an input. Inputs not newer than the previous one are ignored.
+  void Add(int64_t timestampNs, const SensorSample &sample);
+
+  bool empty() const { return count_ == 0; }
+
+  // Latest output time with all of its inputs in: one half kernel width
+  // before the newest input. Only valid if !empty().
+  int64_t readyUntil() const;
+
+  int64_t halfWidthNs() const { return 2 * periodNs_; }
+
+  /*
+   * The value at timeNs. Outputs must be asked for in increasing time, as
+   * the inputs they no longer need are forgotten. Where the inputs are too
+   * sparse to weigh, the input closest before timeNs is held. Only valid if
+   * !empty().
+   */
+  SensorSample Sample(int64_t timeNs);
+
+ private:
+  struct Input {
+    SensorSample value;
+    int64_t timestampNs;
+  };
+  const Input &at(int32_t i) const {
+    return inputs_[(first_ + i) % inputs_.size()];
+  }
+  // Time around input i it stands for, in the weighted average.
+  int64_t coveredNs(int32_t i) const;
+
+  int64_t periodNs_;
+  std::vector<Input> inputs_;
+  int32_t first_;
+  int32_t count_;
+};
+
+#endif  // SENSORGRAPH_SENSOR_RESAMPLER_H
@@ -22,9 +22,18 @@
 #include <dlfcn.h>
 #include <jni.h>
 
+#include <algorithm>
 #include <cassert>
 #include <cstdint>
+#include <memory>
 #include <string>
+#include <vector>
+
+#include "history_ring.h"
+#include "sensor_capture.h"
+#include "sensor_event_ring.h"
+#include "sensor_filter.h"
+#include "sensor_resampler.h"
 
 #define LOG_TAG "accelerometergraph"
 #define LOGI(...) __android_log_print(ANDROID_LOG_INFO, LOG_TAG, __VA_ARGS__)
@@ -35,6 +44,41 @@ const int SENSOR_REFRESH_RATE_HZ = 100;
 constexpr int32_t SENSOR_REFRESH_PERIOD_US =
     int32_t(1000000 / SENSOR_REFRESH_RATE_HZ);
 const float SENSOR_FILTER_ALPHA = 0.1f;
+// Events drained from the queue per ASensorEventQueue_getEvents() call.
+const int SENSOR_EVENT_BATCH = 32;
+const int SENSOR_AXES = 3;
+// In high-rate mode, the history is resampled to a grid at the display rate,
+// from events the capture thread hands over through a ring of this size.
+const int DISPLAY_RATE_HZ = 60;
+constexpr int64_t DISPLAY_PERIOD_NS = int64_t(1000000000 / DISPLAY_RATE_HZ);
+const uint32_t CAPTURE_RING_CAPACITY = 4096;
+
+/*
+ * The sensors the graph can show, each one in its own horizontal lane.
+ * The accelerometer is always shown; the others are added when the activity
+ * asks for all the sensors.
+ */
+struct SensorTrack {
+  int type;
+  const char *name;
+  float range;  // value drawn at the edge of the lane
+  GLfloat colors[SENSOR_AXES][3];
+};
+const SensorTrack SENSOR_TRACKS[] = {
+    {ASENSOR_TYPE_ACCELEROMETER,
+     "accelerometer",
+     ASENSOR_STANDARD_GRAVITY,
+     {{1.0f, 1.0f, 0.0f}, {1.0f, 0.0f, 1.0f}, {0.0f, 1.0f, 1.0f}}},
+    {ASENSOR_TYPE_GYROSCOPE,
+     "gyroscope",
+     2.0f * 3.14159265f,
+     {{1.0f, 0.3f, 0.3f}, {0.3f, 1.0f, 0.3f}, {0.3f, 0.3f, 1.0f}}},
+    {ASENSOR_TYPE_MAGNETIC_FIELD,
+     "magnetometer",
+     ASENSOR_MAGNETIC_FIELD_EARTH_MAX,
+     {{1.0f, 0.6f, 0.2f}, {0.6f, 1.0f, 0.8f}, {0.8f, 0.6f, 1.0f}}},
+};
+const int SENSOR_TRACK_COUNT = sizeof(SENSOR_TRACKS) / sizeof(SENSOR_TRACKS[0]);
 
 /*
  * AcquireASensorManagerInstance(void)
@@ -65,29 +109,48 @@ class sensorgraph {
   std::string vertexShaderSource;
   std::string fragmentShaderSource;
   ASensorManager *sensorManager;
-  const ASensor *accelerometer;
-  ASensorEventQueue *accelerometerEventQueue;
+  ASensorEventQueue *sensorEventQueue;
   ALooper *looper;
 
+  struct GraphedSensor {
+    const SensorTrack *track;
+    const ASensor *sensor;
+    LowPassFilter filter;
+    SensorResampler resampler;
+  };
+  std::vector<GraphedSensor> sensors;
+
+  // High-rate mode only.
+  std::unique_ptr<SensorEventRing> captureRing;
+  std::unique_ptr<SensorCapture> capture;
+  int64_t nextOutputNs;
+
   GLuint shaderProgram;
   GLuint vPositionHandle;
   GLuint vSensorValueHandle;
   GLuint uFragColorHandle;
+  GLuint uSensorScaleHandle;
+  GLuint uSensorOffsetHandle;
   GLfloat xPos[SENSOR_HISTORY_LENGTH];
+  GLuint xPosBuffer;
 
-  struct AccelerometerData {
-    GLfloat x;
-    GLfloat y;
-    GLfloat z;
-  };
-  AccelerometerData sensorData[SENSOR_HISTORY_LENGTH * 2];
-  AccelerometerData sensorDataFilter;
-  int sensorDataIndex;
+  // The filtered values of every sensor, SENSOR_AXES floats each, for each
+  // slot of the ring. historyBuffer holds the same on the GPU; the copy
+  // here refills it when the GL context is recreated.
+  HistoryRing historyRing;
+  int historyChannels;
+  std::vector<GLfloat> history;
+  GLuint historyBuffer;
 
  public:
-  sensorgraph() : sensorDataIndex(0) {}
-
-  void init(AAssetManager *assetManager) {
+  sensorgraph()
+      : nextOutputNs(0),
+        xPosBuffer(0),
+        historyRing(SENSOR_HISTORY_LENGTH),
+        historyChannels(0),
+        historyBuffer(0) {}
+
+  void init(AAssetManager *assetManager, bool allSensors, bool highRate) {
     AAsset *vertexShaderAsset =
         AAssetManager_open(assetManager, "shader.glslv", AASSET_MODE_BUFFER);
     assert(vertexShaderAsset != NULL);
@@ -110,22 +173,39 @@ class sensorgraph {
 
     sensorManager = AcquireASensorManagerInstance();
     assert(sensorManager != NULL);
-    accelerometer = ASensorManager_getDefaultSensor(sensorManager,
-                                                    ASENSOR_TYPE_ACCELEROMETER);
-    assert(accelerometer != NULL);
-    looper = ALooper_prepare(ALOOPER_PREPARE_ALLOW_NON_CALLBACKS);
-    assert(looper != NULL);
-    accelerometerEventQueue = ASensorManager_createEventQueue(
-        sensorManager, looper, LOOPER_ID_USER, NULL, NULL);
-    assert(accelerometerEventQueue != NULL);
-    auto status =
-        ASensorEventQueue_enableSensor(accelerometerEventQueue, accelerometer);
-    assert(status >= 0);
-    status = ASensorEventQueue_setEventRate(
-        accelerometerEventQueue, accelerometer, SENSOR_REFRESH_PERIOD_US);
-    assert(status >= 0);
-    (void)status;  // to silent unused compiler warning
+    for (int i = 0; i < (allSensors ? SENSOR_TRACK_COUNT : 1); i++) {
+      const ASensor *sensor =
+          ASensorManager_getDefaultSensor(sensorManager, SENSOR_TRACKS[i].type);
+      if (sensor == NULL) {
+        LOGI("No %s, not graphed", SENSOR_TRACKS[i].name);
+        continue;
+      }
+      sensors.push_back({&SENSOR_TRACKS[i], sensor,
+                         LowPassFilter(SENSOR_FILTER_ALPHA),
+                         SensorResampler(DISPLAY_PERIOD_NS)});
+    }
+    assert(!sensors.empty() &&
+           sensors[0].track->type == ASENSOR_TYPE_ACCELEROMETER);
+    if (highRate) {
+      std::vector<const ASensor *> captured;
+      for (auto &graphed : sensors) {
+        captured.push_back(graphed.sensor);
+      }
+      captureRing.reset(new SensorEventRing(CAPTURE_RING_CAPACITY));
+      capture.reset(
+          new SensorCapture(sensorManager, captured, captureRing.get()));
+      capture->Start();
+    } else {
+      looper = ALooper_prepare(ALOOPER_PREPARE_ALLOW_NON_CALLBACKS);
+      assert(looper != NULL);
+      sensorEventQueue = ASensorManager_createEventQueue(
+          sensorManager, looper, LOOPER_ID_USER, NULL, NULL);
+      assert(sensorEventQueue != NULL);
+      enableSensors();
+    }
 
+    historyChannels = SENSOR_AXES * static_cast<int>(sensors.size());
+    history.assign(historyRing.slots() * historyChannels, 0.f);
     generateXPos();
   }
 
@@ -149,6 +229,25 @@ class sensorgraph {
         glGetUniformLocation(shaderProgram, "uFragColor");
     assert(getFragColorLocationResult != -1);
     uFragColorHandle = (GLuint)getFragColorLocationResult;
+    GLint getSensorScaleLocationResult =
+        glGetUniformLocation(shaderProgram, "uSensorScale");
+    assert(getSensorScaleLocationResult != -1);
+    uSensorScaleHandle = (GLuint)getSensorScaleLocationResult;
+    GLint getSensorOffsetLocationResult =
+        glGetUniformLocation(shaderProgram, "uSensorOffset");
+    assert(getSensorOffsetLocationResult != -1);
+    uSensorOffsetHandle = (GLuint)getSensorOffsetLocationResult;
+
+    // The context is new, and so are the buffers: the old names went with
+    // the previous one.
+    glGenBuffers(1, &xPosBuffer);
+    glBindBuffer(GL_ARRAY_BUFFER, xPosBuffer);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(xPos), xPos, GL_STATIC_DRAW);
+    glGenBuffers(1, &historyBuffer);
+    glBindBuffer(GL_ARRAY_BUFFER, historyBuffer);
+    glBufferData(GL_ARRAY_BUFFER, history.size() * sizeof(GLfloat),
+                 history.data(), GL_DYNAMIC_DRAW);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
   }
 
   void surfaceChanged(int w, int h) { glViewport(0, 0, w, h); }
@@ -191,21 +290,119 @@ class sensorgraph {
   }
 
   void update() {
+    if (capture) {
+      updateCaptured();
+    } else {
+      updateFiltered();
+    }
+  }
+
+  // Low-rate mode: the history gets the filtered value of each frame.
+  void updateFiltered() {
     ALooper_pollOnce(0, NULL, NULL, NULL);
-    ASensorEvent event;
-    float a = SENSOR_FILTER_ALPHA;
-    while (ASensorEventQueue_getEvents(accelerometerEventQueue, &event, 1) >
+    ASensorEvent events[SENSOR_EVENT_BATCH];
+    SensorSample samples[SENSOR_EVENT_BATCH];
+    ssize_t eventCount;
+    while ((eventCount = ASensorEventQueue_getEvents(
+                sensorEventQueue, events, SENSOR_EVENT_BATCH)) > 0) {
+      // The sensors share the queue: sort each one's events out of the
+      // batch and filter them in one go.
+      for (auto &graphed : sensors) {
+        int32_t sampleCount = 0;
+        for (ssize_t i = 0; i < eventCount; i++) {
+          if (events[i].type == graphed.track->type) {
+            samples[sampleCount++] = {events[i].data[0], events[i].data[1],
+                                      events[i].data[2], 0.f};
+          }
+        }
+        graphed.filter.Apply(samples, sampleCount);
+      }
+    }
+
+    GLfloat latest[SENSOR_AXES * SENSOR_TRACK_COUNT];
+    for (size_t i = 0; i < sensors.size(); i++) {
+      const SensorSample &value = sensors[i].filter.value();
+      latest[SENSOR_AXES * i + 0] = value.x;
+      latest[SENSOR_AXES * i + 1] = value.y;
+      latest[SENSOR_AXES * i + 2] = value.z;
+    }
+    pushHistory(latest, 1);
+  }
+
+  // High-rate mode: the history gets every point of the display-rate grid
+  // that all the sensors have the events for.
+  void updateCaptured() {
+    TimedSample captured[SENSOR_EVENT_BATCH];
+    int32_t capturedCount;
+    while ((capturedCount = captureRing->Pop(captured, SENSOR_EVENT_BATCH)) >
            0) {
-      sensorDataFilter.x =
-          a * event.acceleration.x + (1.0f - a) * sensorDataFilter.x;
-      sensorDataFilter.y =
-          a * event.acceleration.y + (1.0f - a) * sensorDataFilter.y;
-      sensorDataFilter.z =
-          a * event.acceleration.z + (1.0f - a) * sensorDataFilter.z;
+      for (int32_t i = 0; i < capturedCount; i++) {
+        sensors[captured[i].sensor].resampler.Add(captured[i].timestampNs,
+                                                  captured[i].value);
+      }
+    }
+
+    // A sensor the capture couldn't register never gets events: it is left
+    // out, and its lane stays flat.
+    int64_t readyUntil = INT64_MAX;
+    for (size_t i = 0; i < sensors.size(); i++) {
+      if (capture->failed(static_cast<int32_t>(i))) {
+        continue;
+      }
+      if (sensors[i].resampler.empty()) {
+        return;
+      }
+      readyUntil = std::min(readyUntil, sensors[i].resampler.readyUntil());
+    }
+    if (readyUntil == INT64_MAX) {
+      return;
+    }
+    // Start over from the present after a pause, or the first time.
+    // Either way, at most SENSOR_HISTORY_LENGTH points are due.
+    if (readyUntil - nextOutputNs >=
+        (SENSOR_HISTORY_LENGTH - 1) * DISPLAY_PERIOD_NS) {
+      nextOutputNs = readyUntil - readyUntil % DISPLAY_PERIOD_NS;
+    }
+
+    GLfloat rows[SENSOR_HISTORY_LENGTH * SENSOR_AXES * SENSOR_TRACK_COUNT];
+    int32_t rowCount = 0;
+    for (; nextOutputNs <= readyUntil; nextOutputNs += DISPLAY_PERIOD_NS) {
+      GLfloat *row = &rows[rowCount++ * historyChannels];
+      for (size_t i = 0; i < sensors.size(); i++) {
+        SensorSample value = {0.f, 0.f, 0.f, 0.f};
+        if (!capture->failed(static_cast<int32_t>(i))) {
+          value = sensors[i].resampler.Sample(nextOutputNs);
+        }
+        row[SENSOR_AXES * i + 0] = value.x;
+        row[SENSOR_AXES * i + 1] = value.y;
+        row[SENSOR_AXES * i + 2] = value.z;
+      }
+    }
+    pushHistory(rows, rowCount);
+  }
+
+  // Append count samples of historyChannels values each to the history,
+  // and write the slots they land in through to historyBuffer.
+  void pushHistory(const GLfloat *samples, int32_t count) {
+    HistoryRing::Span spans[HistoryRing::kMaxSpans];
+    int32_t spanCount = historyRing.Push(count, spans);
+    if (historyBuffer) {
+      glBindBuffer(GL_ARRAY_BUFFER, historyBuffer);
+    }
+    for (int32_t i = 0; i < spanCount; i++) {
+      size_t offset = static_cast<size_t>(spans[i].slot) * historyChannels;
+      size_t length = static_cast<size_t>(spans[i].count) * historyChannels;
+      std::copy(samples + spans[i].sample * historyChannels,
+                samples + spans[i].sample * historyChannels + length,
+                history.begin() + offset);
+      if (historyBuffer) {
+        glBufferSubData(GL_ARRAY_BUFFER, offset * sizeof(GLfloat),
+                        length * sizeof(GLfloat), &history[offset]);
+      }
+    }
+    if (historyBuffer) {
+      glBindBuffer(GL_ARRAY_BUFFER, 0);
     }
-    sensorData[sensorDataIndex] = sensorDataFilter;
-    sensorData[SENSOR_HISTORY_LENGTH + sensorDataIndex] = sensorDataFilter;
-    sensorDataIndex = (sensorDataIndex + 1) % SENSOR_HISTORY_LENGTH;
   }
 
   void render() {
@@ -215,38 +412,59 @@ class sensorgraph {
     glUseProgram(shaderProgram);
 
     glEnableVertexAttribArray(vPositionHandle);
-    glVertexAttribPointer(vPositionHandle, 1, GL_FLOAT, GL_FALSE, 0, xPos);
+    glBindBuffer(GL_ARRAY_BUFFER, xPosBuffer);
+    glVertexAttribPointer(vPositionHandle, 1, GL_FLOAT, GL_FALSE, 0, 0);
 
+    // Every axis of every sensor is a line strip through the same slots of
+    // historyBuffer, starting at the oldest sample.
     glEnableVertexAttribArray(vSensorValueHandle);
-    glVertexAttribPointer(vSensorValueHandle, 1, GL_FLOAT, GL_FALSE,
-                          sizeof(AccelerometerData),
-                          &sensorData[sensorDataIndex].x);
-
-    glUniform4f(uFragColorHandle, 1.0f, 1.0f, 0.0f, 1.0f);
-    glDrawArrays(GL_LINE_STRIP, 0, SENSOR_HISTORY_LENGTH);
-
-    glVertexAttribPointer(vSensorValueHandle, 1, GL_FLOAT, GL_FALSE,
-                          sizeof(AccelerometerData),
-                          &sensorData[sensorDataIndex].y);
-    glUniform4f(uFragColorHandle, 1.0f, 0.0f, 1.0f, 1.0f);
-    glDrawArrays(GL_LINE_STRIP, 0, SENSOR_HISTORY_LENGTH);
-
-    glVertexAttribPointer(vSensorValueHandle, 1, GL_FLOAT, GL_FALSE,
-                          sizeof(AccelerometerData),
-                          &sensorData[sensorDataIndex].z);
-    glUniform4f(uFragColorHandle, 0.0f, 1.0f, 1.0f, 1.0f);
-    glDrawArrays(GL_LINE_STRIP, 0, SENSOR_HISTORY_LENGTH);
+    glBindBuffer(GL_ARRAY_BUFFER, historyBuffer);
+    GLsizei stride = historyChannels * sizeof(GLfloat);
+    float laneHeight = 2.0f / sensors.size();
+    for (size_t i = 0; i < sensors.size(); i++) {
+      const SensorTrack *track = sensors[i].track;
+      glUniform1f(uSensorScaleHandle, 0.5f * laneHeight / track->range);
+      glUniform1f(uSensorOffsetHandle, 1.0f - laneHeight * (i + 0.5f));
+      for (int axis = 0; axis < SENSOR_AXES; axis++) {
+        size_t channel = historyRing.first() * historyChannels +
+                         SENSOR_AXES * i + axis;
+        glVertexAttribPointer(
+            vSensorValueHandle, 1, GL_FLOAT, GL_FALSE, stride,
+            reinterpret_cast<const void *>(channel * sizeof(GLfloat)));
+        glUniform4f(uFragColorHandle, track->colors[axis][0],
+                    track->colors[axis][1], track->colors[axis][2], 1.0f);
+        glDrawArrays(GL_LINE_STRIP, 0, SENSOR_HISTORY_LENGTH);
+      }
+    }
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+  }
+
+  void enableSensors() {
+    for (auto &graphed : sensors) {
+      ASensorEventQueue_enableSensor(sensorEventQueue, graphed.sensor);
+      auto status = ASensorEventQueue_setEventRate(
+          sensorEventQueue, graphed.sensor, SENSOR_REFRESH_PERIOD_US);
+      assert(status >= 0);
+      (void)status;  // to silent unused compiler warning
+    }
   }
 
   void pause() {
-    ASensorEventQueue_disableSensor(accelerometerEventQueue, accelerometer);
+    if (capture) {
+      capture->Stop();
+      return;
+    }
+    for (auto &graphed : sensors) {
+      ASensorEventQueue_disableSensor(sensorEventQueue, graphed.sensor);
+    }
   }
 
   void resume() {
-    ASensorEventQueue_enableSensor(accelerometerEventQueue, accelerometer);
-    auto status = ASensorEventQueue_setEventRate(
-        accelerometerEventQueue, accelerometer, SENSOR_REFRESH_PERIOD_US);
-    assert(status >= 0);
+    if (capture) {
+      capture->Start();
+      return;
+    }
+    enableSensors();
   }
 };
 
@@ -255,10 +473,11 @@ sensorgraph gSensorGraph;
 extern "C" {
 JNIEXPORT void JNICALL
 Java_com_android_accelerometergraph_AccelerometerGraphJNI_init(
-    JNIEnv *env, jclass type, jobject assetManager) {
+    JNIEnv *env, jclass type, jobject assetManager, jboolean allSensors,
+    jboolean highRate) {
   (void)type;
   AAssetManager *nativeAssetManager = AAssetManager_fromJava(env, assetManager);
-  gSensorGraph.init(nativeAssetManager);
+  gSensorGraph.init(nativeAssetManager, allSensors, highRate);
 }
 
 JNIEXPORT void JNICALL
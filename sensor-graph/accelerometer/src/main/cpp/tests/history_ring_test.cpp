@@ -0,0 +1,101 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "history_ring.h"
+
+#include <gtest/gtest.h>
+
+#include <deque>
+#include <random>
+#include <vector>
+
+namespace {
+
+// A buffer kept up to date from the spans of each push, next to the whole
+// history it should show.
+class HistoryRingTest : public testing::TestWithParam<int32_t> {
+ protected:
+  HistoryRingTest()
+      : ring_(GetParam()),
+        buffer_(ring_.slots(), 0),
+        history_(GetParam(), 0),
+        next_(1) {}
+
+  void Push(int32_t count) {
+    std::vector<int32_t> samples;
+    for (int32_t i = 0; i < count; i++) {
+      samples.push_back(next_);
+      history_.push_back(next_++);
+    }
+    HistoryRing::Span spans[HistoryRing::kMaxSpans];
+    int32_t spanCount = ring_.Push(count, spans);
+    ASSERT_LE(spanCount, HistoryRing::kMaxSpans);
+    for (int32_t i = 0; i < spanCount; i++) {
+      const HistoryRing::Span &span = spans[i];
+      ASSERT_GE(span.slot, 0);
+      ASSERT_LE(span.slot + span.count, ring_.slots());
+      ASSERT_GE(span.sample, 0);
+      ASSERT_LE(span.sample + span.count, count);
+      for (int32_t j = 0; j < span.count; j++) {
+        buffer_[span.slot + j] = samples[span.sample + j];
+      }
+    }
+  }
+
+  // The latest capacity samples, oldest first, from first().
+  void ExpectHistory() {
+    int32_t capacity = ring_.capacity();
+    ASSERT_GE(ring_.first(), 0);
+    ASSERT_LT(ring_.first(), capacity);
+    std::vector<int32_t> drawn(buffer_.begin() + ring_.first(),
+                               buffer_.begin() + ring_.first() + capacity);
+    std::vector<int32_t> expected(history_.end() - capacity, history_.end());
+    EXPECT_EQ(drawn, expected);
+  }
+
+  HistoryRing ring_;
+  std::vector<int32_t> buffer_;
+  std::deque<int32_t> history_;
+  int32_t next_;
+};
+
+TEST_P(HistoryRingTest, KeepsTheLatestSamplesConsecutive) {
+  for (int32_t i = 0; i < 3 * GetParam(); i++) {
+    Push(1);
+    ExpectHistory();
+  }
+}
+
+TEST_P(HistoryRingTest, TakesBatchesOfAnySize) {
+  std::mt19937 random(GetParam());
+  std::uniform_int_distribution<int32_t> count(0, 5 * GetParam() / 2);
+  for (int32_t i = 0; i < 200; i++) {
+    Push(count(random));
+    ExpectHistory();
+  }
+}
+
+TEST_P(HistoryRingTest, WritesNothingForEmptyPushes) {
+  HistoryRing::Span spans[HistoryRing::kMaxSpans];
+  EXPECT_EQ(ring_.Push(0, spans), 0);
+  EXPECT_EQ(ring_.Push(-1, spans), 0);
+  EXPECT_EQ(ring_.first(), 0);
+}
+
+INSTANTIATE_TEST_SUITE_P(Capacities, HistoryRingTest,
+                         testing::Values(1, 2, 7, 100));
+
+}  // namespace
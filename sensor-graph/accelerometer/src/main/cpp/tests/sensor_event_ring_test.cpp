@@ -0,0 +1,98 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "sensor_event_ring.h"
+
+#include <gtest/gtest.h>
+
+#include <thread>
+#include <vector>
+
+namespace {
+
+TimedSample Sample(int32_t n) {
+  return {{float(n), 0.f, 0.f, 0.f}, int64_t(n) * 2500000, n % 3};
+}
+
+TEST(SensorEventRingTest, RoundsTheCapacityUpToAPowerOfTwo) {
+  EXPECT_EQ(SensorEventRing(1).capacity(), 1u);
+  EXPECT_EQ(SensorEventRing(5).capacity(), 8u);
+  EXPECT_EQ(SensorEventRing(4096).capacity(), 4096u);
+}
+
+TEST(SensorEventRingTest, PopsInOrder) {
+  SensorEventRing ring(8);
+  TimedSample out[8];
+  EXPECT_EQ(ring.Pop(out, 8), 0);
+  for (int32_t round = 0; round < 10; round++) {
+    for (int32_t i = 0; i < 5; i++) {
+      ASSERT_TRUE(ring.Push(Sample(round * 5 + i)));
+    }
+    ASSERT_EQ(ring.Pop(out, 3), 3);
+    ASSERT_EQ(ring.Pop(out + 3, 8), 2);
+    for (int32_t i = 0; i < 5; i++) {
+      EXPECT_EQ(out[i].timestampNs, Sample(round * 5 + i).timestampNs);
+      EXPECT_EQ(out[i].sensor, Sample(round * 5 + i).sensor);
+      EXPECT_EQ(out[i].value.x, Sample(round * 5 + i).value.x);
+    }
+  }
+  EXPECT_EQ(ring.dropped(), 0u);
+}
+
+TEST(SensorEventRingTest, DropsAndCountsWhenFull) {
+  SensorEventRing ring(4);
+  for (int32_t i = 0; i < 4; i++) ASSERT_TRUE(ring.Push(Sample(i)));
+  EXPECT_FALSE(ring.Push(Sample(4)));
+  EXPECT_FALSE(ring.Push(Sample(5)));
+  EXPECT_EQ(ring.dropped(), 2u);
+
+  TimedSample out[4];
+  ASSERT_EQ(ring.Pop(out, 1), 1);
+  EXPECT_EQ(out[0].timestampNs, Sample(0).timestampNs);
+  EXPECT_TRUE(ring.Push(Sample(6)));
+  ASSERT_EQ(ring.Pop(out, 4), 4);
+  EXPECT_EQ(out[3].timestampNs, Sample(6).timestampNs);
+}
+
+// The capture thread pushes while the renderer pops, as in the sample.
+TEST(SensorEventRingTest, HandsOverEverySampleBetweenThreads) {
+  const int32_t kSamples = 20000;
+  SensorEventRing ring(64);
+  std::thread producer([&ring]() {
+    for (int32_t i = 0; i < kSamples;) {
+      if (ring.Push(Sample(i))) {
+        i++;
+      } else {
+        std::this_thread::yield();  // full, let the consumer run
+      }
+    }
+  });
+  std::vector<int64_t> timestamps;
+  TimedSample out[32];
+  while (timestamps.size() < kSamples) {
+    int32_t count = ring.Pop(out, 32);
+    if (count == 0) std::this_thread::yield();
+    for (int32_t i = 0; i < count; i++) {
+      timestamps.push_back(out[i].timestampNs);
+    }
+  }
+  producer.join();
+  for (int32_t i = 0; i < kSamples; i++) {
+    ASSERT_EQ(timestamps[i], Sample(i).timestampNs);
+  }
+}
+
+}  // namespace
@@ -0,0 +1,89 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "sensor_filter.h"
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <random>
+#include <vector>
+
+namespace {
+
+std::vector<SensorSample> RandomSamples(int32_t count) {
+  std::mt19937 random(count);
+  std::uniform_real_distribution<float> value(-20.f, 20.f);
+  std::vector<SensorSample> samples(count);
+  for (SensorSample &sample : samples) {
+    sample = {value(random), value(random), value(random), 0.f};
+  }
+  return samples;
+}
+
+TEST(LowPassFilterTest, SmoothesLikeTheScalarFormula) {
+  const float kAlpha = 0.1f;
+  std::vector<SensorSample> samples = RandomSamples(1000);
+  LowPassFilter filter(kAlpha);
+  filter.Apply(samples.data(), static_cast<int32_t>(samples.size()));
+
+  float x = 0.f, y = 0.f, z = 0.f;
+  for (const SensorSample &sample : samples) {
+    x = kAlpha * sample.x + (1.0f - kAlpha) * x;
+    y = kAlpha * sample.y + (1.0f - kAlpha) * y;
+    z = kAlpha * sample.z + (1.0f - kAlpha) * z;
+  }
+  EXPECT_FLOAT_EQ(filter.value().x, x);
+  EXPECT_FLOAT_EQ(filter.value().y, y);
+  EXPECT_FLOAT_EQ(filter.value().z, z);
+}
+
+// Draining the queue in batches must not change the graph.
+TEST(LowPassFilterTest, GivesTheSameValueInBatchesAndOneByOne) {
+  std::vector<SensorSample> samples = RandomSamples(517);
+  LowPassFilter batched(0.1f), single(0.1f);
+  for (size_t i = 0; i < samples.size(); i += 32) {
+    int32_t count = static_cast<int32_t>(
+        std::min<size_t>(32, samples.size() - i));
+    batched.Apply(&samples[i], count);
+  }
+  for (const SensorSample &sample : samples) {
+    single.Apply(&sample, 1);
+  }
+  EXPECT_EQ(batched.value().x, single.value().x);
+  EXPECT_EQ(batched.value().y, single.value().y);
+  EXPECT_EQ(batched.value().z, single.value().z);
+}
+
+TEST(LowPassFilterTest, SettlesOnAConstantInput) {
+  std::vector<SensorSample> samples(500, {9.81f, -1.f, 0.5f, 0.f});
+  LowPassFilter filter(0.1f);
+  filter.Apply(samples.data(), static_cast<int32_t>(samples.size()));
+  EXPECT_NEAR(filter.value().x, 9.81f, 1e-4f);
+  EXPECT_NEAR(filter.value().y, -1.f, 1e-4f);
+  EXPECT_NEAR(filter.value().z, 0.5f, 1e-4f);
+}
+
+TEST(LowPassFilterTest, KeepsItsValueWithoutSamples) {
+  LowPassFilter filter(0.5f);
+  filter.Reset({1.f, 2.f, 3.f, 0.f});
+  filter.Apply(nullptr, 0);
+  EXPECT_EQ(filter.value().x, 1.f);
+  EXPECT_EQ(filter.value().y, 2.f);
+  EXPECT_EQ(filter.value().z, 3.f);
+}
+
+}  // namespace
@@ -0,0 +1,127 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * The per-frame work of the graph without the sensors and GL: filtering the
+ * events of a frame in a batch or one call at a time, and adding a frame to
+ * the history through the ring or by shifting all of it. Then, for the
+ * high-rate mode, the handover of events between threads and resampling a
+ * frame of three sensors at 400 Hz.
+ */
+#include <stdio.h>
+
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <vector>
+
+#include "history_ring.h"
+#include "sensor_event_ring.h"
+#include "sensor_filter.h"
+#include "sensor_resampler.h"
+
+namespace {
+
+const int kHistoryLength = 100;
+const int kChannels = 9;  // three sensors of three axes
+
+// Nanoseconds per call of work, over enough calls to last a while.
+double NsPerCall(const std::function<void()> &work) {
+  const int kCalls = 1000000;
+  auto begin = std::chrono::steady_clock::now();
+  for (int i = 0; i < kCalls; i++) work();
+  return std::chrono::duration<double, std::nano>(
+             std::chrono::steady_clock::now() - begin)
+             .count() /
+         kCalls;
+}
+
+}  // namespace
+
+int main() {
+  std::vector<SensorSample> events(32);
+  for (size_t i = 0; i < events.size(); i++) {
+    events[i] = {float(i), 1.f, -1.f, 0.f};
+  }
+  LowPassFilter filter(0.1f);
+  double batch = NsPerCall([&]() {
+    filter.Apply(events.data(), static_cast<int32_t>(events.size()));
+  });
+  double single = NsPerCall([&]() {
+    for (const SensorSample &event : events) filter.Apply(&event, 1);
+  });
+  printf("filter %zu events: batch %.1f ns, one by one %.1f ns (%.3f)\n",
+         events.size(), batch, single, filter.value().x);
+
+  float row[kChannels] = {};
+  std::vector<float> shifted(kHistoryLength * kChannels);
+  double shift = NsPerCall([&]() {
+    std::copy(shifted.begin() + kChannels, shifted.end(), shifted.begin());
+    std::copy(row, row + kChannels, shifted.end() - kChannels);
+    row[0] += 1.f;
+  });
+  HistoryRing ring(kHistoryLength);
+  std::vector<float> buffer(ring.slots() * kChannels);
+  double pushed = NsPerCall([&]() {
+    HistoryRing::Span spans[HistoryRing::kMaxSpans];
+    int32_t spanCount = ring.Push(1, spans);
+    for (int32_t i = 0; i < spanCount; i++) {
+      std::copy(row + spans[i].sample * kChannels,
+                row + (spans[i].sample + spans[i].count) * kChannels,
+                buffer.begin() + spans[i].slot * kChannels);
+    }
+    row[0] += 1.f;
+  });
+  printf("history of %d frames: shifted %.1f ns, ring %.1f ns per frame\n",
+         kHistoryLength, shift, pushed);
+
+  const int kBatch = 32;
+  SensorEventRing eventRing(4096);
+  TimedSample popped[kBatch];
+  int64_t timestampNs = 0;
+  double handover = NsPerCall([&]() {
+    for (int i = 0; i < kBatch; i++) {
+      eventRing.Push({{1.f, 2.f, 3.f, 0.f}, timestampNs++, i % 3});
+    }
+    eventRing.Pop(popped, kBatch);
+  });
+  printf("event ring: %.1f ns per event pushed and popped\n",
+         handover / kBatch);
+
+  // 400 Hz events of three sensors, 60 Hz frames: 20 events a frame.
+  const int64_t kFrameNs = 1000000000 / 60, kEventNs = 2500000;
+  SensorResampler resamplers[3] = {SensorResampler(kFrameNs),
+                                   SensorResampler(kFrameNs),
+                                   SensorResampler(kFrameNs)};
+  int64_t eventNs = 0, frameNs = 0, outputNs = 0;
+  float sum = 0.f;
+  double resampled = NsPerCall([&]() {
+    frameNs += kFrameNs;
+    for (; eventNs < frameNs; eventNs += kEventNs) {
+      for (SensorResampler &resampler : resamplers) {
+        resampler.Add(eventNs, {float(eventNs & 255), 0.f, 0.f, 0.f});
+      }
+    }
+    for (; outputNs <= resamplers[0].readyUntil(); outputNs += kFrameNs) {
+      for (SensorResampler &resampler : resamplers) {
+        sum += resampler.Sample(outputNs).x;
+      }
+    }
+  });
+  printf("resampling 3 sensors at 400 Hz: %.1f ns per frame (%.0f)\n",
+         resampled, sum);
+  return 0;
+}
@@ -0,0 +1,131 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "sensor_resampler.h"
+
+#include <gtest/gtest.h>
+#include <math.h>
+
+#include <algorithm>
+#include <random>
+
+namespace {
+
+const int64_t kOutputPeriodNs = 1000000000 / 60;
+const int64_t kInputPeriodNs = 2500000;  // 400 Hz
+
+// Feeds two seconds of inputs of value f(t in seconds), at 400 Hz with up
+// to jitterNs of timestamp noise, a display frame at a time as the graph
+// does, and returns the largest difference between the outputs ready after
+// a short warm-up and g(t in seconds).
+template <typename F, typename G>
+float MaxError(F f, G g, int64_t jitterNs = 0) {
+  const int64_t kDurationNs = 2000000000, kWarmUpNs = 100000000;
+  SensorResampler resampler(kOutputPeriodNs);
+  std::mt19937 random(42);
+  std::uniform_int_distribution<int64_t> jitter(-jitterNs, jitterNs);
+  int64_t inputNs = 0, outputNs = kWarmUpNs;
+  float error = 0.f;
+  for (int64_t frameNs = 0; frameNs < kDurationNs;
+       frameNs += kOutputPeriodNs) {
+    for (; inputNs < frameNs; inputNs += kInputPeriodNs) {
+      int64_t timestampNs = inputNs + jitter(random);
+      float value = f(timestampNs * 1e-9);
+      resampler.Add(timestampNs, {value, -value, 1.f, 0.f});
+    }
+    if (resampler.empty()) continue;
+    for (; outputNs <= resampler.readyUntil(); outputNs += kOutputPeriodNs) {
+      SensorSample value = resampler.Sample(outputNs);
+      error = std::max(error, std::fabs(value.x - g(outputNs * 1e-9)));
+      EXPECT_FLOAT_EQ(value.y, -value.x);
+      EXPECT_NEAR(value.z, 1.f, 1e-5f);
+    }
+  }
+  EXPECT_GT(outputNs, kDurationNs - 4 * kOutputPeriodNs);
+  return error;
+}
+
+TEST(SensorResamplerTest, KeepsAConstant) {
+  auto constant = [](double) { return 9.81f; };
+  EXPECT_LT(MaxError(constant, constant), 1e-4f);
+}
+
+TEST(SensorResamplerTest, FollowsSlowMotion) {
+  auto wave = [](double t) { return float(sin(2 * M_PI * 2 * t)); };
+  EXPECT_LT(MaxError(wave, wave), 0.05f);
+}
+
+// Motion faster than half the display rate can't be shown: it must fade
+// instead of turning into a slow, false wave. Taking the input closest to
+// each frame would show this 55 Hz wave as a 5 Hz one of full amplitude.
+TEST(SensorResamplerTest, StopsMotionAboveTheDisplayNyquistRate) {
+  auto wave = [](double t) { return float(sin(2 * M_PI * 55 * t)); };
+  EXPECT_LT(MaxError(wave, [](double) { return 0.f; }), 0.05f);
+}
+
+TEST(SensorResamplerTest, AllowsUnevenTimestamps) {
+  auto wave = [](double t) { return float(sin(2 * M_PI * 2 * t)); };
+  EXPECT_LT(MaxError(wave, wave, kInputPeriodNs / 3), 0.05f);
+}
+
+TEST(SensorResamplerTest, WorksAtAnyInputRate) {
+  // 50 Hz inputs: fewer than one per output.
+  SensorResampler resampler(kOutputPeriodNs);
+  for (int64_t t = 0; t <= 1000000000; t += 20000000) {
+    resampler.Add(t, {3.f, -3.f, 1.f, 0.f});
+  }
+  float error = 0.f;
+  for (int64_t t = 100000000; t <= resampler.readyUntil();
+       t += kOutputPeriodNs) {
+    error = std::max(error, std::fabs(resampler.Sample(t).x - 3.f));
+  }
+  EXPECT_LT(error, 1e-4f);
+}
+
+TEST(SensorResamplerTest, IsReadyHalfAKernelBeforeTheNewestInput) {
+  SensorResampler resampler(kOutputPeriodNs);
+  EXPECT_TRUE(resampler.empty());
+  resampler.Add(1000000000, {1.f, 0.f, 0.f, 0.f});
+  EXPECT_FALSE(resampler.empty());
+  EXPECT_EQ(resampler.halfWidthNs(), 2 * kOutputPeriodNs);
+  EXPECT_EQ(resampler.readyUntil(), 1000000000 - 2 * kOutputPeriodNs);
+
+  // Inputs not newer than the last one are ignored.
+  resampler.Add(999000000, {2.f, 0.f, 0.f, 0.f});
+  resampler.Add(1000000000, {2.f, 0.f, 0.f, 0.f});
+  EXPECT_EQ(resampler.readyUntil(), 1000000000 - 2 * kOutputPeriodNs);
+  EXPECT_EQ(resampler.Sample(1000000000).x, 1.f);
+}
+
+TEST(SensorResamplerTest, HoldsTheLastInputAcrossAGap) {
+  SensorResampler resampler(kOutputPeriodNs);
+  resampler.Add(0, {1.f, 0.f, 0.f, 0.f});
+  resampler.Add(kInputPeriodNs, {2.f, 0.f, 0.f, 0.f});
+  resampler.Add(5000000000, {5.f, 0.f, 0.f, 0.f});
+  EXPECT_EQ(resampler.Sample(1000000000).x, 2.f);
+  EXPECT_EQ(resampler.Sample(3000000000).x, 2.f);
+}
+
+TEST(SensorResamplerTest, DropsTheOldestInputsPastItsCapacity) {
+  SensorResampler resampler(kOutputPeriodNs, 8);
+  for (int64_t t = 0; t <= 1000000000; t += kInputPeriodNs) {
+    resampler.Add(t, {4.f, 0.f, 0.f, 0.f});
+  }
+  EXPECT_EQ(resampler.readyUntil(), 1000000000 - 2 * kOutputPeriodNs);
+  EXPECT_NEAR(resampler.Sample(resampler.readyUntil()).x, 4.f, 1e-4f);
+}
+
+}  // namespace
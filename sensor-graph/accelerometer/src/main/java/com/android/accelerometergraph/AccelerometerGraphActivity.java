@@ -26,10 +26,20 @@ import javax.microedition.khronos.opengles.GL10;
 
 public class AccelerometerGraphActivity extends Activity {
 
+    // Intent extra adding the gyroscope and the magnetometer to the graph.
+    static final String EXTRA_ALL_SENSORS = "allSensors";
+    // Intent extra capturing the sensors at up to 400 Hz on a native thread,
+    // and resampling them to the display rate.
+    static final String EXTRA_HIGH_RATE = "highRate";
+
     GLSurfaceView mView;
 
     @Override protected void onCreate(Bundle icicle) {
         super.onCreate(icicle);
+        final boolean allSensors =
+                getIntent().getBooleanExtra(EXTRA_ALL_SENSORS, false);
+        final boolean highRate =
+                getIntent().getBooleanExtra(EXTRA_HIGH_RATE, false);
         mView = new GLSurfaceView(getApplication());
         mView.setEGLContextClientVersion(2);
         mView.setRenderer(new GLSurfaceView.Renderer() {
@@ -51,7 +61,7 @@ public class AccelerometerGraphActivity extends Activity {
         mView.queueEvent(new Runnable() {
             @Override
             public void run() {
-                AccelerometerGraphJNI.init(getAssets());
+                AccelerometerGraphJNI.init(getAssets(), allSensors, highRate);
             }
         });
 	    setContentView(mView);
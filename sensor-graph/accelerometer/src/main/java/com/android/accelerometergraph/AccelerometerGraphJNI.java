@@ -26,7 +26,8 @@ public class AccelerometerGraphJNI {
          System.loadLibrary("accelerometergraph");
      }
 
-     public static native void init(AssetManager assetManager);
+     public static native void init(AssetManager assetManager, boolean allSensors,
+                                   boolean highRate);
      public static native void surfaceCreated();
      public static native void surfaceChanged(int width, int height);
      public static native void drawFrame();